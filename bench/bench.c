@@ -0,0 +1,625 @@
+#include "service.h"
+#include "protocol.h"
+#include "ethercat.h"
+#include "logging.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <getopt.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+#define BENCH_RUNS              5
+#define BENCH_NS_RETRIES        2
+#define BENCH_TARGET_NS         20000000ULL
+#define BENCH_MAX_CASES         32
+#define BENCH_SLAVES            64
+#define BENCH_SIGNALS           4096
+#define BENCH_SYMBOLS           4096
+#define BENCH_IMAGE_BYTES       16384
+#define BENCH_RMW_OPS           64
+#define BENCH_SCHEDULED         64
+
+typedef void (*bench_fn_t)(uint64_t iterations);
+
+typedef struct {
+    const char *name;
+    bench_fn_t fn;
+} bench_case_t;
+
+typedef struct {
+    char name[64];
+    double ns_per_op;
+    double instr_per_op;
+} bench_result_t;
+
+static service_context_t g_ctx;
+static udp_command_t g_cmd_pdo_read;
+static udp_command_t g_cmd_diag_slave;
+static udp_response_t g_resp;
+static struct sockaddr_in g_clients[MAX_CLIENTS];
+static uint8_t g_image[BENCH_IMAGE_BYTES];
+static signal_program_t g_windowed;
+static char g_symbol_names[BENCH_SYMBOLS][SYMBOL_NAME_LEN];
+static volatile uint32_t g_sink;
+static int g_perf_fd = -1;
+
+#define BENCH_CLOBBER() __asm__ volatile("" ::: "memory")
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static void open_instruction_counter(void) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(attr);
+    attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    
+    g_perf_fd = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+    if (g_perf_fd < 0) {
+        // ENOENT usually means a VM without a virtual PMU
+        fprintf(stderr, "Instruction counter unavailable (%s), gating on ns/op\n",
+                strerror(errno));
+    }
+}
+
+static void build_command(udp_command_t *cmd, uint8_t type, uint8_t id, const void *payload,
+                          uint16_t len) {
+    memset(cmd, 0, sizeof(udp_command_t));
+    cmd->magic = htonl(PROTOCOL_MAGIC_CMD);
+    cmd->command_type = type;
+    cmd->command_id = id;
+    cmd->payload_len = htons(len);
+    memcpy(cmd->payload, payload, len);
+}
+
+static int setup_context(void) {
+    memset(&g_ctx, 0, sizeof(g_ctx));
+    config_set_defaults(&g_ctx.config);
+    // update_client_32 measures a lookup of the last client slot
+    g_ctx.config.security.max_clients = MAX_CLIENTS;
+    
+    if (pthread_mutex_init(&g_ctx.client_lock, NULL) != 0 ||
+        pthread_mutex_init(&g_ctx.ec_ctx.slave_table_lock, NULL) != 0 ||
+        mailbox_init(&g_ctx.mailbox) < 0 ||
+        metrics_init(&g_ctx.metrics, NULL) < 0) {
+        return -1;
+    }
+    supervisor_init(&g_ctx.supervisor);
+    hotplug_init(&g_ctx.hotplug);
+    g_ctx.pdo_buffer.mask = PDO_BUFFER_SIZE - 1;
+    
+    // A running network with a full slave table and process image
+    ethercat_context_t *ec = &g_ctx.ec_ctx;
+    ec->network_active = true;
+    ec->slave_count = BENCH_SLAVES;
+    ec->input_size = ec->output_size = BENCH_SLAVES * 8;
+    ec->pdo_input = calloc(1, ec->input_size);
+    ec->pdo_output = calloc(1, ec->output_size);
+    if (!ec->pdo_input || !ec->pdo_output) return -1;
+    
+    for (uint32_t i = 0; i < BENCH_SLAVES; i++) {
+        ec->slaves[i].slave_id = i + 1;
+        snprintf(ec->slaves[i].name, sizeof(ec->slaves[i].name), "EL%04u", 1000 + i);
+        ec->slaves[i].vendor_id = 2;
+        ec->slaves[i].product_code = 0x03E83052 + i;
+        ec->slaves[i].online = true;
+        ec->slaves[i].al_state = 8;
+        ec->slaves[i].input_size = ec->slaves[i].output_size = 8;
+    }
+    
+    // A signal table mixing every type across the whole input image
+    static signal_def_t defs[BENCH_SIGNALS];
+    static uint32_t slave_base[BENCH_SLAVES];
+    for (uint32_t i = 0; i < BENCH_SIGNALS; i++) {
+        signal_def_t *def = &defs[i];
+        memset(def, 0, sizeof(*def));
+        snprintf(def->name, sizeof(def->name), "sig%u", i);
+        def->slave = (uint16_t)(i % BENCH_SLAVES + 1);
+        def->type = (signal_type_t)(i % SIGNAL_TYPE_COUNT);
+        def->offset = (i / BENCH_SLAVES) % 4;
+        def->bit = (uint8_t)(i % 8);
+        def->scale = 0.1f;
+        def->filter = (i % 2) ? 0.25f : 1.0f;
+    }
+    for (uint32_t i = 0; i < BENCH_SLAVES; i++) {
+        slave_base[i] = i * 8;
+    }
+    if (signals_compile(&g_ctx.signals, defs, BENCH_SIGNALS, 1) < 0) return -1;
+    signals_link(&g_ctx.signals, ec->pdo_input, ec->input_size, slave_base, BENCH_SLAVES);
+    
+    // The same table with windowed aggregation, sealing every 100 evaluations
+    if (signals_compile(&g_windowed, defs, BENCH_SIGNALS, 1) < 0 ||
+        signals_enable_windows(&g_windowed, 100, 16) < 0) {
+        return -1;
+    }
+    signals_link(&g_windowed, ec->pdo_input, ec->input_size, slave_base, BENCH_SLAVES);
+    
+    changemap_init(&g_ctx.changes);
+    changemap_update(&g_ctx.changes, g_image, sizeof(g_image));
+    
+    // Conditions spread over the whole image; none of them ever fires
+    events_init(&g_ctx.events);
+    for (uint32_t i = 0; i < EVENT_MAX_CONDITIONS; i++) {
+        event_condition_t cond;
+        memset(&cond, 0, sizeof(cond));
+        cond.offset = (uint16_t)(i * (BENCH_IMAGE_BYTES / EVENT_MAX_CONDITIONS));
+        cond.type = SIGNAL_UINT16;
+        cond.kind = EVENT_ABOVE;
+        cond.threshold = 1e9;
+        uint32_t id;
+        if (events_add(&g_ctx.events, &cond, &id) < 0) return -1;
+    }
+    if (events_compile(&g_ctx.events, g_image, sizeof(g_image), NULL, 0) < 0) return -1;
+    events_evaluate(&g_ctx.events, g_image, sizeof(g_image), &g_ctx.changes, 0, 0);
+    
+    // The per-cycle worst case: every scope armed with every channel in use
+    scope_init(&g_ctx.scopes);
+    for (uint32_t i = 0; i < SCOPE_MAX; i++) {
+        int id = scope_create(&g_ctx.scopes, &g_clients[0], 1024, 256, 1);
+        if (id < 0) return -1;
+        scope_t *scope = &g_ctx.scopes.scopes[id];
+        for (uint32_t ch = 0; ch < SCOPE_MAX_CHANNELS; ch++) {
+            scope_field_t field = { 0, (uint16_t)(i * 512 + ch * 4), SIGNAL_INT32, 0 };
+            if (scope_add_channel(scope, &field) < 0) return -1;
+        }
+        scope_field_t trigger = { 0, (uint16_t)(i * 512), SIGNAL_INT32, 0 };
+        if (scope_set_trigger(scope, &trigger, EVENT_ABOVE, 1e12) < 0 ||
+            scope_arm(scope, sizeof(g_image), NULL, 0) < 0) {
+            return -1;
+        }
+    }
+    
+    // A large mapping: 8 slaves with 256 16-bit entries in each direction
+    symbol_table_t *symbols = &g_ctx.ec_ctx.symbols;
+    for (uint32_t i = 0; i < BENCH_SYMBOLS; i++) {
+        uint16_t slave = (uint16_t)(i / 512 + 1);
+        symbol_dir_t dir = (i % 2) ? SYMBOL_OUTPUT : SYMBOL_INPUT;
+        uint8_t subindex = (uint8_t)((i / 2) % 256);
+        if (symbols_add_entry(symbols, slave, dir, dir == SYMBOL_INPUT ? 0x6000 : 0x7000, subindex,
+                              (i / 2) * 16, 16) < 0) {
+            return -1;
+        }
+        snprintf(g_symbol_names[i], SYMBOL_NAME_LEN, "%s",
+                 symbols_name(symbols, &symbols->entries[i]));
+    }
+    if (symbols_build(symbols) < 0) return -1;
+    
+    rmw_init(&g_ctx.rmw);
+    schedule_init(&g_ctx.schedule, 1000);
+    if (snapshot_init(&g_ctx.snapshots) < 0) return -1;
+    
+    // A private segment, unlinked at once so nothing is left behind
+    char shm_name[64];
+    snprintf(shm_name, sizeof(shm_name), "/etherforge-bench-%d", (int)getpid());
+    if (retain_init(&g_ctx.retain, shm_name, 0) < 0) return -1;
+    shm_unlink(shm_name);
+    retain_slave_t retained = { 0, 0, BENCH_IMAGE_BYTES, BENCH_IMAGE_BYTES };
+    if (retain_attach(&g_ctx.retain, &retained, 1, g_image, sizeof(g_image)) < 0) return -1;
+    
+    uint32_t pdo[4] = { htonl(3), htonl(0), htonl(4), 0 };
+    build_command(&g_cmd_pdo_read, CMD_CATEGORY_PDO, PDO_READ, pdo, sizeof(pdo));
+    
+    uint32_t slave = htonl(5);
+    build_command(&g_cmd_diag_slave, CMD_CATEGORY_DIAGNOSTIC, DIAG_SLAVE, &slave, sizeof(slave));
+    
+    // Fill every client slot; lookups below hit the last one
+    for (uint32_t i = 0; i < MAX_CLIENTS; i++) {
+        g_clients[i].sin_family = AF_INET;
+        g_clients[i].sin_addr.s_addr = htonl(0x7F000001);
+        g_clients[i].sin_port = htons((uint16_t)(40000 + i));
+        update_client(&g_ctx, &g_clients[i]);
+    }
+    
+    return 0;
+}
+
+static void bench_validate_command(uint64_t n) {
+    for (uint64_t i = 0; i < n; i++) {
+        g_sink += protocol_validate_command(&g_cmd_pdo_read);
+        BENCH_CLOBBER();
+    }
+}
+
+static void bench_extract_pdo_op(uint64_t n) {
+    pdo_operation_t op;
+    for (uint64_t i = 0; i < n; i++) {
+        g_sink += protocol_extract_pdo_op(&g_cmd_pdo_read, &op);
+        BENCH_CLOBBER();
+    }
+}
+
+static void bench_create_response(uint64_t n) {
+    uint8_t payload[8] = {1, 2, 3, 4, 5, 6, 7, 8};
+    for (uint64_t i = 0; i < n; i++) {
+        protocol_create_response(&g_resp, STATUS_SUCCESS, ERR_NONE, payload, sizeof(payload));
+        BENCH_CLOBBER();
+    }
+}
+
+static void bench_command_diag_slave(uint64_t n) {
+    for (uint64_t i = 0; i < n; i++) {
+        g_sink += handle_client_command(&g_ctx, &g_cmd_diag_slave, &g_resp, &g_clients[0]);
+        BENCH_CLOBBER();
+    }
+}
+
+static void bench_command_pdo_read(uint64_t n) {
+    for (uint64_t i = 0; i < n; i++) {
+        g_sink += handle_client_command(&g_ctx, &g_cmd_pdo_read, &g_resp, &g_clients[0]);
+        BENCH_CLOBBER();
+    }
+}
+
+static void bench_update_client(uint64_t n) {
+    for (uint64_t i = 0; i < n; i++) {
+        g_sink += update_client(&g_ctx, &g_clients[MAX_CLIENTS - 1]);
+        BENCH_CLOBBER();
+    }
+}
+
+static void bench_signals_evaluate(uint64_t n) {
+    uint8_t *image = g_ctx.ec_ctx.pdo_input;
+    for (uint64_t i = 0; i < n; i++) {
+        image[i % g_ctx.ec_ctx.input_size] ^= 0x5A;
+        signals_evaluate(&g_ctx.signals, image);
+        BENCH_CLOBBER();
+    }
+}
+
+static void bench_signals_windowed(uint64_t n) {
+    uint8_t *image = g_ctx.ec_ctx.pdo_input;
+    for (uint64_t i = 0; i < n; i++) {
+        image[i % g_ctx.ec_ctx.input_size] ^= 0x5A;
+        signals_evaluate(&g_windowed, image);
+        BENCH_CLOBBER();
+    }
+}
+
+static void bench_symbols_find(uint64_t n) {
+    for (uint64_t i = 0; i < n; i++) {
+        uint32_t handle;
+        g_sink += symbols_find(&g_ctx.ec_ctx.symbols, g_symbol_names[(i * 7919) % BENCH_SYMBOLS],
+                               &handle) != NULL;
+        BENCH_CLOBBER();
+    }
+}
+
+// One cycle's worth of queued bit operations, submitted and applied
+static void bench_rmw_apply(uint64_t n) {
+    rmw_op_t op = { RMW_TOGGLE_BITS, 2, false, 0, 0x0101, 0, 0 };
+    for (uint64_t i = 0; i < n; i++) {
+        for (uint32_t k = 0; k < BENCH_RMW_OPS; k++) {
+            op.offset = (uint32_t)((i * 4099 + k * 2) % (BENCH_IMAGE_BYTES - 2));
+            rmw_submit(&g_ctx.rmw, &op, NULL);
+        }
+        rmw_apply(&g_ctx.rmw, g_image, sizeof(g_image));
+        BENCH_CLOBBER();
+    }
+}
+
+// Writes for the next cycle filed into the wheel and applied in one slot
+static void bench_schedule_run(uint64_t n) {
+    schedule_write_t write = { 0, 0, 0x5A5A, 0, 2, 0, -1 };
+    for (uint64_t i = 0; i < n; i++) {
+        for (uint32_t k = 0; k < BENCH_SCHEDULED; k++) {
+            write.cycle = i;
+            write.offset = (uint32_t)((i * 4099 + k * 2) % (BENCH_IMAGE_BYTES - 2));
+            schedule_submit(&g_ctx.schedule, &write, NULL);
+        }
+        schedule_run(&g_ctx.schedule, g_image, sizeof(g_image), i);
+        BENCH_CLOBBER();
+    }
+}
+
+static void bench_snapshot_publish(uint64_t n) {
+    for (uint64_t i = 0; i < n; i++) {
+        snapshot_publish(&g_ctx.snapshots, g_image, SNAPSHOT_MAX_BYTES, i, 0, 3, 3);
+        BENCH_CLOBBER();
+    }
+}
+
+static void bench_retain_store(uint64_t n) {
+    for (uint64_t i = 0; i < n; i++) {
+        retain_store(&g_ctx.retain, g_image, sizeof(g_image), i);
+        BENCH_CLOBBER();
+    }
+}
+
+static void bench_changemap_update(uint64_t n) {
+    for (uint64_t i = 0; i < n; i++) {
+        g_image[(i * 4099) % BENCH_IMAGE_BYTES]++;
+        changemap_update(&g_ctx.changes, g_image, sizeof(g_image));
+        BENCH_CLOBBER();
+    }
+}
+
+static void bench_events_evaluate(uint64_t n) {
+    for (uint64_t i = 0; i < n; i++) {
+        g_image[(i * 4099) % BENCH_IMAGE_BYTES]++;
+        changemap_update(&g_ctx.changes, g_image, sizeof(g_image));
+        events_evaluate(&g_ctx.events, g_image, sizeof(g_image), &g_ctx.changes, i, i);
+        BENCH_CLOBBER();
+    }
+}
+
+static void bench_scope_run(uint64_t n) {
+    for (uint64_t i = 0; i < n; i++) {
+        scope_run(&g_ctx.scopes, g_image, sizeof(g_image), i);
+        BENCH_CLOBBER();
+    }
+}
+
+static void bench_log_filtered(uint64_t n) {
+    for (uint64_t i = 0; i < n; i++) {
+        LOG_DEBUG("filtered message %u", (uint32_t)i);
+        BENCH_CLOBBER();
+    }
+}
+
+static void bench_log_emitted(uint64_t n) {
+    for (uint64_t i = 0; i < n; i++) {
+        LOG_INFO("emitted message %u", (uint32_t)i);
+        BENCH_CLOBBER();
+    }
+}
+
+static const bench_case_t g_cases[] = {
+    { "protocol_validate_command",  bench_validate_command },
+    { "protocol_extract_pdo_op",    bench_extract_pdo_op },
+    { "protocol_create_response",   bench_create_response },
+    { "handle_command_diag_slave",  bench_command_diag_slave },
+    { "handle_command_pdo_read",    bench_command_pdo_read },
+    { "update_client_32",           bench_update_client },
+    { "signals_evaluate_4096",      bench_signals_evaluate },
+    { "signals_windowed_4096",      bench_signals_windowed },
+    { "symbols_find_4096",          bench_symbols_find },
+    { "rmw_apply_64",               bench_rmw_apply },
+    { "schedule_run_64",            bench_schedule_run },
+    { "snapshot_publish_8k",        bench_snapshot_publish },
+    { "retain_store_16k",           bench_retain_store },
+    { "changemap_update_16k",       bench_changemap_update },
+    { "events_evaluate_1024",       bench_events_evaluate },
+    { "scope_run_16x8",             bench_scope_run },
+    { "log_message_filtered",       bench_log_filtered },
+    { "log_message_emitted",        bench_log_emitted },
+};
+
+static void run_case(const bench_case_t *bc, bench_result_t *result) {
+    // Grow the batch until it runs long enough to time reliably
+    uint64_t iterations = 1000;
+    for (;;) {
+        uint64_t start = now_ns();
+        bc->fn(iterations);
+        if (now_ns() - start >= BENCH_TARGET_NS / 10 || iterations >= (1ULL << 32)) break;
+        iterations *= 4;
+    }
+    iterations *= 10;
+    
+    snprintf(result->name, sizeof(result->name), "%s", bc->name);
+    result->ns_per_op = 0;
+    result->instr_per_op = -1;
+    
+    // Best of several runs filters out preemption and frequency ramps
+    for (int run = 0; run < BENCH_RUNS; run++) {
+        if (g_perf_fd >= 0) {
+            ioctl(g_perf_fd, PERF_EVENT_IOC_RESET, 0);
+            ioctl(g_perf_fd, PERF_EVENT_IOC_ENABLE, 0);
+        }
+        
+        uint64_t start = now_ns();
+        bc->fn(iterations);
+        uint64_t elapsed = now_ns() - start;
+        
+        if (g_perf_fd >= 0) {
+            ioctl(g_perf_fd, PERF_EVENT_IOC_DISABLE, 0);
+            uint64_t instructions = 0;
+            if (read(g_perf_fd, &instructions, sizeof(instructions)) == sizeof(instructions)) {
+                double per_op = (double)instructions / (double)iterations;
+                if (result->instr_per_op < 0 || per_op < result->instr_per_op) {
+                    result->instr_per_op = per_op;
+                }
+            }
+        }
+        
+        double ns = (double)elapsed / (double)iterations;
+        if (run == 0 || ns < result->ns_per_op) {
+            result->ns_per_op = ns;
+        }
+    }
+}
+
+static int load_baseline(const char *path, bench_result_t *baseline, int max) {
+    FILE *file = fopen(path, "r");
+    if (!file) return -1;
+    
+    char line[256];
+    int count = 0;
+    
+    while (count < max && fgets(line, sizeof(line), file)) {
+        if (line[0] == '#' || line[0] == '\n') continue;
+        
+        char instr[32];
+        if (sscanf(line, "%63s %lf %31s", baseline[count].name, &baseline[count].ns_per_op,
+                   instr) == 3) {
+            baseline[count].instr_per_op = (instr[0] == '-') ? -1 : atof(instr);
+            count++;
+        }
+    }
+    
+    fclose(file);
+    return count;
+}
+
+static int write_baseline(const char *path, const bench_result_t *results, int count) {
+    FILE *file = fopen(path, "w");
+    if (!file) {
+        fprintf(stderr, "Cannot write baseline %s\n", path);
+        return -1;
+    }
+    
+    fprintf(file, "# name ns_per_op instructions_per_op\n");
+    for (int i = 0; i < count; i++) {
+        if (results[i].instr_per_op >= 0) {
+            fprintf(file, "%s %.2f %.1f\n", results[i].name, results[i].ns_per_op,
+                    results[i].instr_per_op);
+        } else {
+            fprintf(file, "%s %.2f -\n", results[i].name, results[i].ns_per_op);
+        }
+    }
+    
+    fclose(file);
+    printf("Baseline written to %s\n", path);
+    return 0;
+}
+
+static void print_usage(const char *program_name) {
+    printf("Usage: %s [OPTIONS]\n", program_name);
+    printf("  --baseline FILE        Compare against a stored baseline, fail on regression\n");
+    printf("  --write-baseline FILE  Store this run as the new baseline\n");
+    printf("  --tolerance PCT        Allowed instructions/op growth (default: 10)\n");
+    printf("  --ns-tolerance PCT     Allowed ns/op growth without instruction counts (default: 50)\n");
+    printf("  --filter NAME          Run only benchmarks whose name contains NAME\n");
+}
+
+int main(int argc, char *argv[]) {
+    const char *baseline_path = NULL;
+    const char *write_path = NULL;
+    const char *filter = NULL;
+    double tolerance = 10.0;
+    double ns_tolerance = 50.0;
+    
+    static struct option long_options[] = {
+        {"baseline",       required_argument, 0, 'b'},
+        {"write-baseline", required_argument, 0, 'w'},
+        {"tolerance",      required_argument, 0, 't'},
+        {"ns-tolerance",   required_argument, 0, 'n'},
+        {"filter",         required_argument, 0, 'f'},
+        {"help",           no_argument,       0, 'h'},
+        {0, 0, 0, 0}
+    };
+    
+    int c;
+    while ((c = getopt_long(argc, argv, "b:w:t:n:f:h", long_options, NULL)) != -1) {
+        switch (c) {
+            case 'b': baseline_path = optarg; break;
+            case 'w': write_path = optarg; break;
+            case 't': tolerance = atof(optarg); break;
+            case 'n': ns_tolerance = atof(optarg); break;
+            case 'f': filter = optarg; break;
+            case 'h':
+                print_usage(argv[0]);
+                return EXIT_SUCCESS;
+            default:
+                print_usage(argv[0]);
+                return EXIT_FAILURE;
+        }
+    }
+    
+    // Emitted log lines go nowhere so the benchmark measures formatting, not the terminal
+    if (logging_init("/dev/null", "info") < 0 || setup_context() < 0) {
+        fprintf(stderr, "Failed to set up benchmark context\n");
+        return EXIT_FAILURE;
+    }
+    
+    open_instruction_counter();
+    
+    bench_result_t results[BENCH_MAX_CASES];
+    bench_result_t baseline[BENCH_MAX_CASES];
+    int baseline_count = 0;
+    int count = 0;
+    int regressions = 0;
+    int by_ns = 0;
+    int compared = 0;
+    
+    if (baseline_path) {
+        baseline_count = load_baseline(baseline_path, baseline, BENCH_MAX_CASES);
+        if (baseline_count < 0) {
+            fprintf(stderr, "No baseline at %s, reporting only\n", baseline_path);
+            baseline_count = 0;
+        }
+    }
+    
+    printf("%-28s %10s %12s %10s  %s\n", "benchmark", "ns/op", "instr/op", "baseline", "delta");
+    
+    for (size_t i = 0; i < sizeof(g_cases) / sizeof(g_cases[0]); i++) {
+        if (filter && !strstr(g_cases[i].name, filter)) continue;
+        
+        bench_result_t *r = &results[count++];
+        run_case(&g_cases[i], r);
+        
+        char instr[16] = "-";
+        if (r->instr_per_op >= 0) snprintf(instr, sizeof(instr), "%.1f", r->instr_per_op);
+        
+        const bench_result_t *base = NULL;
+        for (int b = 0; b < baseline_count; b++) {
+            if (strcmp(baseline[b].name, r->name) == 0) base = &baseline[b];
+        }
+        
+        if (!base) {
+            printf("%-28s %10.2f %12s %10s\n", r->name, r->ns_per_op, instr, "-");
+            continue;
+        }
+        
+        // Instruction counts are stable across runs and gate tightly. Without
+        // them on both sides, ns/op gates with a tolerance loose enough for
+        // the jitter of a shared or virtual machine
+        bool by_instr = base->instr_per_op > 0 && r->instr_per_op >= 0;
+        double before = by_instr ? base->instr_per_op : base->ns_per_op;
+        double after = by_instr ? r->instr_per_op : r->ns_per_op;
+        double delta = (after - before) * 100.0 / before;
+        
+        // A wall-clock regression has to survive running the case again, so
+        // one pass that was preempted does not fail the build
+        for (int retry = 0; !by_instr && delta > ns_tolerance && retry < BENCH_NS_RETRIES; retry++) {
+            bench_result_t again;
+            run_case(&g_cases[i], &again);
+            if (again.ns_per_op < r->ns_per_op) r->ns_per_op = again.ns_per_op;
+            after = r->ns_per_op;
+            delta = (after - before) * 100.0 / before;
+        }
+        bool regressed = delta > (by_instr ? tolerance : ns_tolerance);
+        
+        compared++;
+        if (regressed) regressions++;
+        if (!by_instr) by_ns++;
+        printf("%-28s %10.2f %12s %10.2f  %+.1f%% %s%s\n", r->name, r->ns_per_op, instr, before,
+               delta, by_instr ? "instr" : "ns", regressed ? "  REGRESSION" : "");
+    }
+    
+    if (write_path && write_baseline(write_path, results, count) < 0) {
+        return EXIT_FAILURE;
+    }
+    
+    if (by_ns > 0) {
+        printf("\n%d benchmark(s) without instruction counts on both sides were gated on ns/op "
+               "(tolerance %.0f%%)\n", by_ns, ns_tolerance);
+    }
+    
+    // A baseline that matches nothing would pass every run, which hides a
+    // renamed benchmark or a broken baseline file
+    if (baseline_path && count > 0 && compared == 0) {
+        fprintf(stderr, "\nNo benchmark matched %s, nothing was gated\n", baseline_path);
+        return EXIT_FAILURE;
+    }
+    
+    if (regressions > 0) {
+        printf("\n%d benchmark(s) regressed against %s\n", regressions, baseline_path);
+        return EXIT_FAILURE;
+    }
+    
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,90 @@
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdatomic.h>
+#include "config.h"
+
+#define CAPTURE_RING_SLOTS      1024
+#define CAPTURE_SNAPLEN         1536
+#define CAPTURE_DRAIN_MS        10
+#define CAPTURE_HOLDOFF_MS      1000
+
+#define CAPTURE_FLAG_HW_TIMESTAMP   0x01
+#define CAPTURE_FLAG_TRIGGER        0x02
+
+typedef enum {
+    CAPTURE_OFF = 0,
+    CAPTURE_CONTINUOUS = 1,
+    CAPTURE_TRIGGERED = 2
+} capture_mode_t;
+
+typedef enum {
+    CAPTURE_TX = 0,
+    CAPTURE_RX = 1
+} capture_dir_t;
+
+typedef enum {
+    CAPTURE_TRIGGER_NONE = 0,
+    CAPTURE_TRIGGER_WKC = 1,
+    CAPTURE_TRIGGER_MISSED = 2,
+    CAPTURE_TRIGGER_MANUAL = 3
+} capture_trigger_t;
+
+typedef struct {
+    uint64_t timestamp_ns;
+    uint16_t length;
+    uint8_t direction;
+    uint8_t flags;
+    uint8_t trigger;
+    uint8_t data[CAPTURE_SNAPLEN];
+} capture_slot_t;
+
+typedef struct {
+    capture_mode_t mode;
+    capture_slot_t *slots;
+    
+    // Single producer (RT thread) / single consumer (capture writer)
+    atomic_uint head;
+    atomic_uint tail;
+    atomic_uint pending_trigger;
+    atomic_bool frozen;
+    uint32_t post_frames;
+    uint32_t post_remaining;
+    uint32_t cycle_overhead_ns;
+    // RT thread only: conditions currently holding, one bit per reason, and
+    // when a condition last fired
+    uint32_t active_conditions;
+    uint64_t last_condition_ns;
+    
+    atomic_uint frames;
+    atomic_uint dropped;
+    atomic_uint triggers;
+    atomic_uint files_written;
+    
+    char dir[256];
+    uint64_t file_limit;
+    uint32_t max_files;
+    FILE *file;
+    uint64_t file_bytes;
+    uint32_t file_index;
+} capture_context_t;
+
+int capture_init(capture_context_t *cap, const capture_config_t *config);
+void capture_cleanup(capture_context_t *cap);
+
+uint64_t capture_timestamp_ns(void);
+void capture_frame(capture_context_t *cap, capture_dir_t dir, const uint8_t *frame, uint32_t len,
+                   uint64_t timestamp_ns, bool hw_timestamp);
+void capture_lrw(capture_context_t *cap, capture_dir_t dir, uint32_t logical_address,
+                 const uint8_t *outputs, uint32_t output_len,
+                 const uint8_t *inputs, uint32_t input_len, int wkc);
+void capture_trigger(capture_context_t *cap, capture_trigger_t reason);
+void capture_condition(capture_context_t *cap, capture_trigger_t reason, bool active);
+uint32_t capture_take_overhead(capture_context_t *cap);
+
+int capture_drain(capture_context_t *cap);
+
+#endif
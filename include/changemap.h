@@ -0,0 +1,43 @@
+#ifndef CHANGEMAP_H
+#define CHANGEMAP_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+
+#define CHANGEMAP_LINE_BYTES    64
+#define CHANGEMAP_MAX_BYTES     17408   // IOmap plus hotplug spare
+#define CHANGEMAP_MAX_LINES     (CHANGEMAP_MAX_BYTES / CHANGEMAP_LINE_BYTES)
+#define CHANGEMAP_WORDS         ((CHANGEMAP_MAX_LINES + 63) / 64)
+
+typedef uint32_t (*changemap_scan_fn)(uint8_t *prev, const uint8_t *cur, uint32_t lines,
+                                      uint64_t *bitmap);
+
+// Written by the RT thread only. `bitmap` holds the lines that changed in
+// the last cycle; other threads use `line_version`, which records the
+// version at which each line last changed and is published with `version`
+typedef struct {
+    uint8_t prev[CHANGEMAP_MAX_BYTES] __attribute__((aligned(CHANGEMAP_LINE_BYTES)));
+    uint64_t bitmap[CHANGEMAP_WORDS];
+    atomic_uint line_version[CHANGEMAP_MAX_LINES];
+    atomic_uint version;
+    atomic_uint lines;
+    
+    const uint8_t *image;
+    uint32_t size;
+    uint32_t changed;
+    changemap_scan_fn scan;
+    const char *kernel;
+} changemap_t;
+
+void changemap_init(changemap_t *cm);
+void changemap_update(changemap_t *cm, const uint8_t *image, uint32_t size);
+
+static inline bool changemap_line_changed(const changemap_t *cm, uint32_t line) {
+    return (cm->bitmap[line / 64] >> (line % 64)) & 1;
+}
+
+uint32_t changemap_since(changemap_t *cm, uint32_t since, uint32_t first_line,
+                         uint8_t *bitmap, uint32_t max_lines, uint32_t *lines);
+
+#endif
@@ -4,10 +4,19 @@
 #include <stdint.h>
 #include <stdbool.h>
 
+#define CONFIG_MAX_PLUGINS 8
+
 typedef struct {
     char interface[32];
     uint32_t cycle_time_us;
     uint32_t timeout_ms;
+    char topology_cache[256];
+    char transport[16];
+    uint32_t busy_poll_us;
+    uint32_t simulate_slaves;
+    uint32_t simulate_slave_bytes;
+    char output_shm[64];
+    uint32_t output_max_age_ms;
 } network_config_t;
 
 typedef struct {
@@ -15,6 +24,8 @@ typedef struct {
     int cpu_affinity[8];
     int cpu_count;
     uint32_t buffer_size;
+    bool trace_enabled;
+    char trace_file[256];
 } performance_config_t;
 
 typedef struct {
@@ -29,11 +40,43 @@ typedef struct {
     uint32_t max_clients;
 } security_config_t;
 
+typedef struct {
+    char mode[16];
+    char dir[256];
+    uint32_t file_mb;
+    uint32_t files;
+    uint32_t post_frames;
+} capture_config_t;
+
+typedef struct {
+    char bind_address[64];
+    uint16_t port;
+    char shm_name[64];
+} metrics_config_t;
+
+typedef struct {
+    char paths[CONFIG_MAX_PLUGINS][256];
+    uint32_t count;
+    uint32_t budget_us;
+    uint32_t overrun_limit;
+} plugin_config_t;
+
+typedef struct {
+    char file[256];
+    uint32_t decimation;
+    uint32_t window_ms;
+    uint32_t window_history;
+} signal_config_t;
+
 typedef struct {
     network_config_t network;
     performance_config_t performance;
     logging_config_t logging;
     security_config_t security;
+    capture_config_t capture;
+    metrics_config_t metrics;
+    plugin_config_t plugins;
+    signal_config_t signals;
 } config_t;
 
 int config_load(config_t *config, const char *filename);
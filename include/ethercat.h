@@ -20,8 +20,13 @@ typedef enum {
 #else
 // Use SOEM's definitions
 typedef int ec_state_t;
+#define EC_STATE_OP EC_STATE_OPERATIONAL
 #endif
 
+#define ETHERCAT_IOMAP_SIZE     16384
+#define ETHERCAT_HOTPLUG_SPARE  1024
+#define ETHERCAT_HOTPLUG_MAX    16
+
 typedef struct {
     uint32_t cycles_total;
     uint32_t cycles_missed;
@@ -30,6 +35,8 @@ typedef struct {
     uint32_t max_cycle_us;
     uint32_t avg_cycle_us;
     uint32_t jitter_us;
+    uint32_t capture_overhead_avg_ns;
+    uint32_t capture_overhead_max_ns;
 } timing_stats_t;
 
 typedef struct {
@@ -50,14 +57,33 @@ int ethercat_configure_slaves(ethercat_context_t *ctx);
 int ethercat_set_state(ethercat_context_t *ctx, ec_state_t state);
 ec_state_t ethercat_get_state(ethercat_context_t *ctx);
 
+int ethercat_attach_slave(ethercat_context_t *ctx, uint32_t position, slave_info_t *info);
+int ethercat_detach_slave(ethercat_context_t *ctx, uint32_t position);
+int ethercat_refresh_symbols(ethercat_context_t *ctx);
+void ethercat_take_symbols(ethercat_context_t *ctx);
+void ethercat_rt_idle(ethercat_context_t *ctx);
+void ethercat_lock_slave_table(ethercat_context_t *ctx);
+void ethercat_unlock_slave_table(ethercat_context_t *ctx);
+bool ethercat_get_slave_info(ethercat_context_t *ctx, uint32_t index, slave_info_t *info);
+
+int ethercat_check_slaves(ethercat_context_t *ctx);
+int ethercat_recover_slave(ethercat_context_t *ctx, uint32_t slave);
+
 int ethercat_process_data(ethercat_context_t *ctx);
 int ethercat_read_pdo(ethercat_context_t *ctx, uint32_t slave, uint32_t offset, 
                      uint32_t size, uint32_t *value);
 int ethercat_write_pdo(ethercat_context_t *ctx, uint32_t slave, uint32_t offset,
                       uint32_t size, uint32_t value);
 
+int ethercat_sdo_read(ethercat_context_t *ctx, uint16_t slave, uint16_t index, uint8_t subindex,
+                      bool complete_access, void *data, uint32_t *size, uint32_t *abort_code);
+int ethercat_sdo_write(ethercat_context_t *ctx, uint16_t slave, uint16_t index, uint8_t subindex,
+                       bool complete_access, const void *data, uint32_t size, uint32_t *abort_code);
+
+void ethercat_record_cycle(uint32_t period_us, bool missed);
 void ethercat_get_timing_stats(timing_stats_t *stats);
 void ethercat_get_error_stats(error_stats_t *stats);
+void ethercat_get_transport_stats(transport_stats_t *stats);
 void ethercat_reset_stats(void);
 
 #ifndef HAVE_SOEM
@@ -0,0 +1,111 @@
+#ifndef EVENTS_H
+#define EVENTS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <netinet/in.h>
+
+#include "signals.h"
+#include "changemap.h"
+
+#define EVENT_MAX_CONDITIONS    1024
+#define EVENT_QUEUE_SIZE        1024
+
+typedef enum {
+    EVENT_RISING = 0x01,
+    EVENT_FALLING = 0x02,
+    EVENT_CHANGE = 0x03,
+    EVENT_ABOVE = 0x04,
+    EVENT_BELOW = 0x05,
+    EVENT_EQUALS = 0x06
+} event_kind_t;
+
+typedef struct {
+    uint32_t id;
+    struct sockaddr_in addr;
+    uint16_t slave;
+    uint16_t offset;
+    signal_type_t type;
+    uint8_t bit;
+    event_kind_t kind;
+    double threshold;
+    double hysteresis;
+} event_condition_t;
+
+// Compiled by the network thread, evaluated by the RT thread. Conditions are
+// sorted by id, and each 64-byte line of the input image lists the
+// conditions that read from it
+typedef struct {
+    uint32_t count;
+    uint32_t *id;
+    const uint8_t **src;
+    uint8_t *type;
+    uint8_t *bit;
+    uint8_t *kind;
+    double *threshold;
+    double *rearm;
+    double *last;
+    uint8_t *armed;
+    
+    uint32_t lines;
+    uint32_t *line_start;
+    uint32_t *line_cond;
+    
+    const uint8_t *image;
+    uint32_t image_size;
+    bool primed;
+} event_table_t;
+
+typedef struct {
+    uint32_t id;
+    uint8_t type;
+    uint32_t raw;
+    uint64_t cycle;
+    uint64_t timestamp_ns;
+} event_record_t;
+
+// Conditions belong to the network thread. Tables are handed to the RT
+// thread through `pending` and returned through `retired`; events come back
+// through a single-producer, single-consumer queue
+typedef struct {
+    event_condition_t conditions[EVENT_MAX_CONDITIONS];
+    uint32_t count;
+    uint32_t next_id;
+    bool dirty;
+    const uint8_t *compiled_image;
+    uint32_t compiled_size;
+    
+    _Atomic(event_table_t*) pending;
+    _Atomic(event_table_t*) retired;
+    event_table_t *active;
+    
+    event_record_t queue[EVENT_QUEUE_SIZE];
+    atomic_uint_fast64_t head;
+    atomic_uint_fast64_t tail;
+    
+    atomic_uint_fast64_t fired;
+    atomic_uint_fast64_t dropped;
+    uint64_t sent;
+    atomic_uint last_eval_ns;
+    atomic_uint max_eval_ns;
+} event_registry_t;
+
+void events_init(event_registry_t *reg);
+void events_cleanup(event_registry_t *reg);
+
+int events_add(event_registry_t *reg, const event_condition_t *cond, uint32_t *id);
+int events_remove(event_registry_t *reg, uint32_t id, const struct sockaddr_in *owner);
+uint32_t events_remove_client(event_registry_t *reg, const struct sockaddr_in *owner);
+
+bool events_needs_compile(const event_registry_t *reg, const uint8_t *image, uint32_t size);
+int events_compile(event_registry_t *reg, const uint8_t *image, uint32_t size,
+                   const uint32_t *slave_base, uint32_t slave_count);
+void events_reclaim(event_registry_t *reg);
+bool events_pop(event_registry_t *reg, event_record_t *record);
+const event_condition_t* events_find(const event_registry_t *reg, uint32_t id);
+
+void events_evaluate(event_registry_t *reg, const uint8_t *image, uint32_t size,
+                     const changemap_t *changes, uint64_t cycle, uint64_t cycle_start_ns);
+
+#endif
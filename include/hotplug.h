@@ -0,0 +1,28 @@
+#ifndef HOTPLUG_H
+#define HOTPLUG_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define HOTPLUG_SCAN_MS         1000
+#define HOTPLUG_POLL_MS         100
+
+typedef struct {
+    uint32_t scans;
+    uint32_t last_count;
+    // Working counter when the last scan ran, so a slave that stays missing
+    // does not prompt a rescan every poll
+    int scan_wkc;
+    // Slave count at which an attach last failed; only an explicit scan
+    // retries it
+    uint32_t failed_count;
+    // Slaves were attached but the symbol table has not been rebuilt yet
+    bool symbols_stale;
+    uint32_t slaves_added;
+    uint32_t slaves_removed;
+    uint32_t attach_failures;
+} hotplug_context_t;
+
+void hotplug_init(hotplug_context_t *hp);
+
+#endif
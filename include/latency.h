@@ -0,0 +1,30 @@
+#ifndef LATENCY_H
+#define LATENCY_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "config.h"
+
+#define LATENCY_HIST_BUCKETS    1000
+#define LATENCY_LOAD_PERIOD_US  50
+
+typedef struct {
+    uint32_t duration_s;
+    uint32_t budget_us;
+    bool load;
+} latency_test_options_t;
+
+typedef struct {
+    uint64_t samples;
+    uint64_t total_us;
+    uint32_t min_us;
+    uint32_t max_us;
+    uint32_t over_budget;
+    uint32_t overruns;
+    uint32_t hist[LATENCY_HIST_BUCKETS + 1];
+} latency_result_t;
+
+int latency_test_run(const config_t *config, const latency_test_options_t *opts);
+uint32_t latency_percentile(const latency_result_t *result, uint32_t per_100k);
+
+#endif
@@ -18,6 +18,7 @@ typedef enum {
 
 int logging_init(const char *log_file, const char *level_str);
 void logging_cleanup(void);
+void logging_set_level(const char *level_str);
 void log_message(log_level_t level, const char *file, int line, const char *fmt, ...);
 void log_hex_dump(log_level_t level, const char *prefix, const void *data, size_t len);
 
@@ -0,0 +1,85 @@
+#ifndef MAILBOX_H
+#define MAILBOX_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <time.h>
+
+#define MAILBOX_MAX_REQUESTS    64
+#define MAILBOX_MAX_DATA        1024
+#define MAILBOX_MAX_SLAVES      256
+#define MAILBOX_QUEUE_END       (-1)
+#define MAILBOX_FILL_TIMEOUT_S  10
+#define MAILBOX_RESULT_RETENTION_S 60
+#define MAILBOX_ID_WINDOW       65536
+
+#define SDO_FLAG_COMPLETE_ACCESS 0x01
+
+typedef enum {
+    MBX_REQ_FREE = 0,
+    MBX_REQ_FILLING = 1,
+    MBX_REQ_QUEUED = 2,
+    MBX_REQ_ACTIVE = 3,
+    MBX_REQ_DONE = 4,
+    MBX_REQ_FAILED = 5
+} mailbox_req_state_t;
+
+typedef struct {
+    uint32_t request_id;
+    mailbox_req_state_t state;
+    bool write;
+    bool complete_access;
+    uint16_t slave;
+    uint16_t index;
+    uint8_t subindex;
+    uint32_t abort_code;
+    uint32_t size;
+    uint32_t filled;
+    int next;
+    bool fetched;
+    struct timespec submitted;
+    struct timespec finished;
+    uint8_t data[MAILBOX_MAX_DATA];
+} mailbox_request_t;
+
+typedef struct {
+    uint8_t state;
+    uint32_t abort_code;
+    uint32_t size;
+} mailbox_result_t;
+
+typedef struct {
+    mailbox_request_t requests[MAILBOX_MAX_REQUESTS];
+    int queue_head[MAILBOX_MAX_SLAVES + 1];
+    int queue_tail[MAILBOX_MAX_SLAVES + 1];
+    uint32_t rr_slave;
+    uint32_t pending;
+    uint32_t next_request_id;
+    uint32_t completed;
+    uint32_t failed;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+} mailbox_context_t;
+
+int mailbox_init(mailbox_context_t *mbx);
+void mailbox_cleanup(mailbox_context_t *mbx);
+void mailbox_wake(mailbox_context_t *mbx);
+
+int mailbox_submit_read(mailbox_context_t *mbx, uint16_t slave, uint16_t index, uint8_t subindex,
+                        bool complete_access, uint32_t max_size, uint32_t *request_id);
+int mailbox_submit_write(mailbox_context_t *mbx, uint16_t slave, uint16_t index, uint8_t subindex,
+                         bool complete_access, uint32_t total_size,
+                         const void *data, uint32_t len, uint32_t *request_id);
+int mailbox_append_data(mailbox_context_t *mbx, uint32_t request_id, uint32_t offset,
+                        const void *data, uint32_t len, uint32_t *filled);
+// Returns -2 for a request that was issued but whose result has since been
+// recycled, and -1 for an id that is not known at all
+int mailbox_get_result(mailbox_context_t *mbx, uint32_t request_id, uint32_t offset,
+                       mailbox_result_t *result, void *data, uint32_t max_len, uint32_t *len);
+
+mailbox_request_t* mailbox_next_request(mailbox_context_t *mbx, uint32_t timeout_ms);
+void mailbox_complete_request(mailbox_context_t *mbx, mailbox_request_t *req,
+                              bool success, uint32_t size, uint32_t abort_code);
+
+#endif
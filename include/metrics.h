@@ -0,0 +1,74 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdatomic.h>
+
+#define METRICS_MAGIC           0x544D4645
+#define METRICS_VERSION         2
+#define METRICS_HIST_BUCKETS    20
+#define METRICS_HIST_BASE_NS    256
+#define METRICS_CATEGORIES      9
+#define METRICS_COMMANDS        16
+#define METRICS_CLIENTS         32
+#define METRICS_RESPONSE_SIZE   (128 * 1024)
+
+// Bucket i counts samples up to METRICS_HIST_BASE_NS << i; the last bucket is +Inf
+typedef struct {
+    atomic_uint buckets[METRICS_HIST_BUCKETS + 1];
+    atomic_ullong count;
+    atomic_ullong sum_ns;
+} metrics_hist_t;
+
+// Layout of the shared-memory stats page. Writers only use relaxed atomics,
+// so readers in other processes see torn totals at worst, never locks.
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t size;
+    uint32_t pid;
+    
+    atomic_ullong cycles_total;
+    atomic_ullong cycles_missed;
+    atomic_ullong wkc_errors;
+    metrics_hist_t cycle_period;
+    metrics_hist_t cycle_exec;
+    
+    metrics_hist_t commands[METRICS_CATEGORIES][METRICS_COMMANDS];
+    atomic_ullong command_errors;
+    atomic_ullong invalid_packets;
+    
+    atomic_uint client_addr[METRICS_CLIENTS];
+    atomic_uint client_port[METRICS_CLIENTS];
+    atomic_ullong client_packets[METRICS_CLIENTS];
+    
+    atomic_uint network_active;
+    atomic_uint slaves_total;
+    atomic_uint slaves_online;
+    atomic_uint clients_active;
+    atomic_uint pdo_queue_depth;
+    atomic_uint mailbox_queue_depth;
+    atomic_uint capture_queue_depth;
+} metrics_t;
+
+typedef struct {
+    metrics_t *page;
+    bool shared;
+    char shm_name[64];
+    int listen_fd;
+} metrics_context_t;
+
+int metrics_init(metrics_context_t *mc, const char *shm_name);
+void metrics_cleanup(metrics_context_t *mc);
+int metrics_listen(metrics_context_t *mc, const char *bind_address, uint16_t port);
+
+void metrics_hist_record(metrics_hist_t *hist, uint64_t value_ns);
+void metrics_record_command(metrics_t *m, uint8_t category, uint8_t command, uint64_t latency_ns,
+                            bool error);
+void metrics_set_client(metrics_t *m, uint32_t slot, uint32_t addr, uint16_t port);
+
+size_t metrics_format_prometheus(const metrics_t *m, char *buf, size_t len);
+
+#endif
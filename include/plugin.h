@@ -0,0 +1,51 @@
+#ifndef PLUGIN_H
+#define PLUGIN_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "config.h"
+#include "plugin_api.h"
+
+#define PLUGIN_MAX              CONFIG_MAX_PLUGINS
+
+typedef struct {
+    char path[256];
+    void *handle;
+    const plugin_descriptor_t *desc;
+    void *state;
+    bool enabled;
+    uint32_t budget_ns;
+    uint32_t consecutive_overruns;
+    
+    uint64_t calls;
+    uint64_t total_ns;
+    uint32_t last_ns;
+    uint32_t max_ns;
+    uint32_t overruns;
+} plugin_t;
+
+typedef struct {
+    plugin_t plugins[PLUGIN_MAX];
+    uint32_t count;
+    uint32_t overrun_limit;
+    uint64_t cycle;
+} plugin_host_t;
+
+typedef struct {
+    char name[32];
+    bool enabled;
+    uint64_t calls;
+    uint32_t avg_ns;
+    uint32_t last_ns;
+    uint32_t max_ns;
+    uint32_t budget_ns;
+    uint32_t overruns;
+} plugin_stats_t;
+
+int plugin_host_init(plugin_host_t *host, const plugin_config_t *config);
+void plugin_host_cleanup(plugin_host_t *host);
+void plugin_host_run(plugin_host_t *host, const uint8_t *inputs, uint32_t input_size,
+                     uint8_t *outputs, uint32_t output_size, int wkc, int expected_wkc);
+int plugin_host_get_stats(const plugin_host_t *host, uint32_t index, plugin_stats_t *stats);
+
+#endif
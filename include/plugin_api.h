@@ -0,0 +1,39 @@
+#ifndef PLUGIN_API_H
+#define PLUGIN_API_H
+
+#include <stdint.h>
+
+// Public interface for cyclic logic plugins. A plugin is a shared object that
+// exports PLUGIN_ENTRY_SYMBOL returning its descriptor. on_cycle runs in the
+// RT thread right after the process image is received; whatever it writes to
+// the output image goes out with the next frame. It must not block, allocate
+// or make syscalls.
+
+#define PLUGIN_API_VERSION      1
+#define PLUGIN_ENTRY_SYMBOL     "etherforge_plugin"
+
+typedef struct {
+    const uint8_t *data;
+    uint32_t size;
+    int32_t wkc;
+    int32_t expected_wkc;
+    uint64_t cycle;
+    uint64_t timestamp_ns;
+} plugin_in_image_t;
+
+typedef struct {
+    uint8_t *data;
+    uint32_t size;
+} plugin_out_image_t;
+
+typedef struct {
+    uint32_t api_version;
+    const char *name;
+    int (*init)(void **state);
+    void (*on_cycle)(void *state, const plugin_in_image_t *in, plugin_out_image_t *out);
+    void (*cleanup)(void *state);
+} plugin_descriptor_t;
+
+typedef const plugin_descriptor_t* (*plugin_entry_fn)(void);
+
+#endif
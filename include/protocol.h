@@ -6,36 +6,108 @@
 
 #define PROTOCOL_MAGIC_CMD      0xEF000001
 #define PROTOCOL_MAGIC_RESP     0xEF800001
+#define PROTOCOL_MAGIC_EVENT    0xEF400001
 #define PROTOCOL_MAX_PAYLOAD    32
 #define PROTOCOL_PORT           2346
 
+#define PDO_WRITE_FLAG_WAIT_SENT    0x01
+#define PDO_SCHEDULE_FLAG_CLAMP     0x01
+#define PDO_SCHEDULE_FLAG_REALTIME  0x02
+#define PDO_SNAPSHOT_FLAG_CYCLE     0x01
+#define PDO_SNAPSHOT_REGIONS_MAX    6
+#define PDO_SNAPSHOT_DATA_MAX       16
+#define SIG_READ_MAX                6
+#define PDO_CHANGES_BITMAP_BYTES    24
+#define SCOPE_READ_MAX              6
+#define SYM_READ_MAX                7
+#define SYM_WRITE_MAX               4
+#define SDO_RESULT_BURST_MAX        52
+
 typedef enum {
     CMD_CATEGORY_NETWORK = 0x01,
     CMD_CATEGORY_PDO = 0x02,
-    CMD_CATEGORY_DIAGNOSTIC = 0x03
+    CMD_CATEGORY_DIAGNOSTIC = 0x03,
+    CMD_CATEGORY_MAILBOX = 0x04,
+    CMD_CATEGORY_SIGNAL = 0x05,
+    CMD_CATEGORY_EVENT = 0x06,
+    CMD_CATEGORY_SCOPE = 0x07,
+    CMD_CATEGORY_SYMBOL = 0x08
 } command_category_t;
 
 typedef enum {
     NET_START = 0x01,
     NET_STOP = 0x02,
     NET_SCAN = 0x03,
-    NET_STATUS = 0x04
+    NET_STATUS = 0x04,
+    NET_RELOAD = 0x05
 } network_command_t;
 
 typedef enum {
     PDO_READ = 0x01,
     PDO_WRITE = 0x02,
     PDO_MONITOR = 0x03,
-    PDO_STOP_MON = 0x04
+    PDO_STOP_MON = 0x04,
+    PDO_CHANGES = 0x05,
+    PDO_SET_BITS = 0x06,
+    PDO_CLEAR_BITS = 0x07,
+    PDO_TOGGLE_BITS = 0x08,
+    PDO_MASKED_WRITE = 0x09,
+    PDO_COMPARE_SWAP = 0x0A,
+    PDO_SCHEDULE = 0x0B,
+    PDO_SCHEDULE_STATUS = 0x0C,
+    PDO_SNAPSHOT = 0x0D
 } pdo_command_t;
 
 typedef enum {
     DIAG_NETWORK = 0x01,
     DIAG_TIMING = 0x02,
     DIAG_ERRORS = 0x03,
-    DIAG_SLAVE = 0x04
+    DIAG_SLAVE = 0x04,
+    DIAG_RECOVERY = 0x05,
+    DIAG_TRANSPORT = 0x06,
+    DIAG_CAPTURE = 0x07,
+    DIAG_TRACE = 0x08,
+    DIAG_WRITE_LATENCY = 0x09,
+    DIAG_PLUGINS = 0x0A
 } diagnostic_command_t;
 
+typedef enum {
+    SDO_READ = 0x01,
+    SDO_WRITE = 0x02,
+    SDO_DATA = 0x03,
+    SDO_RESULT = 0x04
+} mailbox_command_t;
+
+typedef enum {
+    SIG_READ = 0x01,
+    SIG_INFO = 0x02,
+    SIG_WINDOW = 0x03
+} signal_command_t;
+
+typedef enum {
+    EVT_ADD = 0x01,
+    EVT_REMOVE = 0x02,
+    EVT_STATUS = 0x03
+} event_command_t;
+
+typedef enum {
+    SCOPE_CREATE = 0x01,
+    SCOPE_CHANNEL = 0x02,
+    SCOPE_TRIGGER = 0x03,
+    SCOPE_ARM = 0x04,
+    SCOPE_STATUS = 0x05,
+    SCOPE_READ = 0x06,
+    SCOPE_DELETE = 0x07
+} scope_command_t;
+
+typedef enum {
+    SYM_RESOLVE = 0x01,
+    SYM_READ = 0x02,
+    SYM_WRITE = 0x03,
+    SYM_LIST = 0x04,
+    SYM_LAYOUT = 0x05
+} symbol_command_t;
+
 typedef enum {
     STATUS_SUCCESS = 0x00,
     STATUS_ERROR = 0x01
@@ -49,6 +121,10 @@ typedef enum {
     ERR_NETWORK_NOT_READY = 0x04,
     ERR_SLAVE_NOT_FOUND = 0x05,
     ERR_TIMEOUT = 0x06,
+    ERR_QUEUE_FULL = 0x07,
+    ERR_LAYOUT_MISMATCH = 0x08,
+    ERR_TOO_LATE = 0x09,
+    ERR_EXPIRED = 0x0A,
     ERR_INTERNAL = 0xFF
 } error_code_t;
 
@@ -70,6 +146,19 @@ typedef struct {
     uint8_t payload[PROTOCOL_MAX_PAYLOAD];
 } udp_response_t;
 
+// A client may append a request tag to a command; the reply then carries the
+// same tag behind the response, so replies can be matched to requests even
+// when several are in flight. Untagged commands get untagged replies
+typedef struct {
+    udp_command_t cmd;
+    uint32_t tag;
+} udp_tagged_command_t;
+
+typedef struct {
+    udp_response_t resp;
+    uint32_t tag;
+} udp_tagged_response_t;
+
 #pragma pack(pop)
 
 typedef struct {
@@ -77,8 +166,19 @@ typedef struct {
     uint32_t offset;
     uint32_t size;
     uint32_t value;
+    uint32_t flags;
 } pdo_operation_t;
 
+typedef struct {
+    uint16_t slave_id;
+    uint16_t index;
+    uint8_t subindex;
+    uint8_t flags;
+    uint32_t size;
+    const uint8_t *data;
+    uint32_t data_len;
+} sdo_operation_t;
+
 typedef struct {
     uint32_t slave_count;
     bool network_active;
@@ -90,6 +190,7 @@ bool protocol_validate_command(const udp_command_t *cmd);
 void protocol_create_response(udp_response_t *resp, response_status_t status, 
                              error_code_t error, const void *data, uint16_t len);
 bool protocol_extract_pdo_op(const udp_command_t *cmd, pdo_operation_t *op);
+bool protocol_extract_sdo_op(const udp_command_t *cmd, sdo_operation_t *op);
 void protocol_pack_network_status(const network_status_t *status, uint8_t *payload);
 
 #endif
\ No newline at end of file
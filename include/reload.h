@@ -0,0 +1,55 @@
+#ifndef RELOAD_H
+#define RELOAD_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <pthread.h>
+
+#include "config.h"
+
+#define RELOAD_RETIRED_MAX      4
+
+typedef enum {
+    RELOAD_READER_RT = 0,
+    RELOAD_READER_NETWORK,
+    RELOAD_READERS
+} reload_reader_t;
+
+typedef struct {
+    config_t config;
+    uint64_t generation;
+} reload_version_t;
+
+typedef struct {
+    uint64_t generation;
+    uint32_t applied;
+    uint32_t pending;
+} reload_result_t;
+
+// The running configuration, published RCU style: a reload builds a new
+// version and swaps the pointer, readers pick it up at the top of their loop
+// and record the generation they run with. A replaced version is freed once
+// every reader has moved past it, so readers never take a lock
+typedef struct {
+    _Atomic(reload_version_t*) current;
+    atomic_uint_fast64_t seen[RELOAD_READERS];
+    reload_version_t *retired[RELOAD_RETIRED_MAX];
+    pthread_mutex_t lock;
+    char path[256];
+    // Last configuration parsed from the file, so a reload reports what was
+    // edited since then rather than command-line overrides
+    config_t parsed;
+    bool initialized;
+} reload_t;
+
+int reload_init(reload_t *rl, const config_t *config, const char *path);
+void reload_cleanup(reload_t *rl);
+
+const config_t* reload_enter(reload_t *rl, reload_reader_t reader);
+const config_t* reload_current(reload_t *rl);
+
+int reload_config(reload_t *rl, reload_result_t *result);
+void reload_reclaim(reload_t *rl);
+
+#endif
@@ -0,0 +1,69 @@
+#ifndef RETAIN_H
+#define RETAIN_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+
+#define RETAIN_MAGIC            0x54524645  /* "EFRT" */
+#define RETAIN_VERSION          1
+#define RETAIN_MAX_SLAVES       256
+#define RETAIN_MAX_BYTES        16384
+
+// Identity of one slave as it was when the outputs were retained
+typedef struct {
+    uint32_t vendor_id;
+    uint32_t product_code;
+    uint32_t input_size;
+    uint32_t output_size;
+} retain_slave_t;
+
+// One copy of the output image. `tag` is the store number, 0 while the RT
+// thread rewrites the bank
+typedef struct {
+    atomic_uint_fast64_t tag;
+    uint64_t cycle;
+    uint64_t time_ns;
+    uint32_t size;
+    uint32_t reserved;
+    uint8_t data[RETAIN_MAX_BYTES];
+} retain_bank_t;
+
+// Layout of the shared-memory segment. It is never unlinked, so it outlives
+// the daemon; the RT thread alternates between two banks, so a crash in the
+// middle of a store always leaves the previous image intact
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t size;
+    uint32_t pid;
+    uint32_t slave_count;
+    uint32_t output_size;
+    retain_slave_t slaves[RETAIN_MAX_SLAVES];
+    retain_bank_t banks[2];
+} retain_page_t;
+
+typedef struct {
+    retain_page_t *page;
+    char shm_name[64];
+    // Set once the segment is bound to the running topology; until then the
+    // RT thread leaves it alone
+    atomic_bool armed;
+    uint64_t stores;
+    // Images older than this are not restored, 0 for no limit
+    uint32_t max_age_ms;
+    // Only the first start of a process restores; a NET_STOP and NET_START
+    // within one daemon run starts with cleared outputs
+    bool restorable;
+} retain_t;
+
+int retain_init(retain_t *rt, const char *shm_name, uint32_t max_age_ms);
+void retain_cleanup(retain_t *rt);
+
+int retain_attach(retain_t *rt, const retain_slave_t *slaves, uint32_t count, uint8_t *image,
+                  uint32_t size);
+void retain_detach(retain_t *rt);
+
+void retain_store(retain_t *rt, const uint8_t *image, uint32_t size, uint64_t cycle);
+
+#endif
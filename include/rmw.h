@@ -0,0 +1,48 @@
+#ifndef RMW_H
+#define RMW_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+
+#define RMW_QUEUE_SIZE          256
+
+typedef enum {
+    RMW_SET_BITS = 0,
+    RMW_CLEAR_BITS,
+    RMW_TOGGLE_BITS,
+    RMW_MASKED_WRITE,
+    RMW_COMPARE_SWAP
+} rmw_kind_t;
+
+// `mask` is the compare value for RMW_COMPARE_SWAP. `pre` and `applied` are
+// filled in by the RT thread
+typedef struct {
+    uint8_t kind;
+    uint8_t size;
+    bool applied;
+    uint32_t offset;
+    uint32_t mask;
+    uint32_t value;
+    uint32_t pre;
+} rmw_op_t;
+
+// Single producer (network thread) queues operations on the output image,
+// single consumer (RT thread) applies them in order right before the image
+// is sent, so concurrent writers to one word never lose each other's bits.
+// The RT thread advances `done` every cycle, also while the network is down
+typedef struct {
+    rmw_op_t queue[RMW_QUEUE_SIZE];
+    atomic_uint_fast64_t head;
+    atomic_uint_fast64_t done;
+} rmw_queue_t;
+
+void rmw_init(rmw_queue_t *rmw);
+
+int rmw_submit(rmw_queue_t *rmw, const rmw_op_t *op, uint64_t *seq);
+int rmw_submit_batch(rmw_queue_t *rmw, const rmw_op_t *ops, uint32_t count, uint64_t *first_seq);
+int rmw_result(rmw_queue_t *rmw, uint64_t seq, rmw_op_t *result);
+
+void rmw_apply(rmw_queue_t *rmw, uint8_t *image, uint32_t size);
+
+#endif
@@ -0,0 +1,77 @@
+#ifndef SCHEDULE_H
+#define SCHEDULE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+
+#define SCHEDULE_QUEUE_SIZE     256
+#define SCHEDULE_WHEEL_SLOTS    4096
+#define SCHEDULE_MAX_PENDING    4096
+
+// A write whose cycle has passed by the time the RT thread sees it goes out
+// with the next frame instead of being rejected
+#define SCHEDULE_FLAG_CLAMP     0x01
+
+typedef struct {
+    uint64_t cycle;
+    uint32_t offset;
+    uint32_t value;
+    uint32_t seq;
+    uint8_t size;
+    uint8_t flags;
+    int32_t next;
+} schedule_write_t;
+
+// Writes for a given RT cycle. The network thread hands them over through a
+// single-producer ring; the RT thread files them into a timer wheel with one
+// slot per cycle and applies a slot in one go right before its frame is sent.
+// Targets are limited to SCHEDULE_WHEEL_SLOTS cycles ahead, so every entry
+// in the current slot is due
+typedef struct {
+    schedule_write_t queue[SCHEDULE_QUEUE_SIZE];
+    atomic_uint_fast64_t head;
+    atomic_uint_fast64_t done;
+    
+    // RT thread only
+    schedule_write_t pool[SCHEDULE_MAX_PENDING];
+    int32_t free_list;
+    int32_t slot_head[SCHEDULE_WHEEL_SLOTS];
+    int32_t slot_tail[SCHEDULE_WHEEL_SLOTS];
+    
+    // Published by the RT thread: the first cycle a new write can still make,
+    // and when the current cycle started (CLOCK_REALTIME)
+    atomic_uint seqlock;
+    uint64_t next_cycle;
+    uint64_t cycle_start_ns;
+    // Changed by a live reload on the RT thread, read by the network thread
+    atomic_uint cycle_ns;
+    
+    atomic_uint pending;
+    atomic_uint applied;
+    atomic_uint late;
+    atomic_uint overflow;
+    atomic_uint dropped;
+    atomic_uint last_rejected;
+} schedule_t;
+
+typedef struct {
+    uint64_t next_cycle;
+    uint32_t pending;
+    uint32_t applied;
+    uint32_t late;
+    uint32_t overflow;
+    uint32_t dropped;
+    uint32_t last_rejected;
+} schedule_stats_t;
+
+void schedule_init(schedule_t *sched, uint32_t cycle_time_us);
+
+void schedule_now(const schedule_t *sched, uint64_t *next_cycle, uint64_t *cycle_start_ns);
+uint64_t schedule_cycle_at(const schedule_t *sched, uint64_t realtime_ns);
+int schedule_submit(schedule_t *sched, const schedule_write_t *write, uint32_t *seq);
+void schedule_get_stats(const schedule_t *sched, schedule_stats_t *stats);
+
+void schedule_run(schedule_t *sched, uint8_t *image, uint32_t size, uint64_t cycle);
+
+#endif
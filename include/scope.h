@@ -0,0 +1,100 @@
+#ifndef SCOPE_H
+#define SCOPE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <netinet/in.h>
+
+#include "signals.h"
+#include "events.h"
+
+#define SCOPE_MAX               16
+#define SCOPE_MAX_CHANNELS      8
+#define SCOPE_MAX_SAMPLES       16384
+
+// Triggers use the event condition kinds; 0 triggers as soon as armed
+#define SCOPE_TRIGGER_IMMEDIATE 0
+
+// Who owns a scope follows from its state: the network thread configures
+// and reads IDLE and DONE scopes, the RT thread fills ARMED and TRIGGERED ones.
+// The network thread never takes a running scope back itself, it sets
+// stop_request and the RT thread answers by moving the scope to IDLE
+typedef enum {
+    SCOPE_FREE = 0,
+    SCOPE_IDLE = 1,
+    SCOPE_ARMED = 2,
+    SCOPE_TRIGGERED = 3,
+    SCOPE_DONE = 4
+} scope_state_t;
+
+typedef struct {
+    uint16_t slave;
+    uint16_t offset;
+    signal_type_t type;
+    uint8_t bit;
+} scope_field_t;
+
+typedef struct {
+    atomic_int state;
+    atomic_bool stop_request;
+    // Deleted while running: the buffers are freed by scope_reclaim once the
+    // RT thread has let go. Only touched by the network thread
+    bool release;
+    struct sockaddr_in owner;
+    
+    uint32_t samples;
+    uint32_t pretrigger;
+    uint32_t decimation;
+    uint32_t channel_count;
+    scope_field_t channels[SCOPE_MAX_CHANNELS];
+    scope_field_t trigger;
+    uint8_t trigger_kind;
+    double threshold;
+    
+    // Resolved when armed
+    uint32_t channel_offset[SCOPE_MAX_CHANNELS];
+    uint32_t trigger_offset;
+    uint32_t min_image_size;
+    
+    // Channel-major columns of raw samples
+    uint32_t *data;
+    
+    uint32_t write_pos;
+    uint32_t filled;
+    uint32_t post_remaining;
+    uint32_t countdown;
+    bool trigger_primed;
+    double trigger_last;
+    
+    uint64_t trigger_cycle;
+    uint64_t trigger_time_ns;
+    uint32_t start;
+    uint32_t count;
+    uint32_t pre;
+} scope_t;
+
+typedef struct {
+    scope_t scopes[SCOPE_MAX];
+} scope_set_t;
+
+void scope_init(scope_set_t *set);
+void scope_cleanup(scope_set_t *set);
+
+int scope_create(scope_set_t *set, const struct sockaddr_in *owner, uint32_t samples,
+                 uint32_t pretrigger, uint32_t decimation);
+scope_t* scope_get(scope_set_t *set, uint32_t id, const struct sockaddr_in *owner);
+int scope_add_channel(scope_t *scope, const scope_field_t *field);
+int scope_set_trigger(scope_t *scope, const scope_field_t *field, uint8_t kind, double threshold);
+int scope_arm(scope_t *scope, uint32_t image_size, const uint32_t *slave_base,
+              uint32_t slave_count);
+void scope_stop(scope_t *scope);
+void scope_destroy(scope_t *scope);
+uint32_t scope_destroy_client(scope_set_t *set, const struct sockaddr_in *owner);
+void scope_reclaim(scope_set_t *set);
+uint32_t scope_read(const scope_t *scope, uint32_t channel, uint32_t first, uint32_t *out,
+                    uint32_t max);
+
+void scope_run(scope_set_t *set, const uint8_t *image, uint32_t size, uint64_t cycle);
+
+#endif
@@ -4,11 +4,32 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include <pthread.h>
+#include <stdatomic.h>
+#include <time.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
 
 #include "protocol.h"
 #include "config.h"
+#include "mailbox.h"
+#include "supervisor.h"
+#include "hotplug.h"
+#include "transport.h"
+#include "capture.h"
+#include "trace.h"
+#include "metrics.h"
+#include "wirestamp.h"
+#include "plugin.h"
+#include "signals.h"
+#include "changemap.h"
+#include "events.h"
+#include "scope.h"
+#include "symbols.h"
+#include "rmw.h"
+#include "schedule.h"
+#include "snapshot.h"
+#include "retain.h"
+#include "reload.h"
 
 #define MAX_CLIENTS 32
 #define MAX_SLAVES 256
@@ -21,6 +42,48 @@ typedef struct {
     bool active;
 } client_info_t;
 
+#define LAYOUT_BINDINGS_MAX 256
+
+// Set by SYM_LAYOUT: the process image layout a client was built for. Kept
+// by address rather than in the client slot, so a client that timed out or
+// never got a slot is still held to it
+typedef struct {
+    struct sockaddr_in addr;
+    uint32_t hash;
+    uint32_t last_seen;
+} layout_binding_t;
+
+#define DEFERRED_REPLY_MAX 256
+
+typedef enum {
+    DEFER_WIRESTAMP = 0,
+    DEFER_RMW,
+    DEFER_KINDS
+} defer_kind_t;
+
+// A reply the network thread holds back until the RT thread has finished
+// the request it answers, so no handler waits for a cycle
+typedef struct {
+    struct sockaddr_in addr;
+    uint64_t seq;
+    uint64_t deadline_ns;
+    uint32_t tag;
+    bool tagged;
+    // Header of the command the reply answers
+    uint8_t command_type;
+    uint8_t command_id;
+    uint16_t payload_len;
+    // Queue entries the reply covers, starting at `seq`
+    uint8_t count;
+} deferred_reply_t;
+
+// Requests of one kind finish in seq order, so each kind is a FIFO
+typedef struct {
+    deferred_reply_t entries[DEFERRED_REPLY_MAX];
+    uint32_t head;
+    uint32_t count;
+} deferred_queue_t;
+
 typedef struct {
     volatile uint32_t write_idx;
     volatile uint32_t read_idx;
@@ -33,9 +96,12 @@ typedef struct {
     char name[32];
     uint32_t vendor_id;
     uint32_t product_code;
-    bool online;
+    volatile bool online;
+    uint16_t al_state;
     uint32_t input_size;
     uint32_t output_size;
+    uint32_t recovery_count;
+    uint32_t last_recovery_ms;
 } slave_info_t;
 
 typedef struct {
@@ -43,10 +109,41 @@ typedef struct {
     bool network_active;
     uint32_t slave_count;
     slave_info_t slaves[MAX_SLAVES];
+    atomic_uint slave_table_seq;
+    pthread_mutex_t slave_table_lock;
+    // Held around acyclic master access from worker threads and around
+    // start/stop, so no worker talks to a master that is being closed
+    pthread_mutex_t master_lock;
     uint8_t *pdo_input;
     uint8_t *pdo_output;
     uint32_t input_size;
     uint32_t output_size;
+    volatile int last_wkc;
+    int expected_wkc;
+    // DC system time of the last frame, 0 without a reference clock
+    int64_t dc_time;
+    char topology_cache[256];
+    bool warm_start;
+    // Outputs were restored from the retained segment on the last start
+    bool outputs_restored;
+    uint32_t startup_ms;
+    transport_type_t transport;
+    uint32_t busy_poll_us;
+    capture_context_t *capture;
+    wirestamp_t *wirestamp;
+    retain_t *retain;
+    uint32_t sim_slaves;
+    uint32_t sim_slave_bytes;
+    // Owned by the network thread. A table rebuilt after a hot-plug attach
+    // waits in `symbols_update` until the network thread swaps it in
+    symbol_table_t symbols;
+    symbol_table_t symbols_update;
+    atomic_bool symbols_updated;
+    // Set while the RT thread runs. ethercat_stop raises stop_pending after
+    // clearing network_active, and frees the images only once the RT thread
+    // has lowered it from its idle branch
+    atomic_bool rt_running;
+    atomic_bool stop_pending;
 } ethercat_context_t;
 
 typedef struct {
@@ -55,18 +152,50 @@ typedef struct {
     client_info_t clients[MAX_CLIENTS];
     uint32_t client_count;
     pthread_mutex_t client_lock;
+    // Only used by the network thread
+    layout_binding_t layout_bindings[LAYOUT_BINDINGS_MAX];
+    uint32_t layout_binding_count;
     
     pthread_t network_thread;
     pthread_t rt_thread;
     pthread_t mgmt_thread;
+    pthread_t mailbox_thread;
+    pthread_t hotplug_thread;
+    pthread_t capture_thread;
+    pthread_t metrics_thread;
     bool threads_running;
     
     ethercat_context_t ec_ctx;
     pdo_buffer_t pdo_buffer;
+    mailbox_context_t mailbox;
+    supervisor_context_t supervisor;
+    hotplug_context_t hotplug;
+    capture_context_t capture;
+    metrics_context_t metrics;
+    wirestamp_t wirestamp;
+    rmw_queue_t rmw;
+    schedule_t schedule;
+    snapshot_ring_t snapshots;
+    retain_t retain;
+    plugin_host_t plugins;
+    signal_program_t signals;
+    changemap_t changes;
+    event_registry_t events;
+    scope_set_t scopes;
+    uint64_t command_rx_ns;
+    // Request tag of the command being handled, echoed by its reply
+    uint32_t command_tag;
+    bool command_tagged;
+    deferred_queue_t deferred[DEFER_KINDS];
     
+    // `config` is what the service started with; settings that can change
+    // while running are read through `reload`
     config_t config;
+    char config_file[256];
+    reload_t reload;
     
     volatile bool shutdown_requested;
+    volatile bool reload_requested;
 } service_context_t;
 
 int service_init(service_context_t *ctx, const char *config_file);
@@ -76,8 +205,31 @@ void service_cleanup(service_context_t *ctx);
 
 void* network_thread_func(void *arg);
 void* rt_thread_func(void *arg);
+void set_thread_priority(int priority);
+void set_thread_affinity(const int *cpus, int count);
+void rt_advance_deadline(struct timespec *deadline, uint64_t cycle_ns);
+void rt_wait_until(const struct timespec *deadline);
 void* mgmt_thread_func(void *arg);
+void* mailbox_thread_func(void *arg);
+void* hotplug_thread_func(void *arg);
+int hotplug_scan(service_context_t *ctx, bool retry, uint32_t *added, uint32_t *removed);
+void* capture_thread_func(void *arg);
+void* metrics_thread_func(void *arg);
+
+void supervisor_poll(service_context_t *ctx);
+uint32_t service_slave_bases(service_context_t *ctx, uint32_t *base);
+const config_t* service_config(service_context_t *ctx);
+void metrics_update_gauges(service_context_t *ctx);
 
+int update_client(service_context_t *ctx, struct sockaddr_in *client_addr);
+void expire_layout_bindings(service_context_t *ctx, uint32_t now, uint32_t timeout);
+client_info_t* find_client(service_context_t *ctx, const struct sockaddr_in *client_addr);
+bool defer_reply_room(service_context_t *ctx, defer_kind_t kind, uint32_t entries);
+int defer_reply(service_context_t *ctx, defer_kind_t kind, uint64_t seq, uint8_t count,
+                const udp_command_t *cmd, const struct sockaddr_in *client_addr,
+                uint64_t timeout_ns);
+void send_extra_reply(service_context_t *ctx, const udp_response_t *resp,
+                      const struct sockaddr_in *client_addr);
 int handle_client_command(service_context_t *ctx, const udp_command_t *cmd,
                          udp_response_t *resp, struct sockaddr_in *client_addr);
 
@@ -0,0 +1,127 @@
+#ifndef SIGNALS_H
+#define SIGNALS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include "config.h"
+
+#define SIGNAL_MAX              65536
+#define SIGNAL_NAME_LEN         20
+#define SIGNAL_WINDOW_MAX_HISTORY 256
+
+typedef enum {
+    SIGNAL_STAT_MIN = 0,
+    SIGNAL_STAT_MAX,
+    SIGNAL_STAT_MEAN,
+    SIGNAL_STAT_RMS,
+    SIGNAL_STAT_COUNT
+} signal_stat_t;
+
+typedef enum {
+    SIGNAL_BOOL = 0,
+    SIGNAL_UINT8,
+    SIGNAL_INT8,
+    SIGNAL_UINT16,
+    SIGNAL_INT16,
+    SIGNAL_UINT32,
+    SIGNAL_INT32,
+    SIGNAL_FLOAT32,
+    SIGNAL_TYPE_COUNT
+} signal_type_t;
+
+// Declarative definition as loaded from the signal file
+typedef struct {
+    char name[SIGNAL_NAME_LEN];
+    uint16_t slave;
+    uint32_t offset;
+    uint8_t bit;
+    signal_type_t type;
+    float scale;
+    float eu_offset;
+    float filter;
+    float deadband;
+} signal_def_t;
+
+// A sealed aggregation window. `seq` is 0 while the RT thread rewrites the
+// slot, so readers can detect a window overwritten under them
+typedef struct {
+    atomic_uint seq;
+    uint32_t samples;
+    uint64_t end_ns;
+    float *stats[SIGNAL_STAT_COUNT];
+} signal_window_t;
+
+// Compiled program: definitions sorted by type into struct-of-arrays so each
+// type is one tight extraction loop and the arithmetic is one vector loop
+typedef struct {
+    uint32_t count;
+    signal_def_t *defs;
+    
+    uint32_t run_start[SIGNAL_TYPE_COUNT + 1];
+    const uint8_t **src;
+    uint8_t *bit;
+    float *scale;
+    float *eu_offset;
+    float *alpha;
+    float *deadband;
+    float *raw;
+    float *filtered;
+    float *value;
+    uint32_t *slot;
+    uint8_t *valid;
+    
+    uint32_t decimation;
+    uint32_t countdown;
+    bool primed;
+    // Set by signals_compile when the CPU has AVX2 for the arithmetic loops
+    bool avx2;
+    
+    const uint8_t *linked_image;
+    uint32_t linked_size;
+    // Published by signals_link on the RT thread and logged by the
+    // management thread, so linking never logs from the cycle
+    atomic_uint links;
+    atomic_uint unlinked;
+    uint32_t links_reported;
+    
+    uint64_t evaluations;
+    uint32_t last_eval_ns;
+    uint32_t max_eval_ns;
+    
+    // Running aggregates of the unfiltered values, sealed every window_evals
+    uint32_t window_evals;
+    uint32_t window_left;
+    uint32_t window_history;
+    float *agg_min;
+    float *agg_max;
+    double *agg_sum;
+    double *agg_sumsq;
+    signal_window_t *windows;
+    atomic_uint window_seq;
+} signal_program_t;
+
+int signals_load(signal_program_t *prog, const signal_config_t *config, uint32_t cycle_time_us);
+int signals_enable_windows(signal_program_t *prog, uint32_t window_evals, uint32_t history);
+int signals_compile(signal_program_t *prog, const signal_def_t *defs, uint32_t count,
+                    uint32_t decimation);
+void signals_cleanup(signal_program_t *prog);
+
+void signals_link(signal_program_t *prog, const uint8_t *image, uint32_t image_size,
+                  const uint32_t *slave_base, uint32_t slave_count);
+void signals_report_links(signal_program_t *prog);
+void signals_evaluate(signal_program_t *prog, const uint8_t *image);
+void signals_set_rate(signal_program_t *prog, uint32_t decimation, uint32_t window_ms,
+                      uint32_t cycle_time_us);
+
+bool signals_read(const signal_program_t *prog, uint32_t index, float *value);
+int signals_read_window(const signal_program_t *prog, uint32_t seq, signal_stat_t stat,
+                        uint32_t first, uint32_t count, float *values, uint32_t *window_seq,
+                        uint32_t *samples, uint64_t *end_ns);
+const signal_def_t* signals_get_def(const signal_program_t *prog, uint32_t index);
+const char* signals_type_name(signal_type_t type);
+uint32_t signals_type_size(signal_type_t type);
+uint32_t signals_read_raw(const uint8_t *src, signal_type_t type, uint8_t bit);
+double signals_raw_value(signal_type_t type, uint32_t raw);
+
+#endif
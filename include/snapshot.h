@@ -0,0 +1,55 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+
+#define SNAPSHOT_HISTORY        8
+#define SNAPSHOT_MAX_BYTES      8192
+
+#define SNAPSHOT_FLAG_WKC_OK    0x01
+#define SNAPSHOT_FLAG_DC_TIME   0x02
+
+typedef struct {
+    uint32_t offset;
+    uint32_t size;
+} snapshot_region_t;
+
+// One published input image. `tag` is the cycle number plus one, 0 while
+// the RT thread rewrites the slot
+typedef struct {
+    atomic_uint_fast64_t tag;
+    uint64_t time_ns;
+    uint32_t size;
+    uint16_t wkc;
+    uint8_t flags;
+    uint8_t *data;
+} snapshot_slot_t;
+
+typedef struct {
+    uint64_t cycle;
+    uint64_t time_ns;
+    uint16_t wkc;
+    uint8_t flags;
+} snapshot_info_t;
+
+// The RT thread copies each cycle's input image into the next slot, so the
+// last SNAPSHOT_HISTORY cycles can be read whole and untorn while the live
+// image is being overwritten. Buffers are allocated and touched up front
+typedef struct {
+    snapshot_slot_t slots[SNAPSHOT_HISTORY];
+    uint8_t *buffer;
+    atomic_uint_fast64_t latest;
+} snapshot_ring_t;
+
+int snapshot_init(snapshot_ring_t *ring);
+void snapshot_cleanup(snapshot_ring_t *ring);
+
+void snapshot_publish(snapshot_ring_t *ring, const uint8_t *image, uint32_t size, uint64_t cycle,
+                      int64_t dc_time, int wkc, int expected_wkc);
+int snapshot_read(const snapshot_ring_t *ring, bool latest, uint32_t cycle,
+                  const snapshot_region_t *regions, uint32_t count, uint8_t *out,
+                  snapshot_info_t *info);
+
+#endif
@@ -0,0 +1,25 @@
+#ifndef SUPERVISOR_H
+#define SUPERVISOR_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+
+#define SUPERVISOR_MAX_SLAVES       256
+#define SUPERVISOR_POLL_MS          100
+#define SUPERVISOR_FULL_CHECK_TICKS 10
+
+typedef struct {
+    struct timespec down_since[SUPERVISOR_MAX_SLAVES];
+    bool recovering[SUPERVISOR_MAX_SLAVES];
+    uint32_t ticks;
+    uint32_t slaves_down;
+    uint32_t wkc_deviations;
+    uint32_t recoveries;
+    uint32_t last_recovery_ms;
+    uint32_t max_recovery_ms;
+} supervisor_context_t;
+
+void supervisor_init(supervisor_context_t *sup);
+
+#endif
@@ -0,0 +1,71 @@
+#ifndef SYMBOLS_H
+#define SYMBOLS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "rmw.h"
+
+#define SYMBOL_MAX              65535
+#define SYMBOL_NAME_LEN         32
+
+typedef enum {
+    SYMBOL_INPUT = 0,
+    SYMBOL_OUTPUT = 1
+} symbol_dir_t;
+
+// One mapped PDO entry. `type` is a signal_type_t derived from the bit length;
+// values are read and written as `bits` wide fields starting at bit `bit` of
+// byte `offset`, wider entries as their low 32 bits
+typedef struct {
+    uint32_t name;
+    uint16_t slave;
+    uint16_t index;
+    uint8_t subindex;
+    uint8_t dir;
+    uint8_t type;
+    uint8_t bit;
+    uint16_t bits;
+    uint32_t offset;
+} symbol_t;
+
+// Built on the network thread when the network starts. Names live once in
+// `pool`; lookups go through a hash-and-displace perfect hash, so every name
+// is found with two hash steps and a single comparison
+typedef struct {
+    symbol_t *entries;
+    uint32_t count;
+    uint32_t capacity;
+    char *pool;
+    uint32_t pool_used;
+    uint32_t pool_size;
+    
+    uint64_t *hashes;
+    uint16_t *seeds;
+    uint32_t bucket_count;
+    uint32_t *slots;
+    uint32_t slot_mask;
+    
+    // Bumped on every build so handles from an older mapping are refused
+    uint16_t generation;
+    uint32_t layout_hash;
+} symbol_table_t;
+
+void symbols_clear(symbol_table_t *table);
+void symbols_cleanup(symbol_table_t *table);
+
+int symbols_add(symbol_table_t *table, const char *name, const symbol_t *symbol);
+int symbols_add_entry(symbol_table_t *table, uint16_t slave, symbol_dir_t dir, uint16_t index,
+                      uint8_t subindex, uint32_t bit_offset, uint16_t bits);
+int symbols_build(symbol_table_t *table);
+uint32_t symbols_layout_hash(const symbol_table_t *table);
+
+const symbol_t* symbols_find(const symbol_table_t *table, const char *name, uint32_t *handle);
+const symbol_t* symbols_get(const symbol_table_t *table, uint32_t handle);
+uint32_t symbols_handle(const symbol_table_t *table, uint32_t index);
+const char* symbols_name(const symbol_table_t *table, const symbol_t *symbol);
+
+uint32_t symbols_byte_size(const symbol_t *symbol);
+uint32_t symbols_read_value(const symbol_t *symbol, const uint8_t *image);
+uint32_t symbols_write_ops(const symbol_t *symbol, uint32_t value, rmw_op_t ops[2]);
+
+#endif
@@ -0,0 +1,66 @@
+#ifndef TOPOLOGY_H
+#define TOPOLOGY_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define TOPOLOGY_MAGIC          0x45465450  /* "EFTP" */
+#define TOPOLOGY_VERSION        2
+#define TOPOLOGY_MAX_SLAVES     256
+#define TOPOLOGY_MAX_SM         8
+#define TOPOLOGY_MAX_FMMU       4
+#define TOPOLOGY_NAME_LEN       40
+
+typedef struct {
+    uint32_t vendor_id;
+    uint32_t product_code;
+    uint32_t revision;
+    uint16_t config_address;
+    uint16_t output_bits;
+    uint16_t input_bits;
+    uint16_t reserved;
+    uint32_t output_bytes;
+    uint32_t input_bytes;
+    uint32_t output_offset;
+    uint32_t input_offset;
+    uint16_t sm_start[TOPOLOGY_MAX_SM];
+    uint16_t sm_length[TOPOLOGY_MAX_SM];
+    uint32_t sm_flags[TOPOLOGY_MAX_SM];
+    uint8_t sm_type[TOPOLOGY_MAX_SM];
+    uint8_t has_dc;
+    uint8_t pad[3];
+    int32_t dc_delay_ns;
+    // What a cold start reads from the SII or derives from the port
+    // registers, so a warm start can configure the slave without them
+    uint16_t mbx_write_offset;
+    uint16_t mbx_write_length;
+    uint16_t mbx_read_offset;
+    uint16_t mbx_read_length;
+    uint16_t mbx_proto;
+    uint16_t parent;
+    uint8_t fmmu_func[TOPOLOGY_MAX_FMMU];
+    uint8_t coe_details;
+    uint8_t topology;
+    uint8_t active_ports;
+    uint8_t port_types;
+    char name[TOPOLOGY_NAME_LEN];
+} topology_slave_t;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t slave_count;
+    uint32_t iomap_size;
+    uint32_t input_size;
+    uint32_t output_size;
+    uint32_t checksum;
+    uint32_t reserved;
+    topology_slave_t slaves[TOPOLOGY_MAX_SLAVES];
+} topology_snapshot_t;
+
+int topology_load(const char *path, topology_snapshot_t *snap);
+int topology_save(const char *path, topology_snapshot_t *snap);
+bool topology_slave_matches(const topology_snapshot_t *snap, uint32_t index,
+                            uint32_t vendor_id, uint32_t product_code, uint32_t revision);
+
+#endif
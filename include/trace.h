@@ -0,0 +1,65 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+
+#define TRACE_RING_EVENTS       8192
+#define TRACE_MAX_THREADS       8
+
+typedef enum {
+    TRACE_CYCLE = 0,
+    TRACE_OUTPUT_COPY,
+    TRACE_SEND,
+    TRACE_RECEIVE,
+    TRACE_INPUT_COPY,
+    TRACE_CAPTURE,
+    TRACE_SUPERVISOR,
+    TRACE_COMMAND,
+    TRACE_PLUGINS,
+    TRACE_SIGNALS,
+    TRACE_CHANGES,
+    TRACE_EVENTS,
+    TRACE_SCOPE,
+    TRACE_PHASE_COUNT
+} trace_phase_t;
+
+typedef enum {
+    TRACE_ACTION_STATUS = 0,
+    TRACE_ACTION_ENABLE = 1,
+    TRACE_ACTION_DISABLE = 2,
+    TRACE_ACTION_EXPORT = 3
+} trace_action_t;
+
+typedef struct {
+    uint64_t tsc;
+    uint16_t phase;
+    uint16_t begin;
+} trace_event_t;
+
+typedef struct {
+    char name[16];
+    int tid;
+    atomic_uint head;
+    trace_event_t events[TRACE_RING_EVENTS];
+} trace_ring_t;
+
+extern volatile bool g_trace_enabled;
+
+// With tracing off each tracepoint is a single, statically predicted branch
+#define TRACE_BEGIN(phase) \
+    do { if (__builtin_expect(g_trace_enabled, 0)) trace_record((phase), true); } while (0)
+#define TRACE_END(phase) \
+    do { if (__builtin_expect(g_trace_enabled, 0)) trace_record((phase), false); } while (0)
+
+int trace_init(bool enabled);
+void trace_cleanup(void);
+void trace_register_thread(const char *name);
+void trace_set_enabled(bool enabled);
+void trace_record(trace_phase_t phase, bool begin);
+
+uint32_t trace_event_count(void);
+int trace_export_chrome(const char *filename);
+
+#endif
@@ -0,0 +1,68 @@
+#ifndef TRANSPORT_H
+#define TRANSPORT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <time.h>
+#include "capture.h"
+
+#define TRANSPORT_FRAME_SIZE        2048
+#define TRANSPORT_BLOCK_SIZE        4096
+#define TRANSPORT_RX_FRAMES         256
+#define TRANSPORT_TX_FRAMES         64
+#define TRANSPORT_MAX_SEGMENTS      8
+#define TRANSPORT_MAX_DATA          1450
+// SOEM matches replies to its own buffers by index alone and uses the indexes
+// below EC_MAXBUF (16), so cyclic frames take every index above that
+#define TRANSPORT_INDEX_BASE        0x10
+#define TRANSPORT_INDEX_COUNT       (256 - TRANSPORT_INDEX_BASE)
+#define TRANSPORT_RTT_BUCKETS       1000
+
+typedef enum {
+    TRANSPORT_SOEM = 0,
+    TRANSPORT_MMAP = 1
+} transport_type_t;
+
+typedef struct {
+    uint32_t frames_sent;
+    uint32_t frames_received;
+    uint32_t rx_timeouts;
+    uint32_t stale_frames;
+    uint32_t rtt_samples;
+    uint32_t rtt_max_us;
+    uint32_t rtt_hist[TRANSPORT_RTT_BUCKETS + 1];
+} transport_stats_t;
+
+typedef struct {
+    int fd;
+    int ifindex;
+    uint8_t src_mac[6];
+    uint8_t *ring;
+    size_t ring_size;
+    uint8_t *rx_ring;
+    uint8_t *tx_ring;
+    uint32_t rx_frame;
+    uint32_t tx_frame;
+    uint8_t next_index;
+    uint32_t busy_poll_us;
+    struct timespec last_tx_time;
+    struct timespec last_rx_time;
+    capture_context_t *capture;
+} transport_t;
+
+transport_type_t transport_parse_type(const char *name);
+int transport_open(transport_t *t, const char *ifname, uint32_t busy_poll_us);
+void transport_close(transport_t *t);
+int transport_exchange(transport_t *t, transport_stats_t *stats, uint32_t logical_address,
+                       uint8_t *data, uint32_t len, uint16_t dc_address, int64_t *dc_time,
+                       uint32_t timeout_us);
+uint32_t transport_format_frame(uint8_t *frame, const uint8_t *src_mac, uint8_t index,
+                                uint32_t logical_address, const uint8_t *data, uint32_t len,
+                                const uint8_t *extra, uint32_t extra_len, uint16_t dc_address,
+                                uint16_t wkc);
+
+void transport_record_rtt(transport_stats_t *stats, uint32_t rtt_us);
+uint32_t transport_rtt_percentile(const transport_stats_t *stats, uint32_t permille);
+
+#endif
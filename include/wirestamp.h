@@ -0,0 +1,62 @@
+#ifndef WIRESTAMP_H
+#define WIRESTAMP_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+
+#define WIRESTAMP_QUEUE_SIZE        256
+#define WIRESTAMP_BUCKETS           2000
+#define WIRESTAMP_BUCKETS_PER_CYCLE 500
+#define WIRESTAMP_WAIT_CYCLES       4
+
+// `sent` is false for a write retired while the network was down
+typedef struct {
+    uint64_t rx_ns;
+    uint32_t latency_ns;
+    bool sent;
+} wirestamp_entry_t;
+
+// Single producer (network thread) marks accepted writes, single consumer
+// (RT thread) stamps them with the send time of the cycle that carries them
+typedef struct {
+    wirestamp_entry_t queue[WIRESTAMP_QUEUE_SIZE];
+    atomic_uint_fast64_t head;
+    atomic_uint_fast64_t done;
+    uint64_t batch_end;
+    atomic_bool reset_pending;
+    
+    // Changed by a live reload on the RT thread, read by the network thread
+    atomic_uint cycle_ns;
+    uint32_t bucket_ns;
+    uint32_t hist[WIRESTAMP_BUCKETS + 1];
+    uint64_t total_ns;
+    atomic_uint samples;
+    atomic_uint dropped;
+    atomic_uint max_ns;
+} wirestamp_t;
+
+typedef struct {
+    uint32_t samples;
+    uint32_t dropped;
+    uint32_t p50_us;
+    uint32_t p99_us;
+    uint32_t p999_us;
+    uint32_t max_us;
+    uint32_t mean_us;
+} wirestamp_stats_t;
+
+void wirestamp_init(wirestamp_t *ws, uint32_t cycle_time_us);
+uint64_t wirestamp_now_ns(void);
+
+int wirestamp_mark(wirestamp_t *ws, uint64_t rx_ns, uint64_t *seq);
+int wirestamp_result(wirestamp_t *ws, uint64_t seq, bool *sent, uint32_t *latency_ns);
+
+void wirestamp_latch(wirestamp_t *ws);
+void wirestamp_complete(wirestamp_t *ws, uint64_t tx_ns);
+void wirestamp_idle(wirestamp_t *ws);
+
+void wirestamp_reset(wirestamp_t *ws);
+void wirestamp_get_stats(wirestamp_t *ws, wirestamp_stats_t *stats);
+
+#endif
@@ -0,0 +1,48 @@
+#include "plugin_api.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Minimal example: mirrors the first input word into the first output word
+// plus one, and counts cycles where the working counter was short. A slave
+// that loops outputs back to inputs sees a counter advancing every cycle.
+
+typedef struct {
+    uint32_t wkc_faults;
+} heartbeat_state_t;
+
+static int heartbeat_init(void **state) {
+    *state = calloc(1, sizeof(heartbeat_state_t));
+    return *state ? 0 : -1;
+}
+
+static void heartbeat_on_cycle(void *state, const plugin_in_image_t *in, plugin_out_image_t *out) {
+    heartbeat_state_t *hb = (heartbeat_state_t*)state;
+    
+    if (in->wkc != in->expected_wkc) {
+        hb->wkc_faults++;
+        return;
+    }
+    
+    if (in->size < 4 || out->size < 4) return;
+    
+    uint32_t value;
+    memcpy(&value, in->data, sizeof(value));
+    value++;
+    memcpy(out->data, &value, sizeof(value));
+}
+
+static void heartbeat_cleanup(void *state) {
+    free(state);
+}
+
+static const plugin_descriptor_t heartbeat_plugin = {
+    .api_version = PLUGIN_API_VERSION,
+    .name = "heartbeat",
+    .init = heartbeat_init,
+    .on_cycle = heartbeat_on_cycle,
+    .cleanup = heartbeat_cleanup
+};
+
+const plugin_descriptor_t* etherforge_plugin(void) {
+    return &heartbeat_plugin;
+}
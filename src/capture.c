@@ -0,0 +1,395 @@
+#include "capture.h"
+#include "service.h"
+#include "transport.h"
+#include "logging.h"
+#include <string.h>
+#include <strings.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <time.h>
+#include <errno.h>
+
+#define PCAPNG_BLOCK_SHB        0x0A0D0D0A
+#define PCAPNG_BLOCK_IDB        0x00000001
+#define PCAPNG_BLOCK_EPB        0x00000006
+#define PCAPNG_BYTE_ORDER       0x1A2B3C4D
+#define PCAPNG_LINKTYPE_ETHER   1
+#define PCAPNG_OPT_END          0
+#define PCAPNG_OPT_COMMENT      1
+#define PCAPNG_OPT_EPB_FLAGS    2
+#define PCAPNG_OPT_TSRESOL      9
+#define PCAPNG_FLAG_INBOUND     0x1
+#define PCAPNG_FLAG_OUTBOUND    0x2
+
+static const char *trigger_names[] = { "none", "wkc", "missed-cycle", "manual" };
+
+static capture_mode_t parse_mode(const char *mode) {
+    if (!mode) return CAPTURE_OFF;
+    if (strcasecmp(mode, "continuous") == 0) return CAPTURE_CONTINUOUS;
+    if (strcasecmp(mode, "trigger") == 0) return CAPTURE_TRIGGERED;
+    return CAPTURE_OFF;
+}
+
+int capture_init(capture_context_t *cap, const capture_config_t *config) {
+    if (!cap || !config) return -1;
+    
+    memset(cap, 0, sizeof(capture_context_t));
+    cap->mode = parse_mode(config->mode);
+    if (cap->mode == CAPTURE_OFF) return 0;
+    
+    // Preallocate and touch the whole ring so the RT path never faults
+    cap->slots = malloc(CAPTURE_RING_SLOTS * sizeof(capture_slot_t));
+    if (!cap->slots) {
+        LOG_ERROR("Failed to allocate capture ring");
+        cap->mode = CAPTURE_OFF;
+        return -1;
+    }
+    memset(cap->slots, 0, CAPTURE_RING_SLOTS * sizeof(capture_slot_t));
+    
+    snprintf(cap->dir, sizeof(cap->dir), "%s", config->dir[0] ? config->dir : ".");
+    cap->file_limit = (uint64_t)(config->file_mb ? config->file_mb : 1) * 1024 * 1024;
+    cap->max_files = config->files ? config->files : 1;
+    cap->post_frames = config->post_frames;
+    
+    LOG_INFO("Frame capture enabled (%s) to %s",
+             cap->mode == CAPTURE_CONTINUOUS ? "continuous" : "trigger", cap->dir);
+    return 0;
+}
+
+void capture_cleanup(capture_context_t *cap) {
+    if (!cap) return;
+    
+    if (cap->file) {
+        fclose(cap->file);
+        cap->file = NULL;
+    }
+    
+    free(cap->slots);
+    cap->slots = NULL;
+    cap->mode = CAPTURE_OFF;
+}
+
+uint64_t capture_timestamp_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static uint64_t monotonic_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static capture_slot_t* reserve_slot(capture_context_t *cap) {
+    if (atomic_load_explicit(&cap->frozen, memory_order_acquire)) {
+        atomic_fetch_add_explicit(&cap->dropped, 1, memory_order_relaxed);
+        return NULL;
+    }
+    
+    uint32_t head = atomic_load_explicit(&cap->head, memory_order_relaxed);
+    
+    // Continuous mode never overwrites frames the writer has not drained;
+    // trigger mode keeps overwriting the oldest history until frozen.
+    if (cap->mode == CAPTURE_CONTINUOUS &&
+        head - atomic_load_explicit(&cap->tail, memory_order_acquire) >= CAPTURE_RING_SLOTS) {
+        atomic_fetch_add_explicit(&cap->dropped, 1, memory_order_relaxed);
+        return NULL;
+    }
+    
+    capture_slot_t *slot = &cap->slots[head % CAPTURE_RING_SLOTS];
+    slot->flags = 0;
+    slot->trigger = CAPTURE_TRIGGER_NONE;
+    return slot;
+}
+
+static void commit_slot(capture_context_t *cap, capture_slot_t *slot) {
+    uint32_t reason = atomic_exchange_explicit(&cap->pending_trigger, CAPTURE_TRIGGER_NONE,
+                                               memory_order_relaxed);
+    if (reason != CAPTURE_TRIGGER_NONE) {
+        slot->flags |= CAPTURE_FLAG_TRIGGER;
+        slot->trigger = (uint8_t)reason;
+        atomic_fetch_add_explicit(&cap->triggers, 1, memory_order_relaxed);
+    }
+    
+    atomic_store_explicit(&cap->head, atomic_load_explicit(&cap->head, memory_order_relaxed) + 1,
+                          memory_order_release);
+    atomic_fetch_add_explicit(&cap->frames, 1, memory_order_relaxed);
+    
+    if (cap->mode != CAPTURE_TRIGGERED) return;
+    
+    // Keep recording post_frames after the trigger, then hand the window to the writer
+    if (reason != CAPTURE_TRIGGER_NONE && cap->post_remaining == 0) {
+        cap->post_remaining = cap->post_frames + 1;
+    }
+    
+    if (cap->post_remaining > 0 && --cap->post_remaining == 0) {
+        atomic_store_explicit(&cap->frozen, true, memory_order_release);
+    }
+}
+
+void capture_frame(capture_context_t *cap, capture_dir_t dir, const uint8_t *frame, uint32_t len,
+                   uint64_t timestamp_ns, bool hw_timestamp) {
+    if (!cap || cap->mode == CAPTURE_OFF) return;
+    
+    uint64_t start = monotonic_ns();
+    capture_slot_t *slot = reserve_slot(cap);
+    
+    if (slot) {
+        if (len > CAPTURE_SNAPLEN) len = CAPTURE_SNAPLEN;
+        memcpy(slot->data, frame, len);
+        slot->length = (uint16_t)len;
+        slot->direction = (uint8_t)dir;
+        slot->timestamp_ns = timestamp_ns ? timestamp_ns : capture_timestamp_ns();
+        if (hw_timestamp) slot->flags |= CAPTURE_FLAG_HW_TIMESTAMP;
+        commit_slot(cap, slot);
+    }
+    
+    cap->cycle_overhead_ns += (uint32_t)(monotonic_ns() - start);
+}
+
+// Used where the frame itself is not visible (SOEM's socket, stub mode):
+// format the equivalent LRW datagram directly into the ring slot.
+void capture_lrw(capture_context_t *cap, capture_dir_t dir, uint32_t logical_address,
+                 const uint8_t *outputs, uint32_t output_len,
+                 const uint8_t *inputs, uint32_t input_len, int wkc) {
+    if (!cap || cap->mode == CAPTURE_OFF) return;
+    
+    uint64_t start = monotonic_ns();
+    capture_slot_t *slot = reserve_slot(cap);
+    
+    if (slot) {
+        if (output_len > TRANSPORT_MAX_DATA) output_len = TRANSPORT_MAX_DATA;
+        if (input_len > TRANSPORT_MAX_DATA - output_len) input_len = TRANSPORT_MAX_DATA - output_len;
+        
+        slot->length = (uint16_t)transport_format_frame(slot->data, NULL, 0, logical_address,
+                                                        outputs, output_len, inputs, input_len, 0,
+                                                        (uint16_t)(wkc > 0 ? wkc : 0));
+        slot->direction = (uint8_t)dir;
+        slot->timestamp_ns = capture_timestamp_ns();
+        commit_slot(cap, slot);
+    }
+    
+    cap->cycle_overhead_ns += (uint32_t)(monotonic_ns() - start);
+}
+
+void capture_trigger(capture_context_t *cap, capture_trigger_t reason) {
+    if (!cap || cap->mode == CAPTURE_OFF) return;
+    
+    atomic_store_explicit(&cap->pending_trigger, (uint32_t)reason, memory_order_relaxed);
+}
+
+// Called by the RT thread every cycle with the state of a fault condition.
+// Only the cycle a condition starts fires a trigger, and not within
+// CAPTURE_HOLDOFF_MS of the last one, so a lasting fault writes one window
+void capture_condition(capture_context_t *cap, capture_trigger_t reason, bool active) {
+    if (!cap || cap->mode != CAPTURE_TRIGGERED) return;
+    
+    uint32_t bit = 1u << reason;
+    if (!active) {
+        cap->active_conditions &= ~bit;
+        return;
+    }
+    if (cap->active_conditions & bit) return;
+    cap->active_conditions |= bit;
+    
+    uint64_t now = monotonic_ns();
+    if (cap->last_condition_ns && now - cap->last_condition_ns < CAPTURE_HOLDOFF_MS * 1000000ULL) {
+        return;
+    }
+    cap->last_condition_ns = now;
+    capture_trigger(cap, reason);
+}
+
+uint32_t capture_take_overhead(capture_context_t *cap) {
+    if (!cap || cap->mode == CAPTURE_OFF) return 0;
+    
+    uint32_t ns = cap->cycle_overhead_ns;
+    cap->cycle_overhead_ns = 0;
+    return ns;
+}
+
+static void write_block(capture_context_t *cap, uint32_t type, const void *body, uint32_t body_len) {
+    uint32_t total = 12 + body_len;
+    
+    fwrite(&type, 4, 1, cap->file);
+    fwrite(&total, 4, 1, cap->file);
+    fwrite(body, 1, body_len, cap->file);
+    fwrite(&total, 4, 1, cap->file);
+    cap->file_bytes += total;
+}
+
+static int open_file(capture_context_t *cap, const char *prefix, uint32_t index) {
+    char path[320];
+    snprintf(path, sizeof(path), "%s/%s-%04u.pcapng", cap->dir, prefix, index);
+    
+    cap->file = fopen(path, "wb");
+    if (!cap->file) {
+        LOG_ERROR("Failed to open capture file %s: %s", path, strerror(errno));
+        return -1;
+    }
+    cap->file_bytes = 0;
+    
+    uint8_t shb[16];
+    uint32_t magic = PCAPNG_BYTE_ORDER;
+    uint16_t major = 1, minor = 0;
+    int64_t section_len = -1;
+    memcpy(shb, &magic, 4);
+    memcpy(shb + 4, &major, 2);
+    memcpy(shb + 6, &minor, 2);
+    memcpy(shb + 8, &section_len, 8);
+    write_block(cap, PCAPNG_BLOCK_SHB, shb, sizeof(shb));
+    
+    // Link type, snaplen and nanosecond timestamp resolution
+    uint8_t idb[20] = {0};
+    uint16_t linktype = PCAPNG_LINKTYPE_ETHER;
+    uint32_t snaplen = CAPTURE_SNAPLEN;
+    uint16_t opt_code = PCAPNG_OPT_TSRESOL, opt_len = 1;
+    memcpy(idb, &linktype, 2);
+    memcpy(idb + 4, &snaplen, 4);
+    memcpy(idb + 8, &opt_code, 2);
+    memcpy(idb + 10, &opt_len, 2);
+    idb[12] = 9;
+    write_block(cap, PCAPNG_BLOCK_IDB, idb, sizeof(idb));
+    
+    LOG_DEBUG("Capture file %s opened", path);
+    return 0;
+}
+
+static void close_file(capture_context_t *cap) {
+    if (!cap->file) return;
+    
+    fclose(cap->file);
+    cap->file = NULL;
+    atomic_fetch_add_explicit(&cap->files_written, 1, memory_order_relaxed);
+}
+
+static void write_slot(capture_context_t *cap, const capture_slot_t *slot) {
+    uint8_t body[28 + CAPTURE_SNAPLEN + 64];
+    uint32_t padded = (slot->length + 3u) & ~3u;
+    uint32_t ts_high = (uint32_t)(slot->timestamp_ns >> 32);
+    uint32_t ts_low = (uint32_t)slot->timestamp_ns;
+    uint32_t caplen = slot->length;
+    uint32_t iface = 0;
+    
+    memcpy(body, &iface, 4);
+    memcpy(body + 4, &ts_high, 4);
+    memcpy(body + 8, &ts_low, 4);
+    memcpy(body + 12, &caplen, 4);
+    memcpy(body + 16, &caplen, 4);
+    memcpy(body + 20, slot->data, slot->length);
+    memset(body + 20 + slot->length, 0, padded - slot->length);
+    
+    uint32_t pos = 20 + padded;
+    uint16_t code = PCAPNG_OPT_EPB_FLAGS, len = 4;
+    uint32_t flags = (slot->direction == CAPTURE_RX) ? PCAPNG_FLAG_INBOUND : PCAPNG_FLAG_OUTBOUND;
+    memcpy(body + pos, &code, 2);
+    memcpy(body + pos + 2, &len, 2);
+    memcpy(body + pos + 4, &flags, 4);
+    pos += 8;
+    
+    if (slot->flags & (CAPTURE_FLAG_TRIGGER | CAPTURE_FLAG_HW_TIMESTAMP)) {
+        char comment[48];
+        int n = snprintf(comment, sizeof(comment), "%s%s%s",
+                         (slot->flags & CAPTURE_FLAG_TRIGGER) ? "trigger: " : "",
+                         (slot->flags & CAPTURE_FLAG_TRIGGER) ? trigger_names[slot->trigger & 3] : "",
+                         (slot->flags & CAPTURE_FLAG_HW_TIMESTAMP) ? " hw-timestamp" : "");
+        code = PCAPNG_OPT_COMMENT;
+        len = (uint16_t)n;
+        memcpy(body + pos, &code, 2);
+        memcpy(body + pos + 2, &len, 2);
+        memset(body + pos + 4, 0, (n + 3u) & ~3u);
+        memcpy(body + pos + 4, comment, (size_t)n);
+        pos += 4 + ((n + 3u) & ~3u);
+    }
+    
+    memset(body + pos, 0, 4);
+    pos += 4;
+    
+    write_block(cap, PCAPNG_BLOCK_EPB, body, pos);
+}
+
+// Keep only the newest max_files files of a kind
+static void remove_oldest(capture_context_t *cap, const char *prefix) {
+    if (cap->file_index < cap->max_files) return;
+    
+    char old[320];
+    snprintf(old, sizeof(old), "%s/%s-%04u.pcapng", cap->dir, prefix,
+             cap->file_index - cap->max_files);
+    unlink(old);
+}
+
+static int drain_continuous(capture_context_t *cap) {
+    uint32_t tail = atomic_load_explicit(&cap->tail, memory_order_relaxed);
+    uint32_t head = atomic_load_explicit(&cap->head, memory_order_acquire);
+    int written = 0;
+    
+    while (tail != head) {
+        if (!cap->file) {
+            if (open_file(cap, "capture", cap->file_index) < 0) return -1;
+            
+            remove_oldest(cap, "capture");
+            cap->file_index++;
+        }
+        
+        write_slot(cap, &cap->slots[tail % CAPTURE_RING_SLOTS]);
+        tail++;
+        atomic_store_explicit(&cap->tail, tail, memory_order_release);
+        written++;
+        
+        if (cap->file_bytes >= cap->file_limit) {
+            close_file(cap);
+        }
+    }
+    
+    if (cap->file) fflush(cap->file);
+    return written;
+}
+
+static int drain_window(capture_context_t *cap) {
+    if (!atomic_load_explicit(&cap->frozen, memory_order_acquire)) return 0;
+    
+    uint32_t head = atomic_load_explicit(&cap->head, memory_order_relaxed);
+    uint32_t count = head < CAPTURE_RING_SLOTS ? head : CAPTURE_RING_SLOTS;
+    
+    if (open_file(cap, "trigger", cap->file_index) == 0) {
+        remove_oldest(cap, "trigger");
+        cap->file_index++;
+        for (uint32_t i = head - count; i != head; i++) {
+            write_slot(cap, &cap->slots[i % CAPTURE_RING_SLOTS]);
+        }
+        close_file(cap);
+        LOG_INFO("Capture trigger window of %u frames written", count);
+    }
+    
+    atomic_store_explicit(&cap->tail, head, memory_order_relaxed);
+    atomic_store_explicit(&cap->frozen, false, memory_order_release);
+    return (int)count;
+}
+
+int capture_drain(capture_context_t *cap) {
+    if (!cap || cap->mode == CAPTURE_OFF) return 0;
+    
+    return (cap->mode == CAPTURE_CONTINUOUS) ? drain_continuous(cap) : drain_window(cap);
+}
+
+void* capture_thread_func(void *arg) {
+    service_context_t *ctx = (service_context_t*)arg;
+    capture_context_t *cap = &ctx->capture;
+    
+    if (cap->mode == CAPTURE_OFF) return NULL;
+    
+    LOG_INFO("Capture writer thread starting");
+    
+    while (ctx->threads_running && !ctx->shutdown_requested) {
+        usleep(CAPTURE_DRAIN_MS * 1000);
+        capture_drain(cap);
+    }
+    
+    capture_drain(cap);
+    close_file(cap);
+    
+    LOG_INFO("Capture writer thread stopping (%u frames, %u dropped)",
+             atomic_load(&cap->frames), atomic_load(&cap->dropped));
+    return NULL;
+}
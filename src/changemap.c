@@ -0,0 +1,183 @@
+#include "changemap.h"
+#include "logging.h"
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define CHANGEMAP_X86 1
+#endif
+
+// Each kernel compares whole lines, records the changed ones in the bitmap
+// and copies them into the previous image
+static uint32_t scan_scalar(uint8_t *prev, const uint8_t *cur, uint32_t lines,
+                            uint64_t *bitmap) {
+    uint32_t changed = 0;
+    
+    for (uint32_t line = 0; line < lines; line++) {
+        uint8_t *p = prev + line * CHANGEMAP_LINE_BYTES;
+        const uint8_t *c = cur + line * CHANGEMAP_LINE_BYTES;
+        uint64_t diff = 0;
+        
+        for (int i = 0; i < CHANGEMAP_LINE_BYTES; i += 8) {
+            uint64_t a, b;
+            memcpy(&a, p + i, 8);
+            memcpy(&b, c + i, 8);
+            diff |= a ^ b;
+        }
+        
+        if (diff) {
+            bitmap[line / 64] |= 1ULL << (line % 64);
+            memcpy(p, c, CHANGEMAP_LINE_BYTES);
+            changed++;
+        }
+    }
+    
+    return changed;
+}
+
+#ifdef CHANGEMAP_X86
+__attribute__((target("sse2")))
+static uint32_t scan_sse2(uint8_t *prev, const uint8_t *cur, uint32_t lines, uint64_t *bitmap) {
+    uint32_t changed = 0;
+    
+    for (uint32_t line = 0; line < lines; line++) {
+        __m128i *p = (__m128i*)(prev + line * CHANGEMAP_LINE_BYTES);
+        const __m128i *c = (const __m128i*)(cur + line * CHANGEMAP_LINE_BYTES);
+        
+        __m128i c0 = _mm_loadu_si128(c);
+        __m128i c1 = _mm_loadu_si128(c + 1);
+        __m128i c2 = _mm_loadu_si128(c + 2);
+        __m128i c3 = _mm_loadu_si128(c + 3);
+        __m128i diff = _mm_or_si128(
+            _mm_or_si128(_mm_xor_si128(c0, _mm_load_si128(p)),
+                         _mm_xor_si128(c1, _mm_load_si128(p + 1))),
+            _mm_or_si128(_mm_xor_si128(c2, _mm_load_si128(p + 2)),
+                         _mm_xor_si128(c3, _mm_load_si128(p + 3))));
+        
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(diff, _mm_setzero_si128())) != 0xFFFF) {
+            bitmap[line / 64] |= 1ULL << (line % 64);
+            _mm_store_si128(p, c0);
+            _mm_store_si128(p + 1, c1);
+            _mm_store_si128(p + 2, c2);
+            _mm_store_si128(p + 3, c3);
+            changed++;
+        }
+    }
+    
+    return changed;
+}
+
+__attribute__((target("avx2")))
+static uint32_t scan_avx2(uint8_t *prev, const uint8_t *cur, uint32_t lines, uint64_t *bitmap) {
+    uint32_t changed = 0;
+    
+    for (uint32_t line = 0; line < lines; line++) {
+        __m256i *p = (__m256i*)(prev + line * CHANGEMAP_LINE_BYTES);
+        const __m256i *c = (const __m256i*)(cur + line * CHANGEMAP_LINE_BYTES);
+        
+        __m256i c0 = _mm256_loadu_si256(c);
+        __m256i c1 = _mm256_loadu_si256(c + 1);
+        __m256i diff = _mm256_or_si256(_mm256_xor_si256(c0, _mm256_load_si256(p)),
+                                       _mm256_xor_si256(c1, _mm256_load_si256(p + 1)));
+        
+        if (!_mm256_testz_si256(diff, diff)) {
+            bitmap[line / 64] |= 1ULL << (line % 64);
+            _mm256_store_si256(p, c0);
+            _mm256_store_si256(p + 1, c1);
+            changed++;
+        }
+    }
+    
+    return changed;
+}
+#endif
+
+void changemap_init(changemap_t *cm) {
+    if (!cm) return;
+    
+    memset(cm, 0, sizeof(changemap_t));
+    cm->scan = scan_scalar;
+    cm->kernel = "scalar";
+
+#ifdef CHANGEMAP_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        cm->scan = scan_avx2;
+        cm->kernel = "avx2";
+    } else if (__builtin_cpu_supports("sse2")) {
+        cm->scan = scan_sse2;
+        cm->kernel = "sse2";
+    }
+#endif
+    
+    LOG_INFO("Process image change detection using %s", cm->kernel);
+}
+
+// Runs once per cycle in the RT thread, after the inputs are received
+void changemap_update(changemap_t *cm, const uint8_t *image, uint32_t size) {
+    if (!cm || !image) return;
+    
+    uint32_t version = atomic_load_explicit(&cm->version, memory_order_relaxed) + 1;
+    uint32_t tracked = (size < CHANGEMAP_MAX_BYTES) ? size : CHANGEMAP_MAX_BYTES;
+    uint32_t lines = (tracked + CHANGEMAP_LINE_BYTES - 1) / CHANGEMAP_LINE_BYTES;
+    uint32_t full_lines = tracked / CHANGEMAP_LINE_BYTES;
+    
+    memset(cm->bitmap, 0, sizeof(cm->bitmap));
+    
+    if (image != cm->image || size != cm->size) {
+        // A new image: everything counts as changed
+        memcpy(cm->prev, image, tracked);
+        for (uint32_t line = 0; line < lines; line++) {
+            cm->bitmap[line / 64] |= 1ULL << (line % 64);
+        }
+        cm->changed = lines;
+        cm->image = image;
+        cm->size = size;
+        atomic_store_explicit(&cm->lines, lines, memory_order_relaxed);
+    } else {
+        cm->changed = cm->scan(cm->prev, image, full_lines, cm->bitmap);
+        
+        if (full_lines < lines) {
+            uint32_t offset = full_lines * CHANGEMAP_LINE_BYTES;
+            if (memcmp(cm->prev + offset, image + offset, tracked - offset) != 0) {
+                memcpy(cm->prev + offset, image + offset, tracked - offset);
+                cm->bitmap[full_lines / 64] |= 1ULL << (full_lines % 64);
+                cm->changed++;
+            }
+        }
+    }
+    
+    if (cm->changed > 0) {
+        for (uint32_t word = 0; word < (lines + 63) / 64; word++) {
+            uint64_t bits = cm->bitmap[word];
+            while (bits) {
+                uint32_t line = word * 64 + (uint32_t)__builtin_ctzll(bits);
+                atomic_store_explicit(&cm->line_version[line], version, memory_order_relaxed);
+                bits &= bits - 1;
+            }
+        }
+    }
+    
+    atomic_store_explicit(&cm->version, version, memory_order_release);
+}
+
+// Lines that changed after version `since`, starting at `first_line`. A line
+// changing while this runs may be reported twice, but never missed
+uint32_t changemap_since(changemap_t *cm, uint32_t since, uint32_t first_line,
+                         uint8_t *bitmap, uint32_t max_lines, uint32_t *lines) {
+    uint32_t version = atomic_load_explicit(&cm->version, memory_order_acquire);
+    uint32_t total = atomic_load_explicit(&cm->lines, memory_order_relaxed);
+    
+    *lines = total;
+    memset(bitmap, 0, (max_lines + 7) / 8);
+    
+    for (uint32_t i = 0; i < max_lines && first_line + i < total; i++) {
+        uint32_t stamp = atomic_load_explicit(&cm->line_version[first_line + i],
+                                              memory_order_relaxed);
+        if ((int32_t)(stamp - since) > 0) {
+            bitmap[i / 8] |= (uint8_t)(1U << (i % 8));
+        }
+    }
+    
+    return version;
+}
@@ -14,7 +14,9 @@ static int handle_network_command(service_context_t *ctx, const udp_command_t *c
                 return 0;
             }
             
+            pthread_mutex_lock(&ctx->ec_ctx.master_lock);
             int result = ethercat_start(&ctx->ec_ctx);
+            pthread_mutex_unlock(&ctx->ec_ctx.master_lock);
             if (result == 0) {
                 protocol_create_response(resp, STATUS_SUCCESS, ERR_NONE, NULL, 0);
                 LOG_INFO("EtherCAT network started");
@@ -27,7 +29,10 @@ static int handle_network_command(service_context_t *ctx, const udp_command_t *c
         
         case NET_STOP: {
             LOG_INFO("Network stop command received");
+            // Waits for an SDO transfer in flight to finish first
+            pthread_mutex_lock(&ctx->ec_ctx.master_lock);
             ethercat_stop(&ctx->ec_ctx);
+            pthread_mutex_unlock(&ctx->ec_ctx.master_lock);
             protocol_create_response(resp, STATUS_SUCCESS, ERR_NONE, NULL, 0);
             LOG_INFO("EtherCAT network stopped");
             break;
@@ -35,12 +40,16 @@ static int handle_network_command(service_context_t *ctx, const udp_command_t *c
         
         case NET_SCAN: {
             LOG_INFO("Network scan command received");
-            int slave_count = ethercat_scan_slaves(&ctx->ec_ctx);
+            uint32_t added = 0;
+            uint32_t removed = 0;
+            int slave_count = hotplug_scan(ctx, true, &added, &removed);
             if (slave_count >= 0) {
-                uint8_t payload[4];
-                uint32_t *count_ptr = (uint32_t*)payload;
-                *count_ptr = htonl((uint32_t)slave_count);
-                protocol_create_response(resp, STATUS_SUCCESS, ERR_NONE, payload, 4);
+                uint8_t payload[12];
+                uint32_t *payload32 = (uint32_t*)payload;
+                payload32[0] = htonl((uint32_t)slave_count);
+                payload32[1] = htonl(added);
+                payload32[2] = htonl(removed);
+                protocol_create_response(resp, STATUS_SUCCESS, ERR_NONE, payload, 12);
                 LOG_INFO("Network scan found %d slaves", slave_count);
             } else {
                 protocol_create_response(resp, STATUS_ERROR, ERR_INTERNAL, NULL, 0);
@@ -53,7 +62,7 @@ static int handle_network_command(service_context_t *ctx, const udp_command_t *c
             network_status_t status;
             status.slave_count = ctx->ec_ctx.slave_count;
             status.network_active = ctx->ec_ctx.network_active;
-            status.cycle_time_us = ctx->config.network.cycle_time_us;
+            status.cycle_time_us = service_config(ctx)->network.cycle_time_us;
             status.error_count = 0;
             
             uint8_t payload[17];
@@ -63,6 +72,20 @@ static int handle_network_command(service_context_t *ctx, const udp_command_t *c
             break;
         }
         
+        case NET_RELOAD: {
+            LOG_INFO("Reloading configuration from %s", ctx->config_file);
+            reload_result_t result;
+            if (reload_config(&ctx->reload, &result) < 0) {
+                protocol_create_response(resp, STATUS_ERROR, ERR_INTERNAL, NULL, 0);
+                break;
+            }
+            
+            uint32_t payload[3] = { htonl((uint32_t)result.generation), htonl(result.applied),
+                                    htonl(result.pending) };
+            protocol_create_response(resp, STATUS_SUCCESS, ERR_NONE, payload, sizeof(payload));
+            break;
+        }
+        
         default:
             protocol_create_response(resp, STATUS_ERROR, ERR_INVALID_COMMAND, NULL, 0);
             return -1;
@@ -71,12 +94,249 @@ static int handle_network_command(service_context_t *ctx, const udp_command_t *c
     return 0;
 }
 
-static int handle_pdo_command(service_context_t *ctx, const udp_command_t *cmd, udp_response_t *resp) {
+// Which 64-byte lines of the input image changed after a given version
+static int handle_pdo_changes(service_context_t *ctx, const udp_command_t *cmd, udp_response_t *resp) {
+    uint16_t payload_len = ntohs(cmd->payload_len);
+    const uint32_t *request = (const uint32_t*)cmd->payload;
+    uint32_t since = (payload_len >= 4) ? ntohl(request[0]) : 0;
+    uint32_t first_line = (payload_len >= 8) ? ntohl(request[1]) : 0;
+    
+    uint8_t payload[8 + PDO_CHANGES_BITMAP_BYTES];
+    uint32_t lines;
+    uint32_t version = changemap_since(&ctx->changes, since, first_line, payload + 8,
+                                       PDO_CHANGES_BITMAP_BYTES * 8, &lines);
+    
+    uint32_t *payload32 = (uint32_t*)payload;
+    uint16_t *payload16 = (uint16_t*)payload;
+    payload32[0] = htonl(version);
+    payload16[2] = htons((uint16_t)lines);
+    payload16[3] = htons((uint16_t)first_line);
+    
+    protocol_create_response(resp, STATUS_SUCCESS, ERR_NONE, payload, sizeof(payload));
+    return 0;
+}
+
+// Bit operations, masked writes and compare-and-swap on 1-4 output bytes.
+// They are applied by the RT thread, in arrival order, right before the
+// frame is sent; the reply carries the value found there (the pre-image) and
+// is deferred until the RT thread has been through the operation
+static int handle_pdo_rmw(service_context_t *ctx, const udp_command_t *cmd, udp_response_t *resp,
+                          const struct sockaddr_in *client_addr) {
+    uint16_t payload_len = ntohs(cmd->payload_len);
+    const uint32_t *request = (const uint32_t*)cmd->payload;
+    bool needs_value = cmd->command_id == PDO_MASKED_WRITE || cmd->command_id == PDO_COMPARE_SWAP;
+    
+    if (payload_len < (needs_value ? 20 : 16)) {
+        protocol_create_response(resp, STATUS_ERROR, ERR_INVALID_PAYLOAD, NULL, 0);
+        return 0;
+    }
+    
+    uint32_t slave = ntohl(request[0]);
+    rmw_op_t op;
+    memset(&op, 0, sizeof(op));
+    op.kind = (uint8_t)(RMW_SET_BITS + (cmd->command_id - PDO_SET_BITS));
+    op.offset = ntohl(request[1]);
+    uint32_t size = ntohl(request[2]);
+    op.mask = ntohl(request[3]);
+    op.value = needs_value ? ntohl(request[4]) : 0;
+    
+    if (slave == 0 || slave > ctx->ec_ctx.slave_count) {
+        protocol_create_response(resp, STATUS_ERROR, ERR_SLAVE_NOT_FOUND, NULL, 0);
+        return 0;
+    }
+    
+    if (size == 0 || size > 4 || op.offset > ctx->ec_ctx.output_size ||
+        size > ctx->ec_ctx.output_size - op.offset) {
+        protocol_create_response(resp, STATUS_ERROR, ERR_INVALID_PAYLOAD, NULL, 0);
+        return 0;
+    }
+    op.size = (uint8_t)size;
+    
+    // The compare value and the new value must fit the field: a compare
+    // value with bits above it could never match the `size` bytes read back
+    uint32_t field_mask = (size == 4) ? 0xFFFFFFFFu : (1u << (8 * size)) - 1;
+    if (op.kind == RMW_COMPARE_SWAP && ((op.mask | op.value) & ~field_mask)) {
+        protocol_create_response(resp, STATUS_ERROR, ERR_INVALID_PAYLOAD, NULL, 0);
+        return 0;
+    }
+    
+    uint64_t seq;
+    if (!client_addr || !defer_reply_room(ctx, DEFER_RMW, 1) || rmw_submit(&ctx->rmw, &op, &seq) < 0) {
+        protocol_create_response(resp, STATUS_ERROR, ERR_QUEUE_FULL, NULL, 0);
+        return 0;
+    }
+    
+    // No deadline: the RT thread answers every queued operation, so the reply
+    // never claims a timeout for an operation that still lands
+    defer_reply(ctx, DEFER_RMW, seq, 1, cmd, client_addr, 0);
+    return 1;
+}
+
+// Hold a write for a given RT cycle, or for the first cycle starting at a
+// CLOCK_REALTIME timestamp. Writes that share a cycle leave in one frame
+static int handle_pdo_schedule(service_context_t *ctx, const udp_command_t *cmd,
+                               udp_response_t *resp) {
+    const uint32_t *request = (const uint32_t*)cmd->payload;
+    
+    if (cmd->command_id == PDO_SCHEDULE_STATUS) {
+        schedule_stats_t stats;
+        schedule_get_stats(&ctx->schedule, &stats);
+        
+        uint32_t payload[8];
+        payload[0] = htonl((uint32_t)(stats.next_cycle >> 32));
+        payload[1] = htonl((uint32_t)stats.next_cycle);
+        payload[2] = htonl(stats.pending);
+        payload[3] = htonl(stats.applied);
+        payload[4] = htonl(stats.late);
+        payload[5] = htonl(stats.overflow);
+        payload[6] = htonl(stats.dropped);
+        payload[7] = htonl(stats.last_rejected);
+        protocol_create_response(resp, STATUS_SUCCESS, ERR_NONE, payload, sizeof(payload));
+        return 0;
+    }
+    
+    if (ntohs(cmd->payload_len) < 24) {
+        protocol_create_response(resp, STATUS_ERROR, ERR_INVALID_PAYLOAD, NULL, 0);
+        return 0;
+    }
+    
+    uint32_t slave = ntohl(request[0]);
+    uint8_t flags = cmd->payload[13];
+    uint64_t when = ((uint64_t)ntohl(request[4]) << 32) | ntohl(request[5]);
+    
+    schedule_write_t write;
+    memset(&write, 0, sizeof(write));
+    write.offset = ntohl(request[1]);
+    write.value = ntohl(request[2]);
+    write.size = cmd->payload[12];
+    write.flags = (flags & PDO_SCHEDULE_FLAG_CLAMP) ? SCHEDULE_FLAG_CLAMP : 0;
+    
+    if (slave == 0 || slave > ctx->ec_ctx.slave_count) {
+        protocol_create_response(resp, STATUS_ERROR, ERR_SLAVE_NOT_FOUND, NULL, 0);
+        return 0;
+    }
+    
+    if (write.size == 0 || write.size > 4 || write.offset > ctx->ec_ctx.output_size ||
+        write.size > ctx->ec_ctx.output_size - write.offset) {
+        protocol_create_response(resp, STATUS_ERROR, ERR_INVALID_PAYLOAD, NULL, 0);
+        return 0;
+    }
+    
+    uint64_t next;
+    schedule_now(&ctx->schedule, &next, NULL);
+    write.cycle = (flags & PDO_SCHEDULE_FLAG_REALTIME) ? schedule_cycle_at(&ctx->schedule, when)
+                                                       : when;
+    
+    bool clamped = false;
+    if (write.cycle < next) {
+        if (!(flags & PDO_SCHEDULE_FLAG_CLAMP)) {
+            uint32_t payload[2] = { htonl((uint32_t)(next >> 32)), htonl((uint32_t)next) };
+            protocol_create_response(resp, STATUS_ERROR, ERR_TOO_LATE, payload, sizeof(payload));
+            return 0;
+        }
+        write.cycle = next;
+        clamped = true;
+    }
+    
+    if (write.cycle - next >= SCHEDULE_WHEEL_SLOTS) {
+        protocol_create_response(resp, STATUS_ERROR, ERR_INVALID_PAYLOAD, NULL, 0);
+        return 0;
+    }
+    
+    uint32_t seq;
+    if (schedule_submit(&ctx->schedule, &write, &seq) < 0) {
+        protocol_create_response(resp, STATUS_ERROR, ERR_QUEUE_FULL, NULL, 0);
+        return 0;
+    }
+    
+    uint32_t payload[4];
+    payload[0] = htonl(seq);
+    payload[1] = htonl(clamped ? 1 : 0);
+    payload[2] = htonl((uint32_t)(write.cycle >> 32));
+    payload[3] = htonl((uint32_t)write.cycle);
+    protocol_create_response(resp, STATUS_SUCCESS, ERR_NONE, payload, sizeof(payload));
+    return 0;
+}
+
+// Several input regions copied from one published cycle, with that cycle's
+// number, timestamp and working counter. A follow-up request naming the same
+// cycle reads more regions from the same image while it is in the ring
+static int handle_pdo_snapshot(service_context_t *ctx, const udp_command_t *cmd,
+                               udp_response_t *resp) {
+    uint16_t payload_len = ntohs(cmd->payload_len);
+    const uint32_t *request = (const uint32_t*)cmd->payload;
+    const uint16_t *request16 = (const uint16_t*)cmd->payload;
+    
+    if (payload_len < 8) {
+        protocol_create_response(resp, STATUS_ERROR, ERR_INVALID_PAYLOAD, NULL, 0);
+        return 0;
+    }
+    
+    uint32_t cycle = ntohl(request[0]);
+    uint8_t flags = cmd->payload[4];
+    uint8_t count = cmd->payload[5];
+    
+    if (count > PDO_SNAPSHOT_REGIONS_MAX || payload_len < 8 + count * 4) {
+        protocol_create_response(resp, STATUS_ERROR, ERR_INVALID_PAYLOAD, NULL, 0);
+        return 0;
+    }
+    
+    snapshot_region_t regions[PDO_SNAPSHOT_REGIONS_MAX];
+    uint32_t total = 0;
+    for (uint8_t i = 0; i < count; i++) {
+        regions[i].offset = ntohs(request16[4 + i * 2]);
+        regions[i].size = ntohs(request16[5 + i * 2]);
+        total += regions[i].size;
+        if (regions[i].size == 0 || total > PDO_SNAPSHOT_DATA_MAX ||
+            regions[i].offset + regions[i].size > ctx->ec_ctx.input_size) {
+            protocol_create_response(resp, STATUS_ERROR, ERR_INVALID_PAYLOAD, NULL, 0);
+            return 0;
+        }
+    }
+    
+    uint8_t payload[16 + PDO_SNAPSHOT_DATA_MAX];
+    snapshot_info_t info;
+    if (snapshot_read(&ctx->snapshots, !(flags & PDO_SNAPSHOT_FLAG_CYCLE), cycle, regions, count,
+                      payload + 16, &info) < 0) {
+        protocol_create_response(resp, STATUS_ERROR, ERR_TOO_LATE, NULL, 0);
+        return 0;
+    }
+    
+    uint32_t *out32 = (uint32_t*)payload;
+    uint16_t wkc = htons(info.wkc);
+    out32[0] = htonl((uint32_t)info.cycle);
+    out32[1] = htonl((uint32_t)(info.time_ns >> 32));
+    out32[2] = htonl((uint32_t)info.time_ns);
+    memcpy(payload + 12, &wkc, 2);
+    payload[14] = info.flags;
+    payload[15] = (uint8_t)total;
+    protocol_create_response(resp, STATUS_SUCCESS, ERR_NONE, payload, (uint16_t)(16 + total));
+    return 0;
+}
+
+static int handle_pdo_command(service_context_t *ctx, const udp_command_t *cmd, udp_response_t *resp,
+                              const struct sockaddr_in *client_addr) {
     if (!ctx->ec_ctx.network_active) {
         protocol_create_response(resp, STATUS_ERROR, ERR_NETWORK_NOT_READY, NULL, 0);
         return 0;
     }
     
+    if (cmd->command_id == PDO_CHANGES) {
+        return handle_pdo_changes(ctx, cmd, resp);
+    }
+    
+    if (cmd->command_id >= PDO_SET_BITS && cmd->command_id <= PDO_COMPARE_SWAP) {
+        return handle_pdo_rmw(ctx, cmd, resp, client_addr);
+    }
+    
+    if (cmd->command_id == PDO_SCHEDULE || cmd->command_id == PDO_SCHEDULE_STATUS) {
+        return handle_pdo_schedule(ctx, cmd, resp);
+    }
+    
+    if (cmd->command_id == PDO_SNAPSHOT) {
+        return handle_pdo_snapshot(ctx, cmd, resp);
+    }
+    
     pdo_operation_t op;
     if (!protocol_extract_pdo_op(cmd, &op)) {
         protocol_create_response(resp, STATUS_ERROR, ERR_INVALID_PAYLOAD, NULL, 0);
@@ -104,6 +364,20 @@ static int handle_pdo_command(service_context_t *ctx, const udp_command_t *cmd,
                      op.slave_id, op.offset, op.size, op.value);
             int result = ethercat_write_pdo(&ctx->ec_ctx, op.slave_id, op.offset, op.size, op.value);
             if (result == 0) {
+                uint64_t seq;
+                bool wait = (op.flags & PDO_WRITE_FLAG_WAIT_SENT) &&
+                            defer_reply_room(ctx, DEFER_WIRESTAMP, 1);
+                
+                // Tag the write with its arrival; the RT thread stamps the send.
+                // On request, the reply is deferred until that cycle is on the
+                // wire, and the network thread serves other clients meanwhile
+                uint64_t timeout_ns = (uint64_t)atomic_load_explicit(&ctx->wirestamp.cycle_ns,
+                                                                     memory_order_relaxed) *
+                                      WIRESTAMP_WAIT_CYCLES;
+                if (wirestamp_mark(&ctx->wirestamp, ctx->command_rx_ns, &seq) == 0 && wait &&
+                    defer_reply(ctx, DEFER_WIRESTAMP, seq, 1, cmd, client_addr, timeout_ns) == 0) {
+                    return 1;
+                }
                 protocol_create_response(resp, STATUS_SUCCESS, ERR_NONE, NULL, 0);
             } else {
                 protocol_create_response(resp, STATUS_ERROR, ERR_SLAVE_NOT_FOUND, NULL, 0);
@@ -134,8 +408,12 @@ static int handle_diagnostic_command(service_context_t *ctx, const udp_command_t
         case DIAG_NETWORK: {
             LOG_DEBUG("Network diagnostics requested");
             uint8_t payload[8] = {0};
+            uint32_t *payload32 = (uint32_t*)payload;
             payload[0] = ctx->ec_ctx.network_active ? 1 : 0;
             payload[1] = (uint8_t)ctx->ec_ctx.slave_count;
+            payload[2] = ctx->ec_ctx.warm_start ? 1 : 0;
+            payload[3] = ctx->ec_ctx.outputs_restored ? 1 : 0;
+            payload32[1] = htonl(ctx->ec_ctx.startup_ms);
             protocol_create_response(resp, STATUS_SUCCESS, ERR_NONE, payload, 8);
             break;
         }
@@ -145,11 +423,16 @@ static int handle_diagnostic_command(service_context_t *ctx, const udp_command_t
             timing_stats_t stats;
             ethercat_get_timing_stats(&stats);
             
-            uint8_t payload[8];
+            uint8_t payload[28];
             uint32_t *payload32 = (uint32_t*)payload;
             payload32[0] = htonl(stats.avg_cycle_us);
             payload32[1] = htonl(stats.jitter_us);
-            protocol_create_response(resp, STATUS_SUCCESS, ERR_NONE, payload, 8);
+            payload32[2] = htonl(stats.min_cycle_us);
+            payload32[3] = htonl(stats.max_cycle_us);
+            payload32[4] = htonl(stats.cycles_missed);
+            payload32[5] = htonl(stats.capture_overhead_avg_ns);
+            payload32[6] = htonl(stats.capture_overhead_max_ns);
+            protocol_create_response(resp, STATUS_SUCCESS, ERR_NONE, payload, 28);
             break;
         }
         
@@ -173,15 +456,155 @@ static int handle_diagnostic_command(service_context_t *ctx, const udp_command_t
                 slave_id = ntohl(*(uint32_t*)cmd->payload);
             }
             
-            if (slave_id < ctx->ec_ctx.slave_count && ctx->ec_ctx.slaves[slave_id].online) {
-                uint8_t payload[8] = {1}; 
-                protocol_create_response(resp, STATUS_SUCCESS, ERR_NONE, payload, 8);
+            slave_info_t slave;
+            if (ethercat_get_slave_info(&ctx->ec_ctx, slave_id, &slave)) {
+                uint8_t payload[12] = {0};
+                uint32_t *payload32 = (uint32_t*)payload;
+                payload[0] = slave.online ? 1 : 0;
+                payload[1] = (uint8_t)slave.al_state;
+                payload32[1] = htonl(slave.recovery_count);
+                payload32[2] = htonl(slave.last_recovery_ms);
+                protocol_create_response(resp, STATUS_SUCCESS, ERR_NONE, payload, 12);
             } else {
                 protocol_create_response(resp, STATUS_ERROR, ERR_SLAVE_NOT_FOUND, NULL, 0);
             }
             break;
         }
         
+        case DIAG_RECOVERY: {
+            LOG_DEBUG("Recovery diagnostics requested");
+            const supervisor_context_t *sup = &ctx->supervisor;
+            
+            uint8_t payload[20];
+            uint32_t *payload32 = (uint32_t*)payload;
+            payload32[0] = htonl(sup->slaves_down);
+            payload32[1] = htonl(sup->recoveries);
+            payload32[2] = htonl(sup->last_recovery_ms);
+            payload32[3] = htonl(sup->max_recovery_ms);
+            payload32[4] = htonl(sup->wkc_deviations);
+            protocol_create_response(resp, STATUS_SUCCESS, ERR_NONE, payload, 20);
+            break;
+        }
+        
+        case DIAG_TRANSPORT: {
+            LOG_DEBUG("Transport diagnostics requested");
+            transport_stats_t stats;
+            ethercat_get_transport_stats(&stats);
+            
+            uint8_t payload[32];
+            payload[0] = (uint8_t)ctx->ec_ctx.transport;
+            payload[1] = payload[2] = payload[3] = 0;
+            uint32_t *payload32 = (uint32_t*)(payload + 4);
+            payload32[0] = htonl(stats.rtt_samples);
+            payload32[1] = htonl(transport_rtt_percentile(&stats, 500));
+            payload32[2] = htonl(transport_rtt_percentile(&stats, 990));
+            payload32[3] = htonl(stats.rtt_max_us);
+            payload32[4] = htonl(stats.frames_sent);
+            payload32[5] = htonl(stats.rx_timeouts);
+            payload32[6] = htonl(stats.stale_frames);
+            protocol_create_response(resp, STATUS_SUCCESS, ERR_NONE, payload, 32);
+            break;
+        }
+        
+        case DIAG_CAPTURE: {
+            LOG_DEBUG("Capture diagnostics requested");
+            capture_context_t *cap = &ctx->capture;
+            
+            // A non-zero first payload byte freezes the current window by hand
+            if (ntohs(cmd->payload_len) >= 1 && cmd->payload[0] != 0) {
+                capture_trigger(cap, CAPTURE_TRIGGER_MANUAL);
+            }
+            
+            uint8_t payload[20];
+            payload[0] = (uint8_t)cap->mode;
+            payload[1] = atomic_load(&cap->frozen) ? 1 : 0;
+            payload[2] = payload[3] = 0;
+            uint32_t *payload32 = (uint32_t*)(payload + 4);
+            payload32[0] = htonl(atomic_load(&cap->frames));
+            payload32[1] = htonl(atomic_load(&cap->dropped));
+            payload32[2] = htonl(atomic_load(&cap->triggers));
+            payload32[3] = htonl(atomic_load(&cap->files_written));
+            protocol_create_response(resp, STATUS_SUCCESS, ERR_NONE, payload, 20);
+            break;
+        }
+        
+        case DIAG_TRACE: {
+            uint8_t action = (ntohs(cmd->payload_len) >= 1) ? cmd->payload[0] : TRACE_ACTION_STATUS;
+            int exported = 0;
+            LOG_DEBUG("Trace control requested (action %u)", action);
+            
+            if (action == TRACE_ACTION_ENABLE) {
+                trace_set_enabled(true);
+            } else if (action == TRACE_ACTION_DISABLE) {
+                trace_set_enabled(false);
+            } else if (action == TRACE_ACTION_EXPORT) {
+                exported = trace_export_chrome(ctx->config.performance.trace_file);
+                if (exported < 0) {
+                    protocol_create_response(resp, STATUS_ERROR, ERR_INTERNAL, NULL, 0);
+                    break;
+                }
+            }
+            
+            uint8_t payload[12];
+            payload[0] = g_trace_enabled ? 1 : 0;
+            payload[1] = payload[2] = payload[3] = 0;
+            uint32_t *payload32 = (uint32_t*)(payload + 4);
+            payload32[0] = htonl(trace_event_count());
+            payload32[1] = htonl((uint32_t)exported);
+            protocol_create_response(resp, STATUS_SUCCESS, ERR_NONE, payload, 12);
+            break;
+        }
+        
+        case DIAG_WRITE_LATENCY: {
+            LOG_DEBUG("Write latency diagnostics requested");
+            wirestamp_stats_t stats;
+            wirestamp_get_stats(&ctx->wirestamp, &stats);
+            
+            // A non-zero first payload byte clears the histogram after this report
+            if (ntohs(cmd->payload_len) >= 1 && cmd->payload[0] != 0) {
+                wirestamp_reset(&ctx->wirestamp);
+            }
+            
+            uint8_t payload[28];
+            uint32_t *payload32 = (uint32_t*)payload;
+            payload32[0] = htonl(stats.samples);
+            payload32[1] = htonl(stats.dropped);
+            payload32[2] = htonl(stats.p50_us);
+            payload32[3] = htonl(stats.p99_us);
+            payload32[4] = htonl(stats.p999_us);
+            payload32[5] = htonl(stats.max_us);
+            payload32[6] = htonl(stats.mean_us);
+            protocol_create_response(resp, STATUS_SUCCESS, ERR_NONE, payload, 28);
+            break;
+        }
+        
+        case DIAG_PLUGINS: {
+            uint8_t index = (ntohs(cmd->payload_len) >= 1) ? cmd->payload[0] : 0;
+            LOG_DEBUG("Plugin diagnostics requested (plugin %u)", index);
+            
+            plugin_stats_t stats;
+            if (plugin_host_get_stats(&ctx->plugins, index, &stats) < 0) {
+                uint8_t count = (uint8_t)ctx->plugins.count;
+                protocol_create_response(resp, STATUS_ERROR, ERR_INVALID_PAYLOAD, &count, 1);
+                break;
+            }
+            
+            uint8_t payload[28];
+            payload[0] = (uint8_t)ctx->plugins.count;
+            payload[1] = index;
+            payload[2] = stats.enabled ? 1 : 0;
+            payload[3] = 0;
+            uint32_t *payload32 = (uint32_t*)(payload + 4);
+            payload32[0] = htonl((uint32_t)stats.calls);
+            payload32[1] = htonl(stats.avg_ns);
+            payload32[2] = htonl(stats.max_ns);
+            payload32[3] = htonl(stats.last_ns);
+            payload32[4] = htonl(stats.budget_ns);
+            payload32[5] = htonl(stats.overruns);
+            protocol_create_response(resp, STATUS_SUCCESS, ERR_NONE, payload, 28);
+            break;
+        }
+        
         default:
             protocol_create_response(resp, STATUS_ERROR, ERR_INVALID_COMMAND, NULL, 0);
             return -1;
@@ -190,9 +613,776 @@ static int handle_diagnostic_command(service_context_t *ctx, const udp_command_t
     return 0;
 }
 
+static int handle_mailbox_command(service_context_t *ctx, const udp_command_t *cmd, udp_response_t *resp,
+                                  const struct sockaddr_in *client_addr) {
+    if (!ctx->ec_ctx.network_active) {
+        protocol_create_response(resp, STATUS_ERROR, ERR_NETWORK_NOT_READY, NULL, 0);
+        return 0;
+    }
+    
+    uint16_t payload_len = ntohs(cmd->payload_len);
+    
+    switch (cmd->command_id) {
+        case SDO_READ:
+        case SDO_WRITE: {
+            sdo_operation_t op;
+            if (!protocol_extract_sdo_op(cmd, &op)) {
+                protocol_create_response(resp, STATUS_ERROR, ERR_INVALID_PAYLOAD, NULL, 0);
+                break;
+            }
+            
+            if (op.slave_id == 0 || op.slave_id > ctx->ec_ctx.slave_count) {
+                protocol_create_response(resp, STATUS_ERROR, ERR_SLAVE_NOT_FOUND, NULL, 0);
+                break;
+            }
+            
+            bool complete_access = (op.flags & SDO_FLAG_COMPLETE_ACCESS) != 0;
+            uint32_t request_id;
+            int result;
+            
+            if (cmd->command_id == SDO_READ) {
+                LOG_DEBUG("SDO read queued: slave=%u, 0x%04X:%02X, ca=%d",
+                          op.slave_id, op.index, op.subindex, complete_access);
+                result = mailbox_submit_read(&ctx->mailbox, op.slave_id, op.index, op.subindex,
+                                             complete_access, op.size, &request_id);
+            } else {
+                if (op.size == 0 || op.size > MAILBOX_MAX_DATA || op.data_len > op.size) {
+                    protocol_create_response(resp, STATUS_ERROR, ERR_INVALID_PAYLOAD, NULL, 0);
+                    break;
+                }
+                LOG_DEBUG("SDO write queued: slave=%u, 0x%04X:%02X, size=%u, ca=%d",
+                          op.slave_id, op.index, op.subindex, op.size, complete_access);
+                result = mailbox_submit_write(&ctx->mailbox, op.slave_id, op.index, op.subindex,
+                                              complete_access, op.size, op.data, op.data_len,
+                                              &request_id);
+            }
+            
+            if (result == 0) {
+                uint8_t payload[4];
+                uint32_t *id_ptr = (uint32_t*)payload;
+                *id_ptr = htonl(request_id);
+                protocol_create_response(resp, STATUS_SUCCESS, ERR_NONE, payload, 4);
+            } else {
+                protocol_create_response(resp, STATUS_ERROR, ERR_QUEUE_FULL, NULL, 0);
+            }
+            break;
+        }
+        
+        case SDO_DATA: {
+            if (payload_len < 8) {
+                protocol_create_response(resp, STATUS_ERROR, ERR_INVALID_PAYLOAD, NULL, 0);
+                break;
+            }
+            
+            const uint32_t *payload32 = (const uint32_t*)cmd->payload;
+            uint32_t request_id = ntohl(payload32[0]);
+            uint32_t offset = ntohl(payload32[1]);
+            uint32_t filled;
+            
+            if (mailbox_append_data(&ctx->mailbox, request_id, offset, cmd->payload + 8,
+                                    payload_len - 8, &filled) == 0) {
+                uint8_t payload[8];
+                uint32_t *out32 = (uint32_t*)payload;
+                out32[0] = htonl(request_id);
+                out32[1] = htonl(filled);
+                protocol_create_response(resp, STATUS_SUCCESS, ERR_NONE, payload, 8);
+            } else {
+                protocol_create_response(resp, STATUS_ERROR, ERR_INVALID_PAYLOAD, NULL, 0);
+            }
+            break;
+        }
+        
+        case SDO_RESULT: {
+            if (payload_len < 4) {
+                protocol_create_response(resp, STATUS_ERROR, ERR_INVALID_PAYLOAD, NULL, 0);
+                break;
+            }
+            
+            const uint32_t *payload32 = (const uint32_t*)cmd->payload;
+            uint32_t request_id = ntohl(payload32[0]);
+            uint32_t offset = (payload_len >= 8) ? ntohl(payload32[1]) : 0;
+            uint8_t count = (payload_len >= 9) ? cmd->payload[8] : 1;
+            if (count == 0 || !client_addr) count = 1;
+            if (count > SDO_RESULT_BURST_MAX) count = SDO_RESULT_BURST_MAX;
+            
+            // With a count, up to that many replies are sent back to back,
+            // each carrying the next chunk and its offset, so a large upload
+            // is collected in one round trip
+            for (;;) {
+                uint8_t payload[PROTOCOL_MAX_PAYLOAD] = {0};
+                mailbox_result_t result;
+                uint32_t len;
+                
+                int found = mailbox_get_result(&ctx->mailbox, request_id, offset, &result,
+                                               payload + 12, PROTOCOL_MAX_PAYLOAD - 12, &len);
+                if (found != 0) {
+                    protocol_create_response(resp, STATUS_ERROR,
+                                             found == -2 ? ERR_EXPIRED : ERR_INVALID_PAYLOAD, NULL, 0);
+                    break;
+                }
+                
+                uint32_t *out32 = (uint32_t*)payload;
+                uint16_t chunk_offset = htons((uint16_t)offset);
+                payload[0] = result.state;
+                memcpy(payload + 2, &chunk_offset, 2);
+                out32[1] = htonl(result.abort_code);
+                out32[2] = htonl(result.size);
+                protocol_create_response(resp, STATUS_SUCCESS, ERR_NONE, payload, 12 + len);
+                
+                offset += len;
+                if (--count == 0 || len == 0 || offset >= result.size) break;
+                send_extra_reply(ctx, resp, client_addr);
+            }
+            break;
+        }
+        
+        default:
+            protocol_create_response(resp, STATUS_ERROR, ERR_INVALID_COMMAND, NULL, 0);
+            return -1;
+    }
+    
+    return 0;
+}
+
+static int handle_signal_command(service_context_t *ctx, const udp_command_t *cmd, udp_response_t *resp) {
+    const signal_program_t *prog = &ctx->signals;
+    uint16_t payload_len = ntohs(cmd->payload_len);
+    
+    switch (cmd->command_id) {
+        case SIG_READ: {
+            if (payload_len < 4) {
+                protocol_create_response(resp, STATUS_ERROR, ERR_INVALID_PAYLOAD, NULL, 0);
+                break;
+            }
+            
+            uint32_t first = ntohl(*(const uint32_t*)cmd->payload);
+            uint8_t count = (payload_len >= 5) ? cmd->payload[4] : 1;
+            if (count == 0 || count > SIG_READ_MAX) count = SIG_READ_MAX;
+            
+            if (first >= prog->count) {
+                protocol_create_response(resp, STATUS_ERROR, ERR_INVALID_PAYLOAD, NULL, 0);
+                break;
+            }
+            if (count > prog->count - first) count = (uint8_t)(prog->count - first);
+            
+            // Values are IEEE-754 single precision, sent in network byte order
+            uint8_t payload[8 + SIG_READ_MAX * 4] = {0};
+            uint32_t *payload32 = (uint32_t*)payload;
+            payload32[0] = htonl(first);
+            payload[4] = count;
+            
+            for (uint8_t i = 0; i < count; i++) {
+                float value;
+                uint32_t bits;
+                if (signals_read(prog, first + i, &value)) {
+                    payload[5] |= (uint8_t)(1U << i);
+                }
+                memcpy(&bits, &value, sizeof(bits));
+                payload32[2 + i] = htonl(bits);
+            }
+            
+            protocol_create_response(resp, STATUS_SUCCESS, ERR_NONE, payload, (uint16_t)(8 + count * 4));
+            break;
+        }
+        
+        case SIG_INFO: {
+            uint8_t payload[32] = {0};
+            uint32_t *payload32 = (uint32_t*)payload;
+            payload32[0] = htonl(prog->count);
+            
+            // Without an index, describe the program itself
+            if (payload_len < 4) {
+                payload32[1] = htonl((uint32_t)prog->evaluations);
+                payload32[2] = htonl(prog->last_eval_ns);
+                payload32[3] = htonl(prog->max_eval_ns);
+                payload32[4] = htonl(prog->decimation);
+                protocol_create_response(resp, STATUS_SUCCESS, ERR_NONE, payload, 20);
+                break;
+            }
+            
+            const signal_def_t *def = signals_get_def(prog, ntohl(*(const uint32_t*)cmd->payload));
+            if (!def) {
+                protocol_create_response(resp, STATUS_ERROR, ERR_INVALID_PAYLOAD, payload, 4);
+                break;
+            }
+            
+            uint16_t slave = htons(def->slave);
+            uint16_t offset = htons((uint16_t)def->offset);
+            memcpy(payload + 4, &slave, 2);
+            memcpy(payload + 6, &offset, 2);
+            payload[8] = (uint8_t)def->type;
+            payload[9] = def->bit;
+            memcpy(payload + 12, def->name, SIGNAL_NAME_LEN);
+            protocol_create_response(resp, STATUS_SUCCESS, ERR_NONE, payload, 32);
+            break;
+        }
+        
+        case SIG_WINDOW: {
+            if (payload_len < 4 || prog->window_evals == 0) {
+                protocol_create_response(resp, STATUS_ERROR, ERR_INVALID_PAYLOAD, NULL, 0);
+                break;
+            }
+            
+            const uint32_t *request32 = (const uint32_t*)cmd->payload;
+            uint32_t seq = ntohl(request32[0]);
+            uint32_t first = (payload_len >= 8) ? ntohl(request32[1]) : 0;
+            uint8_t stat = (payload_len >= 9) ? cmd->payload[8] : SIGNAL_STAT_MEAN;
+            uint8_t count = (payload_len >= 10) ? cmd->payload[9] : 0;
+            uint8_t payload[32] = {0};
+            uint32_t *payload32 = (uint32_t*)payload;
+            uint32_t window_seq, samples;
+            uint64_t end_ns;
+            
+            // Without a count, describe the window: the client learns the
+            // latest and oldest sequence numbers it can still fetch
+            if (count == 0) {
+                if (signals_read_window(prog, seq, SIGNAL_STAT_MIN, 0, 0, NULL, &window_seq,
+                                        &samples, &end_ns) < 0) {
+                    protocol_create_response(resp, STATUS_ERROR, ERR_INVALID_PAYLOAD, NULL, 0);
+                    break;
+                }
+                uint32_t latest = atomic_load(&prog->window_seq);
+                uint32_t oldest = (latest > prog->window_history) ? latest - prog->window_history + 1 : 1;
+                payload32[0] = htonl(window_seq);
+                payload32[1] = htonl(samples);
+                payload32[2] = htonl((uint32_t)(end_ns >> 32));
+                payload32[3] = htonl((uint32_t)end_ns);
+                payload32[4] = htonl(latest);
+                payload32[5] = htonl(oldest);
+                protocol_create_response(resp, STATUS_SUCCESS, ERR_NONE, payload, 24);
+                break;
+            }
+            
+            if (count > SIG_READ_MAX) count = SIG_READ_MAX;
+            if (first < prog->count && count > prog->count - first) {
+                count = (uint8_t)(prog->count - first);
+            }
+            
+            float values[SIG_READ_MAX];
+            if (signals_read_window(prog, seq, (signal_stat_t)stat, first, count, values,
+                                    &window_seq, &samples, &end_ns) < 0) {
+                protocol_create_response(resp, STATUS_ERROR, ERR_INVALID_PAYLOAD, NULL, 0);
+                break;
+            }
+            
+            uint16_t first16 = htons((uint16_t)first);
+            payload32[0] = htonl(window_seq);
+            memcpy(payload + 4, &first16, 2);
+            payload[6] = stat;
+            payload[7] = count;
+            for (uint8_t i = 0; i < count; i++) {
+                uint32_t bits;
+                memcpy(&bits, &values[i], sizeof(bits));
+                payload32[2 + i] = htonl(bits);
+            }
+            
+            protocol_create_response(resp, STATUS_SUCCESS, ERR_NONE, payload, (uint16_t)(8 + count * 4));
+            break;
+        }
+        
+        default:
+            protocol_create_response(resp, STATUS_ERROR, ERR_INVALID_COMMAND, NULL, 0);
+            return -1;
+    }
+    
+    return 0;
+}
+
+static int handle_event_command(service_context_t *ctx, const udp_command_t *cmd,
+                                udp_response_t *resp, const struct sockaddr_in *client_addr) {
+    event_registry_t *reg = &ctx->events;
+    uint16_t payload_len = ntohs(cmd->payload_len);
+    
+    switch (cmd->command_id) {
+        case EVT_ADD: {
+            if (payload_len < 12 || !client_addr) {
+                protocol_create_response(resp, STATUS_ERROR, ERR_INVALID_PAYLOAD, NULL, 0);
+                break;
+            }
+            
+            const uint16_t *payload16 = (const uint16_t*)cmd->payload;
+            const uint32_t *payload32 = (const uint32_t*)cmd->payload;
+            event_condition_t cond;
+            memset(&cond, 0, sizeof(cond));
+            cond.addr = *client_addr;
+            cond.slave = ntohs(payload16[0]);
+            cond.offset = ntohs(payload16[1]);
+            cond.type = (signal_type_t)cmd->payload[4];
+            cond.bit = cmd->payload[5];
+            cond.kind = (event_kind_t)cmd->payload[6];
+            // Thresholds travel as 32-bit patterns, read according to the field type
+            cond.threshold = signals_raw_value(cond.type, ntohl(payload32[2]));
+            cond.hysteresis = (payload_len >= 16) ? signals_raw_value(cond.type, ntohl(payload32[3])) : 0.0;
+            
+            uint32_t id;
+            if (events_add(reg, &cond, &id) < 0) {
+                error_code_t error = (reg->count == EVENT_MAX_CONDITIONS) ? ERR_QUEUE_FULL
+                                                                          : ERR_INVALID_PAYLOAD;
+                protocol_create_response(resp, STATUS_ERROR, error, NULL, 0);
+                break;
+            }
+            
+            LOG_DEBUG("Event %u registered: slave=%u offset=%u %s kind=%u", id, cond.slave,
+                      cond.offset, signals_type_name(cond.type), cond.kind);
+            uint32_t value = htonl(id);
+            protocol_create_response(resp, STATUS_SUCCESS, ERR_NONE, &value, 4);
+            break;
+        }
+        
+        case EVT_REMOVE: {
+            if (payload_len < 4 || !client_addr) {
+                protocol_create_response(resp, STATUS_ERROR, ERR_INVALID_PAYLOAD, NULL, 0);
+                break;
+            }
+            
+            // Id 0 drops every condition the client registered
+            uint32_t id = ntohl(*(const uint32_t*)cmd->payload);
+            uint32_t removed;
+            if (id == 0) {
+                removed = events_remove_client(reg, client_addr);
+            } else {
+                removed = (events_remove(reg, id, client_addr) == 0) ? 1 : 0;
+            }
+            
+            uint32_t value = htonl(removed);
+            protocol_create_response(resp, removed || id == 0 ? STATUS_SUCCESS : STATUS_ERROR,
+                                     removed || id == 0 ? ERR_NONE : ERR_INVALID_PAYLOAD, &value, 4);
+            break;
+        }
+        
+        case EVT_STATUS: {
+            uint32_t payload[6];
+            payload[0] = htonl(reg->count);
+            payload[1] = htonl((uint32_t)atomic_load_explicit(&reg->fired, memory_order_relaxed));
+            payload[2] = htonl((uint32_t)reg->sent);
+            payload[3] = htonl((uint32_t)atomic_load_explicit(&reg->dropped, memory_order_relaxed));
+            payload[4] = htonl(atomic_load_explicit(&reg->last_eval_ns, memory_order_relaxed));
+            payload[5] = htonl(atomic_load_explicit(&reg->max_eval_ns, memory_order_relaxed));
+            protocol_create_response(resp, STATUS_SUCCESS, ERR_NONE, payload, sizeof(payload));
+            break;
+        }
+        
+        default:
+            protocol_create_response(resp, STATUS_ERROR, ERR_INVALID_COMMAND, NULL, 0);
+            return -1;
+    }
+    
+    return 0;
+}
+
+static void extract_scope_field(const uint8_t *payload, scope_field_t *field) {
+    uint16_t slave, offset;
+    memcpy(&slave, payload, 2);
+    memcpy(&offset, payload + 2, 2);
+    field->slave = ntohs(slave);
+    field->offset = ntohs(offset);
+    field->type = (signal_type_t)payload[4];
+    field->bit = payload[5];
+}
+
+static int handle_scope_command(service_context_t *ctx, const udp_command_t *cmd,
+                                udp_response_t *resp, const struct sockaddr_in *client_addr) {
+    uint16_t payload_len = ntohs(cmd->payload_len);
+    const uint32_t *payload32 = (const uint32_t*)cmd->payload;
+    
+    if (payload_len < 4 || !client_addr) {
+        protocol_create_response(resp, STATUS_ERROR, ERR_INVALID_PAYLOAD, NULL, 0);
+        return 0;
+    }
+    
+    if (cmd->command_id == SCOPE_CREATE) {
+        uint32_t samples = ntohl(payload32[0]);
+        uint32_t pretrigger = (payload_len >= 8) ? ntohl(payload32[1]) : 0;
+        uint32_t decimation = (payload_len >= 12) ? ntohl(payload32[2]) : 1;
+        
+        int id = scope_create(&ctx->scopes, client_addr, samples, pretrigger, decimation);
+        if (id < 0) {
+            protocol_create_response(resp, STATUS_ERROR, ERR_QUEUE_FULL, NULL, 0);
+        } else {
+            uint32_t value = htonl((uint32_t)id);
+            protocol_create_response(resp, STATUS_SUCCESS, ERR_NONE, &value, 4);
+        }
+        return 0;
+    }
+    
+    // Every other command names a scope the client created
+    scope_t *scope = scope_get(&ctx->scopes, ntohl(payload32[0]), client_addr);
+    if (!scope) {
+        protocol_create_response(resp, STATUS_ERROR, ERR_INVALID_PAYLOAD, NULL, 0);
+        return 0;
+    }
+    
+    switch (cmd->command_id) {
+        case SCOPE_CHANNEL: {
+            scope_field_t field;
+            int channel = -1;
+            if (payload_len >= 10) {
+                extract_scope_field(cmd->payload + 4, &field);
+                channel = scope_add_channel(scope, &field);
+            }
+            
+            if (channel < 0) {
+                protocol_create_response(resp, STATUS_ERROR, ERR_INVALID_PAYLOAD, NULL, 0);
+            } else {
+                uint32_t value = htonl((uint32_t)channel);
+                protocol_create_response(resp, STATUS_SUCCESS, ERR_NONE, &value, 4);
+            }
+            break;
+        }
+        
+        case SCOPE_TRIGGER: {
+            scope_field_t field;
+            int result = -1;
+            if (payload_len >= 16) {
+                extract_scope_field(cmd->payload + 4, &field);
+                result = scope_set_trigger(scope, &field, cmd->payload[10],
+                                           signals_raw_value(field.type, ntohl(payload32[3])));
+            }
+            
+            protocol_create_response(resp, result == 0 ? STATUS_SUCCESS : STATUS_ERROR,
+                                     result == 0 ? ERR_NONE : ERR_INVALID_PAYLOAD, NULL, 0);
+            break;
+        }
+        
+        case SCOPE_ARM: {
+            bool arm = (payload_len < 5) || cmd->payload[4] != 0;
+            int state = atomic_load_explicit(&scope->state, memory_order_acquire);
+            
+            // A running scope is handed back by the RT thread on its next
+            // cycle; re-arming it has to wait for that, so the client retries
+            scope_stop(scope);
+            if (!arm) {
+                protocol_create_response(resp, STATUS_SUCCESS, ERR_NONE, NULL, 0);
+                break;
+            }
+            if (state == SCOPE_ARMED || state == SCOPE_TRIGGERED) {
+                protocol_create_response(resp, STATUS_ERROR, ERR_QUEUE_FULL, NULL, 0);
+                break;
+            }
+            
+            static uint32_t slave_base[MAX_SLAVES];
+            uint32_t count = service_slave_bases(ctx, slave_base);
+            uint32_t size = ctx->ec_ctx.network_active ? ctx->ec_ctx.input_size : 0;
+            int result = scope_arm(scope, size, slave_base, count);
+            
+            protocol_create_response(resp, result == 0 ? STATUS_SUCCESS : STATUS_ERROR,
+                                     result == 0 ? ERR_NONE : ERR_INVALID_PAYLOAD, NULL, 0);
+            break;
+        }
+        
+        case SCOPE_STATUS: {
+            uint8_t payload[28] = {0};
+            uint32_t *out32 = (uint32_t*)payload;
+            int state = atomic_load_explicit(&scope->state, memory_order_acquire);
+            bool done = (state == SCOPE_DONE);
+            
+            payload[0] = (uint8_t)state;
+            payload[1] = (uint8_t)scope->channel_count;
+            out32[1] = htonl(done ? scope->pre : 0);
+            out32[2] = htonl(done ? scope->count : 0);
+            out32[3] = htonl(done ? (uint32_t)(scope->trigger_cycle >> 32) : 0);
+            out32[4] = htonl(done ? (uint32_t)scope->trigger_cycle : 0);
+            out32[5] = htonl(done ? (uint32_t)(scope->trigger_time_ns >> 32) : 0);
+            out32[6] = htonl(done ? (uint32_t)scope->trigger_time_ns : 0);
+            protocol_create_response(resp, STATUS_SUCCESS, ERR_NONE, payload, sizeof(payload));
+            break;
+        }
+        
+        case SCOPE_READ: {
+            uint8_t channel = (payload_len >= 5) ? cmd->payload[4] : 0;
+            uint32_t first = (payload_len >= 12) ? ntohl(payload32[2]) : 0;
+            uint32_t samples[SCOPE_READ_MAX];
+            uint32_t count = scope_read(scope, channel, first, samples, SCOPE_READ_MAX);
+            
+            if (count == 0) {
+                protocol_create_response(resp, STATUS_ERROR, ERR_INVALID_PAYLOAD, NULL, 0);
+                break;
+            }
+            
+            uint8_t payload[8 + SCOPE_READ_MAX * 4] = {0};
+            uint32_t *out32 = (uint32_t*)payload;
+            payload[0] = channel;
+            payload[1] = (uint8_t)count;
+            out32[1] = htonl(first);
+            for (uint32_t i = 0; i < count; i++) {
+                out32[2 + i] = htonl(samples[i]);
+            }
+            protocol_create_response(resp, STATUS_SUCCESS, ERR_NONE, payload, (uint16_t)(8 + count * 4));
+            break;
+        }
+        
+        case SCOPE_DELETE:
+            scope_destroy(scope);
+            protocol_create_response(resp, STATUS_SUCCESS, ERR_NONE, NULL, 0);
+            break;
+        
+        default:
+            protocol_create_response(resp, STATUS_ERROR, ERR_INVALID_COMMAND, NULL, 0);
+            return -1;
+    }
+    
+    return 0;
+}
+
+static layout_binding_t* find_binding(service_context_t *ctx, const struct sockaddr_in *addr) {
+    for (uint32_t i = 0; i < ctx->layout_binding_count; i++) {
+        layout_binding_t *binding = &ctx->layout_bindings[i];
+        if (binding->addr.sin_addr.s_addr == addr->sin_addr.s_addr &&
+            binding->addr.sin_port == addr->sin_port) {
+            return binding;
+        }
+    }
+    return NULL;
+}
+
+// The layout hash an address is bound to, 0 when it is not bound. Looking
+// it up counts as use and keeps the binding alive
+static uint32_t bound_layout(service_context_t *ctx, const struct sockaddr_in *addr) {
+    layout_binding_t *binding = find_binding(ctx, addr);
+    if (!binding) return 0;
+    
+    binding->last_seen = (uint32_t)time(NULL);
+    return binding->hash;
+}
+
+// Binds an address to a layout hash, or unbinds it for hash 0. Bindings stay
+// until the client unbinds or stops using them; fails once every binding is
+// taken
+static int bind_layout(service_context_t *ctx, const struct sockaddr_in *addr, uint32_t hash) {
+    layout_binding_t *binding = find_binding(ctx, addr);
+    
+    if (hash == 0) {
+        if (binding) *binding = ctx->layout_bindings[--ctx->layout_binding_count];
+        return 0;
+    }
+    
+    if (!binding) {
+        if (ctx->layout_binding_count == LAYOUT_BINDINGS_MAX) return -1;
+        binding = &ctx->layout_bindings[ctx->layout_binding_count++];
+        binding->addr = *addr;
+    }
+    binding->hash = hash;
+    binding->last_seen = (uint32_t)time(NULL);
+    return 0;
+}
+
+// Called from the network thread's client cleanup. A binding nobody has used
+// for `timeout` seconds is dropped, so clients that come and go on new ports
+// do not use up the table
+void expire_layout_bindings(service_context_t *ctx, uint32_t now, uint32_t timeout) {
+    for (uint32_t i = 0; i < ctx->layout_binding_count; ) {
+        if (now - ctx->layout_bindings[i].last_seen > timeout) {
+            ctx->layout_bindings[i] = ctx->layout_bindings[--ctx->layout_binding_count];
+        } else {
+            i++;
+        }
+    }
+}
+
+// The symbol's bytes must lie inside the image it belongs to
+static uint8_t* symbol_image(ethercat_context_t *ec, const symbol_t *symbol) {
+    uint8_t *image = (symbol->dir == SYMBOL_INPUT) ? ec->pdo_input : ec->pdo_output;
+    uint32_t size = (symbol->dir == SYMBOL_INPUT) ? ec->input_size : ec->output_size;
+    
+    if (!image || symbol->offset + symbols_byte_size(symbol) > size) return NULL;
+    return image;
+}
+
+static int handle_symbol_command(service_context_t *ctx, const udp_command_t *cmd,
+                                 udp_response_t *resp, const struct sockaddr_in *client_addr) {
+    ethercat_context_t *ec = &ctx->ec_ctx;
+    const symbol_table_t *table = &ec->symbols;
+    uint16_t payload_len = ntohs(cmd->payload_len);
+    const uint32_t *payload32 = (const uint32_t*)cmd->payload;
+    
+    // A client may pin the layout it was generated for before the network is up
+    if (cmd->command_id == SYM_LAYOUT) {
+        uint32_t current = htonl(table->layout_hash);
+        
+        if (payload_len >= 4) {
+            if (!client_addr) {
+                protocol_create_response(resp, STATUS_ERROR, ERR_INVALID_PAYLOAD, NULL, 0);
+                return 0;
+            }
+            if (bind_layout(ctx, client_addr, ntohl(payload32[0])) < 0) {
+                protocol_create_response(resp, STATUS_ERROR, ERR_QUEUE_FULL, NULL, 0);
+                return 0;
+            }
+        }
+        
+        uint32_t bound = client_addr ? bound_layout(ctx, client_addr) : 0;
+        bool mismatch = bound != 0 && ec->network_active && bound != table->layout_hash;
+        protocol_create_response(resp, mismatch ? STATUS_ERROR : STATUS_SUCCESS,
+                                 mismatch ? ERR_LAYOUT_MISMATCH : ERR_NONE, &current, 4);
+        return 0;
+    }
+    
+    if (!ec->network_active) {
+        protocol_create_response(resp, STATUS_ERROR, ERR_NETWORK_NOT_READY, NULL, 0);
+        return 0;
+    }
+    
+    switch (cmd->command_id) {
+        case SYM_RESOLVE: {
+            char name[SYMBOL_NAME_LEN];
+            uint16_t len = (payload_len < SYMBOL_NAME_LEN) ? payload_len : SYMBOL_NAME_LEN - 1;
+            memcpy(name, cmd->payload, len);
+            name[len] = '\0';
+            
+            uint32_t handle;
+            const symbol_t *symbol = symbols_find(table, name, &handle);
+            if (!symbol) {
+                protocol_create_response(resp, STATUS_ERROR, ERR_INVALID_PAYLOAD, NULL, 0);
+                break;
+            }
+            
+            uint8_t payload[16] = {0};
+            uint32_t *out32 = (uint32_t*)payload;
+            uint16_t slave = htons(symbol->slave);
+            uint16_t bits = htons(symbol->bits);
+            out32[0] = htonl(handle);
+            memcpy(payload + 4, &slave, 2);
+            payload[6] = symbol->dir;
+            payload[7] = symbol->type;
+            out32[2] = htonl(symbol->offset);
+            payload[12] = symbol->bit;
+            memcpy(payload + 14, &bits, 2);
+            protocol_create_response(resp, STATUS_SUCCESS, ERR_NONE, payload, 16);
+            break;
+        }
+        
+        case SYM_READ: {
+            uint8_t count = (uint8_t)(payload_len / 4);
+            if (count == 0 || count > SYM_READ_MAX) {
+                protocol_create_response(resp, STATUS_ERROR, ERR_INVALID_PAYLOAD, NULL, 0);
+                break;
+            }
+            
+            // Bit n of byte 1 is set when handle n was valid
+            uint8_t payload[4 + SYM_READ_MAX * 4] = {0};
+            uint32_t *out32 = (uint32_t*)payload;
+            payload[0] = count;
+            
+            for (uint8_t i = 0; i < count; i++) {
+                const symbol_t *symbol = symbols_get(table, ntohl(payload32[i]));
+                const uint8_t *image = symbol ? symbol_image(ec, symbol) : NULL;
+                if (image) {
+                    out32[1 + i] = htonl(symbols_read_value(symbol, image));
+                    payload[1] |= (uint8_t)(1U << i);
+                }
+            }
+            
+            protocol_create_response(resp, payload[1] ? STATUS_SUCCESS : STATUS_ERROR,
+                                     payload[1] ? ERR_NONE : ERR_INVALID_PAYLOAD, payload,
+                                     (uint16_t)(4 + count * 4));
+            break;
+        }
+        
+        case SYM_WRITE: {
+            uint8_t count = (uint8_t)(payload_len / 8);
+            if (count == 0 || count > SYM_WRITE_MAX) {
+                protocol_create_response(resp, STATUS_ERROR, ERR_INVALID_PAYLOAD, NULL, 0);
+                break;
+            }
+            
+            // Validate the whole batch first so it is applied all or nothing
+            rmw_op_t ops[SYM_WRITE_MAX * 2];
+            uint32_t op_count = 0;
+            uint8_t payload[4] = { count, 0, 0, 0 };
+            
+            for (uint8_t i = 0; i < count; i++) {
+                const symbol_t *symbol = symbols_get(table, ntohl(payload32[i * 2]));
+                if (!symbol || symbol->dir != SYMBOL_OUTPUT || !symbol_image(ec, symbol)) {
+                    payload[1] = (uint8_t)(i + 1);
+                    break;
+                }
+                op_count += symbols_write_ops(symbol, ntohl(payload32[i * 2 + 1]), &ops[op_count]);
+            }
+            
+            // Byte 1 names the first rejected entry, counting from 1
+            if (payload[1] != 0) {
+                protocol_create_response(resp, STATUS_ERROR, ERR_INVALID_PAYLOAD, payload, 4);
+                break;
+            }
+            
+            // The RT thread applies the batch in one cycle, in between the
+            // other writers to the image, and the reply waits for that cycle
+            uint64_t seq;
+            if (!client_addr || !defer_reply_room(ctx, DEFER_RMW, op_count) ||
+                rmw_submit_batch(&ctx->rmw, ops, op_count, &seq) < 0) {
+                protocol_create_response(resp, STATUS_ERROR, ERR_QUEUE_FULL, NULL, 0);
+                break;
+            }
+            defer_reply(ctx, DEFER_RMW, seq, (uint8_t)op_count, cmd, client_addr, 0);
+            return 1;
+        }
+        
+        case SYM_LIST: {
+            uint8_t payload[32] = {0};
+            uint32_t *out32 = (uint32_t*)payload;
+            
+            // Without an index, report the table size, generation and layout
+            if (payload_len < 4) {
+                out32[0] = htonl(table->count);
+                out32[1] = htonl(table->generation);
+                out32[2] = htonl(table->layout_hash);
+                protocol_create_response(resp, STATUS_SUCCESS, ERR_NONE, payload, 12);
+                break;
+            }
+            
+            uint32_t index = ntohl(payload32[0]);
+            if (index >= table->count) {
+                protocol_create_response(resp, STATUS_ERROR, ERR_INVALID_PAYLOAD, NULL, 0);
+                break;
+            }
+            
+            const char *name = symbols_name(table, &table->entries[index]);
+            out32[0] = htonl(symbols_handle(table, index));
+            snprintf((char*)payload + 4, 28, "%s", name);
+            protocol_create_response(resp, STATUS_SUCCESS, ERR_NONE, payload, 32);
+            break;
+        }
+        
+        default:
+            protocol_create_response(resp, STATUS_ERROR, ERR_INVALID_COMMAND, NULL, 0);
+            return -1;
+    }
+    
+    return 0;
+}
+
+// Commands that carry image offsets or symbol handles, or resolve the
+// offsets given earlier against the running layout
+static bool addresses_image(const udp_command_t *cmd) {
+    switch (cmd->command_type) {
+        case CMD_CATEGORY_PDO:
+            return true;
+        case CMD_CATEGORY_SYMBOL:
+            return cmd->command_id != SYM_LAYOUT && cmd->command_id != SYM_LIST;
+        case CMD_CATEGORY_EVENT:
+            return cmd->command_id == EVT_ADD;
+        case CMD_CATEGORY_SCOPE:
+            return cmd->command_id == SCOPE_CHANNEL || cmd->command_id == SCOPE_TRIGGER ||
+                   cmd->command_id == SCOPE_ARM;
+        default:
+            return false;
+    }
+}
+
+// A client that pinned a layout hash must not touch process data once the
+// running layout differs: its compiled-in offsets would address other fields
+static bool layout_refused(service_context_t *ctx, const udp_command_t *cmd,
+                           const struct sockaddr_in *client_addr) {
+    if (!addresses_image(cmd) || !client_addr) return false;
+    
+    uint32_t bound = bound_layout(ctx, client_addr);
+    return bound != 0 && ctx->ec_ctx.network_active && bound != ctx->ec_ctx.symbols.layout_hash;
+}
+
+// Returns 0 with `resp` filled in, 1 when the reply was deferred and will be
+// sent by the network loop, or -1 when no reply is due
 int handle_client_command(service_context_t *ctx, const udp_command_t *cmd,
                          udp_response_t *resp, struct sockaddr_in *client_addr) {
-    (void)client_addr;
     
     if (!protocol_validate_command(cmd)) {
         LOG_WARN("Invalid command received");
@@ -203,16 +1393,36 @@ int handle_client_command(service_context_t *ctx, const udp_command_t *cmd,
     LOG_DEBUG("Command received: type=0x%02X, id=0x%02X, payload_len=%u",
               cmd->command_type, cmd->command_id, ntohs(cmd->payload_len));
     
+    if (layout_refused(ctx, cmd, client_addr)) {
+        protocol_create_response(resp, STATUS_ERROR, ERR_LAYOUT_MISMATCH, NULL, 0);
+        return 0;
+    }
+    
     switch (cmd->command_type) {
         case CMD_CATEGORY_NETWORK:
             return handle_network_command(ctx, cmd, resp);
             
         case CMD_CATEGORY_PDO:
-            return handle_pdo_command(ctx, cmd, resp);
+            return handle_pdo_command(ctx, cmd, resp, client_addr);
             
         case CMD_CATEGORY_DIAGNOSTIC:
             return handle_diagnostic_command(ctx, cmd, resp);
             
+        case CMD_CATEGORY_MAILBOX:
+            return handle_mailbox_command(ctx, cmd, resp, client_addr);
+            
+        case CMD_CATEGORY_SIGNAL:
+            return handle_signal_command(ctx, cmd, resp);
+            
+        case CMD_CATEGORY_EVENT:
+            return handle_event_command(ctx, cmd, resp, client_addr);
+            
+        case CMD_CATEGORY_SCOPE:
+            return handle_scope_command(ctx, cmd, resp, client_addr);
+            
+        case CMD_CATEGORY_SYMBOL:
+            return handle_symbol_command(ctx, cmd, resp, client_addr);
+            
         default:
             protocol_create_response(resp, STATUS_ERROR, ERR_INVALID_COMMAND, NULL, 0);
             return 0;
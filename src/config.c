@@ -11,11 +11,20 @@ void config_set_defaults(config_t *config) {
     strcpy(config->network.interface, "eth0");
     config->network.cycle_time_us = 1000;
     config->network.timeout_ms = 1000;
+    strcpy(config->network.topology_cache, "/var/lib/etherforge/topology.bin");
+    strcpy(config->network.transport, "soem");
+    config->network.busy_poll_us = 0;
+    config->network.simulate_slaves = 0;
+    config->network.simulate_slave_bytes = 8;
+    config->network.output_shm[0] = '\0';
+    config->network.output_max_age_ms = 10000;
     
     config->performance.rt_priority = 50;
     config->performance.cpu_count = 1;
     config->performance.cpu_affinity[0] = 1;
     config->performance.buffer_size = 8192;
+    config->performance.trace_enabled = false;
+    strcpy(config->performance.trace_file, "/tmp/etherforge-trace.json");
     
     strcpy(config->logging.level, "info");
     strcpy(config->logging.file, "/var/log/etherforged.log");
@@ -24,6 +33,25 @@ void config_set_defaults(config_t *config) {
     strcpy(config->security.bind_address, "127.0.0.1");
     config->security.port = PROTOCOL_PORT;
     config->security.max_clients = 16;
+    
+    strcpy(config->capture.mode, "off");
+    strcpy(config->capture.dir, "/var/log/etherforge");
+    config->capture.file_mb = 64;
+    config->capture.files = 8;
+    config->capture.post_frames = 64;
+    
+    strcpy(config->metrics.bind_address, "127.0.0.1");
+    config->metrics.port = 9102;
+    strcpy(config->metrics.shm_name, "/etherforge-stats");
+    
+    config->plugins.count = 0;
+    config->plugins.budget_us = 100;
+    config->plugins.overrun_limit = 0;
+    
+    config->signals.file[0] = '\0';
+    config->signals.decimation = 1;
+    config->signals.window_ms = 0;
+    config->signals.window_history = 16;
 }
 
 static int parse_yaml_value(const char *key, const char *value, config_t *config) {
@@ -34,10 +62,32 @@ static int parse_yaml_value(const char *key, const char *value, config_t *config
         config->network.cycle_time_us = (uint32_t)atol(value);
     } else if (strcmp(key, "timeout_ms") == 0) {
         config->network.timeout_ms = (uint32_t)atol(value);
+    } else if (strcmp(key, "topology_cache") == 0) {
+        strncpy(config->network.topology_cache, value, sizeof(config->network.topology_cache) - 1);
+        config->network.topology_cache[sizeof(config->network.topology_cache) - 1] = '\0';
+    } else if (strcmp(key, "transport") == 0) {
+        strncpy(config->network.transport, value, sizeof(config->network.transport) - 1);
+        config->network.transport[sizeof(config->network.transport) - 1] = '\0';
+    } else if (strcmp(key, "busy_poll_us") == 0) {
+        config->network.busy_poll_us = (uint32_t)atol(value);
+    } else if (strcmp(key, "simulate_slaves") == 0) {
+        config->network.simulate_slaves = (uint32_t)atol(value);
+    } else if (strcmp(key, "simulate_slave_bytes") == 0) {
+        config->network.simulate_slave_bytes = (uint32_t)atol(value);
+    } else if (strcmp(key, "output_shm") == 0) {
+        strncpy(config->network.output_shm, value, sizeof(config->network.output_shm) - 1);
+        config->network.output_shm[sizeof(config->network.output_shm) - 1] = '\0';
+    } else if (strcmp(key, "output_max_age_ms") == 0) {
+        config->network.output_max_age_ms = (uint32_t)atol(value);
     } else if (strcmp(key, "rt_priority") == 0) {
         config->performance.rt_priority = atoi(value);
     } else if (strcmp(key, "buffer_size") == 0) {
         config->performance.buffer_size = (uint32_t)atol(value);
+    } else if (strcmp(key, "trace_enabled") == 0) {
+        config->performance.trace_enabled = (strcmp(value, "true") == 0 || strcmp(value, "1") == 0);
+    } else if (strcmp(key, "trace_file") == 0) {
+        strncpy(config->performance.trace_file, value, sizeof(config->performance.trace_file) - 1);
+        config->performance.trace_file[sizeof(config->performance.trace_file) - 1] = '\0';
     } else if (strcmp(key, "level") == 0) {
         strncpy(config->logging.level, value, sizeof(config->logging.level) - 1);
         config->logging.level[sizeof(config->logging.level) - 1] = '\0';
@@ -54,6 +104,45 @@ static int parse_yaml_value(const char *key, const char *value, config_t *config
         config->security.port = (uint16_t)atoi(value);
     } else if (strcmp(key, "max_clients") == 0) {
         config->security.max_clients = (uint32_t)atol(value);
+    } else if (strcmp(key, "capture_mode") == 0) {
+        strncpy(config->capture.mode, value, sizeof(config->capture.mode) - 1);
+        config->capture.mode[sizeof(config->capture.mode) - 1] = '\0';
+    } else if (strcmp(key, "capture_dir") == 0) {
+        strncpy(config->capture.dir, value, sizeof(config->capture.dir) - 1);
+        config->capture.dir[sizeof(config->capture.dir) - 1] = '\0';
+    } else if (strcmp(key, "capture_file_mb") == 0) {
+        config->capture.file_mb = (uint32_t)atol(value);
+    } else if (strcmp(key, "capture_files") == 0) {
+        config->capture.files = (uint32_t)atol(value);
+    } else if (strcmp(key, "capture_post_frames") == 0) {
+        config->capture.post_frames = (uint32_t)atol(value);
+    } else if (strcmp(key, "metrics_bind") == 0) {
+        strncpy(config->metrics.bind_address, value, sizeof(config->metrics.bind_address) - 1);
+        config->metrics.bind_address[sizeof(config->metrics.bind_address) - 1] = '\0';
+    } else if (strcmp(key, "metrics_port") == 0) {
+        config->metrics.port = (uint16_t)atoi(value);
+    } else if (strcmp(key, "metrics_shm") == 0) {
+        strncpy(config->metrics.shm_name, value, sizeof(config->metrics.shm_name) - 1);
+        config->metrics.shm_name[sizeof(config->metrics.shm_name) - 1] = '\0';
+    } else if (strcmp(key, "plugin_paths") == 0) {
+        if (config->plugins.count < CONFIG_MAX_PLUGINS) {
+            char *path = config->plugins.paths[config->plugins.count++];
+            strncpy(path, value, sizeof(config->plugins.paths[0]) - 1);
+            path[sizeof(config->plugins.paths[0]) - 1] = '\0';
+        }
+    } else if (strcmp(key, "plugin_budget_us") == 0) {
+        config->plugins.budget_us = (uint32_t)atol(value);
+    } else if (strcmp(key, "plugin_overrun_limit") == 0) {
+        config->plugins.overrun_limit = (uint32_t)atol(value);
+    } else if (strcmp(key, "signal_file") == 0) {
+        strncpy(config->signals.file, value, sizeof(config->signals.file) - 1);
+        config->signals.file[sizeof(config->signals.file) - 1] = '\0';
+    } else if (strcmp(key, "signal_decimation") == 0) {
+        config->signals.decimation = (uint32_t)atol(value);
+    } else if (strcmp(key, "signal_window_ms") == 0) {
+        config->signals.window_ms = (uint32_t)atol(value);
+    } else if (strcmp(key, "signal_window_history") == 0) {
+        config->signals.window_history = (uint32_t)atol(value);
     } else if (strcmp(key, "cpu_affinity") == 0) {
         // Handle cpu_affinity array parsing - simplified for now
         config->performance.cpu_count = 1;
@@ -91,17 +180,25 @@ int config_load(config_t *config, const char *filename) {
     char current_section[64] = {0};
     bool expecting_value = false;
     bool in_array = false;
+    bool in_block_array = false;
+    bool in_indentless_array = false;
     int array_index = 0;
+    bool failed = false;
     
     do {
         if (!yaml_parser_scan(&parser, &token)) {
             LOG_ERROR("YAML parsing error");
+            failed = true;
             break;
         }
         
         switch (token.type) {
             case YAML_KEY_TOKEN:
                 expecting_value = false;
+                if (in_indentless_array) {
+                    in_array = false;
+                    in_indentless_array = false;
+                }
                 break;
                 
             case YAML_VALUE_TOKEN:
@@ -111,6 +208,7 @@ int config_load(config_t *config, const char *filename) {
             case YAML_FLOW_SEQUENCE_START_TOKEN:
             case YAML_BLOCK_SEQUENCE_START_TOKEN:
                 in_array = true;
+                in_block_array = (token.type == YAML_BLOCK_SEQUENCE_START_TOKEN);
                 array_index = 0;
                 break;
                 
@@ -118,10 +216,20 @@ int config_load(config_t *config, const char *filename) {
                 in_array = false;
                 break;
                 
+            case YAML_BLOCK_ENTRY_TOKEN:
+                // "- item" lines at the key's own indentation carry no sequence start
+                if (!in_array) {
+                    in_array = true;
+                    in_indentless_array = true;
+                    array_index = 0;
+                }
+                break;
+                
             case YAML_SCALAR_TOKEN: {
                 char *scalar_value = (char*)token.data.scalar.value;
                 
-                if (!expecting_value) {
+                // Every scalar inside a sequence is an element, not a key
+                if (!expecting_value && !in_array) {
                     // This is a key
                     if (strlen(current_section) == 0) {
                         // Top-level section name
@@ -162,7 +270,16 @@ int config_load(config_t *config, const char *filename) {
                 break;
                 
             case YAML_BLOCK_END_TOKEN:
+                // A block sequence ends here too; that must not close the section
+                if (in_block_array) {
+                    in_array = false;
+                    in_block_array = false;
+                    break;
+                }
+                
                 // Reset section when exiting a mapping
+                in_array = false;
+                in_indentless_array = false;
                 current_section[0] = '\0';
                 current_key[0] = '\0';
                 break;
@@ -180,6 +297,8 @@ int config_load(config_t *config, const char *filename) {
     yaml_parser_delete(&parser);
     fclose(file);
     
+    if (failed) return -1;
+    
     LOG_INFO("Configuration loaded from %s", filename);
     return 0;
 }
@@ -190,7 +309,32 @@ void config_print(const config_t *config) {
     LOG_INFO("Configuration:");
     LOG_INFO("  Network interface: %s", config->network.interface);
     LOG_INFO("  Cycle time: %u us", config->network.cycle_time_us);
+    LOG_INFO("  Transport: %s (busy poll %u us)", config->network.transport,
+             config->network.busy_poll_us);
+    if (config->network.simulate_slaves > 0) {
+        LOG_INFO("  Simulation: %u slaves x %u bytes", config->network.simulate_slaves,
+                 config->network.simulate_slave_bytes);
+    }
+    if (config->network.output_shm[0]) {
+        LOG_INFO("  Retained outputs: %s (max age %u ms)", config->network.output_shm,
+                 config->network.output_max_age_ms);
+    } else {
+        LOG_INFO("  Retained outputs: (none)");
+    }
     LOG_INFO("  RT priority: %d", config->performance.rt_priority);
     LOG_INFO("  Bind address: %s:%u", config->security.bind_address, config->security.port);
     LOG_INFO("  Max clients: %u", config->security.max_clients);
+    LOG_INFO("  Capture: %s", config->capture.mode);
+    if (config->plugins.count > 0) {
+        LOG_INFO("  Plugins: %u (budget %u us)", config->plugins.count, config->plugins.budget_us);
+    }
+    if (config->signals.file[0]) {
+        LOG_INFO("  Signals: %s (every %u cycles)", config->signals.file, config->signals.decimation);
+        if (config->signals.window_ms > 0) {
+            LOG_INFO("  Signal windows: %u ms, %u kept", config->signals.window_ms,
+                     config->signals.window_history);
+        }
+    }
+    LOG_INFO("  Metrics: %s:%u, stats page %s", config->metrics.bind_address, config->metrics.port,
+             config->metrics.shm_name[0] ? config->metrics.shm_name : "(none)");
 }
\ No newline at end of file
@@ -1,5 +1,6 @@
 #include "ethercat.h"
 #include "logging.h"
+#include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
 #include <time.h>
@@ -7,6 +8,22 @@
 
 static timing_stats_t g_timing_stats = {0};
 static error_stats_t g_error_stats = {0};
+static transport_stats_t g_transport_stats = {0};
+static uint32_t g_capture_cycles = 0;
+static uint64_t g_capture_total_ns = 0;
+
+// Capture cost is accumulated per cycle and folded into the timing stats
+static void record_capture_overhead(ethercat_context_t *ctx) {
+    uint32_t ns = capture_take_overhead(ctx->capture);
+    if (ns == 0) return;
+    
+    g_capture_cycles++;
+    g_capture_total_ns += ns;
+    g_timing_stats.capture_overhead_avg_ns = (uint32_t)(g_capture_total_ns / g_capture_cycles);
+    if (ns > g_timing_stats.capture_overhead_max_ns) {
+        g_timing_stats.capture_overhead_max_ns = ns;
+    }
+}
 
 #ifdef HAVE_SOEM
 
@@ -163,7 +180,7 @@ int ethercat_read_pdo(ethercat_context_t *ctx, uint32_t slave, uint32_t offset,
     
     if (!ctx->network_active || !ctx->pdo_input) return -1;
     
-    if (offset + size > ctx->input_size) return -1;
+    if (offset > ctx->input_size || size > ctx->input_size - offset) return -1;
     
     *value = 0;
     memcpy(value, ctx->pdo_input + offset, (size > 4) ? 4 : size);
@@ -177,7 +194,7 @@ int ethercat_write_pdo(ethercat_context_t *ctx, uint32_t slave, uint32_t offset,
     
     if (!ctx->network_active || !ctx->pdo_output) return -1;
     
-    if (offset + size > ctx->output_size) return -1;
+    if (offset > ctx->output_size || size > ctx->output_size - offset) return -1;
     
     memcpy(ctx->pdo_output + offset, &value, (size > 4) ? 4 : size);
     
@@ -190,28 +207,135 @@ int ethercat_init(ethercat_context_t *ctx, const char *interface) {
     return ethercat_stub_init(ctx, interface);
 }
 
+// Simulated slaves are in OP with a fixed-size process image each and loop
+// their outputs back to their inputs, so clients can exercise the full
+// command path without hardware
+static int simulate_slaves(ethercat_context_t *ctx) {
+    uint32_t count = (ctx->sim_slaves > MAX_SLAVES) ? MAX_SLAVES : ctx->sim_slaves;
+    uint32_t bytes = (ctx->sim_slave_bytes == 0) ? 8 : ctx->sim_slave_bytes;
+    
+    ctx->input_size = count * bytes;
+    ctx->output_size = count * bytes;
+    ctx->pdo_input = calloc(1, ctx->input_size);
+    ctx->pdo_output = calloc(1, ctx->output_size);
+    
+    if (!ctx->pdo_input || !ctx->pdo_output) {
+        LOG_ERROR("STUB: Failed to allocate simulated process image");
+        free(ctx->pdo_input);
+        free(ctx->pdo_output);
+        ctx->pdo_input = NULL;
+        ctx->pdo_output = NULL;
+        ctx->input_size = 0;
+        ctx->output_size = 0;
+        return -1;
+    }
+    
+    ethercat_lock_slave_table(ctx);
+    for (uint32_t i = 0; i < count; i++) {
+        slave_info_t *slave = &ctx->slaves[i];
+        memset(slave, 0, sizeof(*slave));
+        slave->slave_id = i + 1;
+        snprintf(slave->name, sizeof(slave->name), "SIM%u", i + 1);
+        slave->online = true;
+        slave->al_state = EC_STATE_OP;
+        slave->input_size = bytes;
+        slave->output_size = bytes;
+    }
+    ctx->slave_count = count;
+    ethercat_unlock_slave_table(ctx);
+    
+    // Each simulated slave maps 16-bit entries 0x6000 (inputs) and 0x7000
+    // (outputs), with a trailing 8-bit entry when the image size is odd
+    symbols_clear(&ctx->symbols);
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t base = i * bytes * 8;
+        for (uint32_t b = 0; b < bytes; b += 2) {
+            uint16_t bits = (b + 1 < bytes) ? 16 : 8;
+            uint8_t subindex = (uint8_t)(b / 2 + 1);
+            symbols_add_entry(&ctx->symbols, (uint16_t)(i + 1), SYMBOL_INPUT, 0x6000, subindex,
+                              base + b * 8, bits);
+            symbols_add_entry(&ctx->symbols, (uint16_t)(i + 1), SYMBOL_OUTPUT, 0x7000, subindex,
+                              base + b * 8, bits);
+        }
+    }
+    if (symbols_build(&ctx->symbols) < 0) {
+        symbols_clear(&ctx->symbols);
+    }
+    
+    // One LRW datagram, each slave reads and writes: 3 per slave
+    ctx->expected_wkc = (int)(count * 3);
+    
+    LOG_INFO("STUB: Simulating %u slaves with %u bytes of process data each", count, bytes);
+    return 0;
+}
+
 int ethercat_start(ethercat_context_t *ctx) {
     if (!ctx || ctx->network_active) return -1;
     
     LOG_INFO("STUB: Starting EtherCAT network on %s", ctx->interface_name);
     ctx->network_active = true;
     ctx->slave_count = 0;
+    ctx->expected_wkc = 0;
+    ctx->last_wkc = 0;
     ctx->input_size = 0;
     ctx->output_size = 0;
     
     ctx->pdo_input = NULL;
     ctx->pdo_output = NULL;
     
+    ctx->warm_start = false;
+    ctx->outputs_restored = false;
+    ctx->startup_ms = 0;
+    
+    if (ctx->sim_slaves > 0 && simulate_slaves(ctx) < 0) {
+        ctx->network_active = false;
+        return -1;
+    }
+    
+    if (ctx->pdo_output && ctx->retain) {
+        retain_slave_t retained[MAX_SLAVES];
+        for (uint32_t i = 0; i < ctx->slave_count; i++) {
+            retained[i] = (retain_slave_t){ ctx->slaves[i].vendor_id, ctx->slaves[i].product_code,
+                                            ctx->slaves[i].input_size, ctx->slaves[i].output_size };
+        }
+        ctx->outputs_restored = retain_attach(ctx->retain, retained, ctx->slave_count,
+                                              ctx->pdo_output, ctx->output_size) > 0;
+    }
+    
     LOG_INFO("STUB: EtherCAT network started with %u slaves", ctx->slave_count);
     return 0;
 }
 
+// The RT thread checks network_active once at the top of a cycle and then
+// works on the images until the cycle ends, so they may only be freed after
+// it has acknowledged a stop from its idle branch
+static void wait_rt_idle(ethercat_context_t *ctx) {
+    atomic_store_explicit(&ctx->stop_pending, true, memory_order_release);
+    while (atomic_load_explicit(&ctx->rt_running, memory_order_acquire) &&
+           atomic_load_explicit(&ctx->stop_pending, memory_order_acquire)) {
+        usleep(100);
+    }
+    atomic_store_explicit(&ctx->stop_pending, false, memory_order_relaxed);
+}
+
+// Called by the RT thread in every cycle it finds the network inactive
+void ethercat_rt_idle(ethercat_context_t *ctx) {
+    if (atomic_load_explicit(&ctx->stop_pending, memory_order_acquire)) {
+        atomic_store_explicit(&ctx->stop_pending, false, memory_order_release);
+    }
+}
+
 int ethercat_stop(ethercat_context_t *ctx) {
     if (!ctx) return -1;
     
     LOG_INFO("STUB: Stopping EtherCAT network");
     ctx->network_active = false;
+    wait_rt_idle(ctx);
+    retain_detach(ctx->retain);
     ctx->slave_count = 0;
+    symbols_clear(&ctx->symbols);
+    symbols_clear(&ctx->symbols_update);
+    atomic_store_explicit(&ctx->symbols_updated, false, memory_order_relaxed);
     
     if (ctx->pdo_input) {
         free(ctx->pdo_input);
@@ -238,9 +362,32 @@ int ethercat_process_data(ethercat_context_t *ctx) {
     static uint32_t counter = 0;
     counter++;
     
-    if (ctx->pdo_input && ctx->input_size >= 4) {
+    wirestamp_latch(ctx->wirestamp);
+    
+    TRACE_BEGIN(TRACE_CAPTURE);
+    capture_lrw(ctx->capture, CAPTURE_TX, 0, ctx->pdo_output, ctx->output_size,
+                ctx->pdo_input, ctx->input_size, 0);
+    TRACE_END(TRACE_CAPTURE);
+    
+    // The stub "sends" once the output image has been captured
+    wirestamp_complete(ctx->wirestamp, wirestamp_now_ns());
+    
+    ctx->last_wkc = ctx->expected_wkc;
+    
+    TRACE_BEGIN(TRACE_INPUT_COPY);
+    if (ctx->sim_slaves > 0 && ctx->pdo_input && ctx->pdo_output) {
+        memcpy(ctx->pdo_input, ctx->pdo_output,
+               (ctx->input_size < ctx->output_size) ? ctx->input_size : ctx->output_size);
+    } else if (ctx->pdo_input && ctx->input_size >= 4) {
         *(uint32_t*)ctx->pdo_input = counter;
     }
+    TRACE_END(TRACE_INPUT_COPY);
+    
+    TRACE_BEGIN(TRACE_CAPTURE);
+    capture_lrw(ctx->capture, CAPTURE_RX, 0, ctx->pdo_output, ctx->output_size,
+                ctx->pdo_input, ctx->input_size, ctx->last_wkc);
+    TRACE_END(TRACE_CAPTURE);
+    record_capture_overhead(ctx);
     
     return 0;
 }
@@ -249,19 +396,93 @@ int ethercat_read_pdo(ethercat_context_t *ctx, uint32_t slave, uint32_t offset,
                      uint32_t size, uint32_t *value) {
     if (!ctx || !value || slave == 0 || slave > ctx->slave_count) return -1;
     
-    if (!ctx->network_active) return -1;
+    if (!ctx->network_active || !ctx->pdo_input) {
+        LOG_DEBUG("STUB: PDO read failed - no slaves available");
+        return -1;
+    }
+    
+    if (offset > ctx->input_size || size > ctx->input_size - offset) return -1;
     
-    LOG_DEBUG("STUB: PDO read failed - no slaves available");
-    return -1;
+    *value = 0;
+    memcpy(value, ctx->pdo_input + offset, (size > 4) ? 4 : size);
+    
+    return 0;
 }
 
 int ethercat_write_pdo(ethercat_context_t *ctx, uint32_t slave, uint32_t offset,
                       uint32_t size, uint32_t value) {
     if (!ctx || slave == 0 || slave > ctx->slave_count) return -1;
     
-    if (!ctx->network_active) return -1;
+    if (!ctx->network_active || !ctx->pdo_output) {
+        LOG_DEBUG("STUB: PDO write failed - no slaves available");
+        return -1;
+    }
+    
+    if (offset > ctx->output_size || size > ctx->output_size - offset) return -1;
     
-    LOG_DEBUG("STUB: PDO write failed - no slaves available");
+    memcpy(ctx->pdo_output + offset, &value, (size > 4) ? 4 : size);
+    
+    return 0;
+}
+
+int ethercat_attach_slave(ethercat_context_t *ctx, uint32_t position, slave_info_t *info) {
+    (void)position;
+    
+    if (!ctx || !info || !ctx->network_active) return -1;
+    
+    LOG_DEBUG("STUB: Slave attach failed - no slaves available");
+    return -1;
+}
+
+int ethercat_detach_slave(ethercat_context_t *ctx, uint32_t position) {
+    if (!ctx || !ctx->network_active || position == 0 || position > ctx->slave_count) return -1;
+    return 0;
+}
+
+// Simulated slaves are never attached while running, so the table built at
+// start stays current
+int ethercat_refresh_symbols(ethercat_context_t *ctx) {
+    return (ctx && ctx->network_active) ? 0 : -1;
+}
+
+int ethercat_check_slaves(ethercat_context_t *ctx) {
+    if (!ctx || !ctx->network_active) return -1;
+    
+    for (uint32_t i = 0; i < ctx->slave_count && i < MAX_SLAVES; i++) {
+        ctx->slaves[i].al_state = EC_STATE_OP;
+    }
+    
+    return 0;
+}
+
+int ethercat_recover_slave(ethercat_context_t *ctx, uint32_t slave) {
+    if (!ctx || !ctx->network_active || slave == 0 || slave > ctx->slave_count) return -1;
+    
+    ctx->slaves[slave - 1].al_state = EC_STATE_OP;
+    return 0;
+}
+
+int ethercat_sdo_read(ethercat_context_t *ctx, uint16_t slave, uint16_t index, uint8_t subindex,
+                      bool complete_access, void *data, uint32_t *size, uint32_t *abort_code) {
+    (void)index; (void)subindex; (void)complete_access;
+    
+    if (!ctx || !data || !size || slave == 0 || slave > ctx->slave_count) return -1;
+    
+    if (abort_code) *abort_code = 0;
+    
+    LOG_DEBUG("STUB: SDO read failed - no slaves available");
+    return -1;
+}
+
+int ethercat_sdo_write(ethercat_context_t *ctx, uint16_t slave, uint16_t index, uint8_t subindex,
+                       bool complete_access, const void *data, uint32_t size, uint32_t *abort_code) {
+    (void)index; (void)subindex; (void)complete_access; (void)size;
+    
+    if (!ctx || !data || slave == 0 || slave > ctx->slave_count) return -1;
+    
+    if (abort_code) *abort_code = 0;
+    
+    LOG_DEBUG("STUB: SDO write failed - no slaves available");
     return -1;
 }
 
@@ -284,10 +505,41 @@ int ethercat_stub_init(ethercat_context_t *ctx, const char *interface) {
 
 #endif
 
+// Called by the network thread at the top of its loop
+void ethercat_take_symbols(ethercat_context_t *ctx) {
+    if (!atomic_load_explicit(&ctx->symbols_updated, memory_order_acquire)) return;
+    
+    symbol_table_t running = ctx->symbols;
+    ctx->symbols = ctx->symbols_update;
+    ctx->symbols_update = running;
+    atomic_store_explicit(&ctx->symbols_updated, false, memory_order_release);
+}
+
 void ethercat_cleanup(ethercat_context_t *ctx) {
     if (!ctx) return;
     
     ethercat_stop(ctx);
+    symbols_cleanup(&ctx->symbols);
+    symbols_cleanup(&ctx->symbols_update);
+}
+
+void ethercat_record_cycle(uint32_t period_us, bool missed) {
+    g_timing_stats.cycles_total++;
+    if (missed) g_timing_stats.cycles_missed++;
+    
+    g_timing_stats.total_time_us += period_us;
+    if (g_timing_stats.min_cycle_us == 0 || period_us < g_timing_stats.min_cycle_us) {
+        g_timing_stats.min_cycle_us = period_us;
+    }
+    if (period_us > g_timing_stats.max_cycle_us) {
+        g_timing_stats.max_cycle_us = period_us;
+    }
+    
+    g_timing_stats.avg_cycle_us = (uint32_t)(g_timing_stats.total_time_us / g_timing_stats.cycles_total);
+    uint32_t deviation = (period_us > g_timing_stats.avg_cycle_us) ?
+                         period_us - g_timing_stats.avg_cycle_us :
+                         g_timing_stats.avg_cycle_us - period_us;
+    g_timing_stats.jitter_us = (g_timing_stats.jitter_us * 15 + deviation) / 16;
 }
 
 void ethercat_get_timing_stats(timing_stats_t *stats) {
@@ -309,7 +561,16 @@ void ethercat_get_error_stats(error_stats_t *stats) {
     memcpy(stats, &g_error_stats, sizeof(error_stats_t));
 }
 
+void ethercat_get_transport_stats(transport_stats_t *stats) {
+    if (!stats) return;
+    
+    memcpy(stats, &g_transport_stats, sizeof(transport_stats_t));
+}
+
 void ethercat_reset_stats(void) {
     memset(&g_timing_stats, 0, sizeof(timing_stats_t));
     memset(&g_error_stats, 0, sizeof(error_stats_t));
+    memset(&g_transport_stats, 0, sizeof(transport_stats_t));
+    g_capture_cycles = 0;
+    g_capture_total_ns = 0;
 }
\ No newline at end of file
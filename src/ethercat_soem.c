@@ -1,5 +1,6 @@
 #include "ethercat.h"
 #include "logging.h"
+#include "topology.h"
 #include <string.h>
 #include <stdlib.h>
 #include <time.h>
@@ -9,6 +10,68 @@
 
 static ecx_contextt ec_context;
 static boolean inOP = FALSE;
+static uint8 g_iomap[ETHERCAT_IOMAP_SIZE];
+static topology_snapshot_t g_topology;
+
+typedef struct {
+    uint32_t iomap_offset;
+    uint32_t image_offset;
+    uint32_t length;
+} hotplug_segment_t;
+
+// Process data of hot-plugged slaves lives in the spare IOmap area behind
+// the original group, so it is copied separately from the main image.
+// Only the RT thread changes the segment tables.
+static hotplug_segment_t g_hotplug_outputs[ETHERCAT_HOTPLUG_MAX];
+static hotplug_segment_t g_hotplug_inputs[ETHERCAT_HOTPLUG_MAX];
+static volatile uint32_t g_hotplug_output_count = 0;
+static volatile uint32_t g_hotplug_input_count = 0;
+static uint32_t g_spare_used = 0;
+
+// Frame growth for one attached slave. The hot-plug thread prepares it and
+// the RT thread applies it between two cycles, so the group never changes
+// under ecx_send_processdata.
+typedef struct {
+    uint32_t added;
+    uint16_t outputs_wkc;
+    uint16_t inputs_wkc;
+    hotplug_segment_t output;
+    hotplug_segment_t input;
+} hotplug_grow_t;
+
+enum { GROW_IDLE, GROW_PENDING, GROW_APPLYING };
+
+#define HOTPLUG_GROW_WAIT_MS    1000
+
+static hotplug_grow_t g_grow;
+static volatile uint32_t g_grow_state = GROW_IDLE;
+
+// Optional memory-mapped transport that replaces SOEM's send/receive for
+// the cyclic LRW only; mailbox and state traffic keep using SOEM's socket.
+static transport_t g_transport = { .fd = -1 };
+static bool g_use_mmap = false;
+static transport_stats_t g_transport_stats;
+
+static timing_stats_t g_timing_stats;
+static uint32_t g_capture_cycles = 0;
+static uint64_t g_capture_total_ns = 0;
+
+// Capture cost is accumulated per cycle and folded into the timing stats
+static void record_capture_overhead(ethercat_context_t *ctx) {
+    uint32_t ns = capture_take_overhead(ctx->capture);
+    if (ns == 0) return;
+    
+    g_capture_cycles++;
+    g_capture_total_ns += ns;
+    g_timing_stats.capture_overhead_avg_ns = (uint32_t)(g_capture_total_ns / g_capture_cycles);
+    if (ns > g_timing_stats.capture_overhead_max_ns) {
+        g_timing_stats.capture_overhead_max_ns = ns;
+    }
+}
+
+static inline uint64_t timespec_to_ns(const struct timespec *ts) {
+    return (uint64_t)ts->tv_sec * 1000000000ULL + (uint64_t)ts->tv_nsec;
+}
 
 int ethercat_init(ethercat_context_t *ctx, const char *interface) {
     if (!ctx || !interface) return -1;
@@ -27,35 +90,397 @@ int ethercat_init(ethercat_context_t *ctx, const char *interface) {
     return 0;
 }
 
+static uint32_t elapsed_ms(const struct timespec *since) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint32_t)((now.tv_sec - since->tv_sec) * 1000 +
+                      (now.tv_nsec - since->tv_nsec) / 1000000);
+}
+
+// With a snapshot whose identities match, the slaves are configured from it
+// instead of by ecx_config_init, whose walk through every slave's SII
+// categories dominates a cold start. Only the station addresses are set and
+// the three identity words read. Any difference falls back to the full scan
+static bool warm_config_init(const ethercat_context_t *ctx) {
+    if (topology_load(ctx->topology_cache, &g_topology) < 0) return false;
+    
+    // Undo whatever a previous configuration left behind, as the full scan
+    // does before counting the slaves
+    static uint8 zeros[sizeof(ec_fmmut) * EC_MAXFMMU + sizeof(ec_smt) * EC_MAXSM];
+    uint16 alctl = htoes(EC_STATE_INIT | EC_STATE_ACK);
+    ecx_BWR(ec_context.port, 0x0000, ECT_REG_ALCTL, sizeof(alctl), &alctl, EC_TIMEOUTRET3);
+    ecx_BWR(ec_context.port, 0x0000, ECT_REG_FMMU0, sizeof(ec_fmmut) * EC_MAXFMMU, zeros,
+            EC_TIMEOUTRET3);
+    ecx_BWR(ec_context.port, 0x0000, ECT_REG_SM0, sizeof(ec_smt) * EC_MAXSM, zeros, EC_TIMEOUTRET3);
+    
+    uint16 type = 0;
+    int found = ecx_BRD(ec_context.port, 0x0000, ECT_REG_TYPE, sizeof(type), &type, EC_TIMEOUTSAFE);
+    if (found <= 0 || found >= EC_MAXSLAVE || (uint32_t)found != g_topology.slave_count) {
+        LOG_INFO("Topology changed (%u cached, %d found), performing cold start",
+                 g_topology.slave_count, found);
+        return false;
+    }
+    
+    memset(&ec_context.slavelist[0], 0, sizeof(ec_slavet) * (size_t)(found + 1));
+    memset(&ec_context.grouplist[0], 0, sizeof(ec_groupt));
+    ec_context.slavecount = found;
+    
+    for (int i = 1; i <= found; i++) {
+        ec_slavet *sl = &ec_context.slavelist[i];
+        const topology_slave_t *cached = &g_topology.slaves[i - 1];
+        uint16 configadr = (uint16)(EC_NODEOFFSET + i);
+        
+        if (ecx_APWRw(ec_context.port, (uint16)(1 - i), ECT_REG_STADR, htoes(configadr),
+                      EC_TIMEOUTRET3) <= 0) {
+            LOG_INFO("Slave %d did not take its address, performing cold start", i);
+            return false;
+        }
+        
+        sl->configadr = configadr;
+        sl->eep_man = ecx_readeeprom(&ec_context, (uint16)i, ECT_SII_MANUF, EC_TIMEOUTEEP);
+        sl->eep_id = ecx_readeeprom(&ec_context, (uint16)i, ECT_SII_ID, EC_TIMEOUTEEP);
+        sl->eep_rev = ecx_readeeprom(&ec_context, (uint16)i, ECT_SII_REV, EC_TIMEOUTEEP);
+        if (!topology_slave_matches(&g_topology, i - 1, sl->eep_man, sl->eep_id, sl->eep_rev)) {
+            LOG_INFO("Slave %d identity differs from snapshot, performing cold start", i);
+            return false;
+        }
+        
+        sl->mbx_wo = cached->mbx_write_offset;
+        sl->mbx_l = cached->mbx_write_length;
+        sl->mbx_ro = cached->mbx_read_offset;
+        sl->mbx_rl = cached->mbx_read_length;
+        sl->mbx_proto = cached->mbx_proto;
+        sl->CoEdetails = cached->coe_details;
+        sl->FMMU0func = cached->fmmu_func[0];
+        sl->FMMU1func = cached->fmmu_func[1];
+        sl->FMMU2func = cached->fmmu_func[2];
+        sl->FMMU3func = cached->fmmu_func[3];
+        sl->topology = cached->topology;
+        sl->activeports = cached->active_ports;
+        sl->ptype = cached->port_types;
+        sl->parent = cached->parent;
+        sl->hasdc = cached->has_dc ? TRUE : FALSE;
+        memcpy(sl->name, cached->name, TOPOLOGY_NAME_LEN);
+        sl->name[TOPOLOGY_NAME_LEN] = '\0';
+        
+        sl->Obits = cached->output_bits;
+        sl->Ibits = cached->input_bits;
+        for (int sm = 0; sm < TOPOLOGY_MAX_SM && sm < EC_MAXSM; sm++) {
+            sl->SM[sm].StartAddr = cached->sm_start[sm];
+            sl->SM[sm].SMlength = cached->sm_length[sm];
+            sl->SM[sm].SMflags = cached->sm_flags[sm];
+            sl->SMtype[sm] = cached->sm_type[sm];
+        }
+        
+        // A non-zero config index makes SOEM trust Obits/Ibits instead of
+        // reading the PDO assignment over CoE or from the SII again
+        sl->configindex = 1;
+        sl->state = EC_STATE_INIT;
+        
+        if (sl->mbx_l > 0) {
+            ecx_FPWR(ec_context.port, configadr, ECT_REG_SM0, sizeof(ec_smt) * 2, &sl->SM[0],
+                     EC_TIMEOUTRET3);
+        }
+        ecx_FPWRw(ec_context.port, configadr, ECT_REG_ALCTL, htoes(EC_STATE_PRE_OP), EC_TIMEOUTRET3);
+    }
+    
+    if (ecx_statecheck(&ec_context, 0, EC_STATE_PRE_OP, EC_TIMEOUTSTATE) != EC_STATE_PRE_OP) {
+        LOG_INFO("Slaves did not reach PRE_OP from the snapshot, performing cold start");
+        return false;
+    }
+    
+    return true;
+}
+
+static void store_topology_snapshot(const ethercat_context_t *ctx, int iomap_size) {
+    if (!ctx->topology_cache[0]) return;
+    
+    memset(&g_topology, 0, sizeof(g_topology));
+    g_topology.slave_count = (uint32_t)ec_context.slavecount;
+    g_topology.iomap_size = (uint32_t)iomap_size;
+    g_topology.input_size = ctx->input_size;
+    g_topology.output_size = ctx->output_size;
+    
+    for (int i = 1; i <= ec_context.slavecount && i <= TOPOLOGY_MAX_SLAVES; i++) {
+        const ec_slavet *sl = &ec_context.slavelist[i];
+        topology_slave_t *cached = &g_topology.slaves[i - 1];
+        
+        cached->vendor_id = sl->eep_man;
+        cached->product_code = sl->eep_id;
+        cached->revision = sl->eep_rev;
+        cached->config_address = sl->configadr;
+        cached->output_bits = sl->Obits;
+        cached->input_bits = sl->Ibits;
+        cached->output_bytes = sl->Obytes;
+        cached->input_bytes = sl->Ibytes;
+        cached->output_offset = sl->outputs ? (uint32_t)(sl->outputs - g_iomap) : 0;
+        cached->input_offset = sl->inputs ? (uint32_t)(sl->inputs - g_iomap) : 0;
+        for (int sm = 0; sm < TOPOLOGY_MAX_SM && sm < EC_MAXSM; sm++) {
+            cached->sm_start[sm] = sl->SM[sm].StartAddr;
+            cached->sm_length[sm] = sl->SM[sm].SMlength;
+            cached->sm_flags[sm] = sl->SM[sm].SMflags;
+            cached->sm_type[sm] = sl->SMtype[sm];
+        }
+        cached->has_dc = sl->hasdc ? 1 : 0;
+        cached->dc_delay_ns = sl->pdelay;
+        cached->mbx_write_offset = sl->mbx_wo;
+        cached->mbx_write_length = sl->mbx_l;
+        cached->mbx_read_offset = sl->mbx_ro;
+        cached->mbx_read_length = sl->mbx_rl;
+        cached->mbx_proto = sl->mbx_proto;
+        cached->coe_details = sl->CoEdetails;
+        cached->fmmu_func[0] = sl->FMMU0func;
+        cached->fmmu_func[1] = sl->FMMU1func;
+        cached->fmmu_func[2] = sl->FMMU2func;
+        cached->fmmu_func[3] = sl->FMMU3func;
+        cached->topology = sl->topology;
+        cached->active_ports = sl->activeports;
+        cached->port_types = sl->ptype;
+        cached->parent = sl->parent;
+        memcpy(cached->name, sl->name, TOPOLOGY_NAME_LEN);
+    }
+    
+    topology_save(ctx->topology_cache, &g_topology);
+}
+
+// The snapshot's DC delays are a cross-check only: ecx_configdc measures them
+// again on every start, and a change usually means the segment was recabled
+static void check_cached_layout(int iomap_size) {
+    if (g_topology.iomap_size != (uint32_t)iomap_size) {
+        LOG_WARN("IOmap size %d differs from snapshot (%u)", iomap_size, g_topology.iomap_size);
+    }
+    
+    for (int i = 1; i <= ec_context.slavecount; i++) {
+        const ec_slavet *sl = &ec_context.slavelist[i];
+        const topology_slave_t *cached = &g_topology.slaves[i - 1];
+        
+        if (sl->hasdc && cached->has_dc && sl->pdelay != cached->dc_delay_ns) {
+            LOG_INFO("Slave %d DC delay %d ns differs from snapshot (%d ns)", i, sl->pdelay,
+                     cached->dc_delay_ns);
+        }
+    }
+}
+
+static uint32_t pop_sdo_abort_code(void) {
+    ec_errort err;
+    uint32_t abort_code = 0;
+    
+    while (ecx_poperror(&ec_context, &err)) {
+        if (err.Etype == EC_ERR_TYPE_SDO_ERROR) {
+            abort_code = (uint32_t)err.AbortCode;
+        }
+    }
+    
+    return abort_code;
+}
+
+#define SYMBOL_SLAVE_ENTRIES    256
+
+// Read the PDO assignment of one direction (0x1C12 outputs, 0x1C13 inputs)
+// and the mapping objects it lists. Each entry is index:16, subindex:8, bits:8
+static int read_coe_mapping(uint16_t slave, uint16_t assign_index, uint32_t *entries,
+                            uint32_t *count) {
+    uint8_t pdo_count = 0;
+    int size = sizeof(pdo_count);
+    
+    *count = 0;
+    if (ecx_SDOread(&ec_context, slave, assign_index, 0, FALSE, &size, &pdo_count,
+                    EC_TIMEOUTRXM) <= 0) {
+        return -1;
+    }
+    
+    for (uint32_t p = 1; p <= pdo_count; p++) {
+        uint16_t pdo = 0;
+        uint8_t entry_count = 0;
+        
+        size = sizeof(pdo);
+        if (ecx_SDOread(&ec_context, slave, assign_index, (uint8_t)p, FALSE, &size, &pdo,
+                        EC_TIMEOUTRXM) <= 0) {
+            return -1;
+        }
+        pdo = etohs(pdo);
+        
+        size = sizeof(entry_count);
+        if (ecx_SDOread(&ec_context, slave, pdo, 0, FALSE, &size, &entry_count,
+                        EC_TIMEOUTRXM) <= 0) {
+            return -1;
+        }
+        
+        for (uint32_t e = 1; e <= entry_count; e++) {
+            uint32_t entry = 0;
+            
+            if (*count == SYMBOL_SLAVE_ENTRIES) return -1;
+            size = sizeof(entry);
+            if (ecx_SDOread(&ec_context, slave, pdo, (uint8_t)e, FALSE, &size, &entry,
+                            EC_TIMEOUTRXM) <= 0) {
+                return -1;
+            }
+            entries[(*count)++] = etohl(entry);
+        }
+    }
+    
+    return 0;
+}
+
+// Byte offset of slave data in the process image. Hot-plugged slaves sit in
+// the spare IOmap region, which the segment tables map behind the image
+static uint32_t image_offset(const uint8 *data, symbol_dir_t dir) {
+    const hotplug_segment_t *segments = (dir == SYMBOL_INPUT) ? g_hotplug_inputs
+                                                              : g_hotplug_outputs;
+    uint32_t count = (dir == SYMBOL_INPUT) ? g_hotplug_input_count : g_hotplug_output_count;
+    uint32_t iomap = (uint32_t)(data - g_iomap);
+    
+    for (uint32_t i = 0; i < count; i++) {
+        if (iomap >= segments[i].iomap_offset &&
+            iomap < segments[i].iomap_offset + segments[i].length) {
+            return segments[i].image_offset + (iomap - segments[i].iomap_offset);
+        }
+    }
+    
+    const uint8 *start = (dir == SYMBOL_INPUT) ? ec_context.slavelist[0].inputs
+                                               : ec_context.slavelist[0].outputs;
+    return (uint32_t)(data - start);
+}
+
+// One direction of one slave: mapped entries over CoE when the slave has a
+// mailbox and its mapping adds up to the bits SOEM mapped, otherwise the PDOs
+// listed in the SII, otherwise the whole slave image as a single symbol
+static void add_slave_symbols(symbol_table_t *table, uint16_t slave, symbol_dir_t dir) {
+    const ec_slavet *sl = &ec_context.slavelist[slave];
+    uint32_t bits = (dir == SYMBOL_INPUT) ? sl->Ibits : sl->Obits;
+    
+    if (bits == 0) return;
+    
+    uint32_t base = (dir == SYMBOL_INPUT)
+                    ? image_offset(sl->inputs, dir) * 8 + sl->Istartbit
+                    : image_offset(sl->outputs, dir) * 8 + sl->Ostartbit;
+    
+    static uint32_t entries[SYMBOL_SLAVE_ENTRIES];
+    uint32_t count = 0;
+    
+    if (sl->mbx_proto & ECT_MBXPROT_COE) {
+        uint16_t assign = (dir == SYMBOL_INPUT) ? 0x1C13 : 0x1C12;
+        uint32_t mapped = 0;
+        
+        if (read_coe_mapping(slave, assign, entries, &count) == 0) {
+            for (uint32_t i = 0; i < count; i++) {
+                mapped += entries[i] & 0xFF;
+            }
+        }
+        pop_sdo_abort_code();
+        
+        if (count > 0 && mapped == bits) {
+            uint32_t bit = 0;
+            for (uint32_t i = 0; i < count; i++) {
+                uint16_t index = (uint16_t)(entries[i] >> 16);
+                uint8_t subindex = (uint8_t)(entries[i] >> 8);
+                uint16_t size = (uint16_t)(entries[i] & 0xFF);
+                
+                // Index 0 is padding between entries
+                if (index != 0) {
+                    symbols_add_entry(table, slave, dir, index, subindex, base + bit, size);
+                }
+                bit += size;
+            }
+            return;
+        }
+    }
+    
+    static ec_eepromPDOt eep_pdo;
+    memset(&eep_pdo, 0, sizeof(eep_pdo));
+    if (ecx_siiPDO(&ec_context, slave, &eep_pdo, (dir == SYMBOL_INPUT) ? 0 : 1) == bits) {
+        uint32_t bit = 0;
+        for (uint16_t i = 0; i < eep_pdo.nPDO; i++) {
+            if (eep_pdo.BitSize[i] == 0) continue;
+            symbols_add_entry(table, slave, dir, eep_pdo.Index[i], 0, base + bit,
+                              eep_pdo.BitSize[i]);
+            bit += eep_pdo.BitSize[i];
+        }
+        if (bit == bits) return;
+    }
+    
+    symbols_add_entry(table, slave, dir, 0, 0, base, (uint16_t)bits);
+}
+
+static void build_symbols(symbol_table_t *table) {
+    symbols_clear(table);
+    
+    for (int i = 1; i <= ec_context.slavecount; i++) {
+        add_slave_symbols(table, (uint16_t)i, SYMBOL_INPUT);
+        add_slave_symbols(table, (uint16_t)i, SYMBOL_OUTPUT);
+    }
+    
+    if (symbols_build(table) < 0) {
+        symbols_clear(table);
+    }
+}
+
 int ethercat_start(ethercat_context_t *ctx) {
     if (!ctx || ctx->network_active) return -1;
     
+    struct timespec start_time;
+    clock_gettime(CLOCK_MONOTONIC, &start_time);
+    
     if (ecx_init(&ec_context, ctx->interface_name)) {
         LOG_INFO("ecx_init on %s succeeded", ctx->interface_name);
         
-        if (ecx_config_init(&ec_context) > 0) {
+        ctx->warm_start = warm_config_init(ctx);
+        if (ctx->warm_start) {
+            LOG_INFO("Topology matches snapshot, configuring slaves from it");
+        }
+        
+        if (ctx->warm_start || ecx_config_init(&ec_context) > 0) {
             LOG_INFO("Found %d slaves", ec_context.slavecount);
             
-            // Allocate IOmap size based on total slaves
-            ctx->input_size = 1024;  // Conservative estimate
-            ctx->output_size = 1024; // Conservative estimate
+            // Map slaves to IOmap
+            memset(g_iomap, 0, sizeof(g_iomap));
+            int iomap_size = ecx_config_map_group(&ec_context, g_iomap, 0);
+            if (iomap_size <= 0 || iomap_size + ETHERCAT_HOTPLUG_SPARE > (int)sizeof(g_iomap)) {
+                LOG_ERROR("Invalid IOmap size %d", iomap_size);
+                return -1;
+            }
+            
+            ecx_configdc(&ec_context);
             
-            ctx->pdo_input = malloc(ctx->input_size);
-            ctx->pdo_output = malloc(ctx->output_size);
+            ctx->output_size = ec_context.grouplist[0].Obytes;
+            ctx->input_size = ec_context.grouplist[0].Ibytes;
+            
+            // Reserve room for slaves attached while cycling
+            ctx->pdo_input = malloc(ctx->input_size + ETHERCAT_HOTPLUG_SPARE);
+            ctx->pdo_output = malloc(ctx->output_size + ETHERCAT_HOTPLUG_SPARE);
+            g_hotplug_output_count = 0;
+            g_hotplug_input_count = 0;
+            g_grow_state = GROW_IDLE;
+            g_spare_used = 0;
             
             if (!ctx->pdo_input || !ctx->pdo_output) {
                 LOG_ERROR("Failed to allocate PDO memory");
                 return -1;
             }
             
-            memset(ctx->pdo_input, 0, ctx->input_size);
-            memset(ctx->pdo_output, 0, ctx->output_size);
+            memset(ctx->pdo_input, 0, ctx->input_size + ETHERCAT_HOTPLUG_SPARE);
+            memset(ctx->pdo_output, 0, ctx->output_size + ETHERCAT_HOTPLUG_SPARE);
             
-            // Map slaves to IOmap
-            ecx_config_map_group(&ec_context, ctx->pdo_input, 0);
-            ecx_configdc(&ec_context);
+            // Outputs retained by the previous daemon go out with the very
+            // frames that take the slaves to OP
+            ctx->outputs_restored = false;
+            if (ctx->retain) {
+                retain_slave_t retained[MAX_SLAVES];
+                uint32_t count = 0;
+                for (int i = 1; i <= ec_context.slavecount && count < MAX_SLAVES; i++, count++) {
+                    retained[count] = (retain_slave_t){ ec_context.slavelist[i].eep_man,
+                                                        ec_context.slavelist[i].eep_id,
+                                                        ec_context.slavelist[i].Ibytes,
+                                                        ec_context.slavelist[i].Obytes };
+                }
+                if (retain_attach(ctx->retain, retained, count, ctx->pdo_output,
+                                  ctx->output_size) > 0) {
+                    memcpy(ec_context.slavelist[0].outputs, ctx->pdo_output, ctx->output_size);
+                    ctx->outputs_restored = true;
+                }
+            }
             
-            LOG_INFO("Slaves mapped, state to SAFE_OP");
+            LOG_INFO("Slaves mapped (IOmap %d bytes), state to SAFE_OP", iomap_size);
             ecx_statecheck(&ec_context, 0, EC_STATE_SAFE_OP, EC_TIMEOUTSTATE * 4);
             
             LOG_INFO("Request operational state for all slaves");
@@ -72,10 +497,15 @@ int ethercat_start(ethercat_context_t *ctx) {
             } while (chk-- && (ec_context.slavelist[0].state != EC_STATE_OPERATIONAL));
             
             if (ec_context.slavelist[0].state == EC_STATE_OPERATIONAL) {
-                LOG_INFO("Operational state reached for all slaves");
+                ctx->startup_ms = elapsed_ms(&start_time);
+                LOG_INFO("Operational state reached for all slaves in %u ms (%s start)",
+                         ctx->startup_ms, ctx->warm_start ? "warm" : "cold");
                 inOP = TRUE;
                 ctx->network_active = true;
                 ctx->slave_count = ec_context.slavecount;
+                ctx->expected_wkc = (ec_context.grouplist[0].outputsWKC * 2) +
+                                    ec_context.grouplist[0].inputsWKC;
+                ctx->last_wkc = ctx->expected_wkc;
                 
                 for (int i = 1; i <= ec_context.slavecount; i++) {
                     if (i - 1 < MAX_SLAVES) {
@@ -85,11 +515,31 @@ int ethercat_start(ethercat_context_t *ctx) {
                         ctx->slaves[i - 1].vendor_id = ec_context.slavelist[i].eep_man;
                         ctx->slaves[i - 1].product_code = ec_context.slavelist[i].eep_id;
                         ctx->slaves[i - 1].online = true;
+                        ctx->slaves[i - 1].al_state = ec_context.slavelist[i].state;
                         ctx->slaves[i - 1].input_size = ec_context.slavelist[i].Ibytes;
                         ctx->slaves[i - 1].output_size = ec_context.slavelist[i].Obytes;
                     }
                 }
                 
+                if (ctx->warm_start) {
+                    check_cached_layout(iomap_size);
+                } else {
+                    store_topology_snapshot(ctx, iomap_size);
+                }
+                
+                build_symbols(&ctx->symbols);
+                
+                memset(&g_transport_stats, 0, sizeof(g_transport_stats));
+                g_use_mmap = false;
+                if (ctx->transport == TRANSPORT_MMAP) {
+                    if (transport_open(&g_transport, ctx->interface_name, ctx->busy_poll_us) == 0) {
+                        g_transport.capture = ctx->capture;
+                        g_use_mmap = true;
+                    } else {
+                        LOG_WARN("Memory-mapped transport unavailable, using SOEM transport");
+                    }
+                }
+                
                 return 0;
             } else {
                 LOG_ERROR("Not all slaves reached operational state");
@@ -107,10 +557,35 @@ int ethercat_start(ethercat_context_t *ctx) {
     return -1;
 }
 
+// The RT thread checks network_active once at the top of a cycle and then
+// works on the images until the cycle ends, so they may only be freed after
+// it has acknowledged a stop from its idle branch
+static void wait_rt_idle(ethercat_context_t *ctx) {
+    atomic_store_explicit(&ctx->stop_pending, true, memory_order_release);
+    while (atomic_load_explicit(&ctx->rt_running, memory_order_acquire) &&
+           atomic_load_explicit(&ctx->stop_pending, memory_order_acquire)) {
+        usleep(100);
+    }
+    atomic_store_explicit(&ctx->stop_pending, false, memory_order_relaxed);
+}
+
+// Called by the RT thread in every cycle it finds the network inactive
+void ethercat_rt_idle(ethercat_context_t *ctx) {
+    if (atomic_load_explicit(&ctx->stop_pending, memory_order_acquire)) {
+        atomic_store_explicit(&ctx->stop_pending, false, memory_order_release);
+    }
+}
+
 int ethercat_stop(ethercat_context_t *ctx) {
     if (!ctx) return -1;
     
-    if (ctx->network_active && inOP) {
+    // No frame may be in flight while the slaves are taken down either
+    bool was_active = ctx->network_active && inOP;
+    ctx->network_active = false;
+    wait_rt_idle(ctx);
+    retain_detach(ctx->retain);
+    
+    if (was_active) {
         LOG_INFO("Stopping EtherCAT network");
         
         ec_context.slavelist[0].state = EC_STATE_SAFE_OP;
@@ -130,23 +605,139 @@ int ethercat_stop(ethercat_context_t *ctx) {
         inOP = FALSE;
     }
     
+    if (g_use_mmap) {
+        transport_close(&g_transport);
+        g_use_mmap = false;
+    }
+    
     ecx_close(&ec_context);
-    ctx->network_active = false;
     ctx->slave_count = 0;
+    symbols_clear(&ctx->symbols);
+    symbols_clear(&ctx->symbols_update);
+    atomic_store_explicit(&ctx->symbols_updated, false, memory_order_relaxed);
     
     return 0;
 }
 
+static uint16_t slave_wkc(const ec_slavet *sl) {
+    return (uint16_t)((sl->Obytes ? 2 : 0) + (sl->Ibytes ? 1 : 0));
+}
+
+static void apply_grow(ethercat_context_t *ctx) {
+    ec_groupt *group = &ec_context.grouplist[0];
+    
+    // The spare region lies behind the group's inputs, so the frame grows at
+    // its input end even for the new outputs. ctx->input_size only counts
+    // real input bytes, which the segment table places in the input image
+    group->IOsegment[group->nsegments - 1] += g_grow.added;
+    group->Ibytes += g_grow.added;
+    ec_context.slavelist[0].Ibytes = group->Ibytes;
+    group->outputsWKC += g_grow.outputs_wkc;
+    group->inputsWKC += g_grow.inputs_wkc;
+    
+    if (g_grow.output.length) {
+        g_hotplug_outputs[g_hotplug_output_count] = g_grow.output;
+        __atomic_store_n(&g_hotplug_output_count, g_hotplug_output_count + 1, __ATOMIC_RELEASE);
+        ctx->output_size += g_grow.output.length;
+    }
+    if (g_grow.input.length) {
+        g_hotplug_inputs[g_hotplug_input_count] = g_grow.input;
+        __atomic_store_n(&g_hotplug_input_count, g_hotplug_input_count + 1, __ATOMIC_RELEASE);
+        ctx->input_size += g_grow.input.length;
+    }
+    ctx->expected_wkc += g_grow.outputs_wkc * 2 + g_grow.inputs_wkc;
+    
+    __atomic_store_n(&g_grow_state, GROW_IDLE, __ATOMIC_RELEASE);
+}
+
 int ethercat_process_data(ethercat_context_t *ctx) {
     if (!ctx || !ctx->network_active || !inOP) return -1;
     
-    ecx_send_processdata(&ec_context);
+    uint32_t grow = GROW_PENDING;
+    if (__atomic_load_n(&g_grow_state, __ATOMIC_RELAXED) == GROW_PENDING &&
+        __atomic_compare_exchange_n(&g_grow_state, &grow, GROW_APPLYING, false,
+                                    __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+        apply_grow(ctx);
+    }
+    
+    wirestamp_latch(ctx->wirestamp);
+    
+    TRACE_BEGIN(TRACE_OUTPUT_COPY);
+    if (ctx->pdo_output && ctx->output_size > 0) {
+        uint32_t segments = g_hotplug_output_count;
+        uint32_t base_size = segments ? g_hotplug_outputs[0].image_offset : ctx->output_size;
+        
+        memcpy(ec_context.slavelist[0].outputs, ctx->pdo_output, base_size);
+        for (uint32_t i = 0; i < segments; i++) {
+            memcpy(g_iomap + g_hotplug_outputs[i].iomap_offset,
+                   ctx->pdo_output + g_hotplug_outputs[i].image_offset,
+                   g_hotplug_outputs[i].length);
+        }
+    }
+    TRACE_END(TRACE_OUTPUT_COPY);
     
-    int wkc = ecx_receive_processdata(&ec_context, EC_TIMEOUTRET);
+    int wkc;
     
+    if (g_use_mmap) {
+        ec_groupt *group = &ec_context.grouplist[0];
+        uint16_t dc_address = group->hasdc ? ec_context.slavelist[group->DCnext].configadr : 0;
+        
+        wkc = transport_exchange(&g_transport, &g_transport_stats, group->logstartaddr,
+                                 group->outputs, group->Obytes + group->Ibytes,
+                                 dc_address, &ec_context.DCtime, EC_TIMEOUTRET);
+        if (wkc >= 0) {
+            wirestamp_complete(ctx->wirestamp, timespec_to_ns(&g_transport.last_tx_time));
+        }
+    } else {
+        ec_groupt *group = &ec_context.grouplist[0];
+        struct timespec sent, received;
+        
+        TRACE_BEGIN(TRACE_CAPTURE);
+        capture_lrw(ctx->capture, CAPTURE_TX, group->logstartaddr, group->outputs, group->Obytes,
+                    group->inputs, group->Ibytes, 0);
+        TRACE_END(TRACE_CAPTURE);
+        
+        clock_gettime(CLOCK_MONOTONIC, &sent);
+        TRACE_BEGIN(TRACE_SEND);
+        ecx_send_processdata(&ec_context);
+        TRACE_END(TRACE_SEND);
+        wirestamp_complete(ctx->wirestamp, timespec_to_ns(&sent));
+        TRACE_BEGIN(TRACE_RECEIVE);
+        wkc = ecx_receive_processdata(&ec_context, EC_TIMEOUTRET);
+        TRACE_END(TRACE_RECEIVE);
+        clock_gettime(CLOCK_MONOTONIC, &received);
+        
+        if (wkc >= 0) {
+            TRACE_BEGIN(TRACE_CAPTURE);
+            capture_lrw(ctx->capture, CAPTURE_RX, group->logstartaddr, group->outputs, group->Obytes,
+                        group->inputs, group->Ibytes, wkc);
+            TRACE_END(TRACE_CAPTURE);
+        }
+        
+        if (wkc > 0) {
+            transport_record_rtt(&g_transport_stats,
+                                 (uint32_t)((received.tv_sec - sent.tv_sec) * 1000000 +
+                                            (received.tv_nsec - sent.tv_nsec) / 1000));
+        }
+    }
+    ctx->last_wkc = wkc;
+    ctx->dc_time = ec_context.grouplist[0].hasdc ? ec_context.DCtime : 0;
+    
+    capture_condition(ctx->capture, CAPTURE_TRIGGER_WKC, wkc != ctx->expected_wkc);
+    record_capture_overhead(ctx);
+    
+    TRACE_BEGIN(TRACE_INPUT_COPY);
     if (wkc >= 0 && ctx->pdo_input) {
-        memcpy(ctx->pdo_input, ec_context.slavelist[0].inputs, ctx->input_size);
+        uint32_t segments = g_hotplug_input_count;
+        uint32_t base_size = segments ? g_hotplug_inputs[0].image_offset : ctx->input_size;
+        
+        memcpy(ctx->pdo_input, ec_context.slavelist[0].inputs, base_size);
+        for (uint32_t i = 0; i < segments; i++) {
+            memcpy(ctx->pdo_input + g_hotplug_inputs[i].image_offset,
+                   g_iomap + g_hotplug_inputs[i].iomap_offset, g_hotplug_inputs[i].length);
+        }
     }
+    TRACE_END(TRACE_INPUT_COPY);
     
     return (wkc >= 0) ? 0 : -1;
 }
@@ -157,7 +748,7 @@ int ethercat_read_pdo(ethercat_context_t *ctx, uint32_t slave, uint32_t offset,
     
     if (!ctx->network_active || !ctx->pdo_input) return -1;
     
-    if (offset + size > ctx->input_size) return -1;
+    if (offset > ctx->input_size || size > ctx->input_size - offset) return -1;
     
     *value = 0;
     memcpy(value, ctx->pdo_input + offset, (size > 4) ? 4 : size);
@@ -173,25 +764,429 @@ int ethercat_write_pdo(ethercat_context_t *ctx, uint32_t slave, uint32_t offset,
     
     if (!ctx->network_active || !ctx->pdo_output) return -1;
     
-    if (offset + size > ctx->output_size) return -1;
+    if (offset > ctx->output_size || size > ctx->output_size - offset) return -1;
     
     memcpy(ctx->pdo_output + offset, &value, (size > 4) ? 4 : size);
     
-    if (ec_context.slavelist[0].outputs) {
-        memcpy(ec_context.slavelist[0].outputs, ctx->pdo_output, ctx->output_size);
-    }
-    
     LOG_DEBUG("PDO write slave=%u, offset=%u, size=%u, value=0x%08X", 
               slave, offset, size, value);
     return 0;
 }
 
+int ethercat_check_slaves(ethercat_context_t *ctx) {
+    if (!ctx || !ctx->network_active) return -1;
+    
+    ecx_readstate(&ec_context);
+    
+    int not_op = 0;
+    for (uint32_t i = 1; i <= ctx->slave_count && i <= MAX_SLAVES; i++) {
+        ctx->slaves[i - 1].al_state = ec_context.slavelist[i].state;
+        if (ec_context.slavelist[i].state != EC_STATE_OPERATIONAL) {
+            not_op++;
+        }
+    }
+    
+    return not_op;
+}
+
+// One incremental recovery step for a single slave, modelled on SOEM's
+// ecatcheck: acknowledge errors, re-request OP, reconfigure or recover a
+// lost slave. Returns 0 once the slave is back in OP.
+int ethercat_recover_slave(ethercat_context_t *ctx, uint32_t slave) {
+    if (!ctx || !ctx->network_active || slave == 0 || slave > ctx->slave_count) return -1;
+    
+    ec_slavet *sl = &ec_context.slavelist[slave];
+    
+    if (sl->state == (EC_STATE_SAFE_OP + EC_STATE_ERROR)) {
+        LOG_WARN("Slave %u in SAFE_OP + ERROR, acknowledging", slave);
+        sl->state = EC_STATE_SAFE_OP + EC_STATE_ACK;
+        ecx_writestate(&ec_context, slave);
+    } else if (sl->state == EC_STATE_SAFE_OP) {
+        LOG_INFO("Slave %u in SAFE_OP, requesting OP", slave);
+        sl->state = EC_STATE_OPERATIONAL;
+        ecx_writestate(&ec_context, slave);
+    } else if (sl->state > EC_STATE_NONE) {
+        if (ecx_reconfig_slave(&ec_context, slave, EC_TIMEOUTMON)) {
+            sl->islost = FALSE;
+            LOG_INFO("Slave %u reconfigured", slave);
+        }
+    } else if (!sl->islost) {
+        ecx_statecheck(&ec_context, slave, EC_STATE_OPERATIONAL, EC_TIMEOUTRET);
+        if (sl->state == EC_STATE_NONE) {
+            sl->islost = TRUE;
+            LOG_WARN("Slave %u lost", slave);
+        }
+    }
+    
+    if (sl->islost) {
+        if (sl->state == EC_STATE_NONE) {
+            if (ecx_recover_slave(&ec_context, slave, EC_TIMEOUTMON)) {
+                sl->islost = FALSE;
+                LOG_INFO("Slave %u recovered", slave);
+            }
+        } else {
+            sl->islost = FALSE;
+        }
+    }
+    
+    ecx_statecheck(&ec_context, slave, EC_STATE_OPERATIONAL, EC_TIMEOUTRET);
+    ctx->slaves[slave - 1].al_state = sl->state;
+    
+    return (sl->state == EC_STATE_OPERATIONAL) ? 0 : 1;
+}
+
+int ethercat_sdo_read(ethercat_context_t *ctx, uint16_t slave, uint16_t index, uint8_t subindex,
+                      bool complete_access, void *data, uint32_t *size, uint32_t *abort_code) {
+    if (!ctx || !data || !size || slave == 0 || slave > ctx->slave_count) return -1;
+    
+    if (!ctx->network_active) return -1;
+    
+    // SOEM switches to segmented upload when the object exceeds the mailbox size
+    int psize = (int)*size;
+    int wkc = ecx_SDOread(&ec_context, slave, index, subindex, complete_access ? TRUE : FALSE,
+                          &psize, data, EC_TIMEOUTRXM);
+    
+    uint32_t code = pop_sdo_abort_code();
+    if (abort_code) *abort_code = code;
+    
+    if (wkc <= 0 || code != 0) return -1;
+    
+    *size = (uint32_t)psize;
+    
+    LOG_DEBUG("SDO read slave=%u, 0x%04X:%02X, size=%u", slave, index, subindex, *size);
+    return 0;
+}
+
+int ethercat_sdo_write(ethercat_context_t *ctx, uint16_t slave, uint16_t index, uint8_t subindex,
+                       bool complete_access, const void *data, uint32_t size, uint32_t *abort_code) {
+    if (!ctx || !data || slave == 0 || slave > ctx->slave_count) return -1;
+    
+    if (!ctx->network_active) return -1;
+    
+    int wkc = ecx_SDOwrite(&ec_context, slave, index, subindex, complete_access ? TRUE : FALSE,
+                           (int)size, (void *)data, EC_TIMEOUTRXM);
+    
+    uint32_t code = pop_sdo_abort_code();
+    if (abort_code) *abort_code = code;
+    
+    if (wkc <= 0 || code != 0) return -1;
+    
+    LOG_DEBUG("SDO write slave=%u, 0x%04X:%02X, size=%u", slave, index, subindex, size);
+    return 0;
+}
+
 int ethercat_scan_slaves(ethercat_context_t *ctx) {
     if (!ctx) return -1;
     
-    LOG_INFO("Scanning for slaves");
-    // In the new API, this is typically done during config_init
-    return ctx->slave_count;
+    if (!ctx->network_active) return ctx->slave_count;
+    
+    // Every slave on the segment increments the working counter of a broadcast read
+    uint16 type = 0;
+    int wkc = ecx_BRD(ec_context.port, 0x0000, ECT_REG_TYPE, sizeof(type), &type, EC_TIMEOUTSAFE);
+    
+    LOG_DEBUG("Scan found %d slaves (%u configured)", wkc, ctx->slave_count);
+    return (wkc >= 0) ? wkc : -1;
+}
+
+static void fill_slave_info(uint32_t position, const ec_slavet *sl, slave_info_t *info) {
+    info->slave_id = position;
+    snprintf(info->name, sizeof(info->name), "slave%u-%08X", position, sl->eep_id);
+    info->vendor_id = sl->eep_man;
+    info->product_code = sl->eep_id;
+    info->online = (sl->state == EC_STATE_OPERATIONAL);
+    info->al_state = sl->state;
+    info->input_size = sl->Ibytes;
+    info->output_size = sl->Obytes;
+}
+
+// Hands g_grow to the RT thread and waits until a cycle has applied it. A grow
+// no cycle picked up in time is withdrawn, so it can never be applied late
+static bool grow_frame(ethercat_context_t *ctx) {
+    __atomic_store_n(&g_grow_state, GROW_PENDING, __ATOMIC_RELEASE);
+    
+    for (int waited = 0; waited < HOTPLUG_GROW_WAIT_MS && ctx->network_active; waited++) {
+        if (__atomic_load_n(&g_grow_state, __ATOMIC_ACQUIRE) == GROW_IDLE) return true;
+        usleep(1000);
+    }
+    
+    uint32_t state = GROW_PENDING;
+    if (__atomic_compare_exchange_n(&g_grow_state, &state, GROW_IDLE, false,
+                                    __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+        return false;
+    }
+    
+    // Taken by a cycle just now; it finishes within that cycle
+    while (__atomic_load_n(&g_grow_state, __ATOMIC_ACQUIRE) != GROW_IDLE) {
+        usleep(100);
+    }
+    return true;
+}
+
+// Mailbox addresses come from the SII as in ecx_config_init; SOEM needs them
+// for any CoE traffic with the slave
+static void read_mailbox_config(uint32_t position, ec_slavet *sl) {
+    uint32 mbx = ecx_readeeprom(&ec_context, (uint16)position, ECT_SII_RXMBXADR, EC_TIMEOUTEEP);
+    sl->mbx_wo = (uint16)(mbx & 0xFFFF);
+    sl->mbx_l = (uint16)(mbx >> 16);
+    if (sl->mbx_l == 0) return;
+    
+    mbx = ecx_readeeprom(&ec_context, (uint16)position, ECT_SII_TXMBXADR, EC_TIMEOUTEEP);
+    sl->mbx_ro = (uint16)(mbx & 0xFFFF);
+    sl->mbx_rl = (uint16)(mbx >> 16);
+    if (sl->mbx_rl == 0) sl->mbx_rl = sl->mbx_l;
+    sl->mbx_proto = (uint16)ecx_readeeprom(&ec_context, (uint16)position, ECT_SII_MBXPROTO,
+                                           EC_TIMEOUTEEP);
+}
+
+// CoE slaves report their PDO assignment over SDO, which needs the mailbox
+// sync managers and PRE_OP first. ecx_readPDOmap also sizes the process SMs
+static bool read_coe_pdo_sizes(uint32_t position, ec_slavet *sl) {
+    if (sl->mbx_l == 0 || !(sl->mbx_proto & ECT_MBXPROT_COE)) return false;
+    
+    ecx_FPWR(ec_context.port, sl->configadr, ECT_REG_SM0, sizeof(ec_smt) * 2, &sl->SM[0],
+             EC_TIMEOUTRET3);
+    ecx_FPWRw(ec_context.port, sl->configadr, ECT_REG_ALCTL, htoes(EC_STATE_PRE_OP), EC_TIMEOUTRET3);
+    if (ecx_statecheck(&ec_context, (uint16)position, EC_STATE_PRE_OP,
+                       EC_TIMEOUTSTATE) != EC_STATE_PRE_OP) {
+        return false;
+    }
+    
+    uint32 osize = 0;
+    uint32 isize = 0;
+    if (ecx_readPDOmap(&ec_context, (uint16)position, &osize, &isize) <= 0 || (!osize && !isize)) {
+        return false;
+    }
+    
+    sl->Obits = (uint16)osize;
+    sl->Ibits = (uint16)isize;
+    return true;
+}
+
+// A slave that returns to a position it was detached from gets its old
+// address and frame region back; ecx_recover_slave checks the identity
+static int reattach_slave(ethercat_context_t *ctx, uint32_t position, slave_info_t *info) {
+    ec_slavet *sl = &ec_context.slavelist[position];
+    
+    if (ecx_recover_slave(&ec_context, (uint16)position, EC_TIMEOUTRET3) <= 0 ||
+        ecx_reconfig_slave(&ec_context, (uint16)position, EC_TIMEOUTSTATE) != EC_STATE_SAFE_OP) {
+        LOG_WARN("Slave at position %u is not the one detached from there", position);
+        return -1;
+    }
+    
+    sl->islost = FALSE;
+    sl->state = EC_STATE_OPERATIONAL;
+    ecx_writestate(&ec_context, (uint16)position);
+    ecx_statecheck(&ec_context, (uint16)position, EC_STATE_OPERATIONAL, EC_TIMEOUTSTATE);
+    ctx->expected_wkc += slave_wkc(sl);
+    
+    fill_slave_info(position, sl, info);
+    return 0;
+}
+
+// Configure a slave that appeared behind the last configured one and map it
+// into the spare IOmap region appended to group 0, without stopping the cycle.
+// A slave returning to a detached position is restored in place instead.
+int ethercat_attach_slave(ethercat_context_t *ctx, uint32_t position, slave_info_t *info) {
+    if (!ctx || !info || !ctx->network_active || !inOP || position == 0) return -1;
+    
+    if (position <= (uint32_t)ec_context.slavecount) {
+        return ec_context.slavelist[position].islost ? reattach_slave(ctx, position, info) : -1;
+    }
+    
+    if (position != (uint32_t)ec_context.slavecount + 1 || position >= EC_MAXSLAVE ||
+        position > MAX_SLAVES || g_hotplug_output_count >= ETHERCAT_HOTPLUG_MAX ||
+        g_hotplug_input_count >= ETHERCAT_HOTPLUG_MAX) {
+        return -1;
+    }
+    
+    ec_slavet *sl = &ec_context.slavelist[position];
+    ec_groupt *group = &ec_context.grouplist[0];
+    uint16 configadr = (uint16)(EC_NODEOFFSET + position);
+    
+    memset(sl, 0, sizeof(ec_slavet));
+    
+    if (ecx_APWRw(ec_context.port, (uint16)(1 - (int)position), ECT_REG_STADR,
+                  htoes(configadr), EC_TIMEOUTRET3) <= 0) {
+        return -1;
+    }
+    
+    sl->configadr = configadr;
+    ecx_FPWRw(ec_context.port, configadr, ECT_REG_ALCTL,
+              htoes(EC_STATE_INIT | EC_STATE_ACK), EC_TIMEOUTRET3);
+    
+    sl->eep_man = ecx_readeeprom(&ec_context, (uint16)position, ECT_SII_MANUF, EC_TIMEOUTEEP);
+    sl->eep_id = ecx_readeeprom(&ec_context, (uint16)position, ECT_SII_ID, EC_TIMEOUTEEP);
+    sl->eep_rev = ecx_readeeprom(&ec_context, (uint16)position, ECT_SII_REV, EC_TIMEOUTEEP);
+    read_mailbox_config(position, sl);
+    
+    ec_eepromSMt eep_sm;
+    if (ecx_siiSM(&ec_context, (uint16)position, &eep_sm)) {
+        uint16 n = 0;
+        do {
+            sl->SM[n].StartAddr = htoes(eep_sm.PhStart);
+            sl->SM[n].SMlength = htoes(eep_sm.Plength);
+            sl->SM[n].SMflags = htoel((uint32)eep_sm.Creg + ((uint32)eep_sm.Activate << 16));
+            sl->SMtype[n] = (uint8)(n < 2 ? n + 1 : 0);
+            n++;
+        } while (n < EC_MAXSM && ecx_siiSMnext(&ec_context, (uint16)position, &eep_sm, n));
+    }
+    
+    if (!read_coe_pdo_sizes(position, sl)) {
+        ec_eepromPDOt eep_pdo;
+        sl->Obits = (uint16)ecx_siiPDO(&ec_context, (uint16)position, &eep_pdo, 1);
+        for (int n = 0; n < EC_MAXSM; n++) {
+            if (eep_pdo.SMbitsize[n] > 0) {
+                sl->SM[n].SMlength = htoes((eep_pdo.SMbitsize[n] + 7) / 8);
+                sl->SMtype[n] = 3;
+            }
+        }
+        
+        sl->Ibits = (uint16)ecx_siiPDO(&ec_context, (uint16)position, &eep_pdo, 0);
+        for (int n = 0; n < EC_MAXSM; n++) {
+            if (eep_pdo.SMbitsize[n] > 0) {
+                sl->SM[n].SMlength = htoes((eep_pdo.SMbitsize[n] + 7) / 8);
+                sl->SMtype[n] = 4;
+            }
+        }
+    }
+    
+    sl->Obytes = (sl->Obits + 7) / 8;
+    sl->Ibytes = (sl->Ibits + 7) / 8;
+    
+    if (g_spare_used + sl->Obytes + sl->Ibytes > ETHERCAT_HOTPLUG_SPARE) {
+        LOG_WARN("Spare IOmap region exhausted, slave %u needs %u bytes",
+                 position, sl->Obytes + sl->Ibytes);
+        return -1;
+    }
+    
+    // The spare region starts right behind the inputs of group 0
+    uint32_t group_offset = (uint32_t)(group->outputs - g_iomap);
+    uint32_t out_offset = group_offset + group->Obytes + group->Ibytes;
+    uint32_t in_offset = out_offset + sl->Obytes;
+    
+    int fmmu = 0;
+    if (sl->Obytes) {
+        for (int n = 0; n < EC_MAXSM; n++) {
+            if (sl->SMtype[n] == 3) {
+                sl->FMMU[fmmu].PhysStart = sl->SM[n].StartAddr;
+                break;
+            }
+        }
+        sl->FMMU[fmmu].LogStart = htoel(group->logstartaddr + (out_offset - group_offset));
+        sl->FMMU[fmmu].LogLength = htoes((uint16)sl->Obytes);
+        sl->FMMU[fmmu].LogStartbit = 0;
+        sl->FMMU[fmmu].LogEndbit = 7;
+        sl->FMMU[fmmu].PhysStartBit = 0;
+        sl->FMMU[fmmu].FMMUtype = 2;
+        sl->FMMU[fmmu].FMMUactive = 1;
+        sl->outputs = g_iomap + out_offset;
+        fmmu++;
+    }
+    
+    if (sl->Ibytes) {
+        for (int n = 0; n < EC_MAXSM; n++) {
+            if (sl->SMtype[n] == 4) {
+                sl->FMMU[fmmu].PhysStart = sl->SM[n].StartAddr;
+                break;
+            }
+        }
+        sl->FMMU[fmmu].LogStart = htoel(group->logstartaddr + (in_offset - group_offset));
+        sl->FMMU[fmmu].LogLength = htoes((uint16)sl->Ibytes);
+        sl->FMMU[fmmu].LogStartbit = 0;
+        sl->FMMU[fmmu].LogEndbit = 7;
+        sl->FMMU[fmmu].PhysStartBit = 0;
+        sl->FMMU[fmmu].FMMUtype = 1;
+        sl->FMMU[fmmu].FMMUactive = 1;
+        sl->inputs = g_iomap + in_offset;
+        fmmu++;
+    }
+    
+    sl->FMMUunused = (uint8)fmmu;
+    
+    if (ecx_reconfig_slave(&ec_context, (uint16)position, EC_TIMEOUTSTATE) != EC_STATE_SAFE_OP) {
+        LOG_WARN("New slave %u did not reach SAFE_OP", position);
+        return -1;
+    }
+    
+    uint32_t added = sl->Obytes + sl->Ibytes;
+    int seg = group->nsegments - 1;
+    if (seg < 0 || group->IOsegment[seg] + added > EC_MAXLRWDATA - EC_FIRSTDCDATAGRAM) {
+        LOG_WARN("LRW frame has no room for slave %u", position);
+        return -1;
+    }
+    
+    memset(&g_grow, 0, sizeof(g_grow));
+    g_grow.added = added;
+    if (sl->Obytes) {
+        g_grow.outputs_wkc = 1;
+        g_grow.output = (hotplug_segment_t){ out_offset, ctx->output_size, sl->Obytes };
+    }
+    if (sl->Ibytes) {
+        g_grow.inputs_wkc = 1;
+        g_grow.input = (hotplug_segment_t){ in_offset, ctx->input_size, sl->Ibytes };
+    }
+    
+    if (!grow_frame(ctx)) {
+        LOG_WARN("Cycle did not pick up slave %u", position);
+        return -1;
+    }
+    g_spare_used += added;
+    ec_context.slavecount = (int)position;
+    
+    sl->state = EC_STATE_OPERATIONAL;
+    ecx_writestate(&ec_context, (uint16)position);
+    ecx_statecheck(&ec_context, (uint16)position, EC_STATE_OPERATIONAL, EC_TIMEOUTSTATE);
+    
+    fill_slave_info(position, sl, info);
+    return 0;
+}
+
+// Takes a slave that vanished from the segment end out of the expected
+// working counter. Its frame region stays reserved for its return
+int ethercat_detach_slave(ethercat_context_t *ctx, uint32_t position) {
+    if (!ctx || !ctx->network_active || position == 0 ||
+        position > (uint32_t)ec_context.slavecount) {
+        return -1;
+    }
+    
+    ec_slavet *sl = &ec_context.slavelist[position];
+    if (!sl->islost) {
+        sl->islost = TRUE;
+        sl->state = EC_STATE_NONE;
+        ctx->expected_wkc -= slave_wkc(sl);
+    }
+    return 0;
+}
+
+// Rebuilds the symbol table after hot-plug attaches, on the hot-plug thread
+// under the master lock. The table is handed to the network thread, so
+// readers never see it change under them. Fails while the previous rebuild
+// has not been taken yet
+int ethercat_refresh_symbols(ethercat_context_t *ctx) {
+    if (!ctx || !ctx->network_active) return -1;
+    
+    if (atomic_load_explicit(&ctx->symbols_updated, memory_order_acquire)) return -1;
+    
+    // Continue the generation of the running table, so old handles are refused
+    ctx->symbols_update.generation = ctx->symbols.generation;
+    build_symbols(&ctx->symbols_update);
+    
+    if (ctx->symbols_update.layout_hash == ctx->symbols.layout_hash) return 0;
+    
+    LOG_INFO("Symbol table rebuilt: %u symbols, layout %08x", ctx->symbols_update.count,
+             ctx->symbols_update.layout_hash);
+    atomic_store_explicit(&ctx->symbols_updated, true, memory_order_release);
+    return 0;
+}
+
+// Called by the network thread at the top of its loop
+void ethercat_take_symbols(ethercat_context_t *ctx) {
+    if (!atomic_load_explicit(&ctx->symbols_updated, memory_order_acquire)) return;
+    
+    symbol_table_t running = ctx->symbols;
+    ctx->symbols = ctx->symbols_update;
+    ctx->symbols_update = running;
+    atomic_store_explicit(&ctx->symbols_updated, false, memory_order_release);
 }
 
 void ethercat_cleanup(ethercat_context_t *ctx) {
@@ -200,14 +1195,34 @@ void ethercat_cleanup(ethercat_context_t *ctx) {
     if (ctx->network_active) {
         ethercat_stop(ctx);
     }
+    symbols_cleanup(&ctx->symbols);
+    symbols_cleanup(&ctx->symbols_update);
     
     LOG_INFO("EtherCAT master cleaned up");
 }
 
+void ethercat_record_cycle(uint32_t period_us, bool missed) {
+    g_timing_stats.cycles_total++;
+    if (missed) g_timing_stats.cycles_missed++;
+    
+    g_timing_stats.total_time_us += period_us;
+    if (g_timing_stats.min_cycle_us == 0 || period_us < g_timing_stats.min_cycle_us) {
+        g_timing_stats.min_cycle_us = period_us;
+    }
+    if (period_us > g_timing_stats.max_cycle_us) {
+        g_timing_stats.max_cycle_us = period_us;
+    }
+    
+    g_timing_stats.avg_cycle_us = (uint32_t)(g_timing_stats.total_time_us / g_timing_stats.cycles_total);
+    uint32_t deviation = (period_us > g_timing_stats.avg_cycle_us) ?
+                         period_us - g_timing_stats.avg_cycle_us :
+                         g_timing_stats.avg_cycle_us - period_us;
+    g_timing_stats.jitter_us = (g_timing_stats.jitter_us * 15 + deviation) / 16;
+}
+
 void ethercat_get_timing_stats(timing_stats_t *stats) {
-    // TODO: Implement timing statistics collection
     if (stats) {
-        memset(stats, 0, sizeof(timing_stats_t));
+        memcpy(stats, &g_timing_stats, sizeof(timing_stats_t));
     }
 }
 
@@ -218,8 +1233,17 @@ void ethercat_get_error_stats(error_stats_t *stats) {
     }
 }
 
+void ethercat_get_transport_stats(transport_stats_t *stats) {
+    if (stats) {
+        memcpy(stats, &g_transport_stats, sizeof(transport_stats_t));
+    }
+}
+
 void ethercat_reset_stats(void) {
-    // TODO: Implement statistics reset
+    memset(&g_timing_stats, 0, sizeof(timing_stats_t));
+    memset(&g_transport_stats, 0, sizeof(transport_stats_t));
+    g_capture_cycles = 0;
+    g_capture_total_ns = 0;
 }
 
 #endif
\ No newline at end of file
@@ -0,0 +1,453 @@
+#include "events.h"
+#include "logging.h"
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define EVENT_UNLINKED  UINT32_MAX
+
+static void free_table(event_table_t *table) {
+    if (!table) return;
+    
+    free(table->id);
+    free(table->src);
+    free(table->type);
+    free(table->bit);
+    free(table->kind);
+    free(table->threshold);
+    free(table->rearm);
+    free(table->last);
+    free(table->armed);
+    free(table->line_start);
+    free(table->line_cond);
+    free(table);
+}
+
+void events_init(event_registry_t *reg) {
+    if (!reg) return;
+    
+    memset(reg, 0, sizeof(event_registry_t));
+    reg->next_id = 1;
+    atomic_init(&reg->pending, NULL);
+    atomic_init(&reg->retired, NULL);
+}
+
+void events_cleanup(event_registry_t *reg) {
+    if (!reg) return;
+    
+    free_table(atomic_exchange(&reg->pending, NULL));
+    free_table(atomic_exchange(&reg->retired, NULL));
+    free_table(reg->active);
+    reg->active = NULL;
+}
+
+int events_add(event_registry_t *reg, const event_condition_t *cond, uint32_t *id) {
+    if (!reg || !cond || !id) return -1;
+    
+    if (reg->count == EVENT_MAX_CONDITIONS) return -1;
+    
+    if (cond->type >= SIGNAL_TYPE_COUNT || cond->kind < EVENT_RISING ||
+        cond->kind > EVENT_EQUALS || cond->bit > 7 || cond->hysteresis < 0.0) {
+        return -1;
+    }
+    
+    event_condition_t *entry = &reg->conditions[reg->count++];
+    *entry = *cond;
+    entry->id = reg->next_id++;
+    if (reg->next_id == 0) {
+        reg->next_id = 1;
+    }
+    
+    reg->dirty = true;
+    *id = entry->id;
+    return 0;
+}
+
+static bool same_client(const struct sockaddr_in *a, const struct sockaddr_in *b) {
+    return a->sin_addr.s_addr == b->sin_addr.s_addr && a->sin_port == b->sin_port;
+}
+
+// Conditions stay sorted by id, so removal shifts rather than swaps
+static void remove_at(event_registry_t *reg, uint32_t index) {
+    memmove(&reg->conditions[index], &reg->conditions[index + 1],
+            (reg->count - index - 1) * sizeof(event_condition_t));
+    reg->count--;
+    reg->dirty = true;
+}
+
+int events_remove(event_registry_t *reg, uint32_t id, const struct sockaddr_in *owner) {
+    if (!reg || !owner) return -1;
+    
+    for (uint32_t i = 0; i < reg->count; i++) {
+        if (reg->conditions[i].id == id && same_client(&reg->conditions[i].addr, owner)) {
+            remove_at(reg, i);
+            return 0;
+        }
+    }
+    
+    return -1;
+}
+
+uint32_t events_remove_client(event_registry_t *reg, const struct sockaddr_in *owner) {
+    if (!reg || !owner) return 0;
+    
+    uint32_t removed = 0;
+    uint32_t i = 0;
+    
+    while (i < reg->count) {
+        if (same_client(&reg->conditions[i].addr, owner)) {
+            remove_at(reg, i);
+            removed++;
+        } else {
+            i++;
+        }
+    }
+    
+    return removed;
+}
+
+const event_condition_t* events_find(const event_registry_t *reg, uint32_t id) {
+    if (!reg) return NULL;
+    
+    for (uint32_t i = 0; i < reg->count; i++) {
+        if (reg->conditions[i].id == id) {
+            return &reg->conditions[i];
+        }
+    }
+    
+    return NULL;
+}
+
+bool events_needs_compile(const event_registry_t *reg, const uint8_t *image, uint32_t size) {
+    return reg->dirty || image != reg->compiled_image || size != reg->compiled_size;
+}
+
+static event_table_t* alloc_table(uint32_t count, uint32_t lines, uint32_t entries) {
+    event_table_t *table = calloc(1, sizeof(event_table_t));
+    if (!table) return NULL;
+    
+    uint32_t n = count ? count : 1;
+    table->id = calloc(n, sizeof(uint32_t));
+    table->src = calloc(n, sizeof(const uint8_t*));
+    table->type = calloc(n, sizeof(uint8_t));
+    table->bit = calloc(n, sizeof(uint8_t));
+    table->kind = calloc(n, sizeof(uint8_t));
+    table->threshold = calloc(n, sizeof(double));
+    table->rearm = calloc(n, sizeof(double));
+    table->last = calloc(n, sizeof(double));
+    table->armed = calloc(n, sizeof(uint8_t));
+    table->line_start = calloc(lines + 1, sizeof(uint32_t));
+    table->line_cond = calloc(entries ? entries : 1, sizeof(uint32_t));
+    
+    if (!table->id || !table->src || !table->type || !table->bit || !table->kind ||
+        !table->threshold || !table->rearm || !table->last || !table->armed ||
+        !table->line_start || !table->line_cond) {
+        free_table(table);
+        return NULL;
+    }
+    
+    return table;
+}
+
+// Runs in the network thread whenever conditions or the image layout change.
+// Conditions outside the image are kept but not evaluated
+int events_compile(event_registry_t *reg, const uint8_t *image, uint32_t size,
+                   const uint32_t *slave_base, uint32_t slave_count) {
+    if (!reg) return -1;
+    
+    events_reclaim(reg);
+    
+    uint32_t tracked = (size < CHANGEMAP_MAX_BYTES) ? size : CHANGEMAP_MAX_BYTES;
+    uint32_t lines = (tracked + CHANGEMAP_LINE_BYTES - 1) / CHANGEMAP_LINE_BYTES;
+    uint32_t offsets[EVENT_MAX_CONDITIONS];
+    uint32_t count = 0;
+    uint32_t entries = 0;
+    
+    for (uint32_t i = 0; i < reg->count; i++) {
+        const event_condition_t *cond = &reg->conditions[i];
+        uint32_t offset = cond->offset;
+        
+        offsets[i] = EVENT_UNLINKED;
+        if (!image) continue;
+        
+        if (cond->slave > 0) {
+            if (cond->slave > slave_count || !slave_base) continue;
+            offset += slave_base[cond->slave - 1];
+        }
+        
+        uint32_t end = offset + signals_type_size(cond->type);
+        if (end > tracked) continue;
+        
+        offsets[i] = offset;
+        entries += (end - 1) / CHANGEMAP_LINE_BYTES - offset / CHANGEMAP_LINE_BYTES + 1;
+        count++;
+    }
+    
+    event_table_t *table = alloc_table(count, lines, entries);
+    if (!table) {
+        LOG_ERROR("Failed to allocate event table (%u conditions)", count);
+        return -1;
+    }
+    
+    table->count = count;
+    table->lines = lines;
+    table->image = image;
+    table->image_size = size;
+    
+    uint32_t pos = 0;
+    for (uint32_t i = 0; i < reg->count; i++) {
+        const event_condition_t *cond = &reg->conditions[i];
+        uint32_t offset = offsets[i];
+        
+        if (offset == EVENT_UNLINKED) continue;
+        
+        table->id[pos] = cond->id;
+        table->src[pos] = image + offset;
+        table->type[pos] = (uint8_t)cond->type;
+        table->bit[pos] = cond->bit;
+        table->kind[pos] = (uint8_t)cond->kind;
+        table->threshold[pos] = cond->threshold;
+        
+        // The level a value has to return to before the condition fires again
+        switch (cond->kind) {
+            case EVENT_ABOVE:
+                table->rearm[pos] = cond->threshold - cond->hysteresis;
+                break;
+            case EVENT_BELOW:
+                table->rearm[pos] = cond->threshold + cond->hysteresis;
+                break;
+            default:
+                table->rearm[pos] = cond->hysteresis;
+                break;
+        }
+        
+        uint32_t first = offset / CHANGEMAP_LINE_BYTES;
+        uint32_t last = (offset + signals_type_size(cond->type) - 1) / CHANGEMAP_LINE_BYTES;
+        for (uint32_t line = first; line <= last; line++) {
+            table->line_start[line + 1]++;
+        }
+        pos++;
+    }
+    
+    // Prefix sums turn per-line counts into a CSR index
+    for (uint32_t line = 0; line < lines; line++) {
+        table->line_start[line + 1] += table->line_start[line];
+    }
+    
+    uint32_t fill[CHANGEMAP_MAX_LINES];
+    memcpy(fill, table->line_start, lines * sizeof(uint32_t));
+    
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t offset = (uint32_t)(table->src[i] - image);
+        uint32_t first = offset / CHANGEMAP_LINE_BYTES;
+        uint32_t last = (offset + signals_type_size((signal_type_t)table->type[i]) - 1) /
+                        CHANGEMAP_LINE_BYTES;
+        for (uint32_t line = first; line <= last; line++) {
+            table->line_cond[fill[line]++] = i;
+        }
+    }
+    
+    // A table the RT thread has not picked up yet is simply replaced
+    free_table(atomic_exchange_explicit(&reg->pending, table, memory_order_acq_rel));
+    
+    reg->dirty = false;
+    reg->compiled_image = image;
+    reg->compiled_size = size;
+    
+    if (count < reg->count) {
+        LOG_WARN("%u of %u event conditions lie outside the process image",
+                 reg->count - count, reg->count);
+    }
+    LOG_DEBUG("Compiled %u event conditions over %u lines", count, lines);
+    return 0;
+}
+
+void events_reclaim(event_registry_t *reg) {
+    if (!reg) return;
+    
+    free_table(atomic_exchange_explicit(&reg->retired, NULL, memory_order_acquire));
+}
+
+bool events_pop(event_registry_t *reg, event_record_t *record) {
+    uint64_t tail = atomic_load_explicit(&reg->tail, memory_order_relaxed);
+    uint64_t head = atomic_load_explicit(&reg->head, memory_order_acquire);
+    
+    if (tail == head) return false;
+    
+    *record = reg->queue[tail % EVENT_QUEUE_SIZE];
+    atomic_store_explicit(&reg->tail, tail + 1, memory_order_release);
+    return true;
+}
+
+static double read_field(const uint8_t *src, uint8_t type, uint8_t bit, uint32_t *raw) {
+    *raw = signals_read_raw(src, (signal_type_t)type, bit);
+    return signals_raw_value((signal_type_t)type, *raw);
+}
+
+// Prime a condition from the current value so registering never fires
+static void prime(event_table_t *table, uint32_t i) {
+    uint32_t raw;
+    double value = read_field(table->src[i], table->type[i], table->bit[i], &raw);
+    
+    table->last[i] = value;
+    switch (table->kind[i]) {
+        case EVENT_ABOVE:
+            table->armed[i] = value <= table->threshold[i];
+            break;
+        case EVENT_BELOW:
+            table->armed[i] = value >= table->threshold[i];
+            break;
+        case EVENT_EQUALS:
+            table->armed[i] = value != table->threshold[i];
+            break;
+        default:
+            table->armed[i] = 1;
+            break;
+    }
+}
+
+static void push_event(event_registry_t *reg, const event_table_t *table, uint32_t i,
+                       uint32_t raw, uint64_t cycle, uint64_t timestamp_ns) {
+    uint64_t head = atomic_load_explicit(&reg->head, memory_order_relaxed);
+    uint64_t tail = atomic_load_explicit(&reg->tail, memory_order_acquire);
+    
+    atomic_fetch_add_explicit(&reg->fired, 1, memory_order_relaxed);
+    
+    if (head - tail >= EVENT_QUEUE_SIZE) {
+        atomic_fetch_add_explicit(&reg->dropped, 1, memory_order_relaxed);
+        return;
+    }
+    
+    event_record_t *record = &reg->queue[head % EVENT_QUEUE_SIZE];
+    record->id = table->id[i];
+    record->type = table->type[i];
+    record->raw = raw;
+    record->cycle = cycle;
+    record->timestamp_ns = timestamp_ns;
+    atomic_store_explicit(&reg->head, head + 1, memory_order_release);
+}
+
+static void evaluate_one(event_registry_t *reg, event_table_t *table, uint32_t i,
+                         uint64_t cycle, uint64_t timestamp_ns) {
+    uint32_t raw;
+    double value = read_field(table->src[i], table->type[i], table->bit[i], &raw);
+    double last = table->last[i];
+    double threshold = table->threshold[i];
+    bool fire = false;
+    
+    switch (table->kind[i]) {
+        case EVENT_RISING:
+            fire = (last == 0.0 && value != 0.0);
+            break;
+        case EVENT_FALLING:
+            fire = (last != 0.0 && value == 0.0);
+            break;
+        case EVENT_CHANGE:
+            fire = (value != last);
+            break;
+        case EVENT_ABOVE:
+            if (table->armed[i] && value > threshold) {
+                fire = true;
+                table->armed[i] = 0;
+            } else if (!table->armed[i] && value <= table->rearm[i]) {
+                table->armed[i] = 1;
+            }
+            break;
+        case EVENT_BELOW:
+            if (table->armed[i] && value < threshold) {
+                fire = true;
+                table->armed[i] = 0;
+            } else if (!table->armed[i] && value >= table->rearm[i]) {
+                table->armed[i] = 1;
+            }
+            break;
+        case EVENT_EQUALS: {
+            double distance = (value > threshold) ? value - threshold : threshold - value;
+            if (table->armed[i] && value == threshold) {
+                fire = true;
+                table->armed[i] = 0;
+            } else if (!table->armed[i] && distance > table->rearm[i]) {
+                table->armed[i] = 1;
+            }
+            break;
+        }
+    }
+    
+    table->last[i] = value;
+    if (fire) {
+        push_event(reg, table, i, raw, cycle, timestamp_ns);
+    }
+}
+
+// Take over a newly compiled table. Conditions present in both tables keep
+// their state; both are sorted by id, so a single merge pass finds them
+static void swap_table(event_registry_t *reg, event_table_t *next) {
+    event_table_t *prev = reg->active;
+    uint32_t j = 0;
+    
+    for (uint32_t i = 0; i < next->count; i++) {
+        while (prev && j < prev->count && prev->id[j] < next->id[i]) j++;
+        
+        if (prev && prev->primed && j < prev->count && prev->id[j] == next->id[i]) {
+            next->last[i] = prev->last[j];
+            next->armed[i] = prev->armed[j];
+        } else {
+            prime(next, i);
+        }
+    }
+    
+    next->primed = true;
+    reg->active = next;
+    atomic_store_explicit(&reg->retired, prev, memory_order_release);
+}
+
+// Runs in the RT thread after the change map is updated. Only conditions on
+// lines that changed this cycle are looked at, so the cost follows the
+// amount of change rather than the number of conditions
+void events_evaluate(event_registry_t *reg, const uint8_t *image, uint32_t size,
+                     const changemap_t *changes, uint64_t cycle, uint64_t cycle_start_ns) {
+    if (!reg) return;
+    
+    if (atomic_load_explicit(&reg->pending, memory_order_relaxed) &&
+        !atomic_load_explicit(&reg->retired, memory_order_acquire)) {
+        event_table_t *next = atomic_exchange_explicit(&reg->pending, NULL, memory_order_acq_rel);
+        if (next && next->image == image && next->image_size == size) {
+            swap_table(reg, next);
+        } else {
+            // Compiled for an image that is already gone; the network thread
+            // notices the new layout and compiles again
+            atomic_store_explicit(&reg->retired, next, memory_order_release);
+        }
+    }
+    
+    event_table_t *table = reg->active;
+    if (!table || table->count == 0 || table->image != image || table->image_size != size ||
+        changes->image != image || changes->changed == 0) {
+        return;
+    }
+    
+    // Every event of a cycle carries the wall-clock start of that cycle, so
+    // the timestamp does not depend on how long earlier work in the cycle took
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    
+    for (uint32_t word = 0; word < (table->lines + 63) / 64; word++) {
+        uint64_t bits = changes->bitmap[word];
+        while (bits) {
+            uint32_t line = word * 64 + (uint32_t)__builtin_ctzll(bits);
+            bits &= bits - 1;
+            
+            if (line >= table->lines) break;
+            for (uint32_t k = table->line_start[line]; k < table->line_start[line + 1]; k++) {
+                evaluate_one(reg, table, table->line_cond[k], cycle, cycle_start_ns);
+            }
+        }
+    }
+    
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    uint32_t ns = (uint32_t)((t1.tv_sec - t0.tv_sec) * 1000000000LL + (t1.tv_nsec - t0.tv_nsec));
+    atomic_store_explicit(&reg->last_eval_ns, ns, memory_order_relaxed);
+    if (ns > atomic_load_explicit(&reg->max_eval_ns, memory_order_relaxed)) {
+        atomic_store_explicit(&reg->max_eval_ns, ns, memory_order_relaxed);
+    }
+}
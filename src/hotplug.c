@@ -0,0 +1,165 @@
+#include "hotplug.h"
+#include "service.h"
+#include "ethercat.h"
+#include "logging.h"
+#include <string.h>
+#include <unistd.h>
+#include <sched.h>
+#include <errno.h>
+
+void hotplug_init(hotplug_context_t *hp) {
+    if (!hp) return;
+    
+    memset(hp, 0, sizeof(hotplug_context_t));
+}
+
+// Seqlock over the slave table: writers are serialised by the mutex and
+// readers retry instead of blocking, so lookups never wait on a rescan.
+void ethercat_lock_slave_table(ethercat_context_t *ctx) {
+    pthread_mutex_lock(&ctx->slave_table_lock);
+    atomic_fetch_add_explicit(&ctx->slave_table_seq, 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+}
+
+void ethercat_unlock_slave_table(ethercat_context_t *ctx) {
+    atomic_fetch_add_explicit(&ctx->slave_table_seq, 1, memory_order_release);
+    pthread_mutex_unlock(&ctx->slave_table_lock);
+}
+
+bool ethercat_get_slave_info(ethercat_context_t *ctx, uint32_t index, slave_info_t *info) {
+    if (!ctx || !info) return false;
+    
+    uint32_t seq;
+    bool found;
+    
+    do {
+        seq = atomic_load_explicit(&ctx->slave_table_seq, memory_order_acquire);
+        if (seq & 1) {
+            sched_yield();
+            continue;
+        }
+        
+        found = index < ctx->slave_count && index < MAX_SLAVES;
+        if (found) {
+            memcpy(info, &ctx->slaves[index], sizeof(slave_info_t));
+        }
+        
+        atomic_thread_fence(memory_order_acquire);
+    } while ((seq & 1) || seq != atomic_load_explicit(&ctx->slave_table_seq, memory_order_relaxed));
+    
+    return found;
+}
+
+// Rescans the segment end: slaves that vanished are detached and dropped from
+// the slave count, new or returning ones are attached. Runs under the master
+// lock, so it never overlaps a start or stop. Returns the slave count found
+// and this scan's changes in `added` and `removed`
+int hotplug_scan(service_context_t *ctx, bool retry, uint32_t *added, uint32_t *removed) {
+    hotplug_context_t *hp = &ctx->hotplug;
+    ethercat_context_t *ec = &ctx->ec_ctx;
+    uint32_t scan_added = 0;
+    uint32_t scan_removed = 0;
+    
+    pthread_mutex_lock(&ec->master_lock);
+    
+    hp->scan_wkc = ec->last_wkc;
+    int found = ethercat_scan_slaves(ec);
+    if (found < 0 || !ec->network_active) {
+        hp->symbols_stale = false;
+        pthread_mutex_unlock(&ec->master_lock);
+        return found;
+    }
+    
+    hp->scans++;
+    hp->last_count = (uint32_t)found;
+    
+    uint32_t known = ec->slave_count;
+    
+    if ((uint32_t)found < known) {
+        ethercat_lock_slave_table(ec);
+        for (uint32_t i = (uint32_t)found; i < known && i < MAX_SLAVES; i++) {
+            ethercat_detach_slave(ec, i + 1);
+            ec->slaves[i].online = false;
+            ec->slaves[i].al_state = EC_STATE_NONE;
+            scan_removed++;
+            LOG_WARN("Slave %u removed from segment end", ec->slaves[i].slave_id);
+        }
+        ec->slave_count = (uint32_t)found;
+        ethercat_unlock_slave_table(ec);
+    } else if ((uint32_t)found > known && (retry || (uint32_t)found != hp->failed_count)) {
+        hp->failed_count = 0;
+        
+        for (uint32_t position = known + 1; position <= (uint32_t)found && position <= MAX_SLAVES; position++) {
+            slave_info_t info;
+            memset(&info, 0, sizeof(info));
+            
+            if (ethercat_attach_slave(ec, position, &info) < 0) {
+                hp->attach_failures++;
+                hp->failed_count = (uint32_t)found;
+                LOG_WARN("Failed to map new slave at position %u", position);
+                break;
+            }
+            
+            ethercat_lock_slave_table(ec);
+            memcpy(&ec->slaves[position - 1], &info, sizeof(slave_info_t));
+            ec->slave_count = position;
+            ethercat_unlock_slave_table(ec);
+            
+            scan_added++;
+            LOG_INFO("Slave %u (%s) attached: %u input bytes, %u output bytes",
+                     position, info.name, info.input_size, info.output_size);
+        }
+    }
+    
+    // Attached slaves get their symbols and a new layout hash. If the network
+    // thread has not taken the last rebuild yet, the next scan retries
+    if (scan_added > 0) hp->symbols_stale = true;
+    if (hp->symbols_stale && ethercat_refresh_symbols(ec) == 0) {
+        hp->symbols_stale = false;
+    }
+    
+    pthread_mutex_unlock(&ec->master_lock);
+    
+    hp->slaves_added += scan_added;
+    hp->slaves_removed += scan_removed;
+    if (added) *added = scan_added;
+    if (removed) *removed = scan_removed;
+    return found;
+}
+
+void* hotplug_thread_func(void *arg) {
+    service_context_t *ctx = (service_context_t*)arg;
+    
+    LOG_INFO("Hot-plug scanner starting");
+    
+    struct sched_param param;
+    memset(&param, 0, sizeof(param));
+    if (pthread_setschedparam(pthread_self(), SCHED_IDLE, &param) != 0) {
+        LOG_WARN("Failed to lower hot-plug scanner priority");
+    }
+    
+    uint32_t elapsed_ms = 0;
+    
+    while (ctx->threads_running && !ctx->shutdown_requested) {
+        usleep(HOTPLUG_POLL_MS * 1000);
+        elapsed_ms += HOTPLUG_POLL_MS;
+        
+        if (!ctx->ec_ctx.network_active) {
+            continue;
+        }
+        
+        // A working counter that is off and has changed since the last scan
+        // prompts an early rescan; one that stays off waits for the next
+        // periodic scan
+        int wkc = ctx->ec_ctx.last_wkc;
+        bool wkc_changed = wkc != ctx->ec_ctx.expected_wkc && wkc != ctx->hotplug.scan_wkc;
+        
+        if (wkc_changed || elapsed_ms >= HOTPLUG_SCAN_MS) {
+            elapsed_ms = 0;
+            hotplug_scan(ctx, false, NULL, NULL);
+        }
+    }
+    
+    LOG_INFO("Hot-plug scanner stopping");
+    return NULL;
+}
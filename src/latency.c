@@ -0,0 +1,314 @@
+#include "latency.h"
+#include "service.h"
+#include "logging.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <limits.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <sys/time.h>
+
+typedef struct {
+    const config_t *config;
+    const latency_test_options_t *opts;
+    latency_result_t result;
+    volatile bool running;
+} latency_test_t;
+
+static int64_t timespec_diff_ns(const struct timespec *a, const struct timespec *b) {
+    return (int64_t)(a->tv_sec - b->tv_sec) * 1000000000LL + (a->tv_nsec - b->tv_nsec);
+}
+
+// Same thread setup and wait path as rt_thread_func; only the cycle body differs
+static void* measure_thread_func(void *arg) {
+    latency_test_t *test = (latency_test_t*)arg;
+    const config_t *config = test->config;
+    latency_result_t *result = &test->result;
+    
+    if (config->performance.rt_priority > 0) {
+        set_thread_priority(config->performance.rt_priority);
+    }
+    
+    if (config->performance.cpu_count > 0) {
+        set_thread_affinity(config->performance.cpu_affinity, config->performance.cpu_count);
+    }
+    
+    uint64_t cycle_ns = config->network.cycle_time_us * 1000ULL;
+    uint64_t cycles = (uint64_t)test->opts->duration_s * 1000000ULL / config->network.cycle_time_us;
+    
+    struct timespec next_cycle, now;
+    clock_gettime(CLOCK_MONOTONIC, &next_cycle);
+    
+    result->min_us = UINT32_MAX;
+    
+    for (uint64_t i = 0; i < cycles && test->running; i++) {
+        rt_advance_deadline(&next_cycle, cycle_ns);
+        rt_wait_until(&next_cycle);
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        
+        int64_t late_ns = timespec_diff_ns(&now, &next_cycle);
+        uint32_t late_us = late_ns > 0 ? (uint32_t)(late_ns / 1000) : 0;
+        
+        result->hist[late_us < LATENCY_HIST_BUCKETS ? late_us : LATENCY_HIST_BUCKETS]++;
+        result->samples++;
+        result->total_us += late_us;
+        if (late_us < result->min_us) result->min_us = late_us;
+        if (late_us > result->max_us) result->max_us = late_us;
+        if (late_us > test->opts->budget_us) result->over_budget++;
+        
+        // Woke up after the following deadline: that cycle is lost entirely
+        if ((uint64_t)late_ns >= cycle_ns && late_ns > 0) {
+            result->overruns++;
+            clock_gettime(CLOCK_MONOTONIC, &next_cycle);
+        }
+    }
+    
+    test->running = false;
+    return NULL;
+}
+
+// Answers load commands the way the network thread would when no daemon
+// owns the command port, so the test still exercises a full request/reply
+static void answer_command(int fd, const config_t *config) {
+    udp_command_t cmd;
+    udp_response_t resp;
+    struct sockaddr_in client_addr;
+    socklen_t client_len = sizeof(client_addr);
+    
+    ssize_t received = recvfrom(fd, &cmd, sizeof(cmd), MSG_DONTWAIT,
+                                (struct sockaddr*)&client_addr, &client_len);
+    if (received < (ssize_t)sizeof(cmd)) return;
+    
+    if (!protocol_validate_command(&cmd)) {
+        protocol_create_response(&resp, STATUS_ERROR, ERR_INVALID_COMMAND, NULL, 0);
+    } else {
+        network_status_t status = { 0, false, config->network.cycle_time_us, 0 };
+        uint8_t payload[17];
+        memset(payload, 0, sizeof(payload));
+        protocol_pack_network_status(&status, payload);
+        protocol_create_response(&resp, STATUS_SUCCESS, ERR_NONE, payload, 17);
+    }
+    sendto(fd, &resp, sizeof(resp), 0, (struct sockaddr*)&client_addr, client_len);
+}
+
+// NET_STATUS requests sent to the configured command port. A daemon already
+// running there answers them; otherwise the port is bound here and answered
+// in-process, so the same socket path is loaded either way. NET_STATUS only
+// reads, so a live daemon is not disturbed
+static void* network_load_func(void *arg) {
+    latency_test_t *test = (latency_test_t*)arg;
+    const config_t *config = test->config;
+    
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(config->security.port);
+    if (inet_pton(AF_INET, config->security.bind_address, &addr.sin_addr) <= 0) {
+        LOG_WARN("Network load disabled: invalid bind address %s", config->security.bind_address);
+        return NULL;
+    }
+    
+    int server = socket(AF_INET, SOCK_DGRAM, 0);
+    if (server >= 0 && bind(server, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+        if (errno != EADDRINUSE) {
+            LOG_WARN("Network load: cannot bind %s:%d: %s", config->security.bind_address,
+                     config->security.port, strerror(errno));
+        }
+        close(server);
+        server = -1;
+    }
+    
+    if (addr.sin_addr.s_addr == htonl(INADDR_ANY)) {
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    }
+    
+    int client = socket(AF_INET, SOCK_DGRAM, 0);
+    if (client < 0) {
+        LOG_WARN("Network load disabled: %s", strerror(errno));
+        if (server >= 0) close(server);
+        return NULL;
+    }
+    
+    struct timeval timeout = { 0, 100000 };
+    setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    
+    LOG_INFO("Network load: NET_STATUS to port %d (%s)", config->security.port,
+             server >= 0 ? "answered in-process" : "running daemon");
+    
+    udp_command_t cmd;
+    udp_response_t resp;
+    memset(&cmd, 0, sizeof(cmd));
+    cmd.magic = htonl(PROTOCOL_MAGIC_CMD);
+    cmd.command_type = CMD_CATEGORY_NETWORK;
+    cmd.command_id = NET_STATUS;
+    
+    while (test->running) {
+        sendto(client, &cmd, sizeof(cmd), 0, (struct sockaddr*)&addr, sizeof(addr));
+        if (server >= 0) answer_command(server, config);
+        recv(client, &resp, sizeof(resp), 0);
+        usleep(LATENCY_LOAD_PERIOD_US);
+    }
+    
+    close(client);
+    if (server >= 0) close(server);
+    return NULL;
+}
+
+// Formatted log output at the rate a busy daemon would produce it. It goes to
+// an unlinked scratch file beside the configured log, so the disk and
+// filesystem are the same but the production log is left alone
+static FILE* open_scratch_log(const char *log_file) {
+    char path[PATH_MAX];
+    const char *slash = strrchr(log_file, '/');
+    
+    if (slash) {
+        snprintf(path, sizeof(path), "%.*s/.etherforge-latency-XXXXXX",
+                 (int)(slash - log_file), log_file);
+    } else {
+        snprintf(path, sizeof(path), ".etherforge-latency-XXXXXX");
+    }
+    
+    int fd = mkstemp(path);
+    if (fd < 0) {
+        snprintf(path, sizeof(path), "/tmp/.etherforge-latency-XXXXXX");
+        fd = mkstemp(path);
+    }
+    if (fd < 0) return fopen("/dev/null", "w");
+    
+    unlink(path);
+    FILE *file = fdopen(fd, "w");
+    if (!file) close(fd);
+    return file;
+}
+
+static void* logging_load_func(void *arg) {
+    latency_test_t *test = (latency_test_t*)arg;
+    
+    FILE *file = open_scratch_log(test->config->logging.file);
+    if (!file) return NULL;
+    
+    uint32_t n = 0;
+    while (test->running) {
+        fprintf(file, "latency-test load line %u: cycle=%u us slaves=%u\n",
+                n, test->config->network.cycle_time_us, n % 64);
+        n++;
+        fflush(file);
+        usleep(LATENCY_LOAD_PERIOD_US * 10);
+    }
+    
+    fclose(file);
+    return NULL;
+}
+
+uint32_t latency_percentile(const latency_result_t *result, uint32_t per_100k) {
+    if (!result || result->samples == 0) return 0;
+    
+    uint64_t target = (result->samples * per_100k + 99999) / 100000;
+    uint64_t seen = 0;
+    
+    for (uint32_t i = 0; i <= LATENCY_HIST_BUCKETS; i++) {
+        seen += result->hist[i];
+        if (seen >= target) {
+            return (i < LATENCY_HIST_BUCKETS) ? i : result->max_us;
+        }
+    }
+    
+    return result->max_us;
+}
+
+static void print_report(const config_t *config, const latency_test_options_t *opts,
+                         const latency_result_t *result) {
+    printf("\nWakeup latency (cycle %u us, priority %d, %d CPU(s), load %s)\n",
+           config->network.cycle_time_us, config->performance.rt_priority,
+           config->performance.cpu_count, opts->load ? "on" : "off");
+    printf("  Samples:      %llu\n", (unsigned long long)result->samples);
+    
+    if (result->samples == 0) return;
+    
+    printf("  Min/Avg/Max:  %u / %llu / %u us\n", result->min_us,
+           (unsigned long long)(result->total_us / result->samples), result->max_us);
+    printf("  p50/p99/p99.9: %u / %u / %u us\n", latency_percentile(result, 50000),
+           latency_percentile(result, 99000), latency_percentile(result, 99900));
+    printf("  Over budget:  %u (budget %u us)\n", result->over_budget, opts->budget_us);
+    printf("  Overruns:     %u\n", result->overruns);
+    
+    printf("\n  Histogram (us):\n");
+    for (uint32_t lo = 0; lo <= LATENCY_HIST_BUCKETS; lo = lo ? lo * 2 : 1) {
+        uint32_t hi = lo ? lo * 2 - 1 : 0;
+        uint64_t count = 0;
+        
+        for (uint32_t i = lo; i <= hi && i <= LATENCY_HIST_BUCKETS; i++) {
+            count += result->hist[i];
+        }
+        
+        if (count > 0) {
+            if (hi >= LATENCY_HIST_BUCKETS) {
+                printf("  %6u+       %10llu\n", lo, (unsigned long long)count);
+            } else {
+                printf("  %6u-%-6u %10llu\n", lo, hi, (unsigned long long)count);
+            }
+        }
+    }
+}
+
+int latency_test_run(const config_t *config, const latency_test_options_t *opts) {
+    if (!config || !opts || config->network.cycle_time_us == 0 || opts->duration_s == 0) return -1;
+    
+    static latency_test_t test;
+    memset(&test, 0, sizeof(test));
+    test.config = config;
+    test.opts = opts;
+    test.running = true;
+    
+    LOG_INFO("Latency test: %u s at %u us cycle, budget %u us%s", opts->duration_s,
+             config->network.cycle_time_us, opts->budget_us, opts->load ? ", with load" : "");
+    
+    pthread_t measure_thread, network_load, logging_load;
+    bool load_started = false;
+    
+    if (opts->load) {
+        if (pthread_create(&network_load, NULL, network_load_func, &test) == 0) {
+            if (pthread_create(&logging_load, NULL, logging_load_func, &test) == 0) {
+                load_started = true;
+            } else {
+                test.running = false;
+                pthread_join(network_load, NULL);
+                test.running = true;
+            }
+        }
+        if (!load_started) {
+            LOG_WARN("Failed to start load threads, measuring without load");
+        }
+    }
+    
+    if (pthread_create(&measure_thread, NULL, measure_thread_func, &test) != 0) {
+        LOG_ERROR("Failed to create latency test thread");
+        test.running = false;
+        if (load_started) {
+            pthread_join(network_load, NULL);
+            pthread_join(logging_load, NULL);
+        }
+        return -1;
+    }
+    
+    pthread_join(measure_thread, NULL);
+    test.running = false;
+    
+    if (load_started) {
+        pthread_join(network_load, NULL);
+        pthread_join(logging_load, NULL);
+    }
+    
+    print_report(config, opts, &test.result);
+    
+    bool pass = test.result.samples > 0 && test.result.max_us <= opts->budget_us;
+    printf("\nVerdict: %s (max %u us, budget %u us)\n", pass ? "PASS" : "FAIL",
+           test.result.max_us, opts->budget_us);
+    
+    return pass ? 0 : 1;
+}
@@ -59,6 +59,12 @@ void logging_cleanup(void) {
     pthread_mutex_unlock(&log_mutex);
 }
 
+void logging_set_level(const char *level_str) {
+    pthread_mutex_lock(&log_mutex);
+    current_level = parse_log_level(level_str);
+    pthread_mutex_unlock(&log_mutex);
+}
+
 void log_message(log_level_t level, const char *file, int line, const char *fmt, ...) {
     if (level > current_level) return;
     
@@ -0,0 +1,368 @@
+#include "mailbox.h"
+#include "service.h"
+#include "ethercat.h"
+#include "logging.h"
+#include <string.h>
+#include <errno.h>
+
+int mailbox_init(mailbox_context_t *mbx) {
+    if (!mbx) return -1;
+
+    memset(mbx->requests, 0, sizeof(mbx->requests));
+
+    for (int i = 0; i <= MAILBOX_MAX_SLAVES; i++) {
+        mbx->queue_head[i] = MAILBOX_QUEUE_END;
+        mbx->queue_tail[i] = MAILBOX_QUEUE_END;
+    }
+
+    mbx->rr_slave = 0;
+    mbx->pending = 0;
+    mbx->next_request_id = 1;
+    mbx->completed = 0;
+    mbx->failed = 0;
+
+    if (pthread_mutex_init(&mbx->lock, NULL) != 0) {
+        LOG_ERROR("Failed to initialize mailbox mutex");
+        return -1;
+    }
+
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+
+    if (pthread_cond_init(&mbx->cond, &attr) != 0) {
+        LOG_ERROR("Failed to initialize mailbox condition");
+        pthread_condattr_destroy(&attr);
+        pthread_mutex_destroy(&mbx->lock);
+        return -1;
+    }
+
+    pthread_condattr_destroy(&attr);
+    return 0;
+}
+
+void mailbox_cleanup(mailbox_context_t *mbx) {
+    if (!mbx) return;
+
+    pthread_cond_destroy(&mbx->cond);
+    pthread_mutex_destroy(&mbx->lock);
+}
+
+void mailbox_wake(mailbox_context_t *mbx) {
+    if (!mbx) return;
+
+    pthread_mutex_lock(&mbx->lock);
+    pthread_cond_broadcast(&mbx->cond);
+    pthread_mutex_unlock(&mbx->lock);
+}
+
+static mailbox_request_t* find_request(mailbox_context_t *mbx, uint32_t request_id) {
+    for (int i = 0; i < MAILBOX_MAX_REQUESTS; i++) {
+        if (mbx->requests[i].state != MBX_REQ_FREE &&
+            mbx->requests[i].request_id == request_id) {
+            return &mbx->requests[i];
+        }
+    }
+    return NULL;
+}
+
+// Prefer a free slot, otherwise recycle the oldest result that was fetched or
+// has outlived its retention, or an abandoned download. Results nobody has
+// read yet are kept, so a full table refuses new requests instead
+static mailbox_request_t* alloc_request(mailbox_context_t *mbx) {
+    mailbox_request_t *oldest = NULL;
+    const struct timespec *oldest_since = NULL;
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    for (int i = 0; i < MAILBOX_MAX_REQUESTS; i++) {
+        mailbox_request_t *req = &mbx->requests[i];
+
+        if (req->state == MBX_REQ_FREE) {
+            return req;
+        }
+
+        const struct timespec *since;
+        if (req->state == MBX_REQ_FILLING) {
+            if (now.tv_sec - req->submitted.tv_sec <= MAILBOX_FILL_TIMEOUT_S) continue;
+            since = &req->submitted;
+        } else if (req->state == MBX_REQ_DONE || req->state == MBX_REQ_FAILED) {
+            if (!req->fetched &&
+                now.tv_sec - req->finished.tv_sec <= MAILBOX_RESULT_RETENTION_S) continue;
+            since = &req->finished;
+        } else {
+            continue;
+        }
+
+        if (!oldest || since->tv_sec < oldest_since->tv_sec ||
+            (since->tv_sec == oldest_since->tv_sec && since->tv_nsec < oldest_since->tv_nsec)) {
+            oldest = req;
+            oldest_since = since;
+        }
+    }
+
+    return oldest;
+}
+
+static void init_request(mailbox_context_t *mbx, mailbox_request_t *req, uint16_t slave,
+                         uint16_t index, uint8_t subindex, bool complete_access) {
+    req->request_id = mbx->next_request_id++;
+    if (mbx->next_request_id == 0) {
+        mbx->next_request_id = 1;
+    }
+
+    req->slave = slave;
+    req->index = index;
+    req->subindex = subindex;
+    req->complete_access = complete_access;
+    req->abort_code = 0;
+    req->size = 0;
+    req->filled = 0;
+    req->next = MAILBOX_QUEUE_END;
+    req->fetched = false;
+    clock_gettime(CLOCK_MONOTONIC, &req->submitted);
+}
+
+static void enqueue_request(mailbox_context_t *mbx, mailbox_request_t *req) {
+    int slot = (int)(req - mbx->requests);
+
+    req->state = MBX_REQ_QUEUED;
+    req->next = MAILBOX_QUEUE_END;
+
+    if (mbx->queue_tail[req->slave] == MAILBOX_QUEUE_END) {
+        mbx->queue_head[req->slave] = slot;
+    } else {
+        mbx->requests[mbx->queue_tail[req->slave]].next = slot;
+    }
+    mbx->queue_tail[req->slave] = slot;
+
+    mbx->pending++;
+    pthread_cond_signal(&mbx->cond);
+}
+
+int mailbox_submit_read(mailbox_context_t *mbx, uint16_t slave, uint16_t index, uint8_t subindex,
+                        bool complete_access, uint32_t max_size, uint32_t *request_id) {
+    if (!mbx || !request_id || slave == 0 || slave > MAILBOX_MAX_SLAVES) return -1;
+
+    pthread_mutex_lock(&mbx->lock);
+
+    mailbox_request_t *req = alloc_request(mbx);
+    if (!req) {
+        pthread_mutex_unlock(&mbx->lock);
+        return -1;
+    }
+
+    init_request(mbx, req, slave, index, subindex, complete_access);
+    req->write = false;
+    req->size = (max_size == 0 || max_size > MAILBOX_MAX_DATA) ? MAILBOX_MAX_DATA : max_size;
+    enqueue_request(mbx, req);
+
+    *request_id = req->request_id;
+
+    pthread_mutex_unlock(&mbx->lock);
+    return 0;
+}
+
+int mailbox_submit_write(mailbox_context_t *mbx, uint16_t slave, uint16_t index, uint8_t subindex,
+                         bool complete_access, uint32_t total_size,
+                         const void *data, uint32_t len, uint32_t *request_id) {
+    if (!mbx || !request_id || slave == 0 || slave > MAILBOX_MAX_SLAVES) return -1;
+
+    if (total_size == 0 || total_size > MAILBOX_MAX_DATA || len > total_size) return -1;
+
+    pthread_mutex_lock(&mbx->lock);
+
+    mailbox_request_t *req = alloc_request(mbx);
+    if (!req) {
+        pthread_mutex_unlock(&mbx->lock);
+        return -1;
+    }
+
+    init_request(mbx, req, slave, index, subindex, complete_access);
+    req->write = true;
+    req->size = total_size;
+
+    if (data && len > 0) {
+        memcpy(req->data, data, len);
+        req->filled = len;
+    }
+
+    if (req->filled == req->size) {
+        enqueue_request(mbx, req);
+    } else {
+        req->state = MBX_REQ_FILLING;
+    }
+
+    *request_id = req->request_id;
+
+    pthread_mutex_unlock(&mbx->lock);
+    return 0;
+}
+
+int mailbox_append_data(mailbox_context_t *mbx, uint32_t request_id, uint32_t offset,
+                        const void *data, uint32_t len, uint32_t *filled) {
+    if (!mbx || !data || !filled) return -1;
+
+    pthread_mutex_lock(&mbx->lock);
+
+    mailbox_request_t *req = find_request(mbx, request_id);
+    if (!req || req->state != MBX_REQ_FILLING || offset != req->filled ||
+        offset + len > req->size) {
+        pthread_mutex_unlock(&mbx->lock);
+        return -1;
+    }
+
+    memcpy(req->data + offset, data, len);
+    req->filled += len;
+    *filled = req->filled;
+
+    if (req->filled == req->size) {
+        enqueue_request(mbx, req);
+    }
+
+    pthread_mutex_unlock(&mbx->lock);
+    return 0;
+}
+
+int mailbox_get_result(mailbox_context_t *mbx, uint32_t request_id, uint32_t offset,
+                       mailbox_result_t *result, void *data, uint32_t max_len, uint32_t *len) {
+    if (!mbx || !result || !len) return -1;
+
+    pthread_mutex_lock(&mbx->lock);
+
+    mailbox_request_t *req = find_request(mbx, request_id);
+    if (!req) {
+        // Ids are handed out in sequence, so one behind the next id that is
+        // no longer in the table had its result recycled
+        uint32_t age = mbx->next_request_id - 1 - request_id;
+        bool issued = request_id != 0 && age < MAILBOX_ID_WINDOW;
+        pthread_mutex_unlock(&mbx->lock);
+        return issued ? -2 : -1;
+    }
+
+    result->state = (uint8_t)req->state;
+    result->abort_code = req->abort_code;
+    result->size = req->size;
+    *len = 0;
+
+    if (req->state == MBX_REQ_DONE && !req->write && data && offset < req->size) {
+        uint32_t remaining = req->size - offset;
+        *len = (remaining > max_len) ? max_len : remaining;
+        memcpy(data, req->data + offset, *len);
+    }
+
+    // A result counts as fetched once its last byte has been read, after
+    // which its slot may be reused before the retention time is up
+    if (req->state == MBX_REQ_FAILED || (req->state == MBX_REQ_DONE &&
+        (req->write || offset + *len >= req->size))) {
+        req->fetched = true;
+    }
+
+    pthread_mutex_unlock(&mbx->lock);
+    return 0;
+}
+
+// Round-robin over slaves so a slow mailbox cannot starve the others
+mailbox_request_t* mailbox_next_request(mailbox_context_t *mbx, uint32_t timeout_ms) {
+    if (!mbx) return NULL;
+
+    pthread_mutex_lock(&mbx->lock);
+
+    if (mbx->pending == 0) {
+        struct timespec deadline;
+        clock_gettime(CLOCK_MONOTONIC, &deadline);
+        deadline.tv_sec += timeout_ms / 1000;
+        deadline.tv_nsec += (timeout_ms % 1000) * 1000000L;
+        if (deadline.tv_nsec >= 1000000000) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000;
+        }
+
+        while (mbx->pending == 0) {
+            if (pthread_cond_timedwait(&mbx->cond, &mbx->lock, &deadline) == ETIMEDOUT) {
+                break;
+            }
+        }
+    }
+
+    mailbox_request_t *req = NULL;
+
+    for (uint32_t n = 0; mbx->pending > 0 && n < MAILBOX_MAX_SLAVES; n++) {
+        uint32_t slave = (mbx->rr_slave + n) % MAILBOX_MAX_SLAVES + 1;
+        int slot = mbx->queue_head[slave];
+
+        if (slot != MAILBOX_QUEUE_END) {
+            req = &mbx->requests[slot];
+            mbx->queue_head[slave] = req->next;
+            if (mbx->queue_head[slave] == MAILBOX_QUEUE_END) {
+                mbx->queue_tail[slave] = MAILBOX_QUEUE_END;
+            }
+
+            req->next = MAILBOX_QUEUE_END;
+            req->state = MBX_REQ_ACTIVE;
+            mbx->pending--;
+            mbx->rr_slave = slave % MAILBOX_MAX_SLAVES;
+            break;
+        }
+    }
+
+    pthread_mutex_unlock(&mbx->lock);
+    return req;
+}
+
+void mailbox_complete_request(mailbox_context_t *mbx, mailbox_request_t *req,
+                              bool success, uint32_t size, uint32_t abort_code) {
+    if (!mbx || !req) return;
+
+    pthread_mutex_lock(&mbx->lock);
+
+    req->state = success ? MBX_REQ_DONE : MBX_REQ_FAILED;
+    req->abort_code = abort_code;
+    clock_gettime(CLOCK_MONOTONIC, &req->finished);
+    if (success) {
+        req->size = size;
+        mbx->completed++;
+    } else {
+        mbx->failed++;
+    }
+
+    pthread_mutex_unlock(&mbx->lock);
+}
+
+void* mailbox_thread_func(void *arg) {
+    service_context_t *ctx = (service_context_t*)arg;
+
+    LOG_INFO("Mailbox thread starting");
+
+    while (ctx->threads_running && !ctx->shutdown_requested) {
+        mailbox_request_t *req = mailbox_next_request(&ctx->mailbox, 100);
+        if (!req) continue;
+
+        uint32_t size = req->size;
+        uint32_t abort_code = 0;
+        int result;
+
+        pthread_mutex_lock(&ctx->ec_ctx.master_lock);
+        if (!ctx->ec_ctx.network_active) {
+            result = -1;
+        } else if (req->write) {
+            result = ethercat_sdo_write(&ctx->ec_ctx, req->slave, req->index, req->subindex,
+                                        req->complete_access, req->data, size, &abort_code);
+        } else {
+            result = ethercat_sdo_read(&ctx->ec_ctx, req->slave, req->index, req->subindex,
+                                       req->complete_access, req->data, &size, &abort_code);
+        }
+        pthread_mutex_unlock(&ctx->ec_ctx.master_lock);
+
+        if (result != 0) {
+            LOG_DEBUG("SDO %s slave=%u 0x%04X:%02X failed (abort 0x%08X)",
+                      req->write ? "write" : "read", req->slave, req->index,
+                      req->subindex, abort_code);
+        }
+
+        mailbox_complete_request(&ctx->mailbox, req, result == 0, size, abort_code);
+    }
+
+    LOG_INFO("Mailbox thread stopping");
+    return NULL;
+}
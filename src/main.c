@@ -12,6 +12,7 @@
 #include "service.h"
 #include "logging.h"
 #include "config.h"
+#include "latency.h"
 
 static service_context_t g_service_ctx;
 static volatile sig_atomic_t g_shutdown = 0;
@@ -25,7 +26,8 @@ static void signal_handler(int signum) {
             g_service_ctx.shutdown_requested = true;
             break;
         case SIGHUP:
-            LOG_INFO("Received SIGHUP, ignoring");
+            LOG_INFO("Received SIGHUP, reloading configuration");
+            g_service_ctx.reload_requested = true;
             break;
         default:
             LOG_WARN("Received unexpected signal %d", signum);
@@ -54,12 +56,16 @@ static void print_usage(const char *program_name) {
     printf("  -i, --interface IF   Network interface name (overrides config)\n");
     printf("  -p, --port PORT      UDP port number (overrides config)\n");
     printf("  -v, --verbose        Enable verbose logging\n");
+    printf("  --latency-test SEC   Measure RT wakeup latency for SEC seconds and exit\n");
+    printf("  --latency-budget US  Maximum wakeup latency for a PASS verdict (default: cycle/4)\n");
+    printf("  --latency-load       Run synthetic network and logging load during the test\n");
     printf("  -h, --help           Show this help message\n");
     printf("  --version            Show version information\n");
     printf("\nExamples:\n");
     printf("  %s --interface eth1                    # Use eth1 interface\n", program_name);
     printf("  %s --config /opt/etherforge.yaml     # Use custom config file\n", program_name);
     printf("  %s --verbose --interface eth1         # Verbose logging\n", program_name);
+    printf("  %s --latency-test 60 --latency-load   # Commissioning latency check\n", program_name);
     printf("  nohup %s -i eth1 &                    # Run in background\n", program_name);
     printf("\nFor more information, visit: https://github.com/etherforge/etherforge\n");
 }
@@ -106,6 +112,7 @@ int main(int argc, char *argv[]) {
     const char *interface_override = NULL;
     int port_override = -1;
     bool verbose = false;
+    latency_test_options_t latency = { 0, 0, false };
     
     static struct option long_options[] = {
         {"config",    required_argument, 0, 'c'},
@@ -114,6 +121,9 @@ int main(int argc, char *argv[]) {
         {"verbose",   no_argument,       0, 'v'},
         {"help",      no_argument,       0, 'h'},
         {"version",   no_argument,       0, 'V'},
+        {"latency-test",   required_argument, 0, 'L'},
+        {"latency-budget", required_argument, 0, 'B'},
+        {"latency-load",   no_argument,       0, 'l'},
         {0, 0, 0, 0}
     };
     
@@ -142,6 +152,19 @@ int main(int argc, char *argv[]) {
             case 'V':
                 print_version();
                 return EXIT_SUCCESS;
+            case 'L':
+                latency.duration_s = (uint32_t)atoi(optarg);
+                if (latency.duration_s == 0) {
+                    fprintf(stderr, "Invalid latency test duration: %s\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'B':
+                latency.budget_us = (uint32_t)atoi(optarg);
+                break;
+            case 'l':
+                latency.load = true;
+                break;
             default:
                 print_usage(argv[0]);
                 return EXIT_FAILURE;
@@ -153,6 +176,22 @@ int main(int argc, char *argv[]) {
         return EXIT_FAILURE;
     }
     
+    if (latency.duration_s > 0) {
+        config_t config;
+        if (config_load(&config, config_file) < 0) {
+            LOG_ERROR("Failed to load configuration");
+            return EXIT_FAILURE;
+        }
+        
+        if (latency.budget_us == 0) {
+            latency.budget_us = config.network.cycle_time_us / 4;
+        }
+        
+        int result = latency_test_run(&config, &latency);
+        logging_cleanup();
+        return (result == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    
     LOG_INFO("EtherForge starting");
     print_version();
     
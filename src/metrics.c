@@ -0,0 +1,363 @@
+#include "metrics.h"
+#include "service.h"
+#include "logging.h"
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/time.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#define METRICS_ACCEPT_POLL_MS  200
+
+static const char *category_names[METRICS_CATEGORIES] = {
+    "0", "network", "pdo", "diagnostic", "mailbox", "signal", "event", "scope",
+    "symbol"
+};
+
+int metrics_init(metrics_context_t *mc, const char *shm_name) {
+    if (!mc) return -1;
+    
+    memset(mc, 0, sizeof(metrics_context_t));
+    mc->listen_fd = -1;
+    
+    if (shm_name && shm_name[0]) {
+        int fd = shm_open(shm_name, O_CREAT | O_RDWR, 0644);
+        if (fd >= 0) {
+            if (ftruncate(fd, sizeof(metrics_t)) == 0) {
+                void *page = mmap(NULL, sizeof(metrics_t), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+                if (page != MAP_FAILED) {
+                    mc->page = page;
+                    mc->shared = true;
+                    snprintf(mc->shm_name, sizeof(mc->shm_name), "%s", shm_name);
+                }
+            }
+            close(fd);
+        }
+        
+        if (!mc->shared) {
+            LOG_WARN("Shared-memory stats page %s unavailable: %s", shm_name, strerror(errno));
+        }
+    }
+    
+    if (!mc->page) {
+        mc->page = malloc(sizeof(metrics_t));
+        if (!mc->page) {
+            LOG_ERROR("Failed to allocate metrics");
+            return -1;
+        }
+    }
+    
+    memset(mc->page, 0, sizeof(metrics_t));
+    mc->page->size = sizeof(metrics_t);
+    mc->page->version = METRICS_VERSION;
+    mc->page->pid = (uint32_t)getpid();
+    atomic_thread_fence(memory_order_release);
+    mc->page->magic = METRICS_MAGIC;
+    
+    if (mc->shared) {
+        LOG_INFO("Stats page published at /dev/shm%s (%zu bytes)", mc->shm_name, sizeof(metrics_t));
+    }
+    return 0;
+}
+
+void metrics_cleanup(metrics_context_t *mc) {
+    if (!mc) return;
+    
+    if (mc->listen_fd >= 0) {
+        close(mc->listen_fd);
+        mc->listen_fd = -1;
+    }
+    
+    if (mc->shared) {
+        munmap(mc->page, sizeof(metrics_t));
+        shm_unlink(mc->shm_name);
+    } else {
+        free(mc->page);
+    }
+    
+    mc->page = NULL;
+    mc->shared = false;
+}
+
+int metrics_listen(metrics_context_t *mc, const char *bind_address, uint16_t port) {
+    if (!mc || port == 0) return 0;
+    
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
+        LOG_ERROR("Failed to create metrics socket: %s", strerror(errno));
+        return -1;
+    }
+    
+    int reuse = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    
+    if (inet_pton(AF_INET, bind_address, &addr.sin_addr) <= 0) {
+        LOG_ERROR("Invalid metrics bind address: %s", bind_address);
+        close(fd);
+        return -1;
+    }
+    
+    if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0 || listen(fd, 4) < 0) {
+        LOG_ERROR("Failed to listen for metrics on %s:%u: %s", bind_address, port, strerror(errno));
+        close(fd);
+        return -1;
+    }
+    
+    mc->listen_fd = fd;
+    LOG_INFO("Prometheus metrics on http://%s:%u/metrics", bind_address, port);
+    return 0;
+}
+
+void metrics_hist_record(metrics_hist_t *hist, uint64_t value_ns) {
+    uint64_t q = value_ns ? (value_ns - 1) / METRICS_HIST_BASE_NS : 0;
+    uint32_t bucket = q ? (uint32_t)(64 - __builtin_clzll(q)) : 0;
+    if (bucket > METRICS_HIST_BUCKETS) bucket = METRICS_HIST_BUCKETS;
+    
+    atomic_fetch_add_explicit(&hist->buckets[bucket], 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&hist->count, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&hist->sum_ns, value_ns, memory_order_relaxed);
+}
+
+void metrics_record_command(metrics_t *m, uint8_t category, uint8_t command, uint64_t latency_ns,
+                            bool error) {
+    if (!m) return;
+    
+    metrics_hist_record(&m->commands[category % METRICS_CATEGORIES][command % METRICS_COMMANDS],
+                        latency_ns);
+    if (error) {
+        atomic_fetch_add_explicit(&m->command_errors, 1, memory_order_relaxed);
+    }
+}
+
+void metrics_set_client(metrics_t *m, uint32_t slot, uint32_t addr, uint16_t port) {
+    if (!m || slot >= METRICS_CLIENTS) return;
+    
+    atomic_store_explicit(&m->client_packets[slot], 0, memory_order_relaxed);
+    atomic_store_explicit(&m->client_addr[slot], addr, memory_order_relaxed);
+    atomic_store_explicit(&m->client_port[slot], port, memory_order_relaxed);
+}
+
+typedef struct {
+    char *buf;
+    size_t len;
+    size_t pos;
+} text_buffer_t;
+
+static void append(text_buffer_t *tb, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+
+static void append(text_buffer_t *tb, const char *fmt, ...) {
+    if (tb->pos >= tb->len) return;
+    
+    va_list args;
+    va_start(args, fmt);
+    int n = vsnprintf(tb->buf + tb->pos, tb->len - tb->pos, fmt, args);
+    va_end(args);
+    
+    if (n > 0) {
+        tb->pos += (size_t)n;
+        if (tb->pos > tb->len) tb->pos = tb->len;
+    }
+}
+
+static void append_counter(text_buffer_t *tb, const char *name, const char *help, uint64_t value) {
+    append(tb, "# HELP %s %s\n# TYPE %s counter\n%s %llu\n", name, help, name, name,
+           (unsigned long long)value);
+}
+
+static void append_gauge(text_buffer_t *tb, const char *name, const char *help, uint32_t value) {
+    append(tb, "# HELP %s %s\n# TYPE %s gauge\n%s %u\n", name, help, name, name, value);
+}
+
+static void append_hist(text_buffer_t *tb, const char *name, const char *labels,
+                        const metrics_hist_t *hist) {
+    const char *sep = labels[0] ? "," : "";
+    uint64_t cumulative = 0;
+    
+    for (uint32_t i = 0; i < METRICS_HIST_BUCKETS; i++) {
+        cumulative += atomic_load_explicit(&hist->buckets[i], memory_order_relaxed);
+        append(tb, "%s_bucket{%s%sle=\"%g\"} %llu\n", name, labels, sep,
+               (double)((uint64_t)METRICS_HIST_BASE_NS << i) / 1e9,
+               (unsigned long long)cumulative);
+    }
+    
+    cumulative += atomic_load_explicit(&hist->buckets[METRICS_HIST_BUCKETS], memory_order_relaxed);
+    append(tb, "%s_bucket{%s%sle=\"+Inf\"} %llu\n", name, labels, sep, (unsigned long long)cumulative);
+    append(tb, "%s_sum%s%s%s %.9f\n", name, labels[0] ? "{" : "", labels, labels[0] ? "}" : "",
+           (double)atomic_load_explicit(&hist->sum_ns, memory_order_relaxed) / 1e9);
+    append(tb, "%s_count%s%s%s %llu\n", name, labels[0] ? "{" : "", labels, labels[0] ? "}" : "",
+           (unsigned long long)cumulative);
+}
+
+size_t metrics_format_prometheus(const metrics_t *m, char *buf, size_t len) {
+    if (!m || !buf || len == 0) return 0;
+    
+    text_buffer_t tb = { buf, len, 0 };
+    
+    append_counter(&tb, "etherforge_cycles_total", "Process data cycles executed",
+                   atomic_load(&m->cycles_total));
+    append_counter(&tb, "etherforge_cycles_missed_total", "Cycles that overran the next deadline",
+                   atomic_load(&m->cycles_missed));
+    append_counter(&tb, "etherforge_wkc_errors_total", "Cycles with an unexpected working counter",
+                   atomic_load(&m->wkc_errors));
+    
+    append(&tb, "# HELP etherforge_cycle_period_seconds Time between cycle starts\n"
+                "# TYPE etherforge_cycle_period_seconds histogram\n");
+    append_hist(&tb, "etherforge_cycle_period_seconds", "", &m->cycle_period);
+    
+    append(&tb, "# HELP etherforge_cycle_exec_seconds Time spent in ethercat_process_data\n"
+                "# TYPE etherforge_cycle_exec_seconds histogram\n");
+    append_hist(&tb, "etherforge_cycle_exec_seconds", "", &m->cycle_exec);
+    
+    append(&tb, "# HELP etherforge_command_seconds Service latency of handle_client_command\n"
+                "# TYPE etherforge_command_seconds histogram\n");
+    for (uint32_t c = 0; c < METRICS_CATEGORIES; c++) {
+        for (uint32_t id = 0; id < METRICS_COMMANDS; id++) {
+            if (atomic_load_explicit(&m->commands[c][id].count, memory_order_relaxed) == 0) continue;
+            
+            char labels[64];
+            snprintf(labels, sizeof(labels), "category=\"%s\",command=\"%u\"", category_names[c], id);
+            append_hist(&tb, "etherforge_command_seconds", labels, &m->commands[c][id]);
+        }
+    }
+    
+    append_counter(&tb, "etherforge_command_errors_total", "Commands answered with an error status",
+                   atomic_load(&m->command_errors));
+    append_counter(&tb, "etherforge_invalid_packets_total", "Truncated or malformed UDP packets",
+                   atomic_load(&m->invalid_packets));
+    
+    append(&tb, "# HELP etherforge_client_packets_total Packets received per client\n"
+                "# TYPE etherforge_client_packets_total counter\n");
+    for (uint32_t i = 0; i < METRICS_CLIENTS; i++) {
+        uint32_t addr = atomic_load_explicit(&m->client_addr[i], memory_order_relaxed);
+        if (addr == 0) continue;
+        
+        char ip[INET_ADDRSTRLEN];
+        struct in_addr in = { .s_addr = addr };
+        inet_ntop(AF_INET, &in, ip, sizeof(ip));
+        append(&tb, "etherforge_client_packets_total{client=\"%s:%u\"} %llu\n", ip,
+               atomic_load_explicit(&m->client_port[i], memory_order_relaxed),
+               (unsigned long long)atomic_load_explicit(&m->client_packets[i], memory_order_relaxed));
+    }
+    
+    append_gauge(&tb, "etherforge_network_active", "1 while the EtherCAT network is cycling",
+                 atomic_load(&m->network_active));
+    append_gauge(&tb, "etherforge_slaves", "Slaves in the slave table", atomic_load(&m->slaves_total));
+    append_gauge(&tb, "etherforge_slaves_online", "Slaves currently online",
+                 atomic_load(&m->slaves_online));
+    append_gauge(&tb, "etherforge_clients", "Active UDP clients", atomic_load(&m->clients_active));
+    append_gauge(&tb, "etherforge_pdo_queue_depth", "Bytes pending in the PDO buffer",
+                 atomic_load(&m->pdo_queue_depth));
+    append_gauge(&tb, "etherforge_mailbox_queue_depth", "SDO requests waiting for the mailbox thread",
+                 atomic_load(&m->mailbox_queue_depth));
+    append_gauge(&tb, "etherforge_capture_queue_depth", "Frames waiting for the capture writer",
+                 atomic_load(&m->capture_queue_depth));
+    
+    return tb.pos;
+}
+
+// Sampled from the management thread so queue owners need no extra hooks
+void metrics_update_gauges(service_context_t *ctx) {
+    metrics_t *m = ctx->metrics.page;
+    if (!m) return;
+    
+    uint32_t online = 0;
+    for (uint32_t i = 0; i < ctx->ec_ctx.slave_count && i < MAX_SLAVES; i++) {
+        if (ctx->ec_ctx.slaves[i].online) online++;
+    }
+    
+    uint32_t clients = 0;
+    for (uint32_t i = 0; i < ctx->client_count && i < MAX_CLIENTS; i++) {
+        if (ctx->clients[i].active) clients++;
+    }
+    
+    atomic_store_explicit(&m->network_active, ctx->ec_ctx.network_active ? 1 : 0, memory_order_relaxed);
+    atomic_store_explicit(&m->slaves_total, ctx->ec_ctx.slave_count, memory_order_relaxed);
+    atomic_store_explicit(&m->slaves_online, online, memory_order_relaxed);
+    atomic_store_explicit(&m->clients_active, clients, memory_order_relaxed);
+    atomic_store_explicit(&m->pdo_queue_depth,
+                          (ctx->pdo_buffer.write_idx - ctx->pdo_buffer.read_idx) & ctx->pdo_buffer.mask,
+                          memory_order_relaxed);
+    atomic_store_explicit(&m->mailbox_queue_depth, ctx->mailbox.pending, memory_order_relaxed);
+    atomic_store_explicit(&m->capture_queue_depth,
+                          atomic_load(&ctx->capture.head) - atomic_load(&ctx->capture.tail),
+                          memory_order_relaxed);
+}
+
+static void serve_client(metrics_context_t *mc, int fd, char *response) {
+    char request[1024];
+    struct timeval timeout = { 1, 0 };
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    
+    ssize_t n = recv(fd, request, sizeof(request) - 1, 0);
+    if (n <= 0) return;
+    request[n] = '\0';
+    
+    const char *status = "200 OK";
+    size_t body_len = 0;
+    char *body = response + 256;
+    
+    if (strncmp(request, "GET /metrics", 12) == 0 || strncmp(request, "GET / ", 6) == 0) {
+        body_len = metrics_format_prometheus(mc->page, body, METRICS_RESPONSE_SIZE - 256);
+    } else {
+        status = "404 Not Found";
+    }
+    
+    int header_len = snprintf(response, 256,
+                              "HTTP/1.0 %s\r\n"
+                              "Content-Type: text/plain; version=0.0.4\r\n"
+                              "Content-Length: %zu\r\n"
+                              "Connection: close\r\n\r\n", status, body_len);
+    
+    memmove(response + header_len, body, body_len);
+    
+    size_t total = (size_t)header_len + body_len;
+    size_t sent = 0;
+    while (sent < total) {
+        ssize_t w = send(fd, response + sent, total - sent, MSG_NOSIGNAL);
+        if (w <= 0) break;
+        sent += (size_t)w;
+    }
+}
+
+void* metrics_thread_func(void *arg) {
+    service_context_t *ctx = (service_context_t*)arg;
+    metrics_context_t *mc = &ctx->metrics;
+    
+    if (mc->listen_fd < 0) return NULL;
+    
+    char *response = malloc(METRICS_RESPONSE_SIZE);
+    if (!response) {
+        LOG_ERROR("Failed to allocate metrics response buffer");
+        return NULL;
+    }
+    
+    LOG_INFO("Metrics thread starting");
+    
+    while (ctx->threads_running && !ctx->shutdown_requested) {
+        struct pollfd pfd = { .fd = mc->listen_fd, .events = POLLIN };
+        if (poll(&pfd, 1, METRICS_ACCEPT_POLL_MS) <= 0) continue;
+        
+        int fd = accept(mc->listen_fd, NULL, NULL);
+        if (fd < 0) continue;
+        
+        serve_client(mc, fd, response);
+        close(fd);
+    }
+    
+    free(response);
+    LOG_INFO("Metrics thread stopping");
+    return NULL;
+}
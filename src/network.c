@@ -1,5 +1,6 @@
 #include "service.h"
 #include "protocol.h"
+#include "ethercat.h"
 #include "logging.h"
 #include <sys/socket.h>
 #include <netinet/in.h>
@@ -45,10 +46,19 @@ static int setup_socket(service_context_t *ctx) {
     return 0;
 }
 
-static void add_client(service_context_t *ctx, struct sockaddr_in *client_addr) {
+static int add_client(service_context_t *ctx, struct sockaddr_in *client_addr) {
+    int slot = -1;
+    uint32_t limit = service_config(ctx)->security.max_clients;
+    if (limit == 0 || limit > MAX_CLIENTS) limit = MAX_CLIENTS;
+    
     pthread_mutex_lock(&ctx->client_lock);
     
-    for (uint32_t i = 0; i < MAX_CLIENTS; i++) {
+    uint32_t active = 0;
+    for (uint32_t i = 0; i < ctx->client_count; i++) {
+        if (ctx->clients[i].active) active++;
+    }
+    
+    for (uint32_t i = 0; i < MAX_CLIENTS && active < limit; i++) {
         if (!ctx->clients[i].active) {
             memcpy(&ctx->clients[i].addr, client_addr, sizeof(struct sockaddr_in));
             ctx->clients[i].addr_len = sizeof(struct sockaddr_in);
@@ -63,14 +73,19 @@ static void add_client(service_context_t *ctx, struct sockaddr_in *client_addr)
             inet_ntop(AF_INET, &client_addr->sin_addr, client_ip, INET_ADDRSTRLEN);
             LOG_INFO("Client connected: %s:%d (slot %d)", client_ip, 
                      ntohs(client_addr->sin_port), i);
+            
+            metrics_set_client(ctx->metrics.page, i, client_addr->sin_addr.s_addr,
+                               ntohs(client_addr->sin_port));
+            slot = (int)i;
             break;
         }
     }
     
     pthread_mutex_unlock(&ctx->client_lock);
+    return slot;
 }
 
-static void update_client(service_context_t *ctx, struct sockaddr_in *client_addr) {
+int update_client(service_context_t *ctx, struct sockaddr_in *client_addr) {
     pthread_mutex_lock(&ctx->client_lock);
     
     for (uint32_t i = 0; i < ctx->client_count; i++) {
@@ -78,12 +93,232 @@ static void update_client(service_context_t *ctx, struct sockaddr_in *client_add
             memcmp(&ctx->clients[i].addr, client_addr, sizeof(struct sockaddr_in)) == 0) {
             ctx->clients[i].last_seen = time(NULL);
             pthread_mutex_unlock(&ctx->client_lock);
-            return;
+            return (int)i;
         }
     }
     
     pthread_mutex_unlock(&ctx->client_lock);
-    add_client(ctx, client_addr);
+    return add_client(ctx, client_addr);
+}
+
+// Clients are only added and dropped by the network thread, which is also
+// the only caller
+client_info_t* find_client(service_context_t *ctx, const struct sockaddr_in *client_addr) {
+    for (uint32_t i = 0; i < ctx->client_count; i++) {
+        if (ctx->clients[i].active &&
+            memcmp(&ctx->clients[i].addr, client_addr, sizeof(struct sockaddr_in)) == 0) {
+            return &ctx->clients[i];
+        }
+    }
+    
+    return NULL;
+}
+
+// Recompile the event table when conditions or the image layout changed,
+// then push out whatever the RT thread has fired
+static void deliver_events(service_context_t *ctx) {
+    event_registry_t *reg = &ctx->events;
+    const uint8_t *image = ctx->ec_ctx.network_active ? ctx->ec_ctx.pdo_input : NULL;
+    uint32_t size = image ? ctx->ec_ctx.input_size : 0;
+    
+    events_reclaim(reg);
+    
+    if (events_needs_compile(reg, image, size)) {
+        static uint32_t slave_base[MAX_SLAVES];
+        uint32_t count = service_slave_bases(ctx, slave_base);
+        events_compile(reg, image, size, slave_base, count);
+    }
+    
+    event_record_t record;
+    uint32_t now = 0;
+    while (events_pop(reg, &record)) {
+        const event_condition_t *cond = events_find(reg, record.id);
+        if (!cond) continue;
+        
+        uint8_t payload[28] = {0};
+        uint32_t *payload32 = (uint32_t*)payload;
+        payload32[0] = htonl(record.id);
+        payload[4] = record.type;
+        payload32[2] = htonl(record.raw);
+        payload32[3] = htonl((uint32_t)(record.cycle >> 32));
+        payload32[4] = htonl((uint32_t)record.cycle);
+        payload32[5] = htonl((uint32_t)(record.timestamp_ns >> 32));
+        payload32[6] = htonl((uint32_t)record.timestamp_ns);
+        
+        udp_response_t event;
+        protocol_create_response(&event, STATUS_SUCCESS, ERR_NONE, payload, sizeof(payload));
+        event.magic = htonl(PROTOCOL_MAGIC_EVENT);
+        
+        if (sendto(ctx->socket_fd, &event, sizeof(event), 0,
+                   (const struct sockaddr*)&cond->addr, sizeof(cond->addr)) < 0) {
+            LOG_DEBUG("Event %u not delivered: %s", record.id, strerror(errno));
+        } else {
+            reg->sent++;
+            
+            // A delivered event keeps its client alive, so a client that only
+            // listens does not time out and lose its conditions
+            if (now == 0) now = time(NULL);
+            pthread_mutex_lock(&ctx->client_lock);
+            client_info_t *client = find_client(ctx, &cond->addr);
+            if (client) client->last_seen = now;
+            pthread_mutex_unlock(&ctx->client_lock);
+        }
+    }
+}
+
+static void send_reply(service_context_t *ctx, udp_tagged_response_t *reply, bool tagged,
+                       const struct sockaddr_in *client_addr) {
+    ssize_t sent = sendto(ctx->socket_fd, reply,
+                          tagged ? sizeof(udp_tagged_response_t) : sizeof(udp_response_t), 0,
+                          (const struct sockaddr*)client_addr, sizeof(struct sockaddr_in));
+    if (sent < 0) {
+        LOG_ERROR("sendto error: %s", strerror(errno));
+    }
+}
+
+// Only called by handlers on the network thread. Sends one reply to the
+// command being handled ahead of the one the handler returns, with the same tag
+void send_extra_reply(service_context_t *ctx, const udp_response_t *resp,
+                      const struct sockaddr_in *client_addr) {
+    udp_tagged_response_t reply;
+    reply.resp = *resp;
+    reply.tag = ctx->command_tag;
+    send_reply(ctx, &reply, ctx->command_tagged, client_addr);
+}
+
+static uint64_t deferred_queue_head(service_context_t *ctx, defer_kind_t kind) {
+    switch (kind) {
+        case DEFER_WIRESTAMP:
+            return atomic_load_explicit(&ctx->wirestamp.head, memory_order_relaxed);
+        case DEFER_RMW:
+            return atomic_load_explicit(&ctx->rmw.head, memory_order_relaxed);
+        default:
+            return 0;
+    }
+}
+
+static const uint64_t deferred_queue_size[DEFER_KINDS] = {
+    [DEFER_WIRESTAMP] = WIRESTAMP_QUEUE_SIZE,
+    [DEFER_RMW] = RMW_QUEUE_SIZE,
+};
+
+// A deferred reply reads its result from the request's queue slots, which
+// stay put while the oldest deferred seq is within one length of that queue
+// from its head. Handlers check this before queueing the `entries` a reply
+// will cover
+bool defer_reply_room(service_context_t *ctx, defer_kind_t kind, uint32_t entries) {
+    deferred_queue_t *queue = &ctx->deferred[kind];
+    if (queue->count == 0) return true;
+    if (queue->count >= DEFERRED_REPLY_MAX) return false;
+    
+    const deferred_reply_t *oldest = &queue->entries[queue->head];
+    return deferred_queue_head(ctx, kind) + entries - oldest->seq <= deferred_queue_size[kind];
+}
+
+// Only called by handlers on the network thread. `timeout_ns` of 0 waits
+// for the RT thread however long it takes
+int defer_reply(service_context_t *ctx, defer_kind_t kind, uint64_t seq, uint8_t count,
+                const udp_command_t *cmd, const struct sockaddr_in *client_addr,
+                uint64_t timeout_ns) {
+    deferred_queue_t *queue = &ctx->deferred[kind];
+    if (queue->count >= DEFERRED_REPLY_MAX) return -1;
+    
+    deferred_reply_t *entry = &queue->entries[(queue->head + queue->count) % DEFERRED_REPLY_MAX];
+    entry->addr = *client_addr;
+    entry->seq = seq;
+    entry->deadline_ns = timeout_ns ? ctx->command_rx_ns + timeout_ns : 0;
+    entry->tag = ctx->command_tag;
+    entry->tagged = ctx->command_tagged;
+    entry->command_type = cmd->command_type;
+    entry->command_id = cmd->command_id;
+    entry->payload_len = ntohs(cmd->payload_len);
+    entry->count = count;
+    queue->count++;
+    return 0;
+}
+
+// Builds the reply once the RT thread is done with the request, or once its
+// deadline has passed
+static bool deferred_response(service_context_t *ctx, defer_kind_t kind,
+                              const deferred_reply_t *entry, uint64_t now, udp_response_t *resp) {
+    switch (kind) {
+        case DEFER_WIRESTAMP: {
+            // A write whose cycle never went out is still accepted, just
+            // without a latency
+            bool sent;
+            uint32_t latency_ns;
+            int result = wirestamp_result(&ctx->wirestamp, entry->seq, &sent, &latency_ns);
+            if (result < 0 && (entry->deadline_ns == 0 || now < entry->deadline_ns)) return false;
+            
+            if (result == 0 && sent) {
+                uint32_t value = htonl(latency_ns);
+                protocol_create_response(resp, STATUS_SUCCESS, ERR_NONE, &value, 4);
+            } else {
+                protocol_create_response(resp, STATUS_SUCCESS, ERR_NONE, NULL, 0);
+            }
+            return true;
+        }
+        case DEFER_RMW: {
+            // Every operation is answered once the RT thread has been through
+            // it; one that found no image was not applied
+            rmw_op_t op;
+            if (rmw_result(&ctx->rmw, entry->seq + entry->count - 1, &op) < 0) return false;
+            
+            if (!op.applied) {
+                protocol_create_response(resp, STATUS_ERROR, ERR_NETWORK_NOT_READY, NULL, 0);
+                return true;
+            }
+            
+            // A symbol batch was queued as one, so it landed in one cycle,
+            // and its last op tells for all of them
+            if (entry->command_type == CMD_CATEGORY_SYMBOL) {
+                uint8_t payload[4] = { (uint8_t)(entry->payload_len / 8), 0, 0, 0 };
+                protocol_create_response(resp, STATUS_SUCCESS, ERR_NONE, payload, 4);
+                return true;
+            }
+            
+            // A compare-and-swap also reports whether it swapped
+            bool swap = entry->command_id == PDO_COMPARE_SWAP;
+            uint8_t payload[5];
+            uint32_t pre = htonl(op.pre);
+            memcpy(payload, &pre, 4);
+            payload[4] = (swap && op.pre == op.mask) ? 1 : 0;
+            protocol_create_response(resp, STATUS_SUCCESS, ERR_NONE, payload, swap ? 5 : 4);
+            return true;
+        }
+        default:
+            protocol_create_response(resp, STATUS_ERROR, ERR_INTERNAL, NULL, 0);
+            return true;
+    }
+}
+
+// Returns the number of replies still held back
+static uint32_t send_deferred(service_context_t *ctx) {
+    uint64_t now = 0;
+    uint32_t pending = 0;
+    
+    for (int kind = 0; kind < DEFER_KINDS; kind++) {
+        deferred_queue_t *queue = &ctx->deferred[kind];
+        
+        while (queue->count > 0) {
+            if (now == 0) {
+                struct timespec ts;
+                clock_gettime(CLOCK_MONOTONIC, &ts);
+                now = (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+            }
+            
+            deferred_reply_t *entry = &queue->entries[queue->head];
+            udp_tagged_response_t reply;
+            if (!deferred_response(ctx, (defer_kind_t)kind, entry, now, &reply.resp)) break;
+            
+            reply.tag = entry->tag;
+            send_reply(ctx, &reply, entry->tagged, &entry->addr);
+            queue->head = (queue->head + 1) % DEFERRED_REPLY_MAX;
+            queue->count--;
+        }
+        pending += queue->count;
+    }
+    return pending;
 }
 
 static void cleanup_stale_clients(service_context_t *ctx) {
@@ -101,6 +336,8 @@ static void cleanup_stale_clients(service_context_t *ctx) {
             LOG_INFO("Client timeout: %s:%d", client_ip, 
                      ntohs(ctx->clients[i].addr.sin_port));
             
+            events_remove_client(&ctx->events, &ctx->clients[i].addr);
+            scope_destroy_client(&ctx->scopes, &ctx->clients[i].addr);
             ctx->clients[i].active = false;
         }
     }
@@ -110,6 +347,8 @@ static void cleanup_stale_clients(service_context_t *ctx) {
     }
     
     pthread_mutex_unlock(&ctx->client_lock);
+    
+    expire_layout_bindings(ctx, current_time, timeout);
 }
 
 void* network_thread_func(void *arg) {
@@ -121,23 +360,34 @@ void* network_thread_func(void *arg) {
     }
     
     LOG_INFO("Network thread started");
+    trace_register_thread("network");
     
-    udp_command_t cmd;
-    udp_response_t resp;
+    udp_tagged_command_t msg;
+    udp_tagged_response_t reply;
+    udp_command_t *cmd = &msg.cmd;
+    udp_response_t *resp = &reply.resp;
     struct sockaddr_in client_addr;
     socklen_t client_len = sizeof(client_addr);
     
     uint32_t last_cleanup = time(NULL);
+    metrics_t *metrics = ctx->metrics.page;
     
     while (ctx->threads_running && !ctx->shutdown_requested) {
-        ssize_t received = recvfrom(ctx->socket_fd, &cmd, sizeof(cmd), 0,
+        reload_enter(&ctx->reload, RELOAD_READER_NETWORK);
+        ethercat_take_symbols(&ctx->ec_ctx);
+        uint32_t deferred = send_deferred(ctx);
+        deliver_events(ctx);
+        scope_reclaim(&ctx->scopes);
+        
+        ssize_t received = recvfrom(ctx->socket_fd, &msg, sizeof(msg), 0,
                                    (struct sockaddr*)&client_addr, &client_len);
         
         if (received < 0) {
             if (errno != EAGAIN && errno != EWOULDBLOCK) {
                 LOG_ERROR("recvfrom error: %s", strerror(errno));
             }
-            usleep(1000);
+            // Poll closely while replies wait for the RT thread
+            usleep(deferred > 0 ? 10 : 1000);
             
             uint32_t now = time(NULL);
             if (now - last_cleanup > 60) {
@@ -147,19 +397,38 @@ void* network_thread_func(void *arg) {
             continue;
         }
         
+        struct timespec start, end;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        ctx->command_rx_ns = (uint64_t)start.tv_sec * 1000000000ULL + (uint64_t)start.tv_nsec;
+        
         if (received < sizeof(udp_command_t)) {
             LOG_WARN("Received truncated packet (%zd bytes)", received);
+            atomic_fetch_add_explicit(&metrics->invalid_packets, 1, memory_order_relaxed);
             continue;
         }
         
-        update_client(ctx, &client_addr);
+        ctx->command_tagged = received == sizeof(udp_tagged_command_t);
+        ctx->command_tag = msg.tag;
         
-        if (handle_client_command(ctx, &cmd, &resp, &client_addr) == 0) {
-            ssize_t sent = sendto(ctx->socket_fd, &resp, sizeof(resp), 0,
-                                 (struct sockaddr*)&client_addr, client_len);
-            if (sent < 0) {
-                LOG_ERROR("sendto error: %s", strerror(errno));
-            }
+        int slot = update_client(ctx, &client_addr);
+        if (slot >= 0 && slot < METRICS_CLIENTS) {
+            atomic_fetch_add_explicit(&metrics->client_packets[slot], 1, memory_order_relaxed);
+        }
+        
+        TRACE_BEGIN(TRACE_COMMAND);
+        int handled = handle_client_command(ctx, cmd, resp, &client_addr);
+        TRACE_END(TRACE_COMMAND);
+        
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        metrics_record_command(metrics, cmd->command_type, cmd->command_id,
+                               (uint64_t)((end.tv_sec - start.tv_sec) * 1000000000LL +
+                                          (end.tv_nsec - start.tv_nsec)),
+                               handled < 0 || (handled == 0 && resp->status != STATUS_SUCCESS));
+        
+        // A handler returns 1 when it deferred the reply to send_deferred
+        if (handled == 0) {
+            reply.tag = msg.tag;
+            send_reply(ctx, &reply, ctx->command_tagged, &client_addr);
         }
     }
     
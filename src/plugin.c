@@ -0,0 +1,167 @@
+#include "plugin.h"
+#include "logging.h"
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
+#include <dlfcn.h>
+
+static inline uint64_t plugin_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+// Entries are "path" or "path@budget_us" to override the default budget
+static int plugin_load(plugin_t *plugin, const char *spec, uint32_t default_budget_us) {
+    memset(plugin, 0, sizeof(plugin_t));
+    snprintf(plugin->path, sizeof(plugin->path), "%s", spec);
+    
+    uint32_t budget_us = default_budget_us;
+    char *at = strrchr(plugin->path, '@');
+    if (at) {
+        *at = '\0';
+        budget_us = (uint32_t)atol(at + 1);
+    }
+    plugin->budget_ns = budget_us * 1000U;
+    
+    plugin->handle = dlopen(plugin->path, RTLD_NOW | RTLD_LOCAL);
+    if (!plugin->handle) {
+        LOG_ERROR("Failed to load plugin %s: %s", plugin->path, dlerror());
+        return -1;
+    }
+    
+    plugin_entry_fn entry = (plugin_entry_fn)dlsym(plugin->handle, PLUGIN_ENTRY_SYMBOL);
+    plugin->desc = entry ? entry() : NULL;
+    
+    if (!plugin->desc || !plugin->desc->on_cycle) {
+        LOG_ERROR("Plugin %s does not export a valid %s", plugin->path, PLUGIN_ENTRY_SYMBOL);
+        dlclose(plugin->handle);
+        return -1;
+    }
+    
+    if (plugin->desc->api_version != PLUGIN_API_VERSION) {
+        LOG_ERROR("Plugin %s was built for API version %u, expected %u", plugin->path,
+                  plugin->desc->api_version, PLUGIN_API_VERSION);
+        dlclose(plugin->handle);
+        return -1;
+    }
+    
+    // init runs here, outside the RT thread, so it may allocate and block
+    if (plugin->desc->init && plugin->desc->init(&plugin->state) != 0) {
+        LOG_ERROR("Plugin %s failed to initialize", plugin->path);
+        dlclose(plugin->handle);
+        return -1;
+    }
+    
+    plugin->enabled = true;
+    LOG_INFO("Loaded plugin %s from %s (budget %u us)",
+             plugin->desc->name ? plugin->desc->name : "(unnamed)", plugin->path, budget_us);
+    return 0;
+}
+
+int plugin_host_init(plugin_host_t *host, const plugin_config_t *config) {
+    if (!host || !config) return -1;
+    
+    memset(host, 0, sizeof(plugin_host_t));
+    host->overrun_limit = config->overrun_limit;
+    
+    int result = 0;
+    
+    for (uint32_t i = 0; i < config->count && i < PLUGIN_MAX; i++) {
+        if (plugin_load(&host->plugins[host->count], config->paths[i], config->budget_us) == 0) {
+            host->count++;
+        } else {
+            result = -1;
+        }
+    }
+    
+    return result;
+}
+
+void plugin_host_cleanup(plugin_host_t *host) {
+    if (!host) return;
+    
+    for (uint32_t i = 0; i < host->count; i++) {
+        plugin_t *plugin = &host->plugins[i];
+        
+        if (plugin->desc && plugin->desc->cleanup) {
+            plugin->desc->cleanup(plugin->state);
+        }
+        if (plugin->handle) {
+            dlclose(plugin->handle);
+        }
+    }
+    
+    host->count = 0;
+}
+
+void plugin_host_run(plugin_host_t *host, const uint8_t *inputs, uint32_t input_size,
+                     uint8_t *outputs, uint32_t output_size, int wkc, int expected_wkc) {
+    if (!host || host->count == 0) return;
+    
+    uint64_t start = plugin_now_ns();
+    
+    // The images point straight at the process image: no copies on the RT path
+    plugin_in_image_t in = {
+        .data = inputs,
+        .size = inputs ? input_size : 0,
+        .wkc = wkc,
+        .expected_wkc = expected_wkc,
+        .cycle = host->cycle++,
+        .timestamp_ns = start
+    };
+    plugin_out_image_t out = {
+        .data = outputs,
+        .size = outputs ? output_size : 0
+    };
+    
+    for (uint32_t i = 0; i < host->count; i++) {
+        plugin_t *plugin = &host->plugins[i];
+        if (!plugin->enabled) continue;
+        
+        plugin->desc->on_cycle(plugin->state, &in, &out);
+        
+        uint64_t end = plugin_now_ns();
+        uint32_t elapsed = (uint32_t)(end - start);
+        start = end;
+        
+        plugin->calls++;
+        plugin->total_ns += elapsed;
+        plugin->last_ns = elapsed;
+        if (elapsed > plugin->max_ns) plugin->max_ns = elapsed;
+        
+        if (plugin->budget_ns == 0 || elapsed <= plugin->budget_ns) {
+            plugin->consecutive_overruns = 0;
+            continue;
+        }
+        
+        plugin->overruns++;
+        plugin->consecutive_overruns++;
+        
+        if (host->overrun_limit > 0 && plugin->consecutive_overruns >= host->overrun_limit) {
+            plugin->enabled = false;
+            LOG_WARN("Plugin %s disabled after %u consecutive overruns (last %u ns, budget %u ns)",
+                     plugin->desc->name ? plugin->desc->name : plugin->path,
+                     plugin->consecutive_overruns, elapsed, plugin->budget_ns);
+        }
+    }
+}
+
+int plugin_host_get_stats(const plugin_host_t *host, uint32_t index, plugin_stats_t *stats) {
+    if (!host || !stats || index >= host->count) return -1;
+    
+    const plugin_t *plugin = &host->plugins[index];
+    
+    memset(stats, 0, sizeof(plugin_stats_t));
+    snprintf(stats->name, sizeof(stats->name), "%s",
+             plugin->desc->name ? plugin->desc->name : "");
+    stats->enabled = plugin->enabled;
+    stats->calls = plugin->calls;
+    stats->avg_ns = plugin->calls ? (uint32_t)(plugin->total_ns / plugin->calls) : 0;
+    stats->last_ns = plugin->last_ns;
+    stats->max_ns = plugin->max_ns;
+    stats->budget_ns = plugin->budget_ns;
+    stats->overruns = plugin->overruns;
+    
+    return 0;
+}
@@ -9,7 +9,7 @@ bool protocol_validate_command(const udp_command_t *cmd) {
         return false;
     }
     
-    if (cmd->command_type < CMD_CATEGORY_NETWORK || cmd->command_type > CMD_CATEGORY_DIAGNOSTIC) {
+    if (cmd->command_type < CMD_CATEGORY_NETWORK || cmd->command_type > CMD_CATEGORY_SYMBOL) {
         return false;
     }
     
@@ -19,11 +19,21 @@ bool protocol_validate_command(const udp_command_t *cmd) {
     
     switch (cmd->command_type) {
         case CMD_CATEGORY_NETWORK:
-            return (cmd->command_id >= NET_START && cmd->command_id <= NET_STATUS);
+            return (cmd->command_id >= NET_START && cmd->command_id <= NET_RELOAD);
         case CMD_CATEGORY_PDO:
-            return (cmd->command_id >= PDO_READ && cmd->command_id <= PDO_STOP_MON);
+            return (cmd->command_id >= PDO_READ && cmd->command_id <= PDO_SNAPSHOT);
         case CMD_CATEGORY_DIAGNOSTIC:
-            return (cmd->command_id >= DIAG_NETWORK && cmd->command_id <= DIAG_SLAVE);
+            return (cmd->command_id >= DIAG_NETWORK && cmd->command_id <= DIAG_PLUGINS);
+        case CMD_CATEGORY_MAILBOX:
+            return (cmd->command_id >= SDO_READ && cmd->command_id <= SDO_RESULT);
+        case CMD_CATEGORY_SIGNAL:
+            return (cmd->command_id >= SIG_READ && cmd->command_id <= SIG_WINDOW);
+        case CMD_CATEGORY_EVENT:
+            return (cmd->command_id >= EVT_ADD && cmd->command_id <= EVT_STATUS);
+        case CMD_CATEGORY_SCOPE:
+            return (cmd->command_id >= SCOPE_CREATE && cmd->command_id <= SCOPE_DELETE);
+        case CMD_CATEGORY_SYMBOL:
+            return (cmd->command_id >= SYM_RESOLVE && cmd->command_id <= SYM_LAYOUT);
         default:
             return false;
     }
@@ -56,10 +66,14 @@ bool protocol_extract_pdo_op(const udp_command_t *cmd, pdo_operation_t *op) {
     const uint32_t *payload32 = (const uint32_t *)cmd->payload;
     op->slave_id = ntohl(payload32[0]);
     op->offset = ntohl(payload32[1]);
+    op->flags = 0;
     
     if (cmd->command_id == PDO_WRITE && payload_len >= 12) {
         op->size = 4;
         op->value = ntohl(payload32[2]);
+        if (payload_len >= 16) {
+            op->flags = ntohl(payload32[3]);
+        }
     } else if (cmd->command_id == PDO_READ && payload_len >= 12) {
         op->size = ntohl(payload32[2]);
         op->value = 0;
@@ -71,6 +85,33 @@ bool protocol_extract_pdo_op(const udp_command_t *cmd, pdo_operation_t *op) {
     return true;
 }
 
+bool protocol_extract_sdo_op(const udp_command_t *cmd, sdo_operation_t *op) {
+    if (!cmd || !op) return false;
+    
+    if (cmd->command_type != CMD_CATEGORY_MAILBOX) return false;
+    
+    uint16_t payload_len = ntohs(cmd->payload_len);
+    if (payload_len < 12) return false;
+    
+    const uint16_t *payload16 = (const uint16_t *)cmd->payload;
+    const uint32_t *payload32 = (const uint32_t *)cmd->payload;
+    op->slave_id = ntohs(payload16[0]);
+    op->index = ntohs(payload16[1]);
+    op->subindex = cmd->payload[4];
+    op->flags = cmd->payload[5];
+    op->size = ntohl(payload32[2]);
+    
+    if (cmd->command_id == SDO_WRITE && payload_len > 12) {
+        op->data = cmd->payload + 12;
+        op->data_len = payload_len - 12;
+    } else {
+        op->data = NULL;
+        op->data_len = 0;
+    }
+    
+    return true;
+}
+
 void protocol_pack_network_status(const network_status_t *status, uint8_t *payload) {
     if (!status || !payload) return;
     
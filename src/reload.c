@@ -0,0 +1,264 @@
+#include "reload.h"
+#include "logging.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+
+typedef struct {
+    const char *name;
+    size_t offset;
+    size_t size;
+    bool live;
+    // Live only while it stays non-zero; switching to or from 0 needs a restart
+    bool live_nonzero;
+} reload_field_t;
+
+#define FIELD(member, name, live) \
+    { name, offsetof(config_t, member), sizeof(((config_t*)0)->member), live, false }
+
+#define FIELD_NONZERO(member, name) \
+    { name, offsetof(config_t, member), sizeof(((config_t*)0)->member), true, true }
+
+// Spans a fixed array and the element count stored right behind it
+#define FIELD_ARRAY(member, count, name, live) \
+    { name, offsetof(config_t, member), \
+      offsetof(config_t, count) + sizeof(((config_t*)0)->count) - offsetof(config_t, member), \
+      live, false }
+
+// Settings marked live are swapped in while running; the rest are reported
+// and keep their running value until the next restart
+static const reload_field_t fields[] = {
+    FIELD(network.interface, "interface", false),
+    FIELD(network.cycle_time_us, "cycle_time_us", true),
+    FIELD(network.timeout_ms, "timeout_ms", false),
+    FIELD(network.topology_cache, "topology_cache", false),
+    FIELD(network.transport, "transport", false),
+    FIELD(network.busy_poll_us, "busy_poll_us", false),
+    FIELD(network.simulate_slaves, "simulate_slaves", false),
+    FIELD(network.simulate_slave_bytes, "simulate_slave_bytes", false),
+    FIELD(network.output_shm, "output_shm", false),
+    FIELD(network.output_max_age_ms, "output_max_age_ms", false),
+    FIELD(performance.rt_priority, "rt_priority", false),
+    FIELD_ARRAY(performance.cpu_affinity, performance.cpu_count, "cpu_affinity", false),
+    FIELD(performance.buffer_size, "buffer_size", false),
+    FIELD(performance.trace_enabled, "trace_enabled", false),
+    FIELD(performance.trace_file, "trace_file", false),
+    FIELD(logging.level, "level", true),
+    FIELD(logging.file, "file", false),
+    FIELD(logging.max_size, "max_size", false),
+    FIELD(security.bind_address, "bind_address", false),
+    FIELD(security.port, "port", false),
+    FIELD(security.max_clients, "max_clients", true),
+    FIELD(capture.mode, "capture_mode", false),
+    FIELD(capture.dir, "capture_dir", false),
+    FIELD(capture.file_mb, "capture_file_mb", false),
+    FIELD(capture.files, "capture_files", false),
+    FIELD(capture.post_frames, "capture_post_frames", false),
+    FIELD(metrics.bind_address, "metrics_bind", false),
+    FIELD(metrics.port, "metrics_port", false),
+    FIELD(metrics.shm_name, "metrics_shm", false),
+    FIELD_ARRAY(plugins.paths, plugins.count, "plugin_paths", false),
+    FIELD(plugins.budget_us, "plugin_budget_us", false),
+    FIELD(plugins.overrun_limit, "plugin_overrun_limit", false),
+    FIELD(signals.file, "signal_file", false),
+    FIELD(signals.decimation, "signal_decimation", true),
+    FIELD_NONZERO(signals.window_ms, "signal_window_ms"),
+    FIELD(signals.window_history, "signal_window_history", false),
+};
+
+#define FIELD_COUNT (sizeof(fields) / sizeof(fields[0]))
+
+static bool is_zero(const uint8_t *value, size_t size) {
+    for (size_t i = 0; i < size; i++) {
+        if (value[i] != 0) return false;
+    }
+    return true;
+}
+
+// Whether a changed field can be swapped in, given the running value
+static bool applies_live(const reload_field_t *field, const uint8_t *from, const uint8_t *running) {
+    if (!field->live) return false;
+    return !field->live_nonzero || is_zero(from, field->size) == is_zero(running, field->size);
+}
+
+int reload_init(reload_t *rl, const config_t *config, const char *path) {
+    if (!rl || !config) return -1;
+    
+    memset(rl, 0, sizeof(reload_t));
+    snprintf(rl->path, sizeof(rl->path), "%s", path ? path : "");
+    
+    reload_version_t *version = calloc(1, sizeof(reload_version_t));
+    if (!version) {
+        LOG_ERROR("Failed to allocate configuration");
+        return -1;
+    }
+    version->config = *config;
+    version->generation = 1;
+    
+    if (!rl->path[0] || config_load(&rl->parsed, rl->path) < 0) {
+        rl->parsed = *config;
+    }
+    
+    if (pthread_mutex_init(&rl->lock, NULL) != 0) {
+        free(version);
+        return -1;
+    }
+    
+    for (int i = 0; i < RELOAD_READERS; i++) {
+        atomic_init(&rl->seen[i], 0);
+    }
+    atomic_init(&rl->current, version);
+    rl->initialized = true;
+    return 0;
+}
+
+void reload_cleanup(reload_t *rl) {
+    if (!rl || !rl->initialized) return;
+    
+    free(atomic_exchange_explicit(&rl->current, NULL, memory_order_acquire));
+    for (int i = 0; i < RELOAD_RETIRED_MAX; i++) {
+        free(rl->retired[i]);
+        rl->retired[i] = NULL;
+    }
+    pthread_mutex_destroy(&rl->lock);
+    rl->initialized = false;
+}
+
+// Readers call this once per loop pass and may use the result until their
+// next call
+const config_t* reload_enter(reload_t *rl, reload_reader_t reader) {
+    reload_version_t *version = atomic_load_explicit(&rl->current, memory_order_acquire);
+    atomic_store_explicit(&rl->seen[reader], version->generation, memory_order_release);
+    return &version->config;
+}
+
+// Only valid on a thread that has entered as a reader; the version returned
+// is at least as new as the one it entered with
+const config_t* reload_current(reload_t *rl) {
+    if (!rl || !rl->initialized) return NULL;
+    return &atomic_load_explicit(&rl->current, memory_order_acquire)->config;
+}
+
+static void reclaim_locked(reload_t *rl) {
+    for (int i = 0; i < RELOAD_RETIRED_MAX; i++) {
+        reload_version_t *version = rl->retired[i];
+        if (!version) continue;
+        
+        bool idle = true;
+        for (int r = 0; r < RELOAD_READERS; r++) {
+            if (atomic_load_explicit(&rl->seen[r], memory_order_acquire) <= version->generation) {
+                idle = false;
+                break;
+            }
+        }
+        
+        if (idle) {
+            free(version);
+            rl->retired[i] = NULL;
+        }
+    }
+}
+
+void reload_reclaim(reload_t *rl) {
+    if (!rl || !rl->initialized) return;
+    
+    pthread_mutex_lock(&rl->lock);
+    reclaim_locked(rl);
+    pthread_mutex_unlock(&rl->lock);
+}
+
+static int parse_file(const char *path, config_t *parsed) {
+    // config_load falls back to defaults for a missing file, which must not
+    // replace a running configuration
+    if (access(path, R_OK) != 0) {
+        LOG_ERROR("Cannot reload %s: %s", path, strerror(errno));
+        return -1;
+    }
+    
+    if (config_load(parsed, path) < 0) {
+        LOG_ERROR("Cannot reload %s: parse error", path);
+        return -1;
+    }
+    
+    if (parsed->network.cycle_time_us == 0) {
+        LOG_ERROR("Cannot reload %s: cycle_time_us must be positive", path);
+        return -1;
+    }
+    return 0;
+}
+
+// Reparses the configuration file, diffs it against the last one and
+// publishes a new version with the live settings replaced. Fails without
+// touching the running configuration if the file is unreadable or invalid
+int reload_config(reload_t *rl, reload_result_t *result) {
+    if (!rl || !rl->initialized || !rl->path[0]) return -1;
+    
+    pthread_mutex_lock(&rl->lock);
+    reclaim_locked(rl);
+    
+    int slot = -1;
+    for (int i = 0; i < RELOAD_RETIRED_MAX; i++) {
+        if (!rl->retired[i]) {
+            slot = i;
+            break;
+        }
+    }
+    
+    config_t *parsed = calloc(1, sizeof(config_t));
+    reload_version_t *next = calloc(1, sizeof(reload_version_t));
+    if (slot < 0 || !parsed || !next || parse_file(rl->path, parsed) < 0) {
+        if (slot < 0) LOG_WARN("Earlier configurations still in use, reload refused");
+        free(parsed);
+        free(next);
+        pthread_mutex_unlock(&rl->lock);
+        return -1;
+    }
+    
+    reload_version_t *current = atomic_load_explicit(&rl->current, memory_order_relaxed);
+    next->config = current->config;
+    next->generation = current->generation + 1;
+    
+    uint32_t applied = 0;
+    uint32_t pending = 0;
+    for (size_t i = 0; i < FIELD_COUNT; i++) {
+        const reload_field_t *field = &fields[i];
+        const uint8_t *from = (const uint8_t*)parsed + field->offset;
+        
+        if (memcmp(from, (const uint8_t*)&rl->parsed + field->offset, field->size) == 0) continue;
+        
+        if (applies_live(field, from, (const uint8_t*)&current->config + field->offset)) {
+            memcpy((uint8_t*)&next->config + field->offset, from, field->size);
+            LOG_INFO("  %s changed, applied", field->name);
+            applied++;
+        } else {
+            LOG_WARN("  %s changed, takes effect after a restart", field->name);
+            pending++;
+        }
+    }
+    rl->parsed = *parsed;
+    free(parsed);
+    
+    if (applied > 0) {
+        rl->retired[slot] = current;
+        atomic_store_explicit(&rl->current, next, memory_order_release);
+        logging_set_level(next->config.logging.level);
+    } else {
+        free(next);
+        next = current;
+    }
+    
+    LOG_INFO("Configuration generation %llu: %u setting(s) applied, %u pending restart",
+             (unsigned long long)next->generation, applied, pending);
+    
+    if (result) {
+        result->generation = next->generation;
+        result->applied = applied;
+        result->pending = pending;
+    }
+    
+    pthread_mutex_unlock(&rl->lock);
+    return 0;
+}
@@ -0,0 +1,176 @@
+#include "retain.h"
+#include "logging.h"
+#include <stdio.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+static uint64_t realtime_ns(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    return (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+}
+
+static bool owner_alive(uint32_t pid) {
+    if (pid == 0 || pid == (uint32_t)getpid()) return false;
+    return kill((pid_t)pid, 0) == 0 || errno == EPERM;
+}
+
+// Opens the named segment, keeping whatever an earlier daemon left in it.
+// A segment of another layout is wiped; one still owned by a running daemon
+// is left alone
+int retain_init(retain_t *rt, const char *shm_name, uint32_t max_age_ms) {
+    if (!rt) return -1;
+    
+    memset(rt, 0, sizeof(retain_t));
+    atomic_init(&rt->armed, false);
+    rt->max_age_ms = max_age_ms;
+    if (!shm_name || !shm_name[0]) return 0;
+    
+    int fd = shm_open(shm_name, O_CREAT | O_RDWR, 0600);
+    if (fd < 0) {
+        LOG_WARN("Retained output segment %s unavailable: %s", shm_name, strerror(errno));
+        return -1;
+    }
+    
+    struct stat st;
+    if (fstat(fd, &st) < 0 ||
+        ((size_t)st.st_size != sizeof(retain_page_t) &&
+         (ftruncate(fd, 0) < 0 || ftruncate(fd, sizeof(retain_page_t)) < 0))) {
+        LOG_WARN("Failed to size retained output segment %s: %s", shm_name, strerror(errno));
+        close(fd);
+        return -1;
+    }
+    
+    void *page = mmap(NULL, sizeof(retain_page_t), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (page == MAP_FAILED) {
+        LOG_WARN("Failed to map retained output segment %s: %s", shm_name, strerror(errno));
+        return -1;
+    }
+    
+    retain_page_t *p = (retain_page_t*)page;
+    if (p->magic == RETAIN_MAGIC && owner_alive(p->pid)) {
+        LOG_WARN("Retained output segment %s is in use by pid %u", shm_name, p->pid);
+        munmap(page, sizeof(retain_page_t));
+        return -1;
+    }
+    
+    if (p->magic != RETAIN_MAGIC || p->version != RETAIN_VERSION ||
+        p->size != sizeof(retain_page_t)) {
+        memset(p, 0, sizeof(retain_page_t));
+        p->version = RETAIN_VERSION;
+        p->size = sizeof(retain_page_t);
+        atomic_thread_fence(memory_order_release);
+        p->magic = RETAIN_MAGIC;
+    }
+    p->pid = (uint32_t)getpid();
+    
+    rt->page = p;
+    rt->restorable = true;
+    snprintf(rt->shm_name, sizeof(rt->shm_name), "%s", shm_name);
+    LOG_INFO("Retaining outputs at /dev/shm%s (%zu bytes)", rt->shm_name, sizeof(retain_page_t));
+    return 0;
+}
+
+// The segment itself stays behind for the next daemon
+void retain_cleanup(retain_t *rt) {
+    if (!rt || !rt->page) return;
+    
+    retain_detach(rt);
+    rt->page->pid = 0;
+    munmap(rt->page, sizeof(retain_page_t));
+    rt->page = NULL;
+}
+
+static const retain_bank_t* newest_bank(const retain_page_t *page, uint64_t *tag) {
+    uint64_t t0 = atomic_load_explicit(&page->banks[0].tag, memory_order_acquire);
+    uint64_t t1 = atomic_load_explicit(&page->banks[1].tag, memory_order_acquire);
+    
+    *tag = (t0 > t1) ? t0 : t1;
+    if (*tag == 0) return NULL;
+    return &page->banks[(t0 > t1) ? 0 : 1];
+}
+
+// Called on network start with the topology just found and the zeroed output
+// image. On the first start of the process, when the segment was retained for
+// the same slaves no longer than `max_age_ms` ago, the last stored image is
+// copied into `image` and 1 is returned; otherwise the segment is rebound to
+// the new topology and its old image discarded. Either way the RT thread
+// stores to it from then on
+int retain_attach(retain_t *rt, const retain_slave_t *slaves, uint32_t count, uint8_t *image,
+                  uint32_t size) {
+    if (!rt || !rt->page || !image) return -1;
+    
+    retain_page_t *page = rt->page;
+    atomic_store_explicit(&rt->armed, false, memory_order_relaxed);
+    
+    if (count > RETAIN_MAX_SLAVES || size > RETAIN_MAX_BYTES) {
+        LOG_WARN("Process image of %u slaves, %u output bytes is too large to retain", count, size);
+        return -1;
+    }
+    
+    uint64_t tag;
+    const retain_bank_t *bank = rt->restorable ? newest_bank(page, &tag) : NULL;
+    bool match = bank && bank->size == size && page->output_size == size &&
+                 page->slave_count == count &&
+                 memcmp(page->slaves, slaves, count * sizeof(retain_slave_t)) == 0;
+    rt->restorable = false;
+    
+    uint64_t now = realtime_ns();
+    uint64_t age_ms = (bank && now > bank->time_ns) ? (now - bank->time_ns) / 1000000 : 0;
+    bool fresh = rt->max_age_ms == 0 || age_ms <= rt->max_age_ms;
+    
+    if (match && fresh) {
+        memcpy(image, bank->data, size);
+        rt->stores = tag;
+        LOG_INFO("Restored %u bytes of outputs retained at cycle %llu, %llu ms ago", size,
+                 (unsigned long long)bank->cycle, (unsigned long long)age_ms);
+    } else {
+        if (match) {
+            LOG_WARN("Retained outputs are %llu ms old (limit %u ms), "
+                     "starting with cleared outputs", (unsigned long long)age_ms, rt->max_age_ms);
+        } else if (bank) {
+            LOG_WARN("Retained outputs do not match the topology, starting with cleared outputs");
+        }
+        atomic_store_explicit(&page->banks[0].tag, 0, memory_order_relaxed);
+        atomic_store_explicit(&page->banks[1].tag, 0, memory_order_relaxed);
+        page->slave_count = count;
+        page->output_size = size;
+        memset(page->slaves, 0, sizeof(page->slaves));
+        memcpy(page->slaves, slaves, count * sizeof(retain_slave_t));
+        rt->stores = 0;
+    }
+    
+    atomic_store_explicit(&rt->armed, true, memory_order_release);
+    return (match && fresh) ? 1 : 0;
+}
+
+void retain_detach(retain_t *rt) {
+    if (!rt) return;
+    atomic_store_explicit(&rt->armed, false, memory_order_release);
+}
+
+// Called by the RT thread right before the output image is sent. Stores
+// alternate between the two banks
+void retain_store(retain_t *rt, const uint8_t *image, uint32_t size, uint64_t cycle) {
+    if (!atomic_load_explicit(&rt->armed, memory_order_acquire) || !image) return;
+    
+    retain_bank_t *bank = &rt->page->banks[rt->stores & 1];
+    uint32_t bytes = (size < RETAIN_MAX_BYTES) ? size : RETAIN_MAX_BYTES;
+    
+    atomic_store_explicit(&bank->tag, 0, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    
+    memcpy(bank->data, image, bytes);
+    bank->size = bytes;
+    bank->cycle = cycle;
+    bank->time_ns = realtime_ns();
+    
+    atomic_store_explicit(&bank->tag, ++rt->stores, memory_order_release);
+}
@@ -0,0 +1,96 @@
+#include "rmw.h"
+#include <string.h>
+
+void rmw_init(rmw_queue_t *rmw) {
+    if (!rmw) return;
+    
+    memset(rmw, 0, sizeof(rmw_queue_t));
+}
+
+int rmw_submit(rmw_queue_t *rmw, const rmw_op_t *op, uint64_t *seq) {
+    return rmw_submit_batch(rmw, op, 1, seq);
+}
+
+// The batch is published with one head update, so the RT thread applies all
+// of it in the same cycle or none of it yet
+int rmw_submit_batch(rmw_queue_t *rmw, const rmw_op_t *ops, uint32_t count, uint64_t *first_seq) {
+    if (!rmw || !ops || count == 0 || count > RMW_QUEUE_SIZE) return -1;
+    
+    for (uint32_t i = 0; i < count; i++) {
+        if (ops[i].size == 0 || ops[i].size > 4 || ops[i].kind > RMW_COMPARE_SWAP) return -1;
+    }
+    
+    uint64_t head = atomic_load_explicit(&rmw->head, memory_order_relaxed);
+    uint64_t done = atomic_load_explicit(&rmw->done, memory_order_acquire);
+    
+    if (head + count - done > RMW_QUEUE_SIZE) return -1;
+    
+    for (uint32_t i = 0; i < count; i++) {
+        rmw->queue[(head + i) % RMW_QUEUE_SIZE] = ops[i];
+    }
+    atomic_store_explicit(&rmw->head, head + count, memory_order_release);
+    
+    if (first_seq) *first_seq = head;
+    return 0;
+}
+
+// Does not wait: returns -1 while the RT thread has not reached `seq` yet
+int rmw_result(rmw_queue_t *rmw, uint64_t seq, rmw_op_t *result) {
+    if (!rmw || !result) return -1;
+    
+    if (atomic_load_explicit(&rmw->done, memory_order_acquire) <= seq) return -1;
+    
+    // Only the producer reuses the slot, and the network thread only submits
+    // while every deferred reply is within one queue length of the head
+    *result = rmw->queue[seq % RMW_QUEUE_SIZE];
+    return 0;
+}
+
+static void apply_one(rmw_op_t *op, uint8_t *image, uint32_t size) {
+    uint32_t pre = 0;
+    
+    op->applied = false;
+    if (!image || op->offset > size || op->size > size - op->offset) return;
+    
+    memcpy(&pre, image + op->offset, op->size);
+    
+    uint32_t next;
+    switch (op->kind) {
+        case RMW_SET_BITS:
+            next = pre | op->mask;
+            break;
+        case RMW_CLEAR_BITS:
+            next = pre & ~op->mask;
+            break;
+        case RMW_TOGGLE_BITS:
+            next = pre ^ op->mask;
+            break;
+        case RMW_MASKED_WRITE:
+            next = (pre & ~op->mask) | (op->value & op->mask);
+            break;
+        case RMW_COMPARE_SWAP:
+            next = (pre == op->mask) ? op->value : pre;
+            break;
+        default:
+            return;
+    }
+    
+    memcpy(image + op->offset, &next, op->size);
+    op->pre = pre;
+    op->applied = true;
+}
+
+// Runs every RT cycle before the output image is sent. Without an image
+// (network down) queued operations fail instead of landing on a later one
+void rmw_apply(rmw_queue_t *rmw, uint8_t *image, uint32_t size) {
+    uint64_t seq = atomic_load_explicit(&rmw->done, memory_order_relaxed);
+    uint64_t head = atomic_load_explicit(&rmw->head, memory_order_acquire);
+    
+    if (seq == head) return;
+    
+    for (; seq < head; seq++) {
+        apply_one(&rmw->queue[seq % RMW_QUEUE_SIZE], image, size);
+    }
+    
+    atomic_store_explicit(&rmw->done, head, memory_order_release);
+}
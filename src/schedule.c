@@ -0,0 +1,201 @@
+#include "schedule.h"
+#include <string.h>
+#include <time.h>
+
+void schedule_init(schedule_t *sched, uint32_t cycle_time_us) {
+    if (!sched) return;
+    
+    memset(sched, 0, sizeof(schedule_t));
+    atomic_init(&sched->cycle_ns, (cycle_time_us ? cycle_time_us : 1000) * 1000U);
+    
+    for (int32_t i = 0; i < SCHEDULE_MAX_PENDING; i++) {
+        sched->pool[i].next = (i + 1 < SCHEDULE_MAX_PENDING) ? i + 1 : -1;
+    }
+    sched->free_list = 0;
+    
+    for (int i = 0; i < SCHEDULE_WHEEL_SLOTS; i++) {
+        sched->slot_head[i] = -1;
+        sched->slot_tail[i] = -1;
+    }
+}
+
+// Odd while the RT thread is updating the pair
+void schedule_now(const schedule_t *sched, uint64_t *next_cycle, uint64_t *cycle_start_ns) {
+    uint32_t seq;
+    uint64_t cycle;
+    uint64_t start;
+    
+    do {
+        seq = atomic_load_explicit(&sched->seqlock, memory_order_acquire);
+        cycle = sched->next_cycle;
+        start = sched->cycle_start_ns;
+        atomic_thread_fence(memory_order_acquire);
+    } while ((seq & 1) || seq != atomic_load_explicit(&sched->seqlock, memory_order_relaxed));
+    
+    if (next_cycle) *next_cycle = cycle;
+    if (cycle_start_ns) *cycle_start_ns = start;
+}
+
+// The first cycle starting at or after a CLOCK_REALTIME timestamp, judged
+// from the start of the last cycle, so it is exact to within cycle jitter
+uint64_t schedule_cycle_at(const schedule_t *sched, uint64_t realtime_ns) {
+    uint64_t next;
+    uint64_t start;
+    
+    schedule_now(sched, &next, &start);
+    if (next == 0 || realtime_ns <= start) return next ? next - 1 : 0;
+    
+    uint64_t cycle_ns = atomic_load_explicit(&sched->cycle_ns, memory_order_relaxed);
+    return next - 1 + (realtime_ns - start + cycle_ns - 1) / cycle_ns;
+}
+
+int schedule_submit(schedule_t *sched, const schedule_write_t *write, uint32_t *seq) {
+    if (!sched || !write || write->size == 0 || write->size > 4) return -1;
+    
+    uint64_t head = atomic_load_explicit(&sched->head, memory_order_relaxed);
+    uint64_t done = atomic_load_explicit(&sched->done, memory_order_acquire);
+    
+    if (head - done >= SCHEDULE_QUEUE_SIZE) return -1;
+    
+    schedule_write_t *slot = &sched->queue[head % SCHEDULE_QUEUE_SIZE];
+    *slot = *write;
+    slot->seq = (uint32_t)head + 1;
+    atomic_store_explicit(&sched->head, head + 1, memory_order_release);
+    
+    if (seq) *seq = slot->seq;
+    return 0;
+}
+
+void schedule_get_stats(const schedule_t *sched, schedule_stats_t *stats) {
+    if (!sched || !stats) return;
+    
+    memset(stats, 0, sizeof(schedule_stats_t));
+    schedule_now(sched, &stats->next_cycle, NULL);
+    stats->pending = atomic_load_explicit(&sched->pending, memory_order_relaxed);
+    stats->applied = atomic_load_explicit(&sched->applied, memory_order_relaxed);
+    stats->late = atomic_load_explicit(&sched->late, memory_order_relaxed);
+    stats->overflow = atomic_load_explicit(&sched->overflow, memory_order_relaxed);
+    stats->dropped = atomic_load_explicit(&sched->dropped, memory_order_relaxed);
+    stats->last_rejected = atomic_load_explicit(&sched->last_rejected, memory_order_relaxed);
+}
+
+static void reject(schedule_t *sched, atomic_uint *counter, uint32_t seq) {
+    atomic_fetch_add_explicit(counter, 1, memory_order_relaxed);
+    atomic_store_explicit(&sched->last_rejected, seq, memory_order_relaxed);
+}
+
+// Move handed-over writes into the wheel, keeping arrival order per slot
+static void file_writes(schedule_t *sched, uint64_t cycle) {
+    uint64_t seq = atomic_load_explicit(&sched->done, memory_order_relaxed);
+    uint64_t head = atomic_load_explicit(&sched->head, memory_order_acquire);
+    uint32_t filed = 0;
+    
+    for (; seq < head; seq++) {
+        const schedule_write_t *write = &sched->queue[seq % SCHEDULE_QUEUE_SIZE];
+        uint64_t target = write->cycle;
+        
+        if (target < cycle) {
+            if (!(write->flags & SCHEDULE_FLAG_CLAMP)) {
+                reject(sched, &sched->late, write->seq);
+                continue;
+            }
+            target = cycle;
+        }
+        
+        if (target - cycle >= SCHEDULE_WHEEL_SLOTS || sched->free_list < 0) {
+            reject(sched, &sched->overflow, write->seq);
+            continue;
+        }
+        
+        int32_t index = sched->free_list;
+        schedule_write_t *entry = &sched->pool[index];
+        sched->free_list = entry->next;
+        *entry = *write;
+        entry->cycle = target;
+        entry->next = -1;
+        
+        uint32_t slot = (uint32_t)(target % SCHEDULE_WHEEL_SLOTS);
+        if (sched->slot_tail[slot] < 0) {
+            sched->slot_head[slot] = index;
+        } else {
+            sched->pool[sched->slot_tail[slot]].next = index;
+        }
+        sched->slot_tail[slot] = index;
+        filed++;
+    }
+    
+    atomic_store_explicit(&sched->done, head, memory_order_release);
+    if (filed) atomic_fetch_add_explicit(&sched->pending, filed, memory_order_relaxed);
+}
+
+// Empty one slot, writing its entries to the image when there is one
+static uint32_t flush_slot(schedule_t *sched, uint32_t slot, uint8_t *image, uint32_t size) {
+    uint32_t count = 0;
+    int32_t index = sched->slot_head[slot];
+    
+    while (index >= 0) {
+        schedule_write_t *entry = &sched->pool[index];
+        int32_t next = entry->next;
+        
+        if (image && entry->offset <= size && entry->size <= size - entry->offset) {
+            memcpy(image + entry->offset, &entry->value, entry->size);
+            atomic_fetch_add_explicit(&sched->applied, 1, memory_order_relaxed);
+        } else {
+            reject(sched, &sched->dropped, entry->seq);
+        }
+        
+        entry->next = sched->free_list;
+        sched->free_list = index;
+        index = next;
+        count++;
+    }
+    
+    sched->slot_head[slot] = -1;
+    sched->slot_tail[slot] = -1;
+    return count;
+}
+
+static void publish(schedule_t *sched, uint64_t next_cycle) {
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    
+    uint32_t seq = atomic_load_explicit(&sched->seqlock, memory_order_relaxed);
+    atomic_store_explicit(&sched->seqlock, seq + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    sched->next_cycle = next_cycle;
+    sched->cycle_start_ns = (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+    atomic_store_explicit(&sched->seqlock, seq + 2, memory_order_release);
+}
+
+// Runs every RT cycle before the output image is sent. Without an image
+// (network down) every queued and pending write is dropped, so nothing lands
+// on the image of a later start
+void schedule_run(schedule_t *sched, uint8_t *image, uint32_t size, uint64_t cycle) {
+    if (!image) {
+        uint64_t head = atomic_load_explicit(&sched->head, memory_order_acquire);
+        uint64_t seq = atomic_load_explicit(&sched->done, memory_order_relaxed);
+        for (; seq < head; seq++) {
+            reject(sched, &sched->dropped, sched->queue[seq % SCHEDULE_QUEUE_SIZE].seq);
+        }
+        atomic_store_explicit(&sched->done, head, memory_order_release);
+        
+        if (atomic_load_explicit(&sched->pending, memory_order_relaxed) > 0) {
+            for (uint32_t slot = 0; slot < SCHEDULE_WHEEL_SLOTS; slot++) {
+                flush_slot(sched, slot, NULL, 0);
+            }
+            atomic_store_explicit(&sched->pending, 0, memory_order_relaxed);
+        }
+        publish(sched, cycle);
+        return;
+    }
+    
+    file_writes(sched, cycle);
+    
+    uint32_t slot = (uint32_t)(cycle % SCHEDULE_WHEEL_SLOTS);
+    if (sched->slot_head[slot] >= 0) {
+        uint32_t count = flush_slot(sched, slot, image, size);
+        atomic_fetch_sub_explicit(&sched->pending, count, memory_order_relaxed);
+    }
+    
+    publish(sched, cycle + 1);
+}
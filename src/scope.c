@@ -0,0 +1,332 @@
+#include "scope.h"
+#include "logging.h"
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+void scope_init(scope_set_t *set) {
+    if (!set) return;
+    
+    memset(set, 0, sizeof(scope_set_t));
+    for (int i = 0; i < SCOPE_MAX; i++) {
+        atomic_init(&set->scopes[i].state, SCOPE_FREE);
+        atomic_init(&set->scopes[i].stop_request, false);
+    }
+}
+
+void scope_cleanup(scope_set_t *set) {
+    if (!set) return;
+    
+    for (int i = 0; i < SCOPE_MAX; i++) {
+        free(set->scopes[i].data);
+        set->scopes[i].data = NULL;
+        set->scopes[i].release = false;
+        atomic_store(&set->scopes[i].state, SCOPE_FREE);
+    }
+}
+
+static bool same_owner(const scope_t *scope, const struct sockaddr_in *owner) {
+    return scope->owner.sin_addr.s_addr == owner->sin_addr.s_addr &&
+           scope->owner.sin_port == owner->sin_port;
+}
+
+int scope_create(scope_set_t *set, const struct sockaddr_in *owner, uint32_t samples,
+                 uint32_t pretrigger, uint32_t decimation) {
+    if (!set || !owner) return -1;
+    
+    if (samples == 0 || samples > SCOPE_MAX_SAMPLES || pretrigger >= samples) return -1;
+    
+    for (int i = 0; i < SCOPE_MAX; i++) {
+        scope_t *scope = &set->scopes[i];
+        if (atomic_load(&scope->state) != SCOPE_FREE) continue;
+        
+        // Every column is allocated and touched up front so the RT thread
+        // never takes a page fault while sampling
+        uint32_t *data = calloc((size_t)SCOPE_MAX_CHANNELS * samples, sizeof(uint32_t));
+        if (!data) {
+            LOG_ERROR("Failed to allocate scope buffers (%u samples)", samples);
+            return -1;
+        }
+        memset(data, 0, (size_t)SCOPE_MAX_CHANNELS * samples * sizeof(uint32_t));
+        
+        scope->owner = *owner;
+        scope->samples = samples;
+        scope->pretrigger = pretrigger;
+        scope->decimation = decimation ? decimation : 1;
+        scope->channel_count = 0;
+        scope->trigger_kind = SCOPE_TRIGGER_IMMEDIATE;
+        scope->data = data;
+        scope->count = 0;
+        scope->release = false;
+        atomic_store(&scope->stop_request, false);
+        atomic_store_explicit(&scope->state, SCOPE_IDLE, memory_order_release);
+        return i;
+    }
+    
+    return -1;
+}
+
+scope_t* scope_get(scope_set_t *set, uint32_t id, const struct sockaddr_in *owner) {
+    if (!set || !owner || id >= SCOPE_MAX) return NULL;
+    
+    scope_t *scope = &set->scopes[id];
+    if (atomic_load(&scope->state) == SCOPE_FREE || scope->release || !same_owner(scope, owner)) {
+        return NULL;
+    }
+    return scope;
+}
+
+// Configuration is only changed while the RT thread does not own the scope
+static bool configurable(const scope_t *scope) {
+    int state = atomic_load_explicit(&scope->state, memory_order_acquire);
+    return state == SCOPE_IDLE || state == SCOPE_DONE;
+}
+
+int scope_add_channel(scope_t *scope, const scope_field_t *field) {
+    if (!scope || !field || !configurable(scope)) return -1;
+    
+    if (scope->channel_count == SCOPE_MAX_CHANNELS || field->type >= SIGNAL_TYPE_COUNT ||
+        field->bit > 7) {
+        return -1;
+    }
+    
+    scope->channels[scope->channel_count] = *field;
+    atomic_store(&scope->state, SCOPE_IDLE);
+    return (int)scope->channel_count++;
+}
+
+int scope_set_trigger(scope_t *scope, const scope_field_t *field, uint8_t kind, double threshold) {
+    if (!scope || !field || !configurable(scope)) return -1;
+    
+    if (kind > EVENT_EQUALS || field->type >= SIGNAL_TYPE_COUNT || field->bit > 7) return -1;
+    
+    scope->trigger = *field;
+    scope->trigger_kind = kind;
+    scope->threshold = threshold;
+    atomic_store(&scope->state, SCOPE_IDLE);
+    return 0;
+}
+
+static int resolve(const scope_field_t *field, uint32_t image_size, const uint32_t *slave_base,
+                   uint32_t slave_count, uint32_t *offset) {
+    uint32_t base = 0;
+    
+    if (field->slave > 0) {
+        if (field->slave > slave_count || !slave_base) return -1;
+        base = slave_base[field->slave - 1];
+    }
+    
+    *offset = base + field->offset;
+    return (*offset + signals_type_size(field->type) <= image_size) ? 0 : -1;
+}
+
+int scope_arm(scope_t *scope, uint32_t image_size, const uint32_t *slave_base,
+              uint32_t slave_count) {
+    if (!scope || !configurable(scope) || scope->channel_count == 0) return -1;
+    
+    uint32_t min_size = 0;
+    
+    for (uint32_t ch = 0; ch < scope->channel_count; ch++) {
+        const scope_field_t *field = &scope->channels[ch];
+        if (resolve(field, image_size, slave_base, slave_count, &scope->channel_offset[ch]) < 0) {
+            return -1;
+        }
+        uint32_t end = scope->channel_offset[ch] + signals_type_size(field->type);
+        if (end > min_size) min_size = end;
+    }
+    
+    if (scope->trigger_kind != SCOPE_TRIGGER_IMMEDIATE) {
+        if (resolve(&scope->trigger, image_size, slave_base, slave_count,
+                    &scope->trigger_offset) < 0) {
+            return -1;
+        }
+        uint32_t end = scope->trigger_offset + signals_type_size(scope->trigger.type);
+        if (end > min_size) min_size = end;
+    }
+    
+    scope->min_image_size = min_size;
+    scope->write_pos = 0;
+    scope->filled = 0;
+    scope->post_remaining = 0;
+    scope->countdown = 1;
+    scope->trigger_primed = false;
+    scope->trigger_cycle = 0;
+    scope->trigger_time_ns = 0;
+    scope->start = 0;
+    scope->count = 0;
+    scope->pre = 0;
+    
+    atomic_store(&scope->stop_request, false);
+    atomic_store_explicit(&scope->state, SCOPE_ARMED, memory_order_release);
+    return 0;
+}
+
+static bool running(const scope_t *scope) {
+    int state = atomic_load_explicit(&scope->state, memory_order_acquire);
+    return state == SCOPE_ARMED || state == SCOPE_TRIGGERED;
+}
+
+// Ask the RT thread to hand a running scope back. It answers on its next
+// cycle, so the scope may still be running when this returns
+void scope_stop(scope_t *scope) {
+    if (!scope || !running(scope)) return;
+    
+    atomic_store_explicit(&scope->stop_request, true, memory_order_release);
+}
+
+static void release(scope_t *scope) {
+    free(scope->data);
+    scope->data = NULL;
+    scope->release = false;
+    atomic_store_explicit(&scope->state, SCOPE_FREE, memory_order_release);
+}
+
+// A running scope is only marked; scope_reclaim frees it after the RT thread
+// has stopped it, so its buffers are never freed under scope_run
+void scope_destroy(scope_t *scope) {
+    if (!scope) return;
+    
+    scope_stop(scope);
+    if (running(scope)) {
+        scope->release = true;
+    } else {
+        release(scope);
+    }
+}
+
+uint32_t scope_destroy_client(scope_set_t *set, const struct sockaddr_in *owner) {
+    if (!set || !owner) return 0;
+    
+    uint32_t destroyed = 0;
+    
+    for (int i = 0; i < SCOPE_MAX; i++) {
+        scope_t *scope = &set->scopes[i];
+        if (atomic_load(&scope->state) != SCOPE_FREE && !scope->release &&
+            same_owner(scope, owner)) {
+            scope_destroy(scope);
+            destroyed++;
+        }
+    }
+    
+    return destroyed;
+}
+
+// Called from the network loop to free deleted scopes the RT thread has
+// handed back
+void scope_reclaim(scope_set_t *set) {
+    if (!set) return;
+    
+    for (int i = 0; i < SCOPE_MAX; i++) {
+        scope_t *scope = &set->scopes[i];
+        if (scope->release && !running(scope)) release(scope);
+    }
+}
+
+uint32_t scope_read(const scope_t *scope, uint32_t channel, uint32_t first, uint32_t *out,
+                    uint32_t max) {
+    if (!scope || !out || channel >= scope->channel_count) return 0;
+    
+    if (atomic_load_explicit(&scope->state, memory_order_acquire) != SCOPE_DONE) return 0;
+    
+    const uint32_t *column = scope->data + (size_t)channel * scope->samples;
+    uint32_t n = 0;
+    
+    while (n < max && first + n < scope->count) {
+        out[n] = column[(scope->start + first + n) % scope->samples];
+        n++;
+    }
+    
+    return n;
+}
+
+static bool trigger_fired(scope_t *scope, const uint8_t *image) {
+    if (scope->trigger_kind == SCOPE_TRIGGER_IMMEDIATE) return true;
+    
+    const scope_field_t *field = &scope->trigger;
+    double value = signals_raw_value(field->type,
+                                     signals_read_raw(image + scope->trigger_offset,
+                                                      field->type, field->bit));
+    double last = scope->trigger_last;
+    double threshold = scope->threshold;
+    
+    scope->trigger_last = value;
+    if (!scope->trigger_primed) {
+        scope->trigger_primed = true;
+        return false;
+    }
+    
+    switch (scope->trigger_kind) {
+        case EVENT_RISING:
+            return last == 0.0 && value != 0.0;
+        case EVENT_FALLING:
+            return last != 0.0 && value == 0.0;
+        case EVENT_CHANGE:
+            return value != last;
+        case EVENT_ABOVE:
+            return last <= threshold && value > threshold;
+        case EVENT_BELOW:
+            return last >= threshold && value < threshold;
+        case EVENT_EQUALS:
+            return last != threshold && value == threshold;
+        default:
+            return false;
+    }
+}
+
+static void record_sample(scope_t *scope, const uint8_t *image) {
+    uint32_t pos = scope->write_pos;
+    
+    for (uint32_t ch = 0; ch < scope->channel_count; ch++) {
+        const scope_field_t *field = &scope->channels[ch];
+        scope->data[(size_t)ch * scope->samples + pos] =
+            signals_read_raw(image + scope->channel_offset[ch], field->type, field->bit);
+    }
+    
+    scope->write_pos = (pos + 1 == scope->samples) ? 0 : pos + 1;
+    if (scope->filled < scope->samples) scope->filled++;
+}
+
+// Runs every RT cycle, also while the network is down so stop requests are
+// answered. Each scope costs at most one trigger check and one read per
+// channel, so the per-cycle cost is bounded by SCOPE_MAX * SCOPE_MAX_CHANNELS
+void scope_run(scope_set_t *set, const uint8_t *image, uint32_t size, uint64_t cycle) {
+    for (int i = 0; i < SCOPE_MAX; i++) {
+        scope_t *scope = &set->scopes[i];
+        int state = atomic_load_explicit(&scope->state, memory_order_acquire);
+        
+        if (state != SCOPE_ARMED && state != SCOPE_TRIGGERED) continue;
+        
+        if (atomic_load_explicit(&scope->stop_request, memory_order_acquire)) {
+            atomic_store_explicit(&scope->state, SCOPE_IDLE, memory_order_release);
+            continue;
+        }
+        
+        if (!image || size < scope->min_image_size) continue;
+        
+        if (state == SCOPE_ARMED && trigger_fired(scope, image)) {
+            struct timespec now;
+            clock_gettime(CLOCK_REALTIME, &now);
+            
+            // The trigger cycle is always sampled and opens the post-trigger part
+            scope->pre = (scope->filled < scope->pretrigger) ? scope->filled : scope->pretrigger;
+            scope->post_remaining = scope->samples - scope->pretrigger;
+            scope->start = (scope->write_pos + scope->samples - scope->pre) % scope->samples;
+            scope->trigger_cycle = cycle;
+            scope->trigger_time_ns = (uint64_t)now.tv_sec * 1000000000ULL +
+                                     (uint64_t)now.tv_nsec;
+            scope->countdown = 1;
+            state = SCOPE_TRIGGERED;
+            atomic_store_explicit(&scope->state, SCOPE_TRIGGERED, memory_order_relaxed);
+        }
+        
+        if (--scope->countdown > 0) continue;
+        scope->countdown = scope->decimation;
+        
+        record_sample(scope, image);
+        
+        if (state == SCOPE_TRIGGERED && --scope->post_remaining == 0) {
+            scope->count = scope->pre + scope->samples - scope->pretrigger;
+            atomic_store_explicit(&scope->state, SCOPE_DONE, memory_order_release);
+        }
+    }
+}
@@ -8,7 +8,7 @@
 #include <sched.h>
 #include <errno.h>
 
-static void set_thread_priority(int priority) {
+void set_thread_priority(int priority) {
     struct sched_param param;
     param.sched_priority = priority;
     
@@ -19,7 +19,7 @@ static void set_thread_priority(int priority) {
     }
 }
 
-static void set_thread_affinity(const int *cpus, int count) {
+void set_thread_affinity(const int *cpus, int count) {
     if (!cpus || count <= 0) return;
     
     cpu_set_t cpuset;
@@ -38,10 +38,79 @@ static void set_thread_affinity(const int *cpus, int count) {
     }
 }
 
+void rt_advance_deadline(struct timespec *deadline, uint64_t cycle_ns) {
+    deadline->tv_sec += (time_t)(cycle_ns / 1000000000ULL);
+    deadline->tv_nsec += (long)(cycle_ns % 1000000000ULL);
+    if (deadline->tv_nsec >= 1000000000) {
+        deadline->tv_sec++;
+        deadline->tv_nsec -= 1000000000;
+    }
+}
+
+void rt_wait_until(const struct timespec *deadline) {
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, deadline, NULL) == EINTR) {
+    }
+}
+
+// Start of each slave's inputs within the input image, in slave order
+uint32_t service_slave_bases(service_context_t *ctx, uint32_t *base) {
+    ethercat_context_t *ec = &ctx->ec_ctx;
+    uint32_t offset = 0;
+    uint32_t count = (ec->slave_count < MAX_SLAVES) ? ec->slave_count : MAX_SLAVES;
+    
+    for (uint32_t i = 0; i < count; i++) {
+        base[i] = offset;
+        offset += ec->slaves[i].input_size;
+    }
+    
+    return count;
+}
+
+// The running configuration with live reloads applied. Only for the network
+// thread and the command handlers it runs, which hold a reader slot
+const config_t* service_config(service_context_t *ctx) {
+    const config_t *config = reload_current(&ctx->reload);
+    return config ? config : &ctx->config;
+}
+
+// Signal offsets are slave-relative; resolve them against the slave layout
+// whenever the input image is reallocated
+static void link_signals(service_context_t *ctx) {
+    static uint32_t slave_base[MAX_SLAVES];
+    uint32_t count = service_slave_bases(ctx, slave_base);
+    
+    signals_link(&ctx->signals, ctx->ec_ctx.pdo_input, ctx->ec_ctx.input_size, slave_base, count);
+}
+
+// Runs on the RT thread between two cycles, so a new cycle time starts with
+// the next deadline. Priority and affinity are not live: an RT thread that
+// moves itself mid-run can miss cycles on the way
+static void apply_live_config(service_context_t *ctx, const config_t *old, const config_t *config,
+                              uint64_t *cycle_ns) {
+    uint32_t cycle_time_us = config->network.cycle_time_us;
+    
+    if (cycle_time_us != old->network.cycle_time_us) {
+        *cycle_ns = cycle_time_us * 1000ULL;
+        atomic_store_explicit(&ctx->schedule.cycle_ns, cycle_time_us * 1000U,
+                              memory_order_relaxed);
+        atomic_store_explicit(&ctx->wirestamp.cycle_ns, cycle_time_us * 1000U,
+                              memory_order_relaxed);
+        LOG_INFO("Cycle time changed to %u us", cycle_time_us);
+    }
+    
+    if (config->signals.decimation != old->signals.decimation ||
+        config->signals.window_ms != old->signals.window_ms ||
+        cycle_time_us != old->network.cycle_time_us) {
+        signals_set_rate(&ctx->signals, config->signals.decimation, config->signals.window_ms,
+                         cycle_time_us);
+    }
+}
+
 void* rt_thread_func(void *arg) {
     service_context_t *ctx = (service_context_t*)arg;
     
     LOG_INFO("Real-time thread starting");
+    trace_register_thread("rt");
     
     if (ctx->config.performance.rt_priority > 0) {
         set_thread_priority(ctx->config.performance.rt_priority);
@@ -56,27 +125,119 @@ void* rt_thread_func(void *arg) {
     clock_gettime(CLOCK_MONOTONIC, &next_cycle);
     
     uint64_t cycle_ns = ctx->config.network.cycle_time_us * 1000ULL;
-    uint32_t cycle_count = 0;
+    uint64_t cycle_count = 0;
+    struct timespec last_start = {0, 0};
+    metrics_t *metrics = ctx->metrics.page;
+    const config_t *applied = reload_enter(&ctx->reload, RELOAD_READER_RT);
+    atomic_store_explicit(&ctx->ec_ctx.rt_running, true, memory_order_release);
     
     while (ctx->threads_running && !ctx->shutdown_requested) {
+        struct timespec cycle_start;
+        clock_gettime(CLOCK_MONOTONIC, &cycle_start);
+        
+        const config_t *config = reload_enter(&ctx->reload, RELOAD_READER_RT);
+        if (config != applied) {
+            apply_live_config(ctx, applied, config, &cycle_ns);
+            applied = config;
+        }
+        
+        rt_advance_deadline(&next_cycle, cycle_ns);
+        
         if (ctx->ec_ctx.network_active) {
+            // Writes due in this cycle and queued read-modify-writes go out
+            // with this cycle's frame
+            schedule_run(&ctx->schedule, ctx->ec_ctx.pdo_output, ctx->ec_ctx.output_size,
+                         cycle_count);
+            rmw_apply(&ctx->rmw, ctx->ec_ctx.pdo_output, ctx->ec_ctx.output_size);
+            retain_store(&ctx->retain, ctx->ec_ctx.pdo_output, ctx->ec_ctx.output_size, cycle_count);
+            
+            TRACE_BEGIN(TRACE_CYCLE);
             int result = ethercat_process_data(&ctx->ec_ctx);
+            TRACE_END(TRACE_CYCLE);
             if (result != 0) {
                 LOG_DEBUG("EtherCAT process data failed");
+            } else {
+                TRACE_BEGIN(TRACE_CHANGES);
+                changemap_update(&ctx->changes, ctx->ec_ctx.pdo_input, ctx->ec_ctx.input_size);
+                TRACE_END(TRACE_CHANGES);
+                snapshot_publish(&ctx->snapshots, ctx->ec_ctx.pdo_input, ctx->ec_ctx.input_size,
+                                 cycle_count, ctx->ec_ctx.dc_time, ctx->ec_ctx.last_wkc,
+                                 ctx->ec_ctx.expected_wkc);
+            }
+            
+            // Plugins see this cycle's inputs; their outputs leave with the next frame
+            if (ctx->plugins.count > 0) {
+                TRACE_BEGIN(TRACE_PLUGINS);
+                plugin_host_run(&ctx->plugins, ctx->ec_ctx.pdo_input, ctx->ec_ctx.input_size,
+                                ctx->ec_ctx.pdo_output, ctx->ec_ctx.output_size,
+                                ctx->ec_ctx.last_wkc, ctx->ec_ctx.expected_wkc);
+                TRACE_END(TRACE_PLUGINS);
+            }
+            
+            if (ctx->signals.count > 0 && result == 0) {
+                if (ctx->ec_ctx.pdo_input != ctx->signals.linked_image ||
+                    ctx->ec_ctx.input_size != ctx->signals.linked_size) {
+                    link_signals(ctx);
+                }
+                TRACE_BEGIN(TRACE_SIGNALS);
+                signals_evaluate(&ctx->signals, ctx->ec_ctx.pdo_input);
+                TRACE_END(TRACE_SIGNALS);
+            }
+            
+            if (result == 0) {
+                TRACE_BEGIN(TRACE_EVENTS);
+                // schedule_run published this cycle's wall-clock start
+                events_evaluate(&ctx->events, ctx->ec_ctx.pdo_input, ctx->ec_ctx.input_size,
+                                &ctx->changes, cycle_count, ctx->schedule.cycle_start_ns);
+                TRACE_END(TRACE_EVENTS);
+                
+                TRACE_BEGIN(TRACE_SCOPE);
+                scope_run(&ctx->scopes, ctx->ec_ctx.pdo_input, ctx->ec_ctx.input_size,
+                          cycle_count);
+                TRACE_END(TRACE_SCOPE);
             }
             cycle_count++;
+            
+            // A cycle is missed when its work runs past the next wakeup
+            struct timespec now;
+            clock_gettime(CLOCK_MONOTONIC, &now);
+            bool missed = (now.tv_sec > next_cycle.tv_sec ||
+                           (now.tv_sec == next_cycle.tv_sec && now.tv_nsec > next_cycle.tv_nsec));
+            capture_condition(&ctx->capture, CAPTURE_TRIGGER_MISSED, missed);
+            
+            atomic_fetch_add_explicit(&metrics->cycles_total, 1, memory_order_relaxed);
+            if (missed) {
+                atomic_fetch_add_explicit(&metrics->cycles_missed, 1, memory_order_relaxed);
+            }
+            if (ctx->ec_ctx.last_wkc != ctx->ec_ctx.expected_wkc) {
+                atomic_fetch_add_explicit(&metrics->wkc_errors, 1, memory_order_relaxed);
+            }
+            metrics_hist_record(&metrics->cycle_exec,
+                                (uint64_t)((now.tv_sec - cycle_start.tv_sec) * 1000000000LL +
+                                           (now.tv_nsec - cycle_start.tv_nsec)));
+            
+            if (last_start.tv_sec != 0) {
+                int64_t period_ns = (cycle_start.tv_sec - last_start.tv_sec) * 1000000000LL +
+                                    (cycle_start.tv_nsec - last_start.tv_nsec);
+                ethercat_record_cycle((uint32_t)(period_ns / 1000), missed);
+                metrics_hist_record(&metrics->cycle_period, (uint64_t)period_ns);
+            }
+            last_start = cycle_start;
+        } else {
+            last_start.tv_sec = 0;
+            ethercat_rt_idle(&ctx->ec_ctx);
+            rmw_apply(&ctx->rmw, NULL, 0);
+            wirestamp_idle(&ctx->wirestamp);
+            schedule_run(&ctx->schedule, NULL, 0, cycle_count);
+            scope_run(&ctx->scopes, NULL, 0, cycle_count);
         }
         
-        next_cycle.tv_nsec += cycle_ns;
-        if (next_cycle.tv_nsec >= 1000000000) {
-            next_cycle.tv_sec++;
-            next_cycle.tv_nsec -= 1000000000;
-        }
-        
-        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next_cycle, NULL);
+        rt_wait_until(&next_cycle);
     }
     
-    LOG_INFO("Real-time thread stopping (processed %u cycles)", cycle_count);
+    atomic_store_explicit(&ctx->ec_ctx.rt_running, false, memory_order_release);
+    LOG_INFO("Real-time thread stopping (processed %llu cycles)",
+             (unsigned long long)cycle_count);
     return NULL;
 }
 
@@ -84,17 +245,35 @@ void* mgmt_thread_func(void *arg) {
     service_context_t *ctx = (service_context_t*)arg;
     
     LOG_INFO("Management thread starting");
+    trace_register_thread("mgmt");
     
     uint32_t last_stats_log = time(NULL);
     
     while (ctx->threads_running && !ctx->shutdown_requested) {
-        sleep(10);
+        usleep(SUPERVISOR_POLL_MS * 1000);
+        
+        if (ctx->reload_requested) {
+            ctx->reload_requested = false;
+            LOG_INFO("Reloading configuration from %s", ctx->config_file);
+            reload_config(&ctx->reload, NULL);
+        }
+        reload_reclaim(&ctx->reload);
+        
+        TRACE_BEGIN(TRACE_SUPERVISOR);
+        pthread_mutex_lock(&ctx->ec_ctx.master_lock);
+        supervisor_poll(ctx);
+        pthread_mutex_unlock(&ctx->ec_ctx.master_lock);
+        TRACE_END(TRACE_SUPERVISOR);
+        
+        metrics_update_gauges(ctx);
+        signals_report_links(&ctx->signals);
         
         uint32_t now = time(NULL);
         if (now - last_stats_log > 60) {
-            LOG_INFO("Status: Network=%s, Slaves=%u, Clients=%u",
+            LOG_INFO("Status: Network=%s, Slaves=%u (%u down), Clients=%u",
                      ctx->ec_ctx.network_active ? "UP" : "DOWN",
                      ctx->ec_ctx.slave_count,
+                     ctx->supervisor.slaves_down,
                      ctx->client_count);
             last_stats_log = now;
         }
@@ -108,6 +287,7 @@ int service_init(service_context_t *ctx, const char *config_file) {
     if (!ctx) return -1;
     
     memset(ctx, 0, sizeof(service_context_t));
+    snprintf(ctx->config_file, sizeof(ctx->config_file), "%s", config_file ? config_file : "");
     
     if (config_load(&ctx->config, config_file) < 0) {
         LOG_ERROR("Failed to load configuration");
@@ -116,16 +296,84 @@ int service_init(service_context_t *ctx, const char *config_file) {
     
     config_print(&ctx->config);
     
+    if (trace_init(ctx->config.performance.trace_enabled) < 0) {
+        LOG_WARN("Cycle tracing unavailable");
+    }
+    
     if (ethercat_init(&ctx->ec_ctx, ctx->config.network.interface) < 0) {
         LOG_ERROR("Failed to initialize EtherCAT master");
         return -1;
     }
     
+    snprintf(ctx->ec_ctx.topology_cache, sizeof(ctx->ec_ctx.topology_cache), "%s",
+             ctx->config.network.topology_cache);
+    ctx->ec_ctx.transport = transport_parse_type(ctx->config.network.transport);
+    ctx->ec_ctx.busy_poll_us = ctx->config.network.busy_poll_us;
+    ctx->ec_ctx.sim_slaves = ctx->config.network.simulate_slaves;
+    ctx->ec_ctx.sim_slave_bytes = ctx->config.network.simulate_slave_bytes;
+    
     if (pthread_mutex_init(&ctx->client_lock, NULL) != 0) {
         LOG_ERROR("Failed to initialize client mutex");
         return -1;
     }
     
+    if (mailbox_init(&ctx->mailbox) < 0) {
+        LOG_ERROR("Failed to initialize mailbox queue");
+        return -1;
+    }
+    
+    supervisor_init(&ctx->supervisor);
+    hotplug_init(&ctx->hotplug);
+    
+    if (capture_init(&ctx->capture, &ctx->config.capture) < 0) {
+        LOG_WARN("Frame capture disabled");
+    }
+    ctx->ec_ctx.capture = &ctx->capture;
+    
+    wirestamp_init(&ctx->wirestamp, ctx->config.network.cycle_time_us);
+    ctx->ec_ctx.wirestamp = &ctx->wirestamp;
+    rmw_init(&ctx->rmw);
+    schedule_init(&ctx->schedule, ctx->config.network.cycle_time_us);
+    
+    if (snapshot_init(&ctx->snapshots) < 0) {
+        return -1;
+    }
+    
+    if (retain_init(&ctx->retain, ctx->config.network.output_shm,
+                    ctx->config.network.output_max_age_ms) < 0) {
+        LOG_WARN("Outputs will not survive a restart");
+    }
+    ctx->ec_ctx.retain = &ctx->retain;
+    
+    if (metrics_init(&ctx->metrics, ctx->config.metrics.shm_name) < 0) {
+        LOG_ERROR("Failed to initialize metrics");
+        return -1;
+    }
+    
+    if (plugin_host_init(&ctx->plugins, &ctx->config.plugins) < 0) {
+        LOG_ERROR("Failed to load cyclic logic plugins");
+        return -1;
+    }
+    
+    changemap_init(&ctx->changes);
+    events_init(&ctx->events);
+    scope_init(&ctx->scopes);
+    
+    if (signals_load(&ctx->signals, &ctx->config.signals, ctx->config.network.cycle_time_us) < 0) {
+        LOG_ERROR("Failed to compile signal table");
+        return -1;
+    }
+    
+    if (metrics_listen(&ctx->metrics, ctx->config.metrics.bind_address, ctx->config.metrics.port) < 0) {
+        LOG_WARN("Prometheus endpoint disabled");
+    }
+    
+    if (pthread_mutex_init(&ctx->ec_ctx.slave_table_lock, NULL) != 0 ||
+        pthread_mutex_init(&ctx->ec_ctx.master_lock, NULL) != 0) {
+        LOG_ERROR("Failed to initialize slave table mutex");
+        return -1;
+    }
+    
     ctx->pdo_buffer.mask = PDO_BUFFER_SIZE - 1;
     ctx->pdo_buffer.write_idx = 0;
     ctx->pdo_buffer.read_idx = 0;
@@ -141,6 +389,13 @@ int service_init(service_context_t *ctx, const char *config_file) {
 int service_start(service_context_t *ctx) {
     if (!ctx) return -1;
     
+    // Published here rather than in service_init so command-line overrides
+    // are part of the first version
+    if (reload_init(&ctx->reload, &ctx->config, ctx->config_file) < 0) {
+        LOG_ERROR("Failed to publish configuration");
+        return -1;
+    }
+    
     ctx->threads_running = true;
     
     if (pthread_create(&ctx->network_thread, NULL, network_thread_func, ctx) != 0) {
@@ -163,6 +418,51 @@ int service_start(service_context_t *ctx) {
         return -1;
     }
     
+    if (pthread_create(&ctx->mailbox_thread, NULL, mailbox_thread_func, ctx) != 0) {
+        LOG_ERROR("Failed to create mailbox thread");
+        ctx->threads_running = false;
+        pthread_join(ctx->network_thread, NULL);
+        pthread_join(ctx->rt_thread, NULL);
+        pthread_join(ctx->mgmt_thread, NULL);
+        return -1;
+    }
+    
+    if (pthread_create(&ctx->hotplug_thread, NULL, hotplug_thread_func, ctx) != 0) {
+        LOG_ERROR("Failed to create hot-plug scanner thread");
+        ctx->threads_running = false;
+        mailbox_wake(&ctx->mailbox);
+        pthread_join(ctx->network_thread, NULL);
+        pthread_join(ctx->rt_thread, NULL);
+        pthread_join(ctx->mgmt_thread, NULL);
+        pthread_join(ctx->mailbox_thread, NULL);
+        return -1;
+    }
+    
+    if (pthread_create(&ctx->capture_thread, NULL, capture_thread_func, ctx) != 0) {
+        LOG_ERROR("Failed to create capture writer thread");
+        ctx->threads_running = false;
+        mailbox_wake(&ctx->mailbox);
+        pthread_join(ctx->network_thread, NULL);
+        pthread_join(ctx->rt_thread, NULL);
+        pthread_join(ctx->mgmt_thread, NULL);
+        pthread_join(ctx->mailbox_thread, NULL);
+        pthread_join(ctx->hotplug_thread, NULL);
+        return -1;
+    }
+    
+    if (pthread_create(&ctx->metrics_thread, NULL, metrics_thread_func, ctx) != 0) {
+        LOG_ERROR("Failed to create metrics thread");
+        ctx->threads_running = false;
+        mailbox_wake(&ctx->mailbox);
+        pthread_join(ctx->network_thread, NULL);
+        pthread_join(ctx->rt_thread, NULL);
+        pthread_join(ctx->mgmt_thread, NULL);
+        pthread_join(ctx->mailbox_thread, NULL);
+        pthread_join(ctx->hotplug_thread, NULL);
+        pthread_join(ctx->capture_thread, NULL);
+        return -1;
+    }
+    
     LOG_INFO("Service started - all threads running");
     return 0;
 }
@@ -187,6 +487,23 @@ void service_stop(service_context_t *ctx) {
         LOG_WARN("Failed to join management thread");
     }
     
+    mailbox_wake(&ctx->mailbox);
+    if (pthread_join(ctx->mailbox_thread, NULL) != 0) {
+        LOG_WARN("Failed to join mailbox thread");
+    }
+    
+    if (pthread_join(ctx->hotplug_thread, NULL) != 0) {
+        LOG_WARN("Failed to join hot-plug scanner thread");
+    }
+    
+    if (pthread_join(ctx->capture_thread, NULL) != 0) {
+        LOG_WARN("Failed to join capture writer thread");
+    }
+    
+    if (pthread_join(ctx->metrics_thread, NULL) != 0) {
+        LOG_WARN("Failed to join metrics thread");
+    }
+    
     LOG_INFO("All threads stopped");
 }
 
@@ -201,6 +518,19 @@ void service_cleanup(service_context_t *ctx) {
     }
     
     pthread_mutex_destroy(&ctx->client_lock);
+    mailbox_cleanup(&ctx->mailbox);
+    pthread_mutex_destroy(&ctx->ec_ctx.slave_table_lock);
+    pthread_mutex_destroy(&ctx->ec_ctx.master_lock);
+    capture_cleanup(&ctx->capture);
+    trace_cleanup();
+    metrics_cleanup(&ctx->metrics);
+    plugin_host_cleanup(&ctx->plugins);
+    signals_cleanup(&ctx->signals);
+    events_cleanup(&ctx->events);
+    scope_cleanup(&ctx->scopes);
+    snapshot_cleanup(&ctx->snapshots);
+    retain_cleanup(&ctx->retain);
+    reload_cleanup(&ctx->reload);
     
     LOG_INFO("Service cleaned up");
 }
@@ -0,0 +1,732 @@
+#include "signals.h"
+#include "logging.h"
+#include <string.h>
+#include <strings.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+#include <math.h>
+#include <yaml.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define SIGNALS_X86 1
+#endif
+
+static const struct {
+    const char *name;
+    uint8_t size;
+} signal_types[SIGNAL_TYPE_COUNT] = {
+    { "bool", 1 }, { "uint8", 1 }, { "int8", 1 }, { "uint16", 2 },
+    { "int16", 2 }, { "uint32", 4 }, { "int32", 4 }, { "float32", 4 }
+};
+
+// Unlinked or out-of-range signals read from here instead of the image
+static const uint8_t signal_zero[4] = {0};
+
+const char* signals_type_name(signal_type_t type) {
+    return (type < SIGNAL_TYPE_COUNT) ? signal_types[type].name : "unknown";
+}
+
+uint32_t signals_type_size(signal_type_t type) {
+    return (type < SIGNAL_TYPE_COUNT) ? signal_types[type].size : 0;
+}
+
+// A field as a 32-bit pattern: bit fields as 0/1, signed types sign-extended,
+// float32 as its IEEE-754 bits
+uint32_t signals_read_raw(const uint8_t *src, signal_type_t type, uint8_t bit) {
+    switch (type) {
+        case SIGNAL_BOOL:
+            return (*src >> bit) & 1;
+        case SIGNAL_UINT8:
+            return *src;
+        case SIGNAL_INT8:
+            return (uint32_t)(int32_t)(int8_t)*src;
+        case SIGNAL_UINT16: {
+            uint16_t v;
+            memcpy(&v, src, sizeof(v));
+            return v;
+        }
+        case SIGNAL_INT16: {
+            int16_t v;
+            memcpy(&v, src, sizeof(v));
+            return (uint32_t)(int32_t)v;
+        }
+        default: {
+            uint32_t v;
+            memcpy(&v, src, sizeof(v));
+            return v;
+        }
+    }
+}
+
+double signals_raw_value(signal_type_t type, uint32_t raw) {
+    switch (type) {
+        case SIGNAL_INT8:
+        case SIGNAL_INT16:
+        case SIGNAL_INT32:
+            return (double)(int32_t)raw;
+        case SIGNAL_FLOAT32: {
+            float value;
+            memcpy(&value, &raw, sizeof(value));
+            return (double)value;
+        }
+        default:
+            return (double)raw;
+    }
+}
+
+static int parse_type(const char *name, signal_type_t *type) {
+    for (int i = 0; i < SIGNAL_TYPE_COUNT; i++) {
+        if (strcasecmp(name, signal_types[i].name) == 0) {
+            *type = (signal_type_t)i;
+            return 0;
+        }
+    }
+    
+    if (strcasecmp(name, "float") == 0) {
+        *type = SIGNAL_FLOAT32;
+        return 0;
+    }
+    return -1;
+}
+
+static void default_def(signal_def_t *def) {
+    memset(def, 0, sizeof(signal_def_t));
+    def->type = SIGNAL_UINT16;
+    def->scale = 1.0f;
+    def->filter = 1.0f;
+}
+
+static int set_field(signal_def_t *def, const char *key, const char *value) {
+    if (strcmp(key, "name") == 0) {
+        snprintf(def->name, sizeof(def->name), "%s", value);
+    } else if (strcmp(key, "slave") == 0) {
+        def->slave = (uint16_t)atoi(value);
+    } else if (strcmp(key, "offset") == 0) {
+        def->offset = (uint32_t)strtoul(value, NULL, 0);
+    } else if (strcmp(key, "bit") == 0) {
+        def->bit = (uint8_t)(atoi(value) & 7);
+    } else if (strcmp(key, "type") == 0) {
+        return parse_type(value, &def->type);
+    } else if (strcmp(key, "scale") == 0) {
+        def->scale = strtof(value, NULL);
+    } else if (strcmp(key, "eu_offset") == 0) {
+        def->eu_offset = strtof(value, NULL);
+    } else if (strcmp(key, "filter") == 0) {
+        def->filter = strtof(value, NULL);
+    } else if (strcmp(key, "deadband") == 0) {
+        def->deadband = strtof(value, NULL);
+    } else {
+        return -1;
+    }
+    return 0;
+}
+
+static int parse_signal_file(const char *filename, signal_def_t **defs_out, uint32_t *count_out) {
+    FILE *file = fopen(filename, "r");
+    if (!file) {
+        LOG_ERROR("Cannot open signal file %s", filename);
+        return -1;
+    }
+    
+    yaml_parser_t parser;
+    if (!yaml_parser_initialize(&parser)) {
+        LOG_ERROR("Failed to initialize YAML parser");
+        fclose(file);
+        return -1;
+    }
+    yaml_parser_set_input_file(&parser, file);
+    
+    signal_def_t *defs = NULL;
+    uint32_t count = 0;
+    uint32_t capacity = 0;
+    signal_def_t current;
+    char key[32] = {0};
+    bool in_sequence = false;
+    bool in_signal = false;
+    bool done = false;
+    int result = 0;
+    
+    while (!done && result == 0) {
+        yaml_event_t event;
+        if (!yaml_parser_parse(&parser, &event)) {
+            LOG_ERROR("Signal file %s: YAML error at line %zu", filename,
+                      parser.problem_mark.line + 1);
+            result = -1;
+            break;
+        }
+        
+        switch (event.type) {
+            case YAML_SEQUENCE_START_EVENT:
+                in_sequence = true;
+                break;
+            
+            case YAML_SEQUENCE_END_EVENT:
+                in_sequence = false;
+                break;
+            
+            case YAML_MAPPING_START_EVENT:
+                if (in_sequence) {
+                    default_def(&current);
+                    in_signal = true;
+                    key[0] = '\0';
+                }
+                break;
+            
+            case YAML_MAPPING_END_EVENT:
+                if (!in_signal) break;
+                in_signal = false;
+                
+                if (count == SIGNAL_MAX) {
+                    LOG_ERROR("Signal file %s: more than %d signals", filename, SIGNAL_MAX);
+                    result = -1;
+                    break;
+                }
+                if (count == capacity) {
+                    capacity = capacity ? capacity * 2 : 256;
+                    signal_def_t *grown = realloc(defs, capacity * sizeof(signal_def_t));
+                    if (!grown) {
+                        result = -1;
+                        break;
+                    }
+                    defs = grown;
+                }
+                if (current.name[0] == '\0') {
+                    snprintf(current.name, sizeof(current.name), "sig%u", count);
+                }
+                defs[count++] = current;
+                break;
+            
+            case YAML_SCALAR_EVENT:
+                if (!in_signal) break;
+                
+                if (key[0] == '\0') {
+                    snprintf(key, sizeof(key), "%s", (const char*)event.data.scalar.value);
+                } else {
+                    if (set_field(&current, key, (const char*)event.data.scalar.value) < 0) {
+                        LOG_ERROR("Signal file %s: invalid %s '%s' at line %zu", filename, key,
+                                  (const char*)event.data.scalar.value, event.start_mark.line + 1);
+                        result = -1;
+                    }
+                    key[0] = '\0';
+                }
+                break;
+            
+            case YAML_STREAM_END_EVENT:
+                done = true;
+                break;
+            
+            default:
+                break;
+        }
+        
+        yaml_event_delete(&event);
+    }
+    
+    yaml_parser_delete(&parser);
+    fclose(file);
+    
+    if (result < 0) {
+        free(defs);
+        return -1;
+    }
+    
+    *defs_out = defs;
+    *count_out = count;
+    return 0;
+}
+
+static void* alloc_touched(size_t size) {
+    void *ptr = malloc(size ? size : 1);
+    if (ptr) memset(ptr, 0, size ? size : 1);
+    return ptr;
+}
+
+int signals_compile(signal_program_t *prog, const signal_def_t *defs, uint32_t count,
+                    uint32_t decimation) {
+    if (!prog || (count > 0 && !defs) || count > SIGNAL_MAX) return -1;
+    
+    memset(prog, 0, sizeof(signal_program_t));
+    prog->count = count;
+    prog->decimation = decimation ? decimation : 1;
+    prog->countdown = 1;
+    
+#ifdef SIGNALS_X86
+    __builtin_cpu_init();
+    prog->avx2 = __builtin_cpu_supports("avx2");
+#endif
+    
+    // Every array is touched here so the RT thread never takes a page fault
+    prog->defs = alloc_touched(count * sizeof(signal_def_t));
+    prog->src = alloc_touched(count * sizeof(const uint8_t*));
+    prog->bit = alloc_touched(count * sizeof(uint8_t));
+    prog->scale = alloc_touched(count * sizeof(float));
+    prog->eu_offset = alloc_touched(count * sizeof(float));
+    prog->alpha = alloc_touched(count * sizeof(float));
+    prog->deadband = alloc_touched(count * sizeof(float));
+    prog->raw = alloc_touched(count * sizeof(float));
+    prog->filtered = alloc_touched(count * sizeof(float));
+    prog->value = alloc_touched(count * sizeof(float));
+    prog->slot = alloc_touched(count * sizeof(uint32_t));
+    prog->valid = alloc_touched(count * sizeof(uint8_t));
+    
+    if (!prog->defs || !prog->src || !prog->bit || !prog->scale || !prog->eu_offset ||
+        !prog->alpha || !prog->deadband || !prog->raw || !prog->filtered || !prog->value ||
+        !prog->slot || !prog->valid) {
+        LOG_ERROR("Failed to allocate signal program (%u signals)", count);
+        signals_cleanup(prog);
+        return -1;
+    }
+    
+    if (count > 0) memcpy(prog->defs, defs, count * sizeof(signal_def_t));
+    
+    // Stable counting sort by type: each type becomes one contiguous run
+    uint32_t per_type[SIGNAL_TYPE_COUNT] = {0};
+    for (uint32_t i = 0; i < count; i++) {
+        per_type[defs[i].type]++;
+    }
+    for (int t = 0; t < SIGNAL_TYPE_COUNT; t++) {
+        prog->run_start[t + 1] = prog->run_start[t] + per_type[t];
+    }
+    
+    uint32_t next[SIGNAL_TYPE_COUNT];
+    memcpy(next, prog->run_start, sizeof(next));
+    
+    for (uint32_t i = 0; i < count; i++) {
+        const signal_def_t *def = &defs[i];
+        uint32_t pos = next[def->type]++;
+        
+        prog->slot[i] = pos;
+        prog->src[pos] = signal_zero;
+        prog->bit[pos] = def->bit;
+        prog->scale[pos] = def->scale;
+        prog->eu_offset[pos] = def->eu_offset;
+        prog->alpha[pos] = (def->filter > 0.0f && def->filter <= 1.0f) ? def->filter : 1.0f;
+        prog->deadband[pos] = (def->deadband > 0.0f) ? def->deadband : 0.0f;
+    }
+    
+    return 0;
+}
+
+static void reset_aggregates(signal_program_t *prog) {
+    for (uint32_t i = 0; i < prog->count; i++) {
+        prog->agg_min[i] = INFINITY;
+        prog->agg_max[i] = -INFINITY;
+        prog->agg_sum[i] = 0.0;
+        prog->agg_sumsq[i] = 0.0;
+    }
+    prog->window_left = prog->window_evals;
+}
+
+// Windows cover `window_evals` evaluations; the last `history` sealed windows
+// are kept. Called after signals_compile and before the RT thread starts
+int signals_enable_windows(signal_program_t *prog, uint32_t window_evals, uint32_t history) {
+    if (!prog || prog->count == 0 || window_evals == 0) return -1;
+    
+    if (history == 0) history = 1;
+    if (history > SIGNAL_WINDOW_MAX_HISTORY) history = SIGNAL_WINDOW_MAX_HISTORY;
+    
+    prog->agg_min = alloc_touched(prog->count * sizeof(float));
+    prog->agg_max = alloc_touched(prog->count * sizeof(float));
+    prog->agg_sum = alloc_touched(prog->count * sizeof(double));
+    prog->agg_sumsq = alloc_touched(prog->count * sizeof(double));
+    prog->windows = alloc_touched(history * sizeof(signal_window_t));
+    if (!prog->agg_min || !prog->agg_max || !prog->agg_sum || !prog->agg_sumsq || !prog->windows) {
+        LOG_ERROR("Failed to allocate signal windows");
+        return -1;
+    }
+    prog->window_history = history;
+    
+    for (uint32_t w = 0; w < history; w++) {
+        atomic_init(&prog->windows[w].seq, 0);
+        for (int s = 0; s < SIGNAL_STAT_COUNT; s++) {
+            prog->windows[w].stats[s] = alloc_touched(prog->count * sizeof(float));
+            if (!prog->windows[w].stats[s]) {
+                LOG_ERROR("Failed to allocate signal windows");
+                return -1;
+            }
+        }
+    }
+    
+    prog->window_evals = window_evals;
+    atomic_init(&prog->window_seq, 0);
+    reset_aggregates(prog);
+    return 0;
+}
+
+// Evaluations per window of `window_ms`, at least one
+static uint32_t window_evals_for(uint32_t window_ms, uint32_t cycle_time_us, uint32_t decimation) {
+    uint64_t eval_us = (uint64_t)(cycle_time_us ? cycle_time_us : 1) * decimation;
+    uint64_t evals = ((uint64_t)window_ms * 1000 + eval_us / 2) / eval_us;
+    if (evals == 0) evals = 1;
+    if (evals > UINT32_MAX) evals = UINT32_MAX;
+    return (uint32_t)evals;
+}
+
+int signals_load(signal_program_t *prog, const signal_config_t *config, uint32_t cycle_time_us) {
+    if (!prog || !config) return -1;
+    
+    memset(prog, 0, sizeof(signal_program_t));
+    if (config->file[0] == '\0') return 0;
+    
+    signal_def_t *defs = NULL;
+    uint32_t count = 0;
+    
+    if (parse_signal_file(config->file, &defs, &count) < 0) {
+        return -1;
+    }
+    
+    int result = signals_compile(prog, defs, count, config->decimation);
+    free(defs);
+    
+    if (result < 0) return -1;
+    
+    LOG_INFO("Compiled %u signals from %s (every %u cycles, %s)", count, config->file,
+             prog->decimation, prog->avx2 ? "avx2" : "scalar");
+    
+    if (config->window_ms > 0 && count > 0) {
+        uint32_t evals = window_evals_for(config->window_ms, cycle_time_us, prog->decimation);
+        if (signals_enable_windows(prog, evals, config->window_history) < 0) {
+            signals_cleanup(prog);
+            return -1;
+        }
+        LOG_INFO("Signal windows of %u ms (%u evaluations), %u kept", config->window_ms,
+                 prog->window_evals, prog->window_history);
+    }
+    return 0;
+}
+
+void signals_cleanup(signal_program_t *prog) {
+    if (!prog) return;
+    
+    free(prog->defs);
+    free(prog->src);
+    free(prog->bit);
+    free(prog->scale);
+    free(prog->eu_offset);
+    free(prog->alpha);
+    free(prog->deadband);
+    free(prog->raw);
+    free(prog->filtered);
+    free(prog->value);
+    free(prog->slot);
+    free(prog->valid);
+    free(prog->agg_min);
+    free(prog->agg_max);
+    free(prog->agg_sum);
+    free(prog->agg_sumsq);
+    if (prog->windows) {
+        for (uint32_t w = 0; w < prog->window_history; w++) {
+            for (int s = 0; s < SIGNAL_STAT_COUNT; s++) {
+                free(prog->windows[w].stats[s]);
+            }
+        }
+        free(prog->windows);
+    }
+    memset(prog, 0, sizeof(signal_program_t));
+}
+
+// Resolve slave-relative offsets into pointers into the current input image.
+// Runs in the RT thread whenever the image is (re)allocated
+void signals_link(signal_program_t *prog, const uint8_t *image, uint32_t image_size,
+                  const uint32_t *slave_base, uint32_t slave_count) {
+    if (!prog || prog->count == 0) return;
+    
+    uint32_t linked = 0;
+    
+    for (uint32_t i = 0; i < prog->count; i++) {
+        const signal_def_t *def = &prog->defs[i];
+        uint32_t pos = prog->slot[i];
+        uint32_t offset = def->offset;
+        bool valid = image != NULL;
+        
+        if (def->slave > 0) {
+            if (def->slave > slave_count || !slave_base) {
+                valid = false;
+            } else {
+                offset += slave_base[def->slave - 1];
+            }
+        }
+        
+        if (valid && (offset > image_size ||
+                      signal_types[def->type].size > image_size - offset)) {
+            valid = false;
+        }
+        
+        prog->src[pos] = valid ? image + offset : signal_zero;
+        prog->valid[pos] = valid ? 1 : 0;
+        if (valid) linked++;
+    }
+    
+    prog->linked_image = image;
+    prog->linked_size = image_size;
+    prog->primed = false;
+    
+    atomic_store_explicit(&prog->unlinked, prog->count - linked, memory_order_relaxed);
+    atomic_fetch_add_explicit(&prog->links, 1, memory_order_release);
+}
+
+// Called periodically off the RT thread; warns once per link that left
+// signals outside the image
+void signals_report_links(signal_program_t *prog) {
+    if (!prog || prog->count == 0) return;
+    
+    uint32_t links = atomic_load_explicit(&prog->links, memory_order_acquire);
+    if (links == prog->links_reported) return;
+    prog->links_reported = links;
+    
+    uint32_t unlinked = atomic_load_explicit(&prog->unlinked, memory_order_relaxed);
+    if (unlinked > 0) {
+        LOG_WARN("%u of %u signals lie outside the process image", unlinked, prog->count);
+    }
+}
+
+#define EXTRACT_RUN(ctype, start, end) \
+    for (uint32_t i = (start); i < (end); i++) { \
+        ctype v; \
+        memcpy(&v, src[i], sizeof(v)); \
+        raw[i] = (float)v; \
+    }
+
+// A filter this close to its input snaps onto it. Without this, a value
+// decaying towards zero walks through the subnormal range for dozens of
+// evaluations, and subnormal arithmetic is many times slower
+#define SIGNAL_SETTLE 1e-30f
+
+// Branch-free and restrict-qualified so the compiler vectorizes it. The body
+// is compiled once per kernel; none of them contracts into FMA, so every
+// kernel produces the same values
+static inline __attribute__((always_inline))
+void filter_body(uint32_t count, const float *restrict raw, const float *restrict scale,
+                 const float *restrict eu_offset, const float *restrict alpha,
+                 const float *restrict deadband, float *restrict filtered,
+                 float *restrict value) {
+    for (uint32_t i = 0; i < count; i++) {
+        float x = raw[i] * scale[i] + eu_offset[i];
+        float f = filtered[i] + alpha[i] * (x - filtered[i]);
+        float r = x - f;
+        float settle = (r < 0.0f) ? -r : r;
+        f = (settle < SIGNAL_SETTLE) ? x : f;
+        float v = value[i];
+        float d = f - v;
+        float mag = (d < 0.0f) ? -d : d;
+        filtered[i] = f;
+        value[i] = (mag > deadband[i]) ? f : v;
+    }
+}
+
+// Aggregates take the unfiltered engineering value so peaks are not smoothed away
+static inline __attribute__((always_inline))
+void aggregate_body(uint32_t count, const float *restrict raw, const float *restrict scale,
+                    const float *restrict eu_offset, float *restrict agg_min,
+                    float *restrict agg_max, double *restrict agg_sum,
+                    double *restrict agg_sumsq) {
+    for (uint32_t i = 0; i < count; i++) {
+        float x = raw[i] * scale[i] + eu_offset[i];
+        agg_min[i] = (x < agg_min[i]) ? x : agg_min[i];
+        agg_max[i] = (x > agg_max[i]) ? x : agg_max[i];
+        agg_sum[i] += x;
+        agg_sumsq[i] += (double)x * x;
+    }
+}
+
+#define FILTER_ARGS \
+    uint32_t count, const float *restrict raw, const float *restrict scale, \
+    const float *restrict eu_offset, const float *restrict alpha, \
+    const float *restrict deadband, float *restrict filtered, float *restrict value
+#define AGGREGATE_ARGS \
+    uint32_t count, const float *restrict raw, const float *restrict scale, \
+    const float *restrict eu_offset, float *restrict agg_min, float *restrict agg_max, \
+    double *restrict agg_sum, double *restrict agg_sumsq
+
+static void filter_run(FILTER_ARGS) {
+    filter_body(count, raw, scale, eu_offset, alpha, deadband, filtered, value);
+}
+
+static void aggregate_run(AGGREGATE_ARGS) {
+    aggregate_body(count, raw, scale, eu_offset, agg_min, agg_max, agg_sum, agg_sumsq);
+}
+
+#ifdef SIGNALS_X86
+__attribute__((target("avx2")))
+static void filter_avx2(FILTER_ARGS) {
+    filter_body(count, raw, scale, eu_offset, alpha, deadband, filtered, value);
+}
+
+__attribute__((target("avx2")))
+static void aggregate_avx2(AGGREGATE_ARGS) {
+    aggregate_body(count, raw, scale, eu_offset, agg_min, agg_max, agg_sum, agg_sumsq);
+}
+#endif
+
+static void filter(signal_program_t *prog) {
+#ifdef SIGNALS_X86
+    if (prog->avx2) {
+        filter_avx2(prog->count, prog->raw, prog->scale, prog->eu_offset, prog->alpha,
+                    prog->deadband, prog->filtered, prog->value);
+        return;
+    }
+#endif
+    filter_run(prog->count, prog->raw, prog->scale, prog->eu_offset, prog->alpha,
+               prog->deadband, prog->filtered, prog->value);
+}
+
+static void aggregate(signal_program_t *prog) {
+#ifdef SIGNALS_X86
+    if (prog->avx2) {
+        aggregate_avx2(prog->count, prog->raw, prog->scale, prog->eu_offset, prog->agg_min,
+                       prog->agg_max, prog->agg_sum, prog->agg_sumsq);
+        return;
+    }
+#endif
+    aggregate_run(prog->count, prog->raw, prog->scale, prog->eu_offset, prog->agg_min,
+                  prog->agg_max, prog->agg_sum, prog->agg_sumsq);
+}
+
+// Seqlock write: readers that see seq 0, or a seq that changed while they
+// copied, know the slot was being overwritten
+static void seal_window(signal_program_t *prog) {
+    uint32_t seq = atomic_load_explicit(&prog->window_seq, memory_order_relaxed) + 1;
+    if (seq == 0) seq = 1;
+    
+    signal_window_t *window = &prog->windows[(seq - 1) % prog->window_history];
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    
+    atomic_store_explicit(&window->seq, 0, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    
+    double inv = 1.0 / (double)prog->window_evals;
+    float *min = window->stats[SIGNAL_STAT_MIN];
+    float *max = window->stats[SIGNAL_STAT_MAX];
+    float *mean = window->stats[SIGNAL_STAT_MEAN];
+    float *rms = window->stats[SIGNAL_STAT_RMS];
+    
+    for (uint32_t i = 0; i < prog->count; i++) {
+        min[i] = prog->agg_min[i];
+        max[i] = prog->agg_max[i];
+        mean[i] = (float)(prog->agg_sum[i] * inv);
+        rms[i] = (float)sqrt(prog->agg_sumsq[i] * inv);
+    }
+    window->samples = prog->window_evals;
+    window->end_ns = (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+    
+    atomic_store_explicit(&window->seq, seq, memory_order_release);
+    atomic_store_explicit(&prog->window_seq, seq, memory_order_release);
+    reset_aggregates(prog);
+}
+
+void signals_evaluate(signal_program_t *prog, const uint8_t *image) {
+    if (!prog || prog->count == 0 || !image || image != prog->linked_image) return;
+    
+    if (--prog->countdown > 0) return;
+    prog->countdown = prog->decimation;
+    
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    
+    const uint8_t *const *src = prog->src;
+    float *restrict raw = prog->raw;
+    const uint32_t *run = prog->run_start;
+    
+    for (uint32_t i = run[SIGNAL_BOOL]; i < run[SIGNAL_BOOL + 1]; i++) {
+        raw[i] = (float)((*src[i] >> prog->bit[i]) & 1);
+    }
+    EXTRACT_RUN(uint8_t, run[SIGNAL_UINT8], run[SIGNAL_UINT8 + 1]);
+    EXTRACT_RUN(int8_t, run[SIGNAL_INT8], run[SIGNAL_INT8 + 1]);
+    EXTRACT_RUN(uint16_t, run[SIGNAL_UINT16], run[SIGNAL_UINT16 + 1]);
+    EXTRACT_RUN(int16_t, run[SIGNAL_INT16], run[SIGNAL_INT16 + 1]);
+    EXTRACT_RUN(uint32_t, run[SIGNAL_UINT32], run[SIGNAL_UINT32 + 1]);
+    EXTRACT_RUN(int32_t, run[SIGNAL_INT32], run[SIGNAL_INT32 + 1]);
+    EXTRACT_RUN(float, run[SIGNAL_FLOAT32], run[SIGNAL_FLOAT32 + 1]);
+    
+    if (!prog->primed) {
+        // Start filters at the first sample rather than ramping up from zero
+        for (uint32_t i = 0; i < prog->count; i++) {
+            float x = raw[i] * prog->scale[i] + prog->eu_offset[i];
+            prog->filtered[i] = x;
+            prog->value[i] = x;
+        }
+        prog->primed = true;
+    } else {
+        filter(prog);
+    }
+    
+    if (prog->window_evals > 0) {
+        aggregate(prog);
+        if (--prog->window_left == 0) seal_window(prog);
+    }
+    
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    uint32_t ns = (uint32_t)((t1.tv_sec - t0.tv_sec) * 1000000000LL + (t1.tv_nsec - t0.tv_nsec));
+    prog->evaluations++;
+    prog->last_eval_ns = ns;
+    if (ns > prog->max_eval_ns) prog->max_eval_ns = ns;
+}
+
+// Called by the RT thread between cycles when the evaluation rate or the
+// cycle time changes. A window in progress is restarted, so every sealed
+// window still covers window_evals evaluations
+void signals_set_rate(signal_program_t *prog, uint32_t decimation, uint32_t window_ms,
+                      uint32_t cycle_time_us) {
+    if (!prog || prog->count == 0) return;
+    
+    prog->decimation = decimation ? decimation : 1;
+    if (prog->countdown > prog->decimation) prog->countdown = prog->decimation;
+    
+    if (prog->window_evals > 0 && window_ms > 0) {
+        uint32_t evals = window_evals_for(window_ms, cycle_time_us, prog->decimation);
+        if (evals != prog->window_evals) {
+            prog->window_evals = evals;
+            reset_aggregates(prog);
+        }
+    }
+}
+
+bool signals_read(const signal_program_t *prog, uint32_t index, float *value) {
+    if (!prog || !value || index >= prog->count) return false;
+    
+    uint32_t pos = prog->slot[index];
+    *value = prog->value[pos];
+    return prog->valid[pos] && prog->evaluations > 0;
+}
+
+// Copy one statistic of signals [first, first + count) out of sealed window
+// `seq`, or the latest one when seq is 0. Fails when the window is not (or no
+// longer) held in the ring, including when the RT thread overwrote it mid-copy
+int signals_read_window(const signal_program_t *prog, uint32_t seq, signal_stat_t stat,
+                        uint32_t first, uint32_t count, float *values, uint32_t *window_seq,
+                        uint32_t *samples, uint64_t *end_ns) {
+    if (!prog || prog->window_evals == 0 || stat >= SIGNAL_STAT_COUNT) return -1;
+    
+    if (count > 0 && (!values || first >= prog->count || count > prog->count - first)) return -1;
+    
+    uint32_t latest = atomic_load_explicit(&prog->window_seq, memory_order_acquire);
+    if (seq == 0) seq = latest;
+    if (seq == 0 || (int32_t)(latest - seq) < 0 ||
+        latest - seq >= prog->window_history) {
+        return -1;
+    }
+    
+    const signal_window_t *window = &prog->windows[(seq - 1) % prog->window_history];
+    if (atomic_load_explicit(&window->seq, memory_order_acquire) != seq) return -1;
+    
+    for (uint32_t i = 0; i < count; i++) {
+        values[i] = window->stats[stat][prog->slot[first + i]];
+    }
+    uint32_t window_samples = window->samples;
+    uint64_t window_end = window->end_ns;
+    
+    atomic_thread_fence(memory_order_acquire);
+    if (atomic_load_explicit(&window->seq, memory_order_relaxed) != seq) return -1;
+    
+    if (window_seq) *window_seq = seq;
+    if (samples) *samples = window_samples;
+    if (end_ns) *end_ns = window_end;
+    return 0;
+}
+
+const signal_def_t* signals_get_def(const signal_program_t *prog, uint32_t index) {
+    if (!prog || index >= prog->count) return NULL;
+    return &prog->defs[index];
+}
@@ -0,0 +1,133 @@
+#include "snapshot.h"
+#include "logging.h"
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define SNAPSHOT_READ_RETRIES   4
+
+int snapshot_init(snapshot_ring_t *ring) {
+    if (!ring) return -1;
+    
+    memset(ring, 0, sizeof(snapshot_ring_t));
+    
+    // Touched now so the RT thread never takes a page fault publishing
+    ring->buffer = calloc(SNAPSHOT_HISTORY, SNAPSHOT_MAX_BYTES);
+    if (!ring->buffer) {
+        LOG_ERROR("Failed to allocate snapshot buffers");
+        return -1;
+    }
+    memset(ring->buffer, 0, (size_t)SNAPSHOT_HISTORY * SNAPSHOT_MAX_BYTES);
+    
+    for (int i = 0; i < SNAPSHOT_HISTORY; i++) {
+        ring->slots[i].data = ring->buffer + (size_t)i * SNAPSHOT_MAX_BYTES;
+        atomic_init(&ring->slots[i].tag, 0);
+    }
+    atomic_init(&ring->latest, 0);
+    return 0;
+}
+
+void snapshot_cleanup(snapshot_ring_t *ring) {
+    if (!ring) return;
+    
+    free(ring->buffer);
+    ring->buffer = NULL;
+    for (int i = 0; i < SNAPSHOT_HISTORY; i++) {
+        ring->slots[i].data = NULL;
+        atomic_store(&ring->slots[i].tag, 0);
+    }
+    atomic_store(&ring->latest, 0);
+}
+
+// Called by the RT thread once the inputs of `cycle` are in. Images larger
+// than SNAPSHOT_MAX_BYTES are published up to that size
+void snapshot_publish(snapshot_ring_t *ring, const uint8_t *image, uint32_t size, uint64_t cycle,
+                      int64_t dc_time, int wkc, int expected_wkc) {
+    if (!ring->buffer || !image) return;
+    
+    snapshot_slot_t *slot = &ring->slots[cycle % SNAPSHOT_HISTORY];
+    uint32_t bytes = (size < SNAPSHOT_MAX_BYTES) ? size : SNAPSHOT_MAX_BYTES;
+    
+    atomic_store_explicit(&slot->tag, 0, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    
+    memcpy(slot->data, image, bytes);
+    slot->size = bytes;
+    slot->wkc = (uint16_t)((wkc < 0) ? 0 : wkc);
+    slot->flags = (wkc == expected_wkc) ? SNAPSHOT_FLAG_WKC_OK : 0;
+    
+    // DC system time when the bus has a reference clock, host time otherwise
+    if (dc_time != 0) {
+        slot->time_ns = (uint64_t)dc_time;
+        slot->flags |= SNAPSHOT_FLAG_DC_TIME;
+    } else {
+        struct timespec now;
+        clock_gettime(CLOCK_REALTIME, &now);
+        slot->time_ns = (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+    }
+    
+    atomic_store_explicit(&slot->tag, cycle + 1, memory_order_release);
+    atomic_store_explicit(&ring->latest, cycle + 1, memory_order_release);
+}
+
+static const snapshot_slot_t* find_slot(const snapshot_ring_t *ring, bool latest, uint32_t cycle,
+                                        uint64_t *tag) {
+    if (latest) {
+        *tag = atomic_load_explicit(&ring->latest, memory_order_acquire);
+        return (*tag != 0) ? &ring->slots[(*tag - 1) % SNAPSHOT_HISTORY] : NULL;
+    }
+    
+    // Clients name cycles by their low 32 bits
+    for (int i = 0; i < SNAPSHOT_HISTORY; i++) {
+        uint64_t t = atomic_load_explicit(&ring->slots[i].tag, memory_order_acquire);
+        if (t != 0 && (uint32_t)(t - 1) == cycle) {
+            *tag = t;
+            return &ring->slots[i];
+        }
+    }
+    return NULL;
+}
+
+// Copies the regions back to back into `out`, all from one cycle. Fails if
+// that cycle has left the ring or a region is outside its image
+int snapshot_read(const snapshot_ring_t *ring, bool latest, uint32_t cycle,
+                  const snapshot_region_t *regions, uint32_t count, uint8_t *out,
+                  snapshot_info_t *info) {
+    if (!ring || !ring->buffer || (count > 0 && (!regions || !out))) return -1;
+    
+    for (int attempt = 0; attempt < SNAPSHOT_READ_RETRIES; attempt++) {
+        uint64_t tag;
+        const snapshot_slot_t *slot = find_slot(ring, latest, cycle, &tag);
+        if (!slot) return -1;
+        
+        if (atomic_load_explicit(&slot->tag, memory_order_acquire) != tag) continue;
+        
+        uint32_t size = slot->size;
+        uint32_t pos = 0;
+        bool valid = true;
+        
+        for (uint32_t i = 0; i < count; i++) {
+            if (regions[i].offset > size || regions[i].size > size - regions[i].offset) {
+                valid = false;
+                break;
+            }
+            memcpy(out + pos, slot->data + regions[i].offset, regions[i].size);
+            pos += regions[i].size;
+        }
+        
+        snapshot_info_t copy = { tag - 1, slot->time_ns, slot->wkc, slot->flags };
+        
+        atomic_thread_fence(memory_order_acquire);
+        if (atomic_load_explicit(&slot->tag, memory_order_relaxed) != tag) {
+            // Overwritten while copying: a fixed cycle is gone, latest moved on
+            if (!latest) return -1;
+            continue;
+        }
+        
+        if (!valid) return -1;
+        if (info) *info = copy;
+        return 0;
+    }
+    
+    return -1;
+}
@@ -0,0 +1,93 @@
+#include "supervisor.h"
+#include "service.h"
+#include "ethercat.h"
+#include "logging.h"
+#include <string.h>
+
+static uint32_t elapsed_ms(const struct timespec *since, const struct timespec *now) {
+    int64_t ms = (int64_t)(now->tv_sec - since->tv_sec) * 1000 +
+                 (now->tv_nsec - since->tv_nsec) / 1000000;
+    return ms > 0 ? (uint32_t)ms : 0;
+}
+
+void supervisor_init(supervisor_context_t *sup) {
+    if (!sup) return;
+    
+    memset(sup, 0, sizeof(supervisor_context_t));
+}
+
+// Called from the management thread; only slaves that left OP are touched,
+// the rest of the segment keeps cycling in the real-time thread.
+void supervisor_poll(service_context_t *ctx) {
+    supervisor_context_t *sup = &ctx->supervisor;
+    ethercat_context_t *ec = &ctx->ec_ctx;
+    
+    if (!ec->network_active) {
+        sup->slaves_down = 0;
+        memset(sup->recovering, 0, sizeof(sup->recovering));
+        return;
+    }
+    
+    sup->ticks++;
+    
+    bool wkc_low = ec->last_wkc < ec->expected_wkc;
+    if (wkc_low) {
+        sup->wkc_deviations++;
+    }
+    
+    if (!wkc_low && sup->slaves_down == 0 && (sup->ticks % SUPERVISOR_FULL_CHECK_TICKS) != 0) {
+        return;
+    }
+    
+    if (ethercat_check_slaves(ec) < 0) {
+        return;
+    }
+    
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    
+    uint32_t down = 0;
+    uint32_t count = ec->slave_count < SUPERVISOR_MAX_SLAVES ? ec->slave_count : SUPERVISOR_MAX_SLAVES;
+    
+    for (uint32_t i = 0; i < count; i++) {
+        slave_info_t *slave = &ec->slaves[i];
+        
+        if (slave->al_state == EC_STATE_OP && !sup->recovering[i]) {
+            continue;
+        }
+        
+        if (!sup->recovering[i]) {
+            LOG_WARN("Slave %u left OP (AL state 0x%02X), starting recovery",
+                     slave->slave_id, slave->al_state);
+            sup->recovering[i] = true;
+            sup->down_since[i] = now;
+            
+            ethercat_lock_slave_table(ec);
+            slave->online = false;
+            ethercat_unlock_slave_table(ec);
+        }
+        
+        if (ethercat_recover_slave(ec, slave->slave_id) == 0) {
+            uint32_t ms = elapsed_ms(&sup->down_since[i], &now);
+            
+            ethercat_lock_slave_table(ec);
+            slave->online = true;
+            slave->recovery_count++;
+            slave->last_recovery_ms = ms;
+            ethercat_unlock_slave_table(ec);
+            
+            sup->recovering[i] = false;
+            sup->recoveries++;
+            sup->last_recovery_ms = ms;
+            if (ms > sup->max_recovery_ms) {
+                sup->max_recovery_ms = ms;
+            }
+            
+            LOG_INFO("Slave %u back in OP after %u ms", slave->slave_id, ms);
+        } else {
+            down++;
+        }
+    }
+    
+    sup->slaves_down = down;
+}
@@ -0,0 +1,417 @@
+#include "symbols.h"
+#include "signals.h"
+#include "logging.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SYMBOL_SEED_TRIES       4096
+#define SYMBOL_BUCKET_KEYS      4
+#define SYMBOL_BUCKET_MAX       64
+
+static uint64_t hash_name(const char *name) {
+    uint64_t h = 0xcbf29ce484222325ULL;
+    while (*name) {
+        h ^= (uint8_t)*name++;
+        h *= 0x100000001b3ULL;
+    }
+    return h;
+}
+
+static uint32_t displace(uint64_t hash, uint16_t seed) {
+    uint64_t h = hash ^ ((uint64_t)seed * 0x9E3779B97F4A7C15ULL);
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    return (uint32_t)h;
+}
+
+// Seed 0 is never used for slots, so it serves as the bucket hash
+static uint32_t bucket_of(const symbol_table_t *table, uint64_t hash) {
+    return displace(hash, 0) % table->bucket_count;
+}
+
+static void free_index(symbol_table_t *table) {
+    free(table->hashes);
+    free(table->seeds);
+    free(table->slots);
+    table->hashes = NULL;
+    table->seeds = NULL;
+    table->slots = NULL;
+    table->bucket_count = 0;
+    table->slot_mask = 0;
+}
+
+// Drop every symbol but keep the generation counter
+void symbols_clear(symbol_table_t *table) {
+    if (!table) return;
+    
+    free_index(table);
+    table->count = 0;
+    table->pool_used = 0;
+    table->layout_hash = 0;
+}
+
+void symbols_cleanup(symbol_table_t *table) {
+    if (!table) return;
+    
+    free_index(table);
+    free(table->entries);
+    free(table->pool);
+    memset(table, 0, sizeof(symbol_table_t));
+}
+
+int symbols_add(symbol_table_t *table, const char *name, const symbol_t *symbol) {
+    if (!table || !name || !symbol || name[0] == '\0') return -1;
+    
+    uint32_t len = (uint32_t)strnlen(name, SYMBOL_NAME_LEN - 1) + 1;
+    
+    if (table->count == SYMBOL_MAX) {
+        LOG_ERROR("More than %d symbols, '%s' dropped", SYMBOL_MAX, name);
+        return -1;
+    }
+    
+    if (table->count == table->capacity) {
+        uint32_t capacity = table->capacity ? table->capacity * 2 : 256;
+        symbol_t *grown = realloc(table->entries, capacity * sizeof(symbol_t));
+        if (!grown) return -1;
+        table->entries = grown;
+        table->capacity = capacity;
+    }
+    
+    if (table->pool_used + len > table->pool_size) {
+        uint32_t size = table->pool_size ? table->pool_size * 2 : 4096;
+        while (size < table->pool_used + len) size *= 2;
+        char *grown = realloc(table->pool, size);
+        if (!grown) return -1;
+        table->pool = grown;
+        table->pool_size = size;
+    }
+    
+    symbol_t *entry = &table->entries[table->count++];
+    *entry = *symbol;
+    entry->name = table->pool_used;
+    memcpy(table->pool + table->pool_used, name, len - 1);
+    table->pool[table->pool_used + len - 1] = '\0';
+    table->pool_used += len;
+    return 0;
+}
+
+static uint8_t type_for_bits(uint16_t bits) {
+    switch (bits) {
+        case 1:
+            return SIGNAL_BOOL;
+        case 8:
+            return SIGNAL_UINT8;
+        case 16:
+            return SIGNAL_UINT16;
+        case 32:
+            return SIGNAL_UINT32;
+        default:
+            return (bits < 8) ? SIGNAL_UINT8 : SIGNAL_UINT32;
+    }
+}
+
+// A mapped PDO entry at an absolute bit position in the input or output
+// image, named "<slave>.<in|out>.<index>:<subindex>"; index 0 names the
+// whole slave image of a device without a readable mapping
+int symbols_add_entry(symbol_table_t *table, uint16_t slave, symbol_dir_t dir, uint16_t index,
+                      uint8_t subindex, uint32_t bit_offset, uint16_t bits) {
+    if (bits == 0) return -1;
+    
+    char name[SYMBOL_NAME_LEN];
+    const char *dir_name = (dir == SYMBOL_INPUT) ? "in" : "out";
+    
+    if (index == 0) {
+        snprintf(name, sizeof(name), "%u.%s", slave, dir_name);
+    } else {
+        snprintf(name, sizeof(name), "%u.%s.%04X:%02X", slave, dir_name, index, subindex);
+    }
+    
+    symbol_t symbol;
+    memset(&symbol, 0, sizeof(symbol));
+    symbol.slave = slave;
+    symbol.index = index;
+    symbol.subindex = subindex;
+    symbol.dir = (uint8_t)dir;
+    symbol.type = type_for_bits(bits);
+    symbol.bit = (uint8_t)(bit_offset % 8);
+    symbol.bits = bits;
+    symbol.offset = bit_offset / 8;
+    return symbols_add(table, name, &symbol);
+}
+
+static int compare_hash(const void *a, const void *b, void *arg) {
+    const uint64_t *hash = arg;
+    uint64_t ha = hash[*(const uint32_t*)a];
+    uint64_t hb = hash[*(const uint32_t*)b];
+    return (ha > hb) - (ha < hb);
+}
+
+// Equal names hash alike and could never be separated by any seed
+static int check_duplicates(const symbol_table_t *table) {
+    uint32_t n = table->count;
+    uint32_t *order = malloc(n * sizeof(uint32_t));
+    int result = 0;
+    
+    if (!order) return -1;
+    
+    for (uint32_t i = 0; i < n; i++) {
+        order[i] = i;
+    }
+    qsort_r(order, n, sizeof(uint32_t), compare_hash, table->hashes);
+    
+    for (uint32_t i = 1; i < n && result == 0; i++) {
+        if (table->hashes[order[i]] == table->hashes[order[i - 1]]) {
+            LOG_ERROR("Duplicate symbol '%s'", symbols_name(table, &table->entries[order[i]]));
+            result = -1;
+        }
+    }
+    
+    free(order);
+    return result;
+}
+
+static int compare_bucket_size(const void *a, const void *b, void *arg) {
+    const uint32_t *size = arg;
+    uint32_t sa = size[*(const uint32_t*)a];
+    uint32_t sb = size[*(const uint32_t*)b];
+    return (sa < sb) - (sa > sb);
+}
+
+// Place one bucket: find a seed that sends each of its keys to a free slot
+static bool place_bucket(symbol_table_t *table, const uint32_t *keys, uint32_t count,
+                         uint16_t *seed_out) {
+    uint32_t slot[SYMBOL_BUCKET_MAX];
+    
+    if (count > SYMBOL_BUCKET_MAX) return false;
+    
+    for (uint32_t seed = 1; seed < SYMBOL_SEED_TRIES; seed++) {
+        bool ok = true;
+        
+        for (uint32_t k = 0; k < count && ok; k++) {
+            slot[k] = displace(table->hashes[keys[k]], (uint16_t)seed) & table->slot_mask;
+            if (table->slots[slot[k]] != 0) ok = false;
+            for (uint32_t j = 0; j < k && ok; j++) {
+                if (slot[j] == slot[k]) ok = false;
+            }
+        }
+        
+        if (ok) {
+            for (uint32_t k = 0; k < count; k++) {
+                table->slots[slot[k]] = keys[k] + 1;
+            }
+            *seed_out = (uint16_t)seed;
+            return true;
+        }
+    }
+    
+    return false;
+}
+
+static int try_build(symbol_table_t *table, uint32_t slot_count) {
+    uint32_t n = table->count;
+    uint32_t buckets = table->bucket_count;
+    
+    table->slot_mask = slot_count - 1;
+    memset(table->slots, 0, slot_count * sizeof(uint32_t));
+    memset(table->seeds, 0, buckets * sizeof(uint16_t));
+    
+    uint32_t *size = calloc(buckets + 1, sizeof(uint32_t));
+    uint32_t *start = calloc(buckets + 1, sizeof(uint32_t));
+    uint32_t *keys = malloc((n ? n : 1) * sizeof(uint32_t));
+    uint32_t *order = malloc(buckets * sizeof(uint32_t));
+    uint32_t *fill = calloc(buckets, sizeof(uint32_t));
+    int result = 0;
+    
+    if (!size || !start || !keys || !order || !fill) {
+        result = -1;
+        goto out;
+    }
+    
+    // Group keys by bucket, then place the largest buckets first
+    for (uint32_t i = 0; i < n; i++) {
+        size[bucket_of(table, table->hashes[i])]++;
+    }
+    for (uint32_t b = 0; b < buckets; b++) {
+        start[b + 1] = start[b] + size[b];
+        order[b] = b;
+    }
+    for (uint32_t i = 0; i < n; i++) {
+        uint32_t b = bucket_of(table, table->hashes[i]);
+        keys[start[b] + fill[b]++] = i;
+    }
+    qsort_r(order, buckets, sizeof(uint32_t), compare_bucket_size, size);
+    
+    for (uint32_t i = 0; i < buckets && size[order[i]] > 0; i++) {
+        uint32_t b = order[i];
+        if (!place_bucket(table, keys + start[b], size[b], &table->seeds[b])) {
+            result = 1;
+            break;
+        }
+    }
+
+out:
+    free(size);
+    free(start);
+    free(keys);
+    free(order);
+    free(fill);
+    return result;
+}
+
+// Build the perfect hash over the symbols added since the last clear. Slots
+// start at the next power of two; if some bucket cannot be placed the slot
+// table doubles and the build starts over
+int symbols_build(symbol_table_t *table) {
+    if (!table) return -1;
+    
+    free_index(table);
+    table->generation = (uint16_t)(table->generation + 1);
+    if (table->generation == 0) table->generation = 1;
+    
+    uint32_t n = table->count;
+    table->layout_hash = 0;
+    if (n == 0) return 0;
+    
+    table->bucket_count = (n + SYMBOL_BUCKET_KEYS - 1) / SYMBOL_BUCKET_KEYS;
+    table->hashes = malloc(n * sizeof(uint64_t));
+    table->seeds = malloc(table->bucket_count * sizeof(uint16_t));
+    if (!table->hashes || !table->seeds) {
+        free_index(table);
+        return -1;
+    }
+    
+    for (uint32_t i = 0; i < n; i++) {
+        table->hashes[i] = hash_name(symbols_name(table, &table->entries[i]));
+    }
+    if (check_duplicates(table) < 0) {
+        free_index(table);
+        return -1;
+    }
+    
+    uint32_t slot_count = 1;
+    while (slot_count < n) slot_count <<= 1;
+    
+    for (int attempt = 0; attempt < 4; attempt++, slot_count <<= 1) {
+        uint32_t *slots = realloc(table->slots, slot_count * sizeof(uint32_t));
+        if (!slots) break;
+        table->slots = slots;
+        
+        int result = try_build(table, slot_count);
+        if (result < 0) break;
+        if (result == 0) {
+            table->layout_hash = symbols_layout_hash(table);
+            LOG_INFO("Symbol table: %u symbols, %u slots, %u bytes of names, layout 0x%08X", n,
+                     slot_count, table->pool_used, table->layout_hash);
+            return 0;
+        }
+    }
+    
+    LOG_ERROR("Failed to build symbol table (%u symbols)", n);
+    free_index(table);
+    return -1;
+}
+
+// Identifies a process image layout: every symbol's name, direction and
+// position. The sum of per-symbol hashes does not depend on the order in
+// which the mapping was read, so a description file lists slaves and entries
+// in any order and still matches the daemon
+uint32_t symbols_layout_hash(const symbol_table_t *table) {
+    if (!table) return 0;
+    
+    uint64_t sum = 0;
+    
+    for (uint32_t i = 0; i < table->count; i++) {
+        const symbol_t *symbol = &table->entries[i];
+        uint64_t h = hash_name(symbols_name(table, symbol));
+        h ^= ((uint64_t)symbol->offset << 16) | ((uint64_t)symbol->bit << 8) | symbol->dir;
+        h ^= (uint64_t)symbol->bits << 48;
+        sum += (uint64_t)displace(h, 0) | ((uint64_t)displace(h, 1) << 32);
+    }
+    
+    uint32_t hash = (uint32_t)(sum ^ (sum >> 32));
+    return hash ? hash : 1;
+}
+
+uint32_t symbols_handle(const symbol_table_t *table, uint32_t index) {
+    return ((uint32_t)table->generation << 16) | index;
+}
+
+const symbol_t* symbols_find(const symbol_table_t *table, const char *name, uint32_t *handle) {
+    if (!table || !name || !table->slots) return NULL;
+    
+    uint64_t hash = hash_name(name);
+    uint16_t seed = table->seeds[bucket_of(table, hash)];
+    uint32_t entry = table->slots[displace(hash, seed) & table->slot_mask];
+    
+    if (entry == 0 || strcmp(table->pool + table->entries[entry - 1].name, name) != 0) {
+        return NULL;
+    }
+    
+    if (handle) *handle = symbols_handle(table, entry - 1);
+    return &table->entries[entry - 1];
+}
+
+// Handles carry the table generation, so a handle resolved before the
+// network was restarted is refused instead of addressing a different field
+const symbol_t* symbols_get(const symbol_table_t *table, uint32_t handle) {
+    if (!table || !table->slots) return NULL;
+    
+    uint32_t index = handle & 0xFFFF;
+    if ((handle >> 16) != table->generation || index >= table->count) return NULL;
+    return &table->entries[index];
+}
+
+const char* symbols_name(const symbol_table_t *table, const symbol_t *symbol) {
+    return table->pool + symbol->name;
+}
+
+uint32_t symbols_byte_size(const symbol_t *symbol) {
+    return (symbol->bit + symbol->bits + 7) / 8;
+}
+
+// Values are little-endian bit fields that may start anywhere in a byte and
+// straddle byte boundaries; only the low 32 bits are transferred, through the
+// at most five bytes they touch
+static uint32_t value_width(const symbol_t *symbol) {
+    return (symbol->bits > 32) ? 32 : symbol->bits;
+}
+
+uint32_t symbols_read_value(const symbol_t *symbol, const uint8_t *image) {
+    const uint8_t *src = image + symbol->offset;
+    uint32_t width = value_width(symbol);
+    uint32_t span = (symbol->bit + width + 7) / 8;
+    uint64_t raw = 0;
+    
+    for (uint32_t i = 0; i < span; i++) {
+        raw |= (uint64_t)src[i] << (8 * i);
+    }
+    
+    return (uint32_t)((raw >> symbol->bit) & ((1ULL << width) - 1));
+}
+
+// A write becomes masked writes for the RT thread to apply, so it only
+// changes the symbol's own bits even while other writers touch the same
+// bytes. A field spanning five bytes needs a second op for its last byte
+uint32_t symbols_write_ops(const symbol_t *symbol, uint32_t value, rmw_op_t ops[2]) {
+    uint32_t width = value_width(symbol);
+    uint32_t span = (symbol->bit + width + 7) / 8;
+    uint64_t mask = ((1ULL << width) - 1) << symbol->bit;
+    uint64_t raw = ((uint64_t)value << symbol->bit) & mask;
+    
+    memset(ops, 0, 2 * sizeof(rmw_op_t));
+    ops[0].kind = RMW_MASKED_WRITE;
+    ops[0].size = (uint8_t)(span > 4 ? 4 : span);
+    ops[0].offset = symbol->offset;
+    ops[0].mask = (uint32_t)mask;
+    ops[0].value = (uint32_t)raw;
+    if (span <= 4) return 1;
+    
+    ops[1].kind = RMW_MASKED_WRITE;
+    ops[1].size = 1;
+    ops[1].offset = symbol->offset + 4;
+    ops[1].mask = (uint32_t)(mask >> 32);
+    ops[1].value = (uint32_t)(raw >> 32);
+    return 2;
+}
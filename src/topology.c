@@ -0,0 +1,98 @@
+#include "topology.h"
+#include "logging.h"
+#include <stdio.h>
+#include <stddef.h>
+#include <string.h>
+#include <errno.h>
+
+static uint32_t topology_checksum(const topology_snapshot_t *snap) {
+    const uint8_t *bytes = (const uint8_t *)snap->slaves;
+    size_t len = snap->slave_count * sizeof(topology_slave_t);
+    uint32_t hash = 2166136261u;
+    
+    for (size_t i = 0; i < len; i++) {
+        hash ^= bytes[i];
+        hash *= 16777619u;
+    }
+    
+    return hash;
+}
+
+int topology_load(const char *path, topology_snapshot_t *snap) {
+    if (!path || !path[0] || !snap) return -1;
+    
+    FILE *file = fopen(path, "rb");
+    if (!file) {
+        LOG_DEBUG("No topology snapshot at %s", path);
+        return -1;
+    }
+    
+    size_t header = offsetof(topology_snapshot_t, slaves);
+    memset(snap, 0, sizeof(topology_snapshot_t));
+    
+    if (fread(snap, 1, header, file) != header ||
+        snap->magic != TOPOLOGY_MAGIC || snap->version != TOPOLOGY_VERSION ||
+        snap->slave_count == 0 || snap->slave_count > TOPOLOGY_MAX_SLAVES) {
+        LOG_WARN("Ignoring invalid topology snapshot %s", path);
+        fclose(file);
+        return -1;
+    }
+    
+    size_t body = snap->slave_count * sizeof(topology_slave_t);
+    if (fread(snap->slaves, 1, body, file) != body ||
+        topology_checksum(snap) != snap->checksum) {
+        LOG_WARN("Topology snapshot %s is truncated or corrupt", path);
+        fclose(file);
+        return -1;
+    }
+    
+    fclose(file);
+    return 0;
+}
+
+int topology_save(const char *path, topology_snapshot_t *snap) {
+    if (!path || !path[0] || !snap || snap->slave_count > TOPOLOGY_MAX_SLAVES) return -1;
+    
+    snap->magic = TOPOLOGY_MAGIC;
+    snap->version = TOPOLOGY_VERSION;
+    snap->checksum = topology_checksum(snap);
+    
+    // Write to a temporary file and rename so a crash never leaves a torn snapshot
+    char tmp_path[512];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+    
+    FILE *file = fopen(tmp_path, "wb");
+    if (!file) {
+        LOG_WARN("Failed to write topology snapshot %s: %s", tmp_path, strerror(errno));
+        return -1;
+    }
+    
+    size_t len = offsetof(topology_snapshot_t, slaves) + snap->slave_count * sizeof(topology_slave_t);
+    if (fwrite(snap, 1, len, file) != len) {
+        LOG_WARN("Failed to write topology snapshot %s", tmp_path);
+        fclose(file);
+        remove(tmp_path);
+        return -1;
+    }
+    
+    fclose(file);
+    
+    if (rename(tmp_path, path) != 0) {
+        LOG_WARN("Failed to store topology snapshot %s: %s", path, strerror(errno));
+        remove(tmp_path);
+        return -1;
+    }
+    
+    LOG_INFO("Topology snapshot with %u slaves saved to %s", snap->slave_count, path);
+    return 0;
+}
+
+bool topology_slave_matches(const topology_snapshot_t *snap, uint32_t index,
+                            uint32_t vendor_id, uint32_t product_code, uint32_t revision) {
+    if (!snap || index >= snap->slave_count) return false;
+    
+    const topology_slave_t *slave = &snap->slaves[index];
+    return slave->vendor_id == vendor_id &&
+           slave->product_code == product_code &&
+           slave->revision == revision;
+}
@@ -0,0 +1,179 @@
+#include "trace.h"
+#include "logging.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/syscall.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define TRACE_HAVE_TSC 1
+#endif
+
+volatile bool g_trace_enabled = false;
+
+static trace_ring_t *g_rings = NULL;
+static atomic_uint g_ring_count;
+static _Thread_local trace_ring_t *t_ring = NULL;
+
+static uint64_t g_base_tsc;
+static uint64_t g_base_ns;
+
+static const char *phase_names[TRACE_PHASE_COUNT] = {
+    "cycle", "output_copy", "send", "receive", "input_copy",
+    "capture", "supervisor", "command", "plugins", "signals",
+    "changes", "events", "scope"
+};
+
+static uint64_t monotonic_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static inline uint64_t read_tsc(void) {
+#ifdef TRACE_HAVE_TSC
+    return __rdtsc();
+#else
+    return monotonic_ns();
+#endif
+}
+
+int trace_init(bool enabled) {
+    g_rings = calloc(TRACE_MAX_THREADS, sizeof(trace_ring_t));
+    if (!g_rings) {
+        LOG_ERROR("Failed to allocate trace rings");
+        return -1;
+    }
+    
+    atomic_store(&g_ring_count, 0);
+    g_base_tsc = read_tsc();
+    g_base_ns = monotonic_ns();
+    g_trace_enabled = enabled;
+    
+    if (enabled) {
+        LOG_INFO("Cycle tracing enabled");
+    }
+    return 0;
+}
+
+void trace_cleanup(void) {
+    g_trace_enabled = false;
+    free(g_rings);
+    g_rings = NULL;
+}
+
+void trace_register_thread(const char *name) {
+    if (!g_rings) return;
+    
+    uint32_t idx = atomic_fetch_add(&g_ring_count, 1);
+    if (idx >= TRACE_MAX_THREADS) {
+        LOG_WARN("No trace ring left for thread %s", name);
+        return;
+    }
+    
+    trace_ring_t *ring = &g_rings[idx];
+    snprintf(ring->name, sizeof(ring->name), "%s", name);
+    ring->tid = (int)syscall(SYS_gettid);
+    
+    // Fault the ring in now rather than on the first traced cycle
+    memset(ring->events, 0, sizeof(ring->events));
+    atomic_store(&ring->head, 0);
+    t_ring = ring;
+}
+
+void trace_set_enabled(bool enabled) {
+    g_trace_enabled = enabled && g_rings != NULL;
+}
+
+void trace_record(trace_phase_t phase, bool begin) {
+    trace_ring_t *ring = t_ring;
+    if (!ring) return;
+    
+    uint32_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    trace_event_t *ev = &ring->events[head % TRACE_RING_EVENTS];
+    ev->tsc = read_tsc();
+    ev->phase = (uint16_t)phase;
+    ev->begin = begin;
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+}
+
+uint32_t trace_event_count(void) {
+    if (!g_rings) return 0;
+    
+    uint32_t total = 0;
+    uint32_t rings = atomic_load(&g_ring_count);
+    
+    for (uint32_t i = 0; i < rings && i < TRACE_MAX_THREADS; i++) {
+        uint32_t head = atomic_load(&g_rings[i].head);
+        total += head < TRACE_RING_EVENTS ? head : TRACE_RING_EVENTS;
+    }
+    return total;
+}
+
+// Chrome trace event format; Perfetto's UI opens the same file
+int trace_export_chrome(const char *filename) {
+    if (!g_rings || !filename) return -1;
+    
+    FILE *file = fopen(filename, "w");
+    if (!file) {
+        LOG_ERROR("Failed to open trace file %s: %s", filename, strerror(errno));
+        return -1;
+    }
+    
+    bool was_enabled = g_trace_enabled;
+    g_trace_enabled = false;
+    
+    // Scale TSC ticks to nanoseconds against the interval since trace_init
+    double ns_per_tick = 1.0;
+#ifdef TRACE_HAVE_TSC
+    uint64_t tsc_span = read_tsc() - g_base_tsc;
+    uint64_t ns_span = monotonic_ns() - g_base_ns;
+    if (tsc_span > 0) {
+        ns_per_tick = (double)ns_span / (double)tsc_span;
+    }
+#endif
+    
+    pid_t pid = getpid();
+    bool first = true;
+    uint32_t written = 0;
+    uint32_t rings = atomic_load(&g_ring_count);
+    
+    fprintf(file, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+    
+    for (uint32_t r = 0; r < rings && r < TRACE_MAX_THREADS; r++) {
+        trace_ring_t *ring = &g_rings[r];
+        uint32_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+        uint32_t count = head < TRACE_RING_EVENTS ? head : TRACE_RING_EVENTS;
+        
+        fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,"
+                "\"args\":{\"name\":\"%s\"}}",
+                first ? "" : ",\n", (int)pid, ring->tid, ring->name);
+        first = false;
+        
+        // Skip leading end events whose begin was overwritten by the wrap
+        uint32_t i = head - count;
+        while (i != head && !ring->events[i % TRACE_RING_EVENTS].begin) i++;
+        
+        for (; i != head; i++) {
+            const trace_event_t *ev = &ring->events[i % TRACE_RING_EVENTS];
+            if (ev->phase >= TRACE_PHASE_COUNT) continue;
+            
+            double ts_us = (double)(int64_t)(ev->tsc - g_base_tsc) * ns_per_tick / 1000.0;
+            fprintf(file, ",\n{\"name\":\"%s\",\"ph\":\"%s\",\"ts\":%.3f,\"pid\":%d,\"tid\":%d}",
+                    phase_names[ev->phase], ev->begin ? "B" : "E", ts_us, (int)pid, ring->tid);
+            written++;
+        }
+    }
+    
+    fprintf(file, "\n]}\n");
+    fclose(file);
+    
+    g_trace_enabled = was_enabled;
+    
+    LOG_INFO("Exported %u trace events to %s", written, filename);
+    return (int)written;
+}
@@ -0,0 +1,450 @@
+#include "transport.h"
+#include "logging.h"
+#include "trace.h"
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <errno.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <net/if.h>
+#include <arpa/inet.h>
+#include <linux/if_packet.h>
+#include <linux/if_ether.h>
+#include <linux/net_tstamp.h>
+
+#define ETH_P_ECAT              0x88A4
+#define ECAT_HEADER_LEN         2
+#define ECAT_DATAGRAM_HDR_LEN   10
+#define ECAT_WKC_LEN            2
+#define ECAT_CMD_FRMW           0x0E
+#define ECAT_CMD_LRW            0x0C
+#define ECAT_REG_DCSYSTIME      0x0910
+#define ECAT_MORE_FOLLOWS       0x8000
+#define ETH_MIN_FRAME           60
+
+#ifndef SO_BUSY_POLL
+#define SO_BUSY_POLL 46
+#endif
+
+typedef struct {
+    uint8_t index;
+    uint32_t offset;
+    uint32_t len;
+    bool done;
+} pending_segment_t;
+
+static inline void put_le16(uint8_t *p, uint16_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+}
+
+static inline void put_le32(uint8_t *p, uint32_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    p[2] = (uint8_t)(v >> 16);
+    p[3] = (uint8_t)(v >> 24);
+}
+
+static inline uint16_t get_le16(const uint8_t *p) {
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static inline uint64_t timespec_ns(const struct timespec *ts) {
+    return (uint64_t)ts->tv_sec * 1000000000ULL + (uint64_t)ts->tv_nsec;
+}
+
+transport_type_t transport_parse_type(const char *name) {
+    if (name && strcasecmp(name, "mmap") == 0) return TRANSPORT_MMAP;
+    return TRANSPORT_SOEM;
+}
+
+int transport_open(transport_t *t, const char *ifname, uint32_t busy_poll_us) {
+    if (!t || !ifname) return -1;
+    
+    memset(t, 0, sizeof(transport_t));
+    t->fd = socket(AF_PACKET, SOCK_RAW, htons(ETH_P_ECAT));
+    if (t->fd < 0) {
+        LOG_ERROR("Failed to create packet socket: %s", strerror(errno));
+        return -1;
+    }
+    
+    struct ifreq ifr;
+    memset(&ifr, 0, sizeof(ifr));
+    strncpy(ifr.ifr_name, ifname, IFNAMSIZ - 1);
+    
+    if (ioctl(t->fd, SIOCGIFINDEX, &ifr) < 0) {
+        LOG_ERROR("Interface %s not found: %s", ifname, strerror(errno));
+        goto fail;
+    }
+    t->ifindex = ifr.ifr_ifindex;
+    
+    if (ioctl(t->fd, SIOCGIFHWADDR, &ifr) == 0) {
+        memcpy(t->src_mac, ifr.ifr_hwaddr.sa_data, 6);
+    }
+    
+    // TPACKET_V2 keeps per-frame ownership; V3 only hands blocks back after a
+    // millisecond-granular retire timer, which is longer than a bus cycle.
+    int version = TPACKET_V2;
+    if (setsockopt(t->fd, SOL_PACKET, PACKET_VERSION, &version, sizeof(version)) < 0) {
+        LOG_ERROR("Failed to select TPACKET_V2: %s", strerror(errno));
+        goto fail;
+    }
+    
+    int one = 1;
+    if (setsockopt(t->fd, SOL_PACKET, PACKET_IGNORE_OUTGOING, &one, sizeof(one)) < 0) {
+        LOG_DEBUG("PACKET_IGNORE_OUTGOING not supported: %s", strerror(errno));
+    }
+    if (setsockopt(t->fd, SOL_PACKET, PACKET_QDISC_BYPASS, &one, sizeof(one)) < 0) {
+        LOG_DEBUG("PACKET_QDISC_BYPASS not supported: %s", strerror(errno));
+    }
+    
+    // Prefer NIC timestamps on received frames; the kernel falls back to software ones
+    int tstamp = SOF_TIMESTAMPING_RAW_HARDWARE;
+    if (setsockopt(t->fd, SOL_PACKET, PACKET_TIMESTAMP, &tstamp, sizeof(tstamp)) < 0) {
+        LOG_DEBUG("Hardware RX timestamps not available: %s", strerror(errno));
+    }
+    
+    t->busy_poll_us = busy_poll_us;
+    if (busy_poll_us > 0) {
+        int value = (int)busy_poll_us;
+        if (setsockopt(t->fd, SOL_SOCKET, SO_BUSY_POLL, &value, sizeof(value)) < 0) {
+            LOG_WARN("Failed to enable busy polling: %s", strerror(errno));
+        }
+    }
+    
+    struct tpacket_req rx_req = {
+        .tp_block_size = TRANSPORT_BLOCK_SIZE,
+        .tp_block_nr = TRANSPORT_RX_FRAMES * TRANSPORT_FRAME_SIZE / TRANSPORT_BLOCK_SIZE,
+        .tp_frame_size = TRANSPORT_FRAME_SIZE,
+        .tp_frame_nr = TRANSPORT_RX_FRAMES
+    };
+    struct tpacket_req tx_req = {
+        .tp_block_size = TRANSPORT_BLOCK_SIZE,
+        .tp_block_nr = TRANSPORT_TX_FRAMES * TRANSPORT_FRAME_SIZE / TRANSPORT_BLOCK_SIZE,
+        .tp_frame_size = TRANSPORT_FRAME_SIZE,
+        .tp_frame_nr = TRANSPORT_TX_FRAMES
+    };
+    
+    if (setsockopt(t->fd, SOL_PACKET, PACKET_RX_RING, &rx_req, sizeof(rx_req)) < 0 ||
+        setsockopt(t->fd, SOL_PACKET, PACKET_TX_RING, &tx_req, sizeof(tx_req)) < 0) {
+        LOG_ERROR("Failed to set up packet rings: %s", strerror(errno));
+        goto fail;
+    }
+    
+    size_t rx_size = (size_t)rx_req.tp_block_size * rx_req.tp_block_nr;
+    size_t tx_size = (size_t)tx_req.tp_block_size * tx_req.tp_block_nr;
+    t->ring_size = rx_size + tx_size;
+    t->ring = mmap(NULL, t->ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_LOCKED, t->fd, 0);
+    if (t->ring == MAP_FAILED) {
+        t->ring = mmap(NULL, t->ring_size, PROT_READ | PROT_WRITE, MAP_SHARED, t->fd, 0);
+    }
+    if (t->ring == MAP_FAILED) {
+        LOG_ERROR("Failed to map packet rings: %s", strerror(errno));
+        t->ring = NULL;
+        goto fail;
+    }
+    t->rx_ring = t->ring;
+    t->tx_ring = t->ring + rx_size;
+    
+    struct sockaddr_ll addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sll_family = AF_PACKET;
+    addr.sll_protocol = htons(ETH_P_ECAT);
+    addr.sll_ifindex = t->ifindex;
+    
+    if (bind(t->fd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+        LOG_ERROR("Failed to bind packet socket to %s: %s", ifname, strerror(errno));
+        goto fail;
+    }
+    
+    LOG_INFO("Memory-mapped packet transport on %s (busy poll %u us)", ifname, busy_poll_us);
+    return 0;
+    
+fail:
+    transport_close(t);
+    return -1;
+}
+
+void transport_close(transport_t *t) {
+    if (!t) return;
+    
+    if (t->ring) {
+        munmap(t->ring, t->ring_size);
+        t->ring = NULL;
+    }
+    
+    if (t->fd > 0) {
+        close(t->fd);
+    }
+    t->fd = -1;
+}
+
+uint32_t transport_format_frame(uint8_t *frame, const uint8_t *src_mac, uint8_t index,
+                                uint32_t logical_address, const uint8_t *data, uint32_t len,
+                                const uint8_t *extra, uint32_t extra_len, uint16_t dc_address,
+                                uint16_t wkc) {
+    memset(frame, 0xFF, 6);
+    if (src_mac) {
+        memcpy(frame + 6, src_mac, 6);
+    } else {
+        memset(frame + 6, 0, 6);
+    }
+    frame[12] = (uint8_t)(ETH_P_ECAT >> 8);
+    frame[13] = (uint8_t)(ETH_P_ECAT & 0xFF);
+    
+    uint8_t *ecat = frame + ETH_HLEN;
+    uint8_t *dg = ecat + ECAT_HEADER_LEN;
+    uint32_t dlen = len + extra_len;
+    uint32_t payload = ECAT_DATAGRAM_HDR_LEN + dlen + ECAT_WKC_LEN;
+    
+    dg[0] = ECAT_CMD_LRW;
+    dg[1] = index;
+    put_le32(dg + 2, logical_address);
+    put_le16(dg + 6, (uint16_t)(dlen | (dc_address ? ECAT_MORE_FOLLOWS : 0)));
+    put_le16(dg + 8, 0);
+    if (len) memcpy(dg + ECAT_DATAGRAM_HDR_LEN, data, len);
+    if (extra_len) memcpy(dg + ECAT_DATAGRAM_HDR_LEN + len, extra, extra_len);
+    put_le16(dg + ECAT_DATAGRAM_HDR_LEN + dlen, wkc);
+    
+    if (dc_address) {
+        uint8_t *dc = dg + payload;
+        dc[0] = ECAT_CMD_FRMW;
+        dc[1] = index;
+        put_le16(dc + 2, dc_address);
+        put_le16(dc + 4, ECAT_REG_DCSYSTIME);
+        put_le16(dc + 6, 8);
+        put_le16(dc + 8, 0);
+        memset(dc + ECAT_DATAGRAM_HDR_LEN, 0, 8 + ECAT_WKC_LEN);
+        payload += ECAT_DATAGRAM_HDR_LEN + 8 + ECAT_WKC_LEN;
+    }
+    
+    put_le16(ecat, (uint16_t)((payload & 0x07FF) | (1 << 12)));
+    
+    uint32_t frame_len = ETH_HLEN + ECAT_HEADER_LEN + payload;
+    if (frame_len < ETH_MIN_FRAME) {
+        memset(frame + frame_len, 0, ETH_MIN_FRAME - frame_len);
+        frame_len = ETH_MIN_FRAME;
+    }
+    
+    return frame_len;
+}
+
+// Process one received EtherCAT frame; returns the index of the segment it
+// completes, -2 for a cyclic frame of an earlier exchange and -1 for any
+// other traffic.
+static int parse_frame(const uint8_t *frame, uint32_t len, pending_segment_t *segments, int count,
+                       uint8_t *data, uint16_t *wkc, int64_t *dc_time) {
+    if (len < ETH_HLEN + ECAT_HEADER_LEN + ECAT_DATAGRAM_HDR_LEN + ECAT_WKC_LEN) return -1;
+    
+    if (frame[12] != (uint8_t)(ETH_P_ECAT >> 8) || frame[13] != (uint8_t)(ETH_P_ECAT & 0xFF)) return -1;
+    
+    const uint8_t *dg = frame + ETH_HLEN + ECAT_HEADER_LEN;
+    if (dg[0] != ECAT_CMD_LRW || dg[1] < TRANSPORT_INDEX_BASE) return -1;
+    
+    for (int i = 0; i < count; i++) {
+        if (segments[i].done || dg[1] != segments[i].index) continue;
+        
+        uint32_t dlen = get_le16(dg + 6) & 0x07FF;
+        if (dlen != segments[i].len ||
+            len < ETH_HLEN + ECAT_HEADER_LEN + ECAT_DATAGRAM_HDR_LEN + dlen + ECAT_WKC_LEN) {
+            return -2;
+        }
+        
+        memcpy(data + segments[i].offset, dg + ECAT_DATAGRAM_HDR_LEN, dlen);
+        *wkc = get_le16(dg + ECAT_DATAGRAM_HDR_LEN + dlen);
+        
+        const uint8_t *dc = dg + ECAT_DATAGRAM_HDR_LEN + dlen + ECAT_WKC_LEN;
+        if ((get_le16(dg + 6) & ECAT_MORE_FOLLOWS) && dc_time &&
+            len >= (uint32_t)(dc - frame) + ECAT_DATAGRAM_HDR_LEN + 8 + ECAT_WKC_LEN &&
+            dc[0] == ECAT_CMD_FRMW) {
+            memcpy(dc_time, dc + ECAT_DATAGRAM_HDR_LEN, sizeof(int64_t));
+        }
+        
+        segments[i].done = true;
+        return i;
+    }
+    
+    return -2;
+}
+
+// Replies still in the RX ring before a new exchange belong to an exchange
+// that already timed out; dropping them keeps their index from being matched
+// once it comes round again
+static void drain_stale(transport_t *t, transport_stats_t *stats) {
+    for (;;) {
+        uint8_t *slot = t->rx_ring + (size_t)t->rx_frame * TRANSPORT_FRAME_SIZE;
+        struct tpacket2_hdr *hdr = (struct tpacket2_hdr*)slot;
+        
+        if (!(__atomic_load_n(&hdr->tp_status, __ATOMIC_ACQUIRE) & TP_STATUS_USER)) return;
+        
+        const struct sockaddr_ll *sll =
+            (const struct sockaddr_ll*)(slot + TPACKET_ALIGN(sizeof(struct tpacket2_hdr)));
+        const uint8_t *frame = slot + hdr->tp_mac;
+        if (stats && sll->sll_pkttype != PACKET_OUTGOING &&
+            hdr->tp_snaplen >= ETH_HLEN + ECAT_HEADER_LEN + ECAT_DATAGRAM_HDR_LEN &&
+            frame[ETH_HLEN + ECAT_HEADER_LEN] == ECAT_CMD_LRW &&
+            frame[ETH_HLEN + ECAT_HEADER_LEN + 1] >= TRANSPORT_INDEX_BASE) {
+            stats->stale_frames++;
+        }
+        
+        __atomic_store_n(&hdr->tp_status, TP_STATUS_KERNEL, __ATOMIC_RELEASE);
+        t->rx_frame = (t->rx_frame + 1) % TRANSPORT_RX_FRAMES;
+    }
+}
+
+int transport_exchange(transport_t *t, transport_stats_t *stats, uint32_t logical_address,
+                       uint8_t *data, uint32_t len, uint16_t dc_address, int64_t *dc_time,
+                       uint32_t timeout_us) {
+    if (!t || !t->ring || !data) return -1;
+    
+    pending_segment_t segments[TRANSPORT_MAX_SEGMENTS];
+    int count = 0;
+    
+    drain_stale(t, stats);
+    
+    TRACE_BEGIN(TRACE_SEND);
+    
+    // Build every frame of the cycle in place in the TX ring, then kick once
+    for (uint32_t offset = 0; offset < len || count == 0; count++) {
+        if (count == TRANSPORT_MAX_SEGMENTS) {
+            TRACE_END(TRACE_SEND);
+            LOG_ERROR("Process image of %u bytes needs more than %d frames", len, TRANSPORT_MAX_SEGMENTS);
+            return -1;
+        }
+        
+        uint8_t *slot = t->tx_ring + (size_t)t->tx_frame * TRANSPORT_FRAME_SIZE;
+        struct tpacket2_hdr *hdr = (struct tpacket2_hdr*)slot;
+        if (__atomic_load_n(&hdr->tp_status, __ATOMIC_ACQUIRE) != TP_STATUS_AVAILABLE) {
+            TRACE_END(TRACE_SEND);
+            LOG_DEBUG("TX ring full");
+            return -1;
+        }
+        
+        uint32_t seg_len = len - offset;
+        if (seg_len > TRANSPORT_MAX_DATA) seg_len = TRANSPORT_MAX_DATA;
+        
+        segments[count].index = (uint8_t)(TRANSPORT_INDEX_BASE + t->next_index);
+        t->next_index = (uint8_t)((t->next_index + 1) % TRANSPORT_INDEX_COUNT);
+        segments[count].offset = offset;
+        segments[count].len = seg_len;
+        segments[count].done = false;
+        
+        uint8_t *frame = slot + TPACKET2_HDRLEN - sizeof(struct sockaddr_ll);
+        uint32_t frame_len = transport_format_frame(frame, t->src_mac, segments[count].index,
+                                                    logical_address + offset, data + offset, seg_len,
+                                                    NULL, 0, count == 0 ? dc_address : 0, 0);
+        
+        capture_frame(t->capture, CAPTURE_TX, frame, frame_len, 0, false);
+        
+        hdr->tp_len = frame_len;
+        __atomic_store_n(&hdr->tp_status, TP_STATUS_SEND_REQUEST, __ATOMIC_RELEASE);
+        t->tx_frame = (t->tx_frame + 1) % TRANSPORT_TX_FRAMES;
+        
+        offset += seg_len;
+    }
+    
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    
+    int sent = send(t->fd, NULL, 0, MSG_DONTWAIT);
+    TRACE_END(TRACE_SEND);
+    t->last_tx_time = start;
+    
+    if (sent < 0 && errno != EAGAIN) {
+        LOG_DEBUG("Packet ring send failed: %s", strerror(errno));
+        return -1;
+    }
+    if (stats) stats->frames_sent += (uint32_t)count;
+    
+    uint64_t deadline = timespec_ns(&start) + (uint64_t)timeout_us * 1000ULL;
+    int remaining = count;
+    int wkc_total = 0;
+    struct timespec now = start;
+    
+    TRACE_BEGIN(TRACE_RECEIVE);
+    while (remaining > 0) {
+        uint8_t *slot = t->rx_ring + (size_t)t->rx_frame * TRANSPORT_FRAME_SIZE;
+        struct tpacket2_hdr *hdr = (struct tpacket2_hdr*)slot;
+        
+        uint32_t status = __atomic_load_n(&hdr->tp_status, __ATOMIC_ACQUIRE);
+        if (status & TP_STATUS_USER) {
+            const struct sockaddr_ll *sll =
+                (const struct sockaddr_ll*)(slot + TPACKET_ALIGN(sizeof(struct tpacket2_hdr)));
+            uint16_t wkc = 0;
+            int seg = (sll->sll_pkttype != PACKET_OUTGOING) ?
+                      parse_frame(slot + hdr->tp_mac, hdr->tp_snaplen, segments, count, data,
+                                  &wkc, dc_time) : -1;
+            
+            if (seg == -2 && stats) {
+                stats->stale_frames++;
+            }
+            if (seg >= 0) {
+                wkc_total += wkc;
+                remaining--;
+                t->last_rx_time.tv_sec = hdr->tp_sec;
+                t->last_rx_time.tv_nsec = hdr->tp_nsec;
+                if (stats) stats->frames_received++;
+                
+                capture_frame(t->capture, CAPTURE_RX, slot + hdr->tp_mac, hdr->tp_snaplen,
+                              (uint64_t)hdr->tp_sec * 1000000000ULL + hdr->tp_nsec,
+                              (status & TP_STATUS_TS_RAW_HARDWARE) != 0);
+            }
+            
+            __atomic_store_n(&hdr->tp_status, TP_STATUS_KERNEL, __ATOMIC_RELEASE);
+            t->rx_frame = (t->rx_frame + 1) % TRANSPORT_RX_FRAMES;
+            continue;
+        }
+        
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        uint64_t now_ns = timespec_ns(&now);
+        if (now_ns >= deadline) {
+            TRACE_END(TRACE_RECEIVE);
+            if (stats) stats->rx_timeouts++;
+            return -1;
+        }
+        
+        // Busy polling spins on the ring; otherwise sleep in the kernel until a frame lands
+        if (t->busy_poll_us == 0) {
+            struct pollfd pfd = { .fd = t->fd, .events = POLLIN };
+            struct timespec wait = { 0, (long)(deadline - now_ns) };
+            ppoll(&pfd, 1, &wait, NULL);
+        }
+    }
+    TRACE_END(TRACE_RECEIVE);
+    
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    if (stats) {
+        transport_record_rtt(stats, (uint32_t)((timespec_ns(&now) - timespec_ns(&start)) / 1000));
+    }
+    
+    return wkc_total;
+}
+
+void transport_record_rtt(transport_stats_t *stats, uint32_t rtt_us) {
+    if (!stats) return;
+    
+    stats->rtt_hist[rtt_us < TRANSPORT_RTT_BUCKETS ? rtt_us : TRANSPORT_RTT_BUCKETS]++;
+    stats->rtt_samples++;
+    if (rtt_us > stats->rtt_max_us) {
+        stats->rtt_max_us = rtt_us;
+    }
+}
+
+uint32_t transport_rtt_percentile(const transport_stats_t *stats, uint32_t permille) {
+    if (!stats || stats->rtt_samples == 0) return 0;
+    
+    uint64_t target = ((uint64_t)stats->rtt_samples * permille + 999) / 1000;
+    uint64_t seen = 0;
+    
+    for (uint32_t i = 0; i <= TRANSPORT_RTT_BUCKETS; i++) {
+        seen += stats->rtt_hist[i];
+        if (seen >= target) {
+            return (i < TRANSPORT_RTT_BUCKETS) ? i : stats->rtt_max_us;
+        }
+    }
+    
+    return stats->rtt_max_us;
+}
@@ -0,0 +1,159 @@
+#include "wirestamp.h"
+#include <string.h>
+#include <time.h>
+
+void wirestamp_init(wirestamp_t *ws, uint32_t cycle_time_us) {
+    if (!ws) return;
+    
+    memset(ws, 0, sizeof(wirestamp_t));
+    uint32_t cycle_ns = (cycle_time_us ? cycle_time_us : 1000) * 1000U;
+    atomic_init(&ws->cycle_ns, cycle_ns);
+    
+    // The histogram spans four cycles; anything later lands in the last bucket
+    ws->bucket_ns = cycle_ns / WIRESTAMP_BUCKETS_PER_CYCLE;
+    if (ws->bucket_ns == 0) ws->bucket_ns = 1;
+}
+
+uint64_t wirestamp_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+int wirestamp_mark(wirestamp_t *ws, uint64_t rx_ns, uint64_t *seq) {
+    if (!ws) return -1;
+    
+    uint64_t head = atomic_load_explicit(&ws->head, memory_order_relaxed);
+    uint64_t done = atomic_load_explicit(&ws->done, memory_order_acquire);
+    
+    if (head - done >= WIRESTAMP_QUEUE_SIZE) {
+        atomic_fetch_add_explicit(&ws->dropped, 1, memory_order_relaxed);
+        return -1;
+    }
+    
+    ws->queue[head % WIRESTAMP_QUEUE_SIZE].rx_ns = rx_ns;
+    atomic_store_explicit(&ws->head, head + 1, memory_order_release);
+    
+    if (seq) *seq = head;
+    return 0;
+}
+
+// Does not wait: fails while the write's cycle has not been sent yet
+int wirestamp_result(wirestamp_t *ws, uint64_t seq, bool *sent, uint32_t *latency_ns) {
+    if (!ws || !sent || !latency_ns) return -1;
+    
+    if (atomic_load_explicit(&ws->done, memory_order_acquire) <= seq) return -1;
+    
+    // Only the producer reuses the slot, so it is stable until the queue
+    // wraps past it
+    const wirestamp_entry_t *entry = &ws->queue[seq % WIRESTAMP_QUEUE_SIZE];
+    *sent = entry->sent;
+    *latency_ns = entry->latency_ns;
+    return 0;
+}
+
+// Taken before the output image is copied into the frame: every write marked
+// by now is in this cycle. A write racing the latch is charged to the next one
+void wirestamp_latch(wirestamp_t *ws) {
+    if (!ws) return;
+    
+    ws->batch_end = atomic_load_explicit(&ws->head, memory_order_acquire);
+}
+
+static void apply_reset(wirestamp_t *ws) {
+    if (atomic_exchange_explicit(&ws->reset_pending, false, memory_order_acquire)) {
+        memset(ws->hist, 0, sizeof(ws->hist));
+        ws->total_ns = 0;
+        atomic_store_explicit(&ws->samples, 0, memory_order_relaxed);
+        atomic_store_explicit(&ws->dropped, 0, memory_order_relaxed);
+        atomic_store_explicit(&ws->max_ns, 0, memory_order_relaxed);
+    }
+}
+
+void wirestamp_complete(wirestamp_t *ws, uint64_t tx_ns) {
+    if (!ws) return;
+    
+    apply_reset(ws);
+    
+    uint64_t seq = atomic_load_explicit(&ws->done, memory_order_relaxed);
+    if (seq == ws->batch_end) return;
+    
+    uint32_t max_ns = atomic_load_explicit(&ws->max_ns, memory_order_relaxed);
+    
+    for (; seq < ws->batch_end; seq++) {
+        wirestamp_entry_t *entry = &ws->queue[seq % WIRESTAMP_QUEUE_SIZE];
+        uint64_t latency = (tx_ns > entry->rx_ns) ? tx_ns - entry->rx_ns : 0;
+        if (latency > UINT32_MAX) latency = UINT32_MAX;
+        
+        entry->latency_ns = (uint32_t)latency;
+        entry->sent = true;
+        
+        uint32_t bucket = (uint32_t)(latency / ws->bucket_ns);
+        ws->hist[bucket < WIRESTAMP_BUCKETS ? bucket : WIRESTAMP_BUCKETS]++;
+        ws->total_ns += latency;
+        if (latency > max_ns) max_ns = (uint32_t)latency;
+        atomic_fetch_add_explicit(&ws->samples, 1, memory_order_relaxed);
+    }
+    
+    atomic_store_explicit(&ws->max_ns, max_ns, memory_order_relaxed);
+    atomic_store_explicit(&ws->done, ws->batch_end, memory_order_release);
+}
+
+// Runs every RT cycle while the network is down: applies a requested reset
+// and retires writes that will never be sent, without a sample
+void wirestamp_idle(wirestamp_t *ws) {
+    if (!ws) return;
+    
+    apply_reset(ws);
+    
+    uint64_t seq = atomic_load_explicit(&ws->done, memory_order_relaxed);
+    uint64_t head = atomic_load_explicit(&ws->head, memory_order_acquire);
+    if (seq == head) return;
+    
+    for (; seq < head; seq++) {
+        ws->queue[seq % WIRESTAMP_QUEUE_SIZE].sent = false;
+    }
+    atomic_store_explicit(&ws->done, head, memory_order_release);
+}
+
+void wirestamp_reset(wirestamp_t *ws) {
+    if (!ws) return;
+    
+    atomic_store_explicit(&ws->reset_pending, true, memory_order_release);
+}
+
+static uint32_t wirestamp_percentile_us(const wirestamp_t *ws, uint32_t samples,
+                                        uint32_t basis_points) {
+    if (samples == 0) return 0;
+    
+    uint64_t target = ((uint64_t)samples * basis_points + 9999) / 10000;
+    uint64_t seen = 0;
+    
+    for (uint32_t i = 0; i <= WIRESTAMP_BUCKETS; i++) {
+        seen += ws->hist[i];
+        if (seen >= target) {
+            return (uint32_t)(((uint64_t)(i + 1) * ws->bucket_ns) / 1000);
+        }
+    }
+    
+    return atomic_load_explicit(&ws->max_ns, memory_order_relaxed) / 1000;
+}
+
+void wirestamp_get_stats(wirestamp_t *ws, wirestamp_stats_t *stats) {
+    if (!ws || !stats) return;
+    
+    memset(stats, 0, sizeof(wirestamp_stats_t));
+    stats->samples = atomic_load_explicit(&ws->samples, memory_order_relaxed);
+    stats->dropped = atomic_load_explicit(&ws->dropped, memory_order_relaxed);
+    stats->max_us = atomic_load_explicit(&ws->max_ns, memory_order_relaxed) / 1000;
+    
+    if (stats->samples > 0) {
+        stats->mean_us = (uint32_t)(ws->total_ns / stats->samples / 1000);
+        stats->p50_us = wirestamp_percentile_us(ws, stats->samples, 5000);
+        stats->p99_us = wirestamp_percentile_us(ws, stats->samples, 9900);
+        stats->p999_us = wirestamp_percentile_us(ws, stats->samples, 9990);
+        if (stats->p50_us > stats->max_us) stats->p50_us = stats->max_us;
+        if (stats->p99_us > stats->max_us) stats->p99_us = stats->max_us;
+        if (stats->p999_us > stats->max_us) stats->p999_us = stats->max_us;
+    }
+}
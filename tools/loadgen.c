@@ -0,0 +1,678 @@
+#include "protocol.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <getopt.h>
+#include <poll.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+
+#define LG_MAX_CLIENTS          256
+#define LG_MAX_WINDOW           1024
+#define LG_HIST_SUB_BITS        7
+#define LG_HIST_SUB             (1U << LG_HIST_SUB_BITS)
+#define LG_HIST_HALF            (LG_HIST_SUB / 2)
+#define LG_HIST_BUCKETS         (LG_HIST_SUB + (64 - LG_HIST_SUB_BITS) * LG_HIST_HALF)
+
+typedef enum {
+    LG_OP_READ = 0,
+    LG_OP_WRITE,
+    LG_OP_STATUS,
+    LG_OP_TIMING,
+    LG_OP_SLAVE,
+    LG_OP_COUNT
+} lg_op_t;
+
+static const struct {
+    const char *name;
+    uint8_t type;
+    uint8_t id;
+} g_ops[LG_OP_COUNT] = {
+    { "read",   CMD_CATEGORY_PDO,        PDO_READ },
+    { "write",  CMD_CATEGORY_PDO,        PDO_WRITE },
+    { "status", CMD_CATEGORY_NETWORK,    NET_STATUS },
+    { "timing", CMD_CATEGORY_DIAGNOSTIC, DIAG_TIMING },
+    { "slave",  CMD_CATEGORY_DIAGNOSTIC, DIAG_SLAVE },
+};
+
+typedef enum {
+    LG_MODE_CLOSED = 0,
+    LG_MODE_OPEN
+} lg_mode_t;
+
+typedef struct {
+    char host[64];
+    uint16_t port;
+    uint32_t clients;
+    uint32_t duration_s;
+    uint32_t warmup_s;
+    double rate;
+    lg_mode_t mode;
+    uint32_t window;
+    uint32_t timeout_ms;
+    uint32_t slaves;
+    uint32_t slave_bytes;
+    uint32_t mix[LG_OP_COUNT];
+    uint32_t mix_total;
+    bool start_network;
+} lg_options_t;
+
+// Log-linear histogram of nanoseconds with LG_HIST_SUB_BITS of precision
+typedef struct {
+    uint64_t counts[LG_HIST_BUCKETS];
+    uint64_t total;
+    uint64_t max;
+} lg_hist_t;
+
+// Indexed by request tag modulo LG_MAX_WINDOW
+typedef struct {
+    uint64_t intended_ns;
+    uint64_t sent_ns;
+    uint32_t seq;
+    bool pending;
+} lg_inflight_t;
+
+typedef struct {
+    uint32_t id;
+    int fd;
+    pthread_t thread;
+    uint64_t rng;
+    uint64_t interval_ns;
+    uint64_t start_ns;
+    uint64_t measure_ns;
+    uint64_t end_ns;
+    
+    lg_inflight_t inflight[LG_MAX_WINDOW];
+    uint32_t head_seq;
+    uint32_t next_seq;
+    uint32_t count;
+    
+    lg_hist_t response;
+    lg_hist_t service;
+    uint64_t service_sum_ns;
+    uint64_t sent;
+    uint64_t received;
+    uint64_t errors;
+    uint64_t timeouts;
+    uint64_t ops[LG_OP_COUNT];
+} lg_client_t;
+
+static lg_options_t g_opts;
+static struct sockaddr_in g_server;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static uint64_t next_random(lg_client_t *c) {
+    c->rng ^= c->rng << 13;
+    c->rng ^= c->rng >> 7;
+    c->rng ^= c->rng << 17;
+    return c->rng;
+}
+
+static uint32_t hist_index(uint64_t value) {
+    if (value < LG_HIST_SUB) return (uint32_t)value;
+    
+    uint32_t msb = 63 - (uint32_t)__builtin_clzll(value);
+    uint32_t shift = msb - (LG_HIST_SUB_BITS - 1);
+    uint32_t mantissa = (uint32_t)(value >> shift);
+    return LG_HIST_SUB + (shift - 1) * LG_HIST_HALF + (mantissa - LG_HIST_HALF);
+}
+
+static uint64_t hist_value(uint32_t index) {
+    if (index < LG_HIST_SUB) return index;
+    
+    uint32_t k = index - LG_HIST_SUB;
+    uint32_t shift = k / LG_HIST_HALF + 1;
+    uint64_t mantissa = k % LG_HIST_HALF + LG_HIST_HALF;
+    return (mantissa << shift) + ((1ULL << shift) - 1);
+}
+
+static void hist_record(lg_hist_t *h, uint64_t value) {
+    h->counts[hist_index(value)]++;
+    h->total++;
+    if (value > h->max) h->max = value;
+}
+
+// Closed-loop senders stall while a slow response is outstanding, hiding the
+// requests they would have sent meanwhile. Back-fill those as in HdrHistogram
+static void hist_record_corrected(lg_hist_t *h, uint64_t value, uint64_t interval) {
+    hist_record(h, value);
+    if (interval == 0) return;
+    
+    for (uint64_t missing = (value > interval) ? value - interval : 0; missing >= interval;
+         missing -= interval) {
+        hist_record(h, missing);
+    }
+}
+
+static void hist_merge(lg_hist_t *dst, const lg_hist_t *src) {
+    for (uint32_t i = 0; i < LG_HIST_BUCKETS; i++) {
+        dst->counts[i] += src->counts[i];
+    }
+    dst->total += src->total;
+    if (src->max > dst->max) dst->max = src->max;
+}
+
+static uint64_t hist_percentile(const lg_hist_t *h, double percentile) {
+    if (h->total == 0) return 0;
+    
+    uint64_t rank = (uint64_t)((percentile / 100.0) * (double)h->total + 0.5);
+    if (rank == 0) rank = 1;
+    
+    uint64_t seen = 0;
+    for (uint32_t i = 0; i < LG_HIST_BUCKETS; i++) {
+        seen += h->counts[i];
+        if (seen >= rank) {
+            uint64_t value = hist_value(i);
+            return (value > h->max) ? h->max : value;
+        }
+    }
+    return h->max;
+}
+
+static void build_command(lg_client_t *c, lg_op_t op, udp_command_t *cmd) {
+    uint32_t payload[4] = {0};
+    uint16_t len = 0;
+    
+    uint32_t slave = 1 + (uint32_t)(next_random(c) % g_opts.slaves);
+    uint32_t words = (g_opts.slave_bytes >= 4) ? g_opts.slave_bytes / 4 : 1;
+    uint32_t offset = (slave - 1) * g_opts.slave_bytes + 4 * (uint32_t)(next_random(c) % words);
+    uint32_t size = (g_opts.slave_bytes >= 4) ? 4 : g_opts.slave_bytes;
+    
+    switch (op) {
+        case LG_OP_READ:
+            payload[0] = htonl(slave);
+            payload[1] = htonl(offset);
+            payload[2] = htonl(size);
+            len = 12;
+            break;
+        case LG_OP_WRITE:
+            payload[0] = htonl(slave);
+            payload[1] = htonl(offset);
+            payload[2] = htonl((uint32_t)next_random(c));
+            len = 12;
+            break;
+        case LG_OP_SLAVE:
+            // DIAG_SLAVE takes a zero-based slave table index
+            payload[0] = htonl(slave - 1);
+            len = 4;
+            break;
+        default:
+            break;
+    }
+    
+    memset(cmd, 0, sizeof(udp_command_t));
+    cmd->magic = htonl(PROTOCOL_MAGIC_CMD);
+    cmd->command_type = g_ops[op].type;
+    cmd->command_id = g_ops[op].id;
+    cmd->payload_len = htons(len);
+    memcpy(cmd->payload, payload, len);
+}
+
+static lg_op_t pick_op(lg_client_t *c) {
+    uint32_t pick = (uint32_t)(next_random(c) % g_opts.mix_total);
+    
+    for (int i = 0; i < LG_OP_COUNT; i++) {
+        if (pick < g_opts.mix[i]) return (lg_op_t)i;
+        pick -= g_opts.mix[i];
+    }
+    return LG_OP_READ;
+}
+
+static int send_request(lg_client_t *c, uint64_t intended) {
+    udp_tagged_command_t msg;
+    lg_op_t op = pick_op(c);
+    build_command(c, op, &msg.cmd);
+    msg.tag = htonl(c->next_seq);
+    
+    uint64_t sent = now_ns();
+    if (send(c->fd, &msg, sizeof(msg), 0) < 0) {
+        if (errno == EAGAIN || errno == EWOULDBLOCK || errno == ENOBUFS) return -1;
+        fprintf(stderr, "client %u: send failed: %s\n", c->id, strerror(errno));
+        return -1;
+    }
+    
+    lg_inflight_t *slot = &c->inflight[c->next_seq % LG_MAX_WINDOW];
+    slot->intended_ns = intended;
+    slot->sent_ns = sent;
+    slot->seq = c->next_seq++;
+    slot->pending = true;
+    c->count++;
+    
+    if (intended >= c->measure_ns) {
+        c->sent++;
+        c->ops[op]++;
+    }
+    return 0;
+}
+
+// Moves the head past requests that were answered out of order
+static void advance_head(lg_client_t *c) {
+    while (c->head_seq != c->next_seq && !c->inflight[c->head_seq % LG_MAX_WINDOW].pending) {
+        c->head_seq++;
+    }
+}
+
+// Requests are tagged with a per-client sequence number that the daemon
+// echoes, so a reply completes exactly the request it answers. Replies to
+// requests that already timed out are dropped
+static void complete_request(lg_client_t *c, uint32_t seq, uint64_t received, bool error) {
+    lg_inflight_t *req = &c->inflight[seq % LG_MAX_WINDOW];
+    if (seq - c->head_seq >= c->next_seq - c->head_seq || !req->pending || req->seq != seq) {
+        return;
+    }
+    req->pending = false;
+    c->count--;
+    advance_head(c);
+    
+    if (req->intended_ns < c->measure_ns) return;
+    
+    uint64_t service = received - req->sent_ns;
+    uint64_t response = received - req->intended_ns;
+    
+    c->received++;
+    if (error) c->errors++;
+    c->service_sum_ns += service;
+    hist_record(&c->service, service);
+    
+    if (g_opts.mode == LG_MODE_CLOSED) {
+        hist_record_corrected(&c->response, response, c->interval_ns);
+    } else {
+        hist_record(&c->response, response);
+    }
+}
+
+static void expire_requests(lg_client_t *c, uint64_t now) {
+    uint64_t timeout = (uint64_t)g_opts.timeout_ms * 1000000ULL;
+    
+    while (c->count > 0) {
+        lg_inflight_t *req = &c->inflight[c->head_seq % LG_MAX_WINDOW];
+        if (now - req->sent_ns <= timeout) break;
+        
+        if (req->intended_ns >= c->measure_ns) c->timeouts++;
+        req->pending = false;
+        c->count--;
+        c->head_seq++;
+        advance_head(c);
+    }
+}
+
+static void* client_thread_func(void *arg) {
+    lg_client_t *c = (lg_client_t*)arg;
+    uint32_t window = (g_opts.mode == LG_MODE_OPEN) ? g_opts.window : 1;
+    uint64_t timeout = (uint64_t)g_opts.timeout_ms * 1000000ULL;
+    uint64_t next_intended = c->start_ns;
+    
+    while (now_ns() < c->start_ns) {
+        struct timespec ts = { 0, 100000 };
+        nanosleep(&ts, NULL);
+    }
+    
+    for (;;) {
+        uint64_t now = now_ns();
+        if (now >= c->end_ns) break;
+        
+        // Everything that is due goes out now; late sends keep their intended
+        // time so queueing in the generator is charged to the daemon
+        while (c->count < window && c->next_seq - c->head_seq < LG_MAX_WINDOW &&
+               (c->interval_ns == 0 || next_intended <= now)) {
+            uint64_t intended = (c->interval_ns == 0) ? now : next_intended;
+            if (send_request(c, intended) < 0) break;
+            next_intended = intended + c->interval_ns;
+        }
+        
+        uint64_t wake = c->end_ns;
+        const lg_inflight_t *oldest = &c->inflight[c->head_seq % LG_MAX_WINDOW];
+        if (c->count > 0 && oldest->sent_ns + timeout < wake) {
+            wake = oldest->sent_ns + timeout;
+        }
+        if (c->interval_ns > 0 && c->count < window && next_intended < wake) {
+            wake = next_intended;
+        }
+        
+        now = now_ns();
+        uint64_t wait = (wake > now) ? wake - now : 0;
+        struct timespec ts = { (time_t)(wait / 1000000000ULL), (long)(wait % 1000000000ULL) };
+        struct pollfd pfd = { .fd = c->fd, .events = POLLIN };
+        
+        if (ppoll(&pfd, 1, &ts, NULL) > 0) {
+            udp_tagged_response_t reply;
+            ssize_t n;
+            
+            while ((n = recv(c->fd, &reply, sizeof(reply), MSG_DONTWAIT)) > 0) {
+                uint64_t received = now_ns();
+                // An untagged reply cannot be matched; its request times out
+                if ((size_t)n != sizeof(reply) || c->count == 0) continue;
+                
+                bool error = ntohl(reply.resp.magic) != PROTOCOL_MAGIC_RESP ||
+                             reply.resp.status != STATUS_SUCCESS;
+                complete_request(c, ntohl(reply.tag), received, error);
+            }
+        }
+        
+        expire_requests(c, now_ns());
+    }
+    
+    return NULL;
+}
+
+static int open_client_socket(void) {
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd < 0) {
+        fprintf(stderr, "socket: %s\n", strerror(errno));
+        return -1;
+    }
+    
+    int rcvbuf = 1 << 20;
+    setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+    
+    if (connect(fd, (struct sockaddr*)&g_server, sizeof(g_server)) < 0) {
+        fprintf(stderr, "connect: %s\n", strerror(errno));
+        close(fd);
+        return -1;
+    }
+    
+    return fd;
+}
+
+static int simple_request(int fd, uint8_t type, uint8_t id, udp_response_t *resp) {
+    udp_command_t cmd;
+    memset(&cmd, 0, sizeof(cmd));
+    cmd.magic = htonl(PROTOCOL_MAGIC_CMD);
+    cmd.command_type = type;
+    cmd.command_id = id;
+    
+    if (send(fd, &cmd, sizeof(cmd), 0) < 0) return -1;
+    
+    struct pollfd pfd = { .fd = fd, .events = POLLIN };
+    if (poll(&pfd, 1, (int)g_opts.timeout_ms * 10) <= 0) return -1;
+    
+    return (recv(fd, resp, sizeof(*resp), 0) == sizeof(*resp)) ? 0 : -1;
+}
+
+// Make sure the daemon has its (simulated) network up before measuring
+static int prepare_network(void) {
+    int fd = open_client_socket();
+    if (fd < 0) return -1;
+    
+    udp_response_t resp;
+    if (simple_request(fd, CMD_CATEGORY_NETWORK, NET_STATUS, &resp) < 0) {
+        fprintf(stderr, "No response from %s:%u\n", g_opts.host, g_opts.port);
+        close(fd);
+        return -1;
+    }
+    
+    uint32_t slaves;
+    memcpy(&slaves, resp.payload, sizeof(slaves));
+    slaves = ntohl(slaves);
+    bool active = resp.payload[4] != 0;
+    
+    if (!active && g_opts.start_network) {
+        if (simple_request(fd, CMD_CATEGORY_NETWORK, NET_START, &resp) < 0 ||
+            resp.status != STATUS_SUCCESS ||
+            simple_request(fd, CMD_CATEGORY_NETWORK, NET_STATUS, &resp) < 0) {
+            fprintf(stderr, "Failed to start the EtherCAT network\n");
+            close(fd);
+            return -1;
+        }
+        memcpy(&slaves, resp.payload, sizeof(slaves));
+        slaves = ntohl(slaves);
+        active = true;
+    }
+    
+    close(fd);
+    
+    printf("Daemon at %s:%u: network %s, %u slaves\n", g_opts.host, g_opts.port,
+           active ? "active" : "inactive", slaves);
+    if (slaves == 0 && (g_opts.mix[LG_OP_READ] || g_opts.mix[LG_OP_WRITE])) {
+        printf("Warning: no slaves, PDO commands will fail (enable simulate_slaves)\n");
+    }
+    return 0;
+}
+
+static int parse_mix(const char *spec) {
+    char buf[256];
+    snprintf(buf, sizeof(buf), "%s", spec);
+    memset(g_opts.mix, 0, sizeof(g_opts.mix));
+    g_opts.mix_total = 0;
+    
+    char *save = NULL;
+    for (char *tok = strtok_r(buf, ",", &save); tok; tok = strtok_r(NULL, ",", &save)) {
+        char *eq = strchr(tok, '=');
+        if (!eq) return -1;
+        *eq = '\0';
+        
+        int op = -1;
+        for (int i = 0; i < LG_OP_COUNT; i++) {
+            if (strcmp(tok, g_ops[i].name) == 0) op = i;
+        }
+        if (op < 0) return -1;
+        
+        g_opts.mix[op] = (uint32_t)atoi(eq + 1);
+        g_opts.mix_total += g_opts.mix[op];
+    }
+    
+    return (g_opts.mix_total > 0) ? 0 : -1;
+}
+
+static void print_percentiles(const char *label, const lg_hist_t *h) {
+    static const double percentiles[] = { 50.0, 90.0, 99.0, 99.9, 99.99 };
+    
+    printf("  %-22s", label);
+    for (size_t i = 0; i < sizeof(percentiles) / sizeof(percentiles[0]); i++) {
+        printf(" %9.1f", (double)hist_percentile(h, percentiles[i]) / 1000.0);
+    }
+    printf(" %9.1f\n", (double)h->max / 1000.0);
+}
+
+static void print_usage(const char *program_name) {
+    printf("EtherForge load generator\n");
+    printf("Usage: %s [OPTIONS]\n", program_name);
+    printf("\nOptions:\n");
+    printf("  -H, --host ADDR        Daemon address (default: 127.0.0.1)\n");
+    printf("  -p, --port PORT        Daemon UDP port (default: %d)\n", PROTOCOL_PORT);
+    printf("  -c, --clients N        Simulated clients, one socket each (default: 4)\n");
+    printf("  -d, --duration SEC     Measured duration (default: 10)\n");
+    printf("  -w, --warmup SEC       Unmeasured warmup before the run (default: 1)\n");
+    printf("  -r, --rate OPS         Target total ops/s, split across clients\n");
+    printf("  -m, --mode MODE        closed (one request in flight) or open (paced, default: closed)\n");
+    printf("  -W, --window N         Max in-flight requests per client in open mode (default: 64)\n");
+    printf("  -x, --mix SPEC         Command weights, e.g. read=70,write=20,status=5,timing=5\n");
+    printf("                         Commands: read, write, status, timing, slave\n");
+    printf("  -s, --slaves N         Slaves addressed by PDO/slave commands (default: 8)\n");
+    printf("  -b, --slave-bytes N    Process data bytes per slave (default: 8)\n");
+    printf("  -t, --timeout-ms MS    Response timeout (default: 100)\n");
+    printf("  -n, --no-start         Do not send NET_START when the network is inactive\n");
+    printf("  -h, --help             Show this help message\n");
+}
+
+int main(int argc, char *argv[]) {
+    memset(&g_opts, 0, sizeof(g_opts));
+    snprintf(g_opts.host, sizeof(g_opts.host), "127.0.0.1");
+    g_opts.port = PROTOCOL_PORT;
+    g_opts.clients = 4;
+    g_opts.duration_s = 10;
+    g_opts.warmup_s = 1;
+    g_opts.mode = LG_MODE_CLOSED;
+    g_opts.window = 64;
+    g_opts.timeout_ms = 100;
+    g_opts.slaves = 8;
+    g_opts.slave_bytes = 8;
+    g_opts.start_network = true;
+    parse_mix("read=70,write=20,status=5,timing=5");
+    
+    static struct option long_options[] = {
+        {"host",        required_argument, 0, 'H'},
+        {"port",        required_argument, 0, 'p'},
+        {"clients",     required_argument, 0, 'c'},
+        {"duration",    required_argument, 0, 'd'},
+        {"warmup",      required_argument, 0, 'w'},
+        {"rate",        required_argument, 0, 'r'},
+        {"mode",        required_argument, 0, 'm'},
+        {"window",      required_argument, 0, 'W'},
+        {"mix",         required_argument, 0, 'x'},
+        {"slaves",      required_argument, 0, 's'},
+        {"slave-bytes", required_argument, 0, 'b'},
+        {"timeout-ms",  required_argument, 0, 't'},
+        {"no-start",    no_argument,       0, 'n'},
+        {"help",        no_argument,       0, 'h'},
+        {0, 0, 0, 0}
+    };
+    
+    int c;
+    while ((c = getopt_long(argc, argv, "H:p:c:d:w:r:m:W:x:s:b:t:nh", long_options, NULL)) != -1) {
+        switch (c) {
+            case 'H':
+                snprintf(g_opts.host, sizeof(g_opts.host), "%s", optarg);
+                break;
+            case 'p': g_opts.port = (uint16_t)atoi(optarg); break;
+            case 'c': g_opts.clients = (uint32_t)atoi(optarg); break;
+            case 'd': g_opts.duration_s = (uint32_t)atoi(optarg); break;
+            case 'w': g_opts.warmup_s = (uint32_t)atoi(optarg); break;
+            case 'r': g_opts.rate = atof(optarg); break;
+            case 'm':
+                if (strcmp(optarg, "open") == 0) {
+                    g_opts.mode = LG_MODE_OPEN;
+                } else if (strcmp(optarg, "closed") == 0) {
+                    g_opts.mode = LG_MODE_CLOSED;
+                } else {
+                    fprintf(stderr, "Unknown mode: %s\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'W': g_opts.window = (uint32_t)atoi(optarg); break;
+            case 'x':
+                if (parse_mix(optarg) < 0) {
+                    fprintf(stderr, "Invalid command mix: %s\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 's': g_opts.slaves = (uint32_t)atoi(optarg); break;
+            case 'b': g_opts.slave_bytes = (uint32_t)atoi(optarg); break;
+            case 't': g_opts.timeout_ms = (uint32_t)atoi(optarg); break;
+            case 'n': g_opts.start_network = false; break;
+            case 'h':
+                print_usage(argv[0]);
+                return EXIT_SUCCESS;
+            default:
+                print_usage(argv[0]);
+                return EXIT_FAILURE;
+        }
+    }
+    
+    if (g_opts.clients == 0 || g_opts.clients > LG_MAX_CLIENTS || g_opts.duration_s == 0 ||
+        g_opts.slaves == 0 || g_opts.slave_bytes == 0 || g_opts.timeout_ms == 0 ||
+        g_opts.window == 0 || g_opts.window > LG_MAX_WINDOW) {
+        fprintf(stderr, "Invalid options (clients 1-%d, window 1-%d)\n", LG_MAX_CLIENTS,
+                LG_MAX_WINDOW);
+        return EXIT_FAILURE;
+    }
+    
+    if (g_opts.mode == LG_MODE_OPEN && g_opts.rate <= 0) {
+        fprintf(stderr, "Open-loop mode needs --rate\n");
+        return EXIT_FAILURE;
+    }
+    
+    memset(&g_server, 0, sizeof(g_server));
+    g_server.sin_family = AF_INET;
+    g_server.sin_port = htons(g_opts.port);
+    if (inet_pton(AF_INET, g_opts.host, &g_server.sin_addr) <= 0) {
+        fprintf(stderr, "Invalid host address: %s\n", g_opts.host);
+        return EXIT_FAILURE;
+    }
+    
+    if (prepare_network() < 0) return EXIT_FAILURE;
+    
+    lg_client_t *clients = calloc(g_opts.clients, sizeof(lg_client_t));
+    if (!clients) {
+        fprintf(stderr, "Out of memory\n");
+        return EXIT_FAILURE;
+    }
+    
+    uint64_t interval = (g_opts.rate > 0) ?
+        (uint64_t)(1e9 * (double)g_opts.clients / g_opts.rate) : 0;
+    uint64_t start = now_ns() + 100000000ULL;
+    uint64_t measure = start + (uint64_t)g_opts.warmup_s * 1000000000ULL;
+    uint64_t end = measure + (uint64_t)g_opts.duration_s * 1000000000ULL;
+    uint32_t started = 0;
+    
+    printf("Running %u %s-loop clients for %us (+%us warmup)", g_opts.clients,
+           g_opts.mode == LG_MODE_OPEN ? "open" : "closed", g_opts.duration_s, g_opts.warmup_s);
+    if (g_opts.rate > 0) printf(" at %.0f ops/s", g_opts.rate);
+    printf("\n");
+    
+    for (uint32_t i = 0; i < g_opts.clients; i++) {
+        lg_client_t *cl = &clients[i];
+        cl->id = i;
+        cl->rng = 0x9E3779B97F4A7C15ULL * (i + 1);
+        cl->interval_ns = interval;
+        // Stagger paced clients so their sends do not line up
+        cl->start_ns = start + (interval ? interval * i / g_opts.clients : 0);
+        cl->measure_ns = measure;
+        cl->end_ns = end;
+        cl->fd = open_client_socket();
+        
+        if (cl->fd < 0 || pthread_create(&cl->thread, NULL, client_thread_func, cl) != 0) {
+            fprintf(stderr, "Failed to start client %u\n", i);
+            if (cl->fd >= 0) close(cl->fd);
+            break;
+        }
+        started++;
+    }
+    
+    lg_hist_t *response = calloc(1, sizeof(lg_hist_t));
+    lg_hist_t *service = calloc(1, sizeof(lg_hist_t));
+    uint64_t sent = 0, received = 0, errors = 0, timeouts = 0, service_sum = 0;
+    uint64_t ops[LG_OP_COUNT] = {0};
+    
+    for (uint32_t i = 0; i < started; i++) {
+        pthread_join(clients[i].thread, NULL);
+        close(clients[i].fd);
+        
+        hist_merge(response, &clients[i].response);
+        hist_merge(service, &clients[i].service);
+        sent += clients[i].sent;
+        received += clients[i].received;
+        errors += clients[i].errors;
+        timeouts += clients[i].timeouts;
+        service_sum += clients[i].service_sum_ns;
+        for (int op = 0; op < LG_OP_COUNT; op++) ops[op] += clients[i].ops[op];
+    }
+    
+    double seconds = (double)g_opts.duration_s;
+    printf("\nRequests: %lu sent, %lu received, %lu errors, %lu timeouts\n",
+           (unsigned long)sent, (unsigned long)received, (unsigned long)errors,
+           (unsigned long)timeouts);
+    printf("Mix:");
+    for (int op = 0; op < LG_OP_COUNT; op++) {
+        if (g_opts.mix[op]) printf(" %s=%lu", g_ops[op].name, (unsigned long)ops[op]);
+    }
+    printf("\nThroughput: %.0f ops/s", (double)received / seconds);
+    if (g_opts.rate > 0) printf(" (target %.0f)", g_opts.rate);
+    printf("\nMean service time: %.1f us\n",
+           received ? (double)service_sum / (double)received / 1000.0 : 0.0);
+    
+    printf("\nLatency (us)                p50       p90       p99     p99.9    p99.99       max\n");
+    print_percentiles("response (corrected)", response);
+    print_percentiles("service", service);
+    
+    if (g_opts.mode == LG_MODE_CLOSED && interval == 0) {
+        printf("\nNote: closed loop without --rate has no schedule to correct against;\n"
+               "      pass --rate or use --mode open for coordinated-omission-free numbers\n");
+    }
+    
+    free(response);
+    free(service);
+    free(clients);
+    
+    return (started == g_opts.clients && timeouts == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,555 @@
+#include "protocol.h"
+#include "symbols.h"
+#include "logging.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <ctype.h>
+#include <errno.h>
+#include <getopt.h>
+#include <poll.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <yaml.h>
+
+typedef struct {
+    char host[64];
+    uint16_t port;
+    uint32_t timeout_ms;
+    const char *yaml_path;
+    const char *output_path;
+} pg_options_t;
+
+static pg_options_t g_opts;
+static symbol_table_t g_table;
+
+static int open_client_socket(void) {
+    struct sockaddr_in server;
+    memset(&server, 0, sizeof(server));
+    server.sin_family = AF_INET;
+    server.sin_port = htons(g_opts.port);
+    if (inet_pton(AF_INET, g_opts.host, &server.sin_addr) != 1) {
+        fprintf(stderr, "Invalid host address: %s\n", g_opts.host);
+        return -1;
+    }
+    
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd < 0) {
+        fprintf(stderr, "socket: %s\n", strerror(errno));
+        return -1;
+    }
+    
+    if (connect(fd, (struct sockaddr*)&server, sizeof(server)) < 0) {
+        fprintf(stderr, "connect: %s\n", strerror(errno));
+        close(fd);
+        return -1;
+    }
+    
+    return fd;
+}
+
+static int request(int fd, uint8_t type, uint8_t id, const void *payload, uint16_t len,
+                   udp_response_t *resp) {
+    udp_command_t cmd;
+    memset(&cmd, 0, sizeof(cmd));
+    cmd.magic = htonl(PROTOCOL_MAGIC_CMD);
+    cmd.command_type = type;
+    cmd.command_id = id;
+    cmd.payload_len = htons(len);
+    if (len > 0) memcpy(cmd.payload, payload, len);
+    
+    if (send(fd, &cmd, sizeof(cmd), 0) < 0) return -1;
+    
+    struct pollfd pfd = { .fd = fd, .events = POLLIN };
+    if (poll(&pfd, 1, (int)g_opts.timeout_ms) <= 0) return -1;
+    
+    if (recv(fd, resp, sizeof(*resp), 0) != sizeof(*resp)) return -1;
+    return (resp->status == STATUS_SUCCESS) ? 0 : -1;
+}
+
+// Walk the daemon's symbol table: SYM_LIST names every entry, SYM_RESOLVE
+// returns where it lives. Rebuilding the table here yields the same layout
+// hash the daemon computed, which is checked against the one it reports
+static int load_from_daemon(void) {
+    int fd = open_client_socket();
+    if (fd < 0) return -1;
+    
+    udp_response_t resp;
+    if (request(fd, CMD_CATEGORY_SYMBOL, SYM_LIST, NULL, 0, &resp) < 0 ||
+        ntohs(resp.payload_len) < 12) {
+        fprintf(stderr, "No symbol table from %s:%u (is the network started?)\n", g_opts.host,
+                g_opts.port);
+        close(fd);
+        return -1;
+    }
+    
+    uint32_t info[3];
+    memcpy(info, resp.payload, sizeof(info));
+    uint32_t count = ntohl(info[0]);
+    uint32_t generation = ntohl(info[1]);
+    uint32_t daemon_hash = ntohl(info[2]);
+    
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t index = htonl(i);
+        if (request(fd, CMD_CATEGORY_SYMBOL, SYM_LIST, &index, 4, &resp) < 0) {
+            fprintf(stderr, "SYM_LIST %u failed\n", i);
+            close(fd);
+            return -1;
+        }
+        
+        char name[SYMBOL_NAME_LEN];
+        snprintf(name, sizeof(name), "%.*s", PROTOCOL_MAX_PAYLOAD - 4,
+                 (const char*)resp.payload + 4);
+        
+        if (request(fd, CMD_CATEGORY_SYMBOL, SYM_RESOLVE, name, (uint16_t)strlen(name),
+                    &resp) < 0) {
+            fprintf(stderr, "SYM_RESOLVE %s failed\n", name);
+            close(fd);
+            return -1;
+        }
+        
+        uint16_t slave;
+        uint16_t bits;
+        uint32_t offset;
+        memcpy(&slave, resp.payload + 4, 2);
+        memcpy(&offset, resp.payload + 8, 4);
+        memcpy(&bits, resp.payload + 14, 2);
+        
+        symbol_t symbol;
+        memset(&symbol, 0, sizeof(symbol));
+        symbol.slave = ntohs(slave);
+        symbol.dir = resp.payload[6];
+        symbol.type = resp.payload[7];
+        symbol.offset = ntohl(offset);
+        symbol.bit = resp.payload[12];
+        symbol.bits = ntohs(bits);
+        
+        // Index and subindex are only carried in the name
+        unsigned int obj = 0;
+        unsigned int sub = 0;
+        const char *entry = strchr(strchr(name, '.') + 1, '.');
+        if (entry && sscanf(entry + 1, "%x:%x", &obj, &sub) == 2) {
+            symbol.index = (uint16_t)obj;
+            symbol.subindex = (uint8_t)sub;
+        }
+        
+        if (symbols_add(&g_table, name, &symbol) < 0) {
+            close(fd);
+            return -1;
+        }
+    }
+    
+    close(fd);
+    
+    if (symbols_build(&g_table) < 0) return -1;
+    
+    if (g_table.layout_hash != daemon_hash) {
+        fprintf(stderr, "Layout hash mismatch: daemon 0x%08X, rebuilt 0x%08X\n", daemon_hash,
+                g_table.layout_hash);
+        return -1;
+    }
+    
+    fprintf(stderr, "Read %u symbols (generation %u) from %s:%u\n", count, generation,
+            g_opts.host, g_opts.port);
+    return 0;
+}
+
+typedef enum {
+    PG_KEY_NONE = 0,
+    PG_KEY_INDEX,
+    PG_KEY_SUBINDEX,
+    PG_KEY_BITS
+} pg_key_t;
+
+// Slaves are laid out one after another, each starting on a byte boundary
+// of both images, with entries packed in the order listed. Index 0 entries
+// are padding: they take up bits but get no symbol, as on the daemon
+static int load_from_yaml(const char *path) {
+    FILE *file = fopen(path, "r");
+    if (!file) {
+        fprintf(stderr, "Failed to open %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+    
+    yaml_parser_t parser;
+    if (!yaml_parser_initialize(&parser)) {
+        fclose(file);
+        return -1;
+    }
+    yaml_parser_set_input_file(&parser, file);
+    
+    // Mapping depth 1 is the document, 2 a slave, 3 an entry
+    int depth = 0;
+    bool in_slaves = false;
+    bool expect_value = false;
+    char key[32] = "";
+    int dir = -1;
+    pg_key_t entry_key = PG_KEY_NONE;
+    uint16_t slave = 0;
+    uint32_t bit_pos[2] = { 0, 0 };
+    uint32_t values[4] = { 0 };
+    bool has_bits = false;
+    int result = 0;
+    bool done = false;
+    
+    while (!done && result == 0) {
+        yaml_event_t event;
+        if (!yaml_parser_parse(&parser, &event)) {
+            fprintf(stderr, "%s:%zu: %s\n", path, parser.problem_mark.line + 1,
+                    parser.problem ? parser.problem : "parse error");
+            result = -1;
+            break;
+        }
+        
+        switch (event.type) {
+            case YAML_MAPPING_START_EVENT:
+                depth++;
+                expect_value = false;
+                if (depth == 2 && in_slaves) {
+                    slave++;
+                    bit_pos[0] = (bit_pos[0] + 7) & ~7U;
+                    bit_pos[1] = (bit_pos[1] + 7) & ~7U;
+                } else if (depth == 3 && dir >= 0) {
+                    memset(values, 0, sizeof(values));
+                    has_bits = false;
+                }
+                break;
+            
+            case YAML_MAPPING_END_EVENT:
+                if (depth == 3 && dir >= 0) {
+                    if (!has_bits || values[PG_KEY_BITS] == 0 || values[PG_KEY_BITS] > 0xFFFF) {
+                        fprintf(stderr, "%s:%zu: entry needs bits 1-65535\n", path,
+                                event.start_mark.line + 1);
+                        result = -1;
+                    } else if (values[PG_KEY_INDEX] != 0 &&
+                               symbols_add_entry(&g_table, slave, (symbol_dir_t)dir,
+                                                 (uint16_t)values[PG_KEY_INDEX],
+                                                 (uint8_t)values[PG_KEY_SUBINDEX], bit_pos[dir],
+                                                 (uint16_t)values[PG_KEY_BITS]) < 0) {
+                        result = -1;
+                    }
+                    bit_pos[dir] += values[PG_KEY_BITS];
+                }
+                depth--;
+                expect_value = false;
+                break;
+            
+            case YAML_SEQUENCE_END_EVENT:
+                if (depth == 2) {
+                    dir = -1;
+                } else if (depth == 1) {
+                    in_slaves = false;
+                }
+                expect_value = false;
+                break;
+            
+            case YAML_SEQUENCE_START_EVENT:
+                if (depth == 1 && strcmp(key, "slaves") == 0) {
+                    in_slaves = true;
+                } else if (depth == 2 && in_slaves) {
+                    if (strcmp(key, "inputs") == 0) {
+                        dir = SYMBOL_INPUT;
+                    } else if (strcmp(key, "outputs") == 0) {
+                        dir = SYMBOL_OUTPUT;
+                    }
+                }
+                expect_value = false;
+                break;
+            
+            case YAML_SCALAR_EVENT: {
+                const char *text = (const char*)event.data.scalar.value;
+                if (!expect_value) {
+                    snprintf(key, sizeof(key), "%s", text);
+                    entry_key = PG_KEY_NONE;
+                    if (depth == 3 && dir >= 0) {
+                        if (strcmp(key, "index") == 0) entry_key = PG_KEY_INDEX;
+                        else if (strcmp(key, "subindex") == 0) entry_key = PG_KEY_SUBINDEX;
+                        else if (strcmp(key, "bits") == 0) entry_key = PG_KEY_BITS;
+                    }
+                    expect_value = true;
+                } else {
+                    if (entry_key != PG_KEY_NONE) {
+                        char *end;
+                        values[entry_key] = (uint32_t)strtoul(text, &end, 0);
+                        if (*end != '\0') {
+                            fprintf(stderr, "%s:%zu: invalid %s: %s\n", path,
+                                    event.start_mark.line + 1, key, text);
+                            result = -1;
+                        }
+                        if (entry_key == PG_KEY_BITS) has_bits = true;
+                    }
+                    expect_value = false;
+                }
+                break;
+            }
+            
+            case YAML_STREAM_END_EVENT:
+                done = true;
+                break;
+            
+            default:
+                break;
+        }
+        
+        yaml_event_delete(&event);
+    }
+    
+    yaml_parser_delete(&parser);
+    fclose(file);
+    
+    if (result == 0 && g_table.count == 0) {
+        fprintf(stderr, "%s: no PDO entries under slaves\n", path);
+        result = -1;
+    }
+    
+    if (result == 0) result = symbols_build(&g_table);
+    if (result == 0) {
+        fprintf(stderr, "Read %u symbols for %u slaves from %s\n", g_table.count, slave, path);
+    }
+    return result;
+}
+
+static int compare_position(const void *a, const void *b, void *arg) {
+    const symbol_t *entries = arg;
+    const symbol_t *sa = &entries[*(const uint32_t*)a];
+    const symbol_t *sb = &entries[*(const uint32_t*)b];
+    
+    if (sa->dir != sb->dir) return (sa->dir > sb->dir) - (sa->dir < sb->dir);
+    if (sa->slave != sb->slave) return (sa->slave > sb->slave) - (sa->slave < sb->slave);
+    
+    uint64_t pa = (uint64_t)sa->offset * 8 + sa->bit;
+    uint64_t pb = (uint64_t)sb->offset * 8 + sb->bit;
+    return (pa > pb) - (pa < pb);
+}
+
+// "3.in.6000:01" becomes "6000_01", the whole-image symbol "3.in" becomes ""
+static void entry_suffix(const char *name, char *out, size_t size) {
+    const char *entry = strchr(strchr(name, '.') + 1, '.');
+    size_t n = 0;
+    
+    if (entry) {
+        for (const char *p = entry + 1; *p && n + 1 < size; p++) {
+            out[n++] = (*p == ':') ? '_' : (char)toupper((unsigned char)*p);
+        }
+    }
+    out[n] = '\0';
+}
+
+static bool byte_aligned(const symbol_t *symbol) {
+    return symbol->bit == 0 && symbol->bits % 8 == 0;
+}
+
+static const char* member_type(uint16_t bits) {
+    switch (bits) {
+        case 8:  return "uint8_t";
+        case 16: return "uint16_t";
+        case 32: return "uint32_t";
+        case 64: return "uint64_t";
+        default: return NULL;
+    }
+}
+
+// One slave in one direction: a packed struct over the bytes from its first
+// mapped entry, with whole-byte entries as typed members and bit entries
+// left in the raw bytes they occupy
+static void emit_slave(FILE *out, const uint32_t *order, uint32_t count) {
+    const symbol_t *first = &g_table.entries[order[0]];
+    const char *dir = (first->dir == SYMBOL_INPUT) ? "inputs" : "outputs";
+    const char *DIR = (first->dir == SYMBOL_INPUT) ? "IN" : "OUT";
+    uint16_t slave = first->slave;
+    uint32_t base = first->offset;
+    uint32_t cursor = 0;
+    char suffix[24];
+    
+    fprintf(out, "/* Slave %u %s */\n", slave, dir);
+    fprintf(out, "#define EF_S%u_%s_BASE %uu\n", slave, DIR, base);
+    
+    for (uint32_t i = 0; i < count; i++) {
+        const symbol_t *symbol = &g_table.entries[order[i]];
+        entry_suffix(symbols_name(&g_table, symbol), suffix, sizeof(suffix));
+        const char *sep = suffix[0] ? "_" : "";
+        
+        fprintf(out, "#define EF_S%u_%s%s%s_OFFSET %uu\n", slave, DIR, sep, suffix,
+                symbol->offset - base);
+        fprintf(out, "#define EF_S%u_%s%s%s_BIT %uu\n", slave, DIR, sep, suffix, symbol->bit);
+        fprintf(out, "#define EF_S%u_%s%s%s_BITS %uu\n", slave, DIR, sep, suffix, symbol->bits);
+    }
+    
+    fprintf(out, "\ntypedef struct {\n");
+    
+    for (uint32_t i = 0; i < count; i++) {
+        const symbol_t *symbol = &g_table.entries[order[i]];
+        uint32_t start = symbol->offset - base;
+        uint32_t end = (symbol->offset * 8 + symbol->bit + symbol->bits + 7) / 8 - base;
+        
+        if (end <= cursor) continue;
+        
+        if (byte_aligned(symbol) && start >= cursor) {
+            if (start > cursor) fprintf(out, "    uint8_t pad_%u[%u];\n", cursor, start - cursor);
+            
+            entry_suffix(symbols_name(&g_table, symbol), suffix, sizeof(suffix));
+            const char *type = member_type(symbol->bits);
+            if (!suffix[0]) {
+                fprintf(out, "    uint8_t image[%u];\n", symbol->bits / 8);
+            } else if (type) {
+                fprintf(out, "    %s pdo_%s;\n", type, suffix);
+            } else {
+                fprintf(out, "    uint8_t pdo_%s[%u];\n", suffix, symbol->bits / 8);
+            }
+        } else {
+            uint32_t from = (start > cursor) ? start : cursor;
+            if (from > cursor) fprintf(out, "    uint8_t pad_%u[%u];\n", cursor, from - cursor);
+            fprintf(out, "    uint8_t bits_%u[%u];\n", from, end - from);
+        }
+        cursor = end;
+    }
+    
+    fprintf(out, "} ef_s%u_%s_t;\n\n", slave, dir);
+    fprintf(out, "#define EF_S%u_%s_SIZE %uu\n", slave, DIR, cursor);
+    fprintf(out, "_Static_assert(sizeof(ef_s%u_%s_t) == EF_S%u_%s_SIZE, \"slave %u %s size\");\n",
+            slave, dir, slave, DIR, slave, dir);
+    
+    for (uint32_t i = 0; i < count; i++) {
+        const symbol_t *symbol = &g_table.entries[order[i]];
+        entry_suffix(symbols_name(&g_table, symbol), suffix, sizeof(suffix));
+        if (!byte_aligned(symbol) || !suffix[0]) continue;
+        
+        fprintf(out, "_Static_assert(offsetof(ef_s%u_%s_t, pdo_%s) == EF_S%u_%s_%s_OFFSET, "
+                "\"slave %u %s %s\");\n", slave, dir, suffix, slave, DIR, suffix, slave, dir,
+                suffix);
+    }
+    
+    const char *qual = (first->dir == SYMBOL_INPUT) ? "const " : "";
+    fprintf(out, "\nstatic inline %sef_s%u_%s_t *ef_s%u_%s(%svoid *image) {\n", qual, slave, dir,
+            slave, dir, qual);
+    fprintf(out, "    return (%sef_s%u_%s_t *)((%suint8_t *)image + EF_S%u_%s_BASE);\n}\n\n",
+            qual, slave, dir, qual, slave, DIR);
+}
+
+static int emit_header(FILE *out, const char *source) {
+    uint32_t n = g_table.count;
+    uint32_t *order = malloc(n * sizeof(uint32_t));
+    if (!order) return -1;
+    
+    for (uint32_t i = 0; i < n; i++) {
+        order[i] = i;
+    }
+    qsort_r(order, n, sizeof(uint32_t), compare_position, g_table.entries);
+    
+    fprintf(out, "/* Generated by etherforge-pdogen from %s. Do not edit.\n", source);
+    fprintf(out, " *\n");
+    fprintf(out, " * Bind a client to this layout with SYM_LAYOUT and EF_LAYOUT_HASH; the daemon\n");
+    fprintf(out, " * then refuses its PDO and symbol commands while another layout is running.\n");
+    fprintf(out, " * Entries that do not start and end on a byte boundary have no typed member;\n");
+    fprintf(out, " * use their _OFFSET, _BIT and _BITS constants on the raw bytes. */\n");
+    fprintf(out, "#ifndef EF_PDO_LAYOUT_H\n#define EF_PDO_LAYOUT_H\n\n");
+    fprintf(out, "#include <stddef.h>\n#include <stdint.h>\n\n");
+    fprintf(out, "#if !defined(__BYTE_ORDER__) || __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__\n");
+    fprintf(out, "#error \"EtherCAT process data is little-endian\"\n#endif\n\n");
+    fprintf(out, "#define EF_LAYOUT_HASH 0x%08Xu\n\n", g_table.layout_hash);
+    fprintf(out, "#pragma pack(push, 1)\n\n");
+    
+    uint32_t i = 0;
+    while (i < n) {
+        const symbol_t *first = &g_table.entries[order[i]];
+        uint32_t j = i + 1;
+        while (j < n && g_table.entries[order[j]].dir == first->dir &&
+               g_table.entries[order[j]].slave == first->slave) {
+            j++;
+        }
+        emit_slave(out, order + i, j - i);
+        i = j;
+    }
+    
+    fprintf(out, "#pragma pack(pop)\n\n#endif\n");
+    free(order);
+    return ferror(out) ? -1 : 0;
+}
+
+static void print_usage(const char *program_name) {
+    printf("EtherForge PDO layout header generator\n");
+    printf("Usage: %s [OPTIONS]\n", program_name);
+    printf("\nOptions:\n");
+    printf("  -H, --host ADDR        Daemon address (default: 127.0.0.1)\n");
+    printf("  -p, --port PORT        Daemon UDP port (default: %d)\n", PROTOCOL_PORT);
+    printf("  -y, --yaml FILE        Read a slave description instead of asking the daemon\n");
+    printf("  -o, --output FILE      Write the header to FILE (default: stdout)\n");
+    printf("  -t, --timeout-ms MS    Response timeout (default: 500)\n");
+    printf("  -h, --help             Show this help message\n");
+}
+
+int main(int argc, char *argv[]) {
+    memset(&g_opts, 0, sizeof(g_opts));
+    snprintf(g_opts.host, sizeof(g_opts.host), "127.0.0.1");
+    g_opts.port = PROTOCOL_PORT;
+    g_opts.timeout_ms = 500;
+    
+    static struct option long_options[] = {
+        {"host",        required_argument, 0, 'H'},
+        {"port",        required_argument, 0, 'p'},
+        {"yaml",        required_argument, 0, 'y'},
+        {"output",      required_argument, 0, 'o'},
+        {"timeout-ms",  required_argument, 0, 't'},
+        {"help",        no_argument,       0, 'h'},
+        {0, 0, 0, 0}
+    };
+    
+    int c;
+    while ((c = getopt_long(argc, argv, "H:p:y:o:t:h", long_options, NULL)) != -1) {
+        switch (c) {
+            case 'H':
+                snprintf(g_opts.host, sizeof(g_opts.host), "%s", optarg);
+                break;
+            case 'p': g_opts.port = (uint16_t)atoi(optarg); break;
+            case 'y': g_opts.yaml_path = optarg; break;
+            case 'o': g_opts.output_path = optarg; break;
+            case 't': g_opts.timeout_ms = (uint32_t)atoi(optarg); break;
+            case 'h':
+                print_usage(argv[0]);
+                return EXIT_SUCCESS;
+            default:
+                print_usage(argv[0]);
+                return EXIT_FAILURE;
+        }
+    }
+    
+    // The symbol table logs its build; keep that off a header on stdout
+    logging_init(NULL, "warn");
+    
+    char source[128];
+    int result;
+    if (g_opts.yaml_path) {
+        snprintf(source, sizeof(source), "%s", g_opts.yaml_path);
+        result = load_from_yaml(g_opts.yaml_path);
+    } else {
+        snprintf(source, sizeof(source), "daemon at %s:%u", g_opts.host, g_opts.port);
+        result = load_from_daemon();
+    }
+    
+    if (result < 0) {
+        symbols_cleanup(&g_table);
+        return EXIT_FAILURE;
+    }
+    
+    FILE *out = stdout;
+    if (g_opts.output_path) {
+        out = fopen(g_opts.output_path, "w");
+        if (!out) {
+            fprintf(stderr, "Failed to open %s: %s\n", g_opts.output_path, strerror(errno));
+            symbols_cleanup(&g_table);
+            return EXIT_FAILURE;
+        }
+    }
+    
+    result = emit_header(out, source);
+    if (out != stdout && fclose(out) != 0) result = -1;
+    
+    if (result == 0) {
+        fprintf(stderr, "Layout hash 0x%08X\n", g_table.layout_hash);
+    }
+    
+    symbols_cleanup(&g_table);
+    return (result == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
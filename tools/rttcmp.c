@@ -0,0 +1,327 @@
+#include "transport.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <getopt.h>
+#include <poll.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <net/if.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <linux/if_packet.h>
+#include <linux/if_ether.h>
+
+#define RC_ETH_P_ECAT           0x88A4
+#define RC_ECAT_HEADER_LEN      2
+#define RC_DATAGRAM_HDR_LEN     10
+#define RC_CMD_LRW              0x0C
+#define RC_CMD_FRMW             0x0E
+#define RC_MORE_FOLLOWS         0x8000
+
+typedef struct {
+    const char *interface;
+    bool responder;
+    uint32_t frames;
+    uint32_t cycle_us;
+    uint32_t bytes;
+    uint32_t slaves;
+    uint32_t busy_poll_us;
+    uint32_t timeout_us;
+    bool run_socket;
+    bool run_mmap;
+} rc_options_t;
+
+static rc_options_t g_opts;
+static volatile sig_atomic_t g_stop = 0;
+
+static void handle_signal(int sig) {
+    (void)sig;
+    g_stop = 1;
+}
+
+static uint64_t monotonic_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static uint16_t get_le16(const uint8_t *p) {
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static void put_le16(uint8_t *p, uint16_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+}
+
+// Raw EtherCAT socket bound to one interface, the way SOEM opens its port
+static int open_raw_socket(const char *ifname) {
+    int fd = socket(AF_PACKET, SOCK_RAW, htons(RC_ETH_P_ECAT));
+    if (fd < 0) {
+        fprintf(stderr, "socket: %s (needs CAP_NET_RAW)\n", strerror(errno));
+        return -1;
+    }
+    
+    struct sockaddr_ll addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sll_family = AF_PACKET;
+    addr.sll_protocol = htons(RC_ETH_P_ECAT);
+    addr.sll_ifindex = (int)if_nametoindex(ifname);
+    if (addr.sll_ifindex == 0 || bind(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+        fprintf(stderr, "Cannot bind to %s: %s\n", ifname, strerror(errno));
+        close(fd);
+        return -1;
+    }
+    
+    return fd;
+}
+
+// Plays a segment of `slaves` slaves: every LRW comes back with the working
+// counter a full segment would produce, an FRMW of the DC time gets the
+// local clock, and the returning frame has its source address marked as a
+// real segment does
+static int run_responder(void) {
+    int fd = open_raw_socket(g_opts.interface);
+    if (fd < 0) return EXIT_FAILURE;
+    
+    printf("Answering EtherCAT frames on %s as %u slaves\n", g_opts.interface, g_opts.slaves);
+    
+    uint8_t frame[2048];
+    uint64_t answered = 0;
+    
+    while (!g_stop) {
+        struct sockaddr_ll from;
+        socklen_t from_len = sizeof(from);
+        ssize_t len = recvfrom(fd, frame, sizeof(frame), 0, (struct sockaddr*)&from, &from_len);
+        if (len < 0) {
+            if (errno == EINTR) continue;
+            if (errno != ENETDOWN) fprintf(stderr, "recv: %s\n", strerror(errno));
+            break;
+        }
+        
+        if (from.sll_pkttype == PACKET_OUTGOING ||
+            len < ETH_HLEN + RC_ECAT_HEADER_LEN + RC_DATAGRAM_HDR_LEN + 2) {
+            continue;
+        }
+        
+        uint8_t *dg = frame + ETH_HLEN + RC_ECAT_HEADER_LEN;
+        uint8_t *end = frame + len;
+        while (dg + RC_DATAGRAM_HDR_LEN + 2 <= end) {
+            uint16_t flags = get_le16(dg + 6);
+            uint16_t dlen = flags & 0x07FF;
+            uint8_t *wkc = dg + RC_DATAGRAM_HDR_LEN + dlen;
+            if (wkc + 2 > end) break;
+            
+            if (dg[0] == RC_CMD_LRW) {
+                put_le16(wkc, (uint16_t)(get_le16(wkc) + g_opts.slaves * 3));
+            } else if (dg[0] == RC_CMD_FRMW && dlen == 8) {
+                uint64_t now = monotonic_ns();
+                memcpy(dg + RC_DATAGRAM_HDR_LEN, &now, sizeof(now));
+                put_le16(wkc, (uint16_t)(get_le16(wkc) + 1));
+            }
+            
+            if (!(flags & RC_MORE_FOLLOWS)) break;
+            dg = wkc + 2;
+        }
+        
+        frame[6] |= 0x02;
+        if (send(fd, frame, (size_t)len, 0) == len) {
+            answered++;
+        }
+    }
+    
+    printf("Answered %llu frames\n", (unsigned long long)answered);
+    close(fd);
+    return EXIT_SUCCESS;
+}
+
+// One LRW round trip over a plain raw socket: send, then poll and read until
+// the reply with our index comes back, which is what SOEM's transport does
+static int socket_exchange(int fd, const uint8_t *src_mac, uint8_t index, uint8_t *data,
+                           transport_stats_t *stats) {
+    uint8_t frame[TRANSPORT_FRAME_SIZE];
+    uint32_t len = transport_format_frame(frame, src_mac, index, 0, data, g_opts.bytes, NULL, 0,
+                                          0, 0);
+    
+    uint64_t start = monotonic_ns();
+    uint64_t deadline = start + (uint64_t)g_opts.timeout_us * 1000ULL;
+    if (send(fd, frame, len, 0) != (ssize_t)len) return -1;
+    stats->frames_sent++;
+    
+    for (;;) {
+        uint64_t now = monotonic_ns();
+        if (now >= deadline) {
+            stats->rx_timeouts++;
+            return -1;
+        }
+        
+        struct pollfd pfd = { .fd = fd, .events = POLLIN };
+        struct timespec wait = { 0, (long)(deadline - now) };
+        if (ppoll(&pfd, 1, &wait, NULL) <= 0) continue;
+        
+        struct sockaddr_ll from;
+        socklen_t from_len = sizeof(from);
+        ssize_t got = recvfrom(fd, frame, sizeof(frame), MSG_DONTWAIT, (struct sockaddr*)&from,
+                               &from_len);
+        const uint8_t *dg = frame + ETH_HLEN + RC_ECAT_HEADER_LEN;
+        if (got < ETH_HLEN + RC_ECAT_HEADER_LEN + RC_DATAGRAM_HDR_LEN + 2 ||
+            from.sll_pkttype == PACKET_OUTGOING || dg[0] != RC_CMD_LRW || dg[1] != index) {
+            continue;
+        }
+        
+        stats->frames_received++;
+        transport_record_rtt(stats, (uint32_t)((monotonic_ns() - start) / 1000));
+        return get_le16(dg + RC_DATAGRAM_HDR_LEN + g_opts.bytes);
+    }
+}
+
+static void wait_cycle(uint64_t *next) {
+    *next += (uint64_t)g_opts.cycle_us * 1000ULL;
+    struct timespec ts = { (time_t)(*next / 1000000000ULL), (long)(*next % 1000000000ULL) };
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR && !g_stop) {
+    }
+}
+
+static void print_result(const char *label, const transport_stats_t *stats, uint32_t bad_wkc) {
+    printf("  %-22s %8u %8u %8u %8u %8u %8u\n", label, stats->rtt_samples, stats->rx_timeouts,
+           bad_wkc, transport_rtt_percentile(stats, 500), transport_rtt_percentile(stats, 990),
+           stats->rtt_max_us);
+}
+
+static int run_socket(transport_stats_t *stats, uint32_t *bad_wkc) {
+    int fd = open_raw_socket(g_opts.interface);
+    if (fd < 0) return -1;
+    
+    uint8_t data[TRANSPORT_MAX_DATA];
+    memset(data, 0, sizeof(data));
+    uint8_t index = 0;
+    uint64_t next = monotonic_ns();
+    
+    for (uint32_t i = 0; i < g_opts.frames && !g_stop; i++) {
+        int wkc = socket_exchange(fd, NULL, (uint8_t)(TRANSPORT_INDEX_BASE + index), data, stats);
+        index = (uint8_t)((index + 1) % TRANSPORT_INDEX_COUNT);
+        if (wkc >= 0 && wkc != (int)(g_opts.slaves * 3)) (*bad_wkc)++;
+        wait_cycle(&next);
+    }
+    
+    close(fd);
+    return 0;
+}
+
+static int run_mmap(transport_stats_t *stats, uint32_t *bad_wkc) {
+    transport_t t;
+    memset(&t, 0, sizeof(t));
+    t.fd = -1;
+    if (transport_open(&t, g_opts.interface, g_opts.busy_poll_us) < 0) return -1;
+    
+    uint8_t data[TRANSPORT_MAX_DATA];
+    memset(data, 0, sizeof(data));
+    uint64_t next = monotonic_ns();
+    
+    for (uint32_t i = 0; i < g_opts.frames && !g_stop; i++) {
+        int wkc = transport_exchange(&t, stats, 0, data, g_opts.bytes, 0, NULL, g_opts.timeout_us);
+        if (wkc >= 0 && wkc != (int)(g_opts.slaves * 3)) (*bad_wkc)++;
+        wait_cycle(&next);
+    }
+    
+    transport_close(&t);
+    return 0;
+}
+
+static void print_usage(const char *program_name) {
+    printf("EtherForge transport round-trip comparison\n");
+    printf("Usage: %s [OPTIONS] INTERFACE\n", program_name);
+    printf("\nOptions:\n");
+    printf("  -r, --responder        Answer EtherCAT frames on INTERFACE instead of measuring\n");
+    printf("  -n, --frames N         Round trips per transport (default: 10000)\n");
+    printf("  -c, --cycle-us US      Spacing between round trips (default: 1000)\n");
+    printf("  -b, --bytes N          LRW data bytes (default: 64)\n");
+    printf("  -s, --slaves N         Slaves the responder plays (default: 8)\n");
+    printf("  -p, --busy-poll-us US  SO_BUSY_POLL for the mmap transport (default: 0)\n");
+    printf("  -t, --timeout-us US    Receive timeout per round trip (default: 1000)\n");
+    printf("  -m, --mode MODE        socket, mmap or both (default: both)\n");
+    printf("  -h, --help             Show this help message\n");
+}
+
+int main(int argc, char *argv[]) {
+    memset(&g_opts, 0, sizeof(g_opts));
+    g_opts.frames = 10000;
+    g_opts.cycle_us = 1000;
+    g_opts.bytes = 64;
+    g_opts.slaves = 8;
+    g_opts.timeout_us = 1000;
+    g_opts.run_socket = true;
+    g_opts.run_mmap = true;
+    
+    static struct option long_options[] = {
+        {"responder",    no_argument,       0, 'r'},
+        {"frames",       required_argument, 0, 'n'},
+        {"cycle-us",     required_argument, 0, 'c'},
+        {"bytes",        required_argument, 0, 'b'},
+        {"slaves",       required_argument, 0, 's'},
+        {"busy-poll-us", required_argument, 0, 'p'},
+        {"timeout-us",   required_argument, 0, 't'},
+        {"mode",         required_argument, 0, 'm'},
+        {"help",         no_argument,       0, 'h'},
+        {0, 0, 0, 0}
+    };
+    
+    int c;
+    while ((c = getopt_long(argc, argv, "rn:c:b:s:p:t:m:h", long_options, NULL)) != -1) {
+        switch (c) {
+            case 'r': g_opts.responder = true; break;
+            case 'n': g_opts.frames = (uint32_t)atoi(optarg); break;
+            case 'c': g_opts.cycle_us = (uint32_t)atoi(optarg); break;
+            case 'b': g_opts.bytes = (uint32_t)atoi(optarg); break;
+            case 's': g_opts.slaves = (uint32_t)atoi(optarg); break;
+            case 'p': g_opts.busy_poll_us = (uint32_t)atoi(optarg); break;
+            case 't': g_opts.timeout_us = (uint32_t)atoi(optarg); break;
+            case 'm':
+                g_opts.run_socket = strcmp(optarg, "mmap") != 0;
+                g_opts.run_mmap = strcmp(optarg, "socket") != 0;
+                if (strcmp(optarg, "socket") != 0 && strcmp(optarg, "mmap") != 0 &&
+                    strcmp(optarg, "both") != 0) {
+                    fprintf(stderr, "Unknown mode: %s\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'h':
+                print_usage(argv[0]);
+                return EXIT_SUCCESS;
+            default:
+                print_usage(argv[0]);
+                return EXIT_FAILURE;
+        }
+    }
+    
+    if (optind != argc - 1 || g_opts.frames == 0 || g_opts.bytes == 0 ||
+        g_opts.bytes > TRANSPORT_MAX_DATA || g_opts.timeout_us == 0) {
+        print_usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+    g_opts.interface = argv[optind];
+    
+    signal(SIGINT, handle_signal);
+    signal(SIGTERM, handle_signal);
+    
+    if (g_opts.responder) return run_responder();
+    
+    static transport_stats_t socket_stats, mmap_stats;
+    uint32_t socket_bad = 0, mmap_bad = 0;
+    
+    if (g_opts.run_socket && run_socket(&socket_stats, &socket_bad) < 0) return EXIT_FAILURE;
+    if (g_opts.run_mmap && run_mmap(&mmap_stats, &mmap_bad) < 0) return EXIT_FAILURE;
+    
+    printf("%u round trips of %u bytes every %u us on %s (RTT in us)\n", g_opts.frames,
+           g_opts.bytes, g_opts.cycle_us, g_opts.interface);
+    printf("  %-22s %8s %8s %8s %8s %8s %8s\n", "transport", "samples", "timeouts", "bad wkc",
+           "p50", "p99", "max");
+    if (g_opts.run_socket) print_result("socket (SOEM style)", &socket_stats, socket_bad);
+    if (g_opts.run_mmap) print_result("mmap", &mmap_stats, mmap_bad);
+    
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,26 @@
+#!/bin/sh
+# Compares p99 round-trip times of the socket and mmap transports over a veth
+# pair, with etherforge-rtt answering as the segment on the far end.
+# Needs root (or CAP_NET_ADMIN and CAP_NET_RAW). Extra arguments go to the
+# measuring side, e.g. `tools/veth-rtt.sh -n 50000 -p 50`.
+set -e
+
+RTT=${RTT:-./build/etherforge-rtt}
+MASTER=${MASTER:-efrtt0}
+SEGMENT=${SEGMENT:-efrtt1}
+
+cleanup() {
+    [ -n "$RESPONDER" ] && kill "$RESPONDER" 2>/dev/null
+    ip link del "$MASTER" 2>/dev/null || true
+}
+trap cleanup EXIT INT TERM
+
+ip link add "$MASTER" type veth peer name "$SEGMENT"
+ip link set "$MASTER" up
+ip link set "$SEGMENT" up
+
+"$RTT" --responder "$SEGMENT" >/dev/null &
+RESPONDER=$!
+sleep 0.5
+
+"$RTT" "$@" "$MASTER"